@@ -102,18 +102,27 @@ xmmsc_ipc_io_out (xmmsc_ipc_t *ipc)
 int
 xmmsc_ipc_io_out_callback (xmmsc_ipc_t *ipc)
 {
+	xmms_ipc_msg_t *msgs[XMMS_IPC_TRANSPORT_MAX_IOV];
 	bool disco = false;
+	bool done = true;
+	x_list_t *l;
+	int i, n, written;
 
 	x_return_val_if_fail (ipc, false);
 	x_return_val_if_fail (!ipc->disconnect, false);
 
-	while (!x_queue_is_empty (ipc->out_msg)) {
-		xmms_ipc_msg_t *msg = x_queue_peek_head (ipc->out_msg);
-		if (xmms_ipc_msg_write_transport (msg, ipc->transport, &disco)) {
+	while (done && !x_queue_is_empty (ipc->out_msg)) {
+		n = 0;
+		for (l = ipc->out_msg->head; l && n < XMMS_IPC_TRANSPORT_MAX_IOV; l = l->next) {
+			msgs[n++] = l->data;
+		}
+
+		done = xmms_ipc_msg_write_transport_many (msgs, n, ipc->transport,
+		                                          &written, &disco);
+
+		for (i = 0; i < written; i++) {
 			x_queue_pop_head (ipc->out_msg);
-			xmms_ipc_msg_destroy (msg);
-		} else {
-			break;
+			xmms_ipc_msg_destroy (msgs[i]);
 		}
 	}
 
@@ -135,6 +144,13 @@ xmmsc_ipc_fd_get (xmmsc_ipc_t *ipc)
 	return xmms_ipc_transport_fd_get (ipc->transport);
 }
 
+bool
+xmmsc_ipc_can_pass_fds (xmmsc_ipc_t *ipc)
+{
+	x_return_val_if_fail (ipc, false);
+	return xmms_ipc_transport_can_pass_fds (ipc->transport);
+}
+
 
 const char *
 xmmsc_ipc_error_get (xmmsc_ipc_t *ipc)
@@ -99,6 +99,20 @@ xmmsc_medialib_move_entry (xmmsc_connection_t *conn, int entry, const char *url)
 	                       XMMSV_LIST_END);
 }
 
+/**
+ * Retrieve statistics about the server's cache of compiled query plans.
+ * @param conn The #xmmsc_connection_t
+ */
+xmmsc_result_t *
+xmmsc_medialib_get_query_stats (xmmsc_connection_t *conn)
+{
+	x_check_conn (conn, NULL);
+
+	return xmmsc_send_cmd (conn, XMMS_IPC_OBJECT_MEDIALIB,
+	                       XMMS_IPC_COMMAND_MEDIALIB_GET_QUERY_STATS,
+	                       XMMSV_LIST_END);
+}
+
 /**
  * Remove a entry from the medialib
  * @param conn The #xmmsc_connection_t
@@ -253,6 +267,73 @@ xmmsc_medialib_import_path_encoded (xmmsc_connection_t *conn,
 	return do_methodcall (conn, XMMS_IPC_COMMAND_MEDIALIB_IMPORT_PATH, path);
 }
 
+/**
+ * Import all files recursively from the directory passed as argument,
+ * without waiting for the import to finish. The result is the id of
+ * the import job, its progress is reported by the
+ * #xmmsc_broadcast_medialib_import_progress broadcast.
+ *
+ * @param conn #xmmsc_connection_t
+ * @param path A directory to recursive search for mediafiles, this must
+ * 		  include the protocol, i.e file://
+ */
+xmmsc_result_t *
+xmmsc_medialib_import_path_async (xmmsc_connection_t *conn, const char *path)
+{
+	xmmsc_result_t *res;
+	char *enc_path;
+
+	x_check_conn (conn, NULL);
+
+	enc_path = xmmsv_encode_url (path);
+	if (!enc_path)
+		return NULL;
+
+	res = xmmsc_medialib_import_path_async_encoded (conn, enc_path);
+
+	free (enc_path);
+
+	return res;
+}
+
+/**
+ * Same as #xmmsc_medialib_import_path_async but expects an encoded
+ * URL instead.
+ *
+ * @param conn #xmmsc_connection_t
+ * @param path A directory to recursive search for mediafiles, this must
+ * 		  include the protocol, i.e file://
+ */
+xmmsc_result_t *
+xmmsc_medialib_import_path_async_encoded (xmmsc_connection_t *conn,
+                                          const char *path)
+{
+	x_check_conn (conn, NULL);
+
+	if (!_xmmsc_medialib_verify_url (path))
+		x_api_error ("with a non encoded url", NULL);
+
+	return do_methodcall (conn, XMMS_IPC_COMMAND_MEDIALIB_IMPORT_PATH_ASYNC, path);
+}
+
+/**
+ * Cancel an import started with #xmmsc_medialib_import_path_async.
+ * Files that were already added stay in the medialib.
+ *
+ * @param conn #xmmsc_connection_t
+ * @param job The id of the import job
+ */
+xmmsc_result_t *
+xmmsc_medialib_import_cancel (xmmsc_connection_t *conn, int job)
+{
+	x_check_conn (conn, NULL);
+
+	return xmmsc_send_cmd (conn, XMMS_IPC_OBJECT_MEDIALIB,
+	                       XMMS_IPC_COMMAND_MEDIALIB_IMPORT_CANCEL,
+	                       XMMSV_LIST_ENTRY_INT (job),
+	                       XMMSV_LIST_END);
+}
+
 /**
  * Import a all files recursivly from the directory passed
  * as argument.
@@ -328,6 +409,20 @@ xmmsc_broadcast_medialib_entry_added (xmmsc_connection_t *c)
 	return xmmsc_send_broadcast_msg (c, XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED);
 }
 
+/**
+ * Request the medialib_import_progress broadcast. This will be called
+ * while an import started with #xmmsc_medialib_import_path_async is
+ * running, and when it has finished. The argument is a dict with the
+ * "id", "path" and "status" of the job and its counters.
+ */
+xmmsc_result_t *
+xmmsc_broadcast_medialib_import_progress (xmmsc_connection_t *c)
+{
+	x_check_conn (c, NULL);
+
+	return xmmsc_send_broadcast_msg (c, XMMS_IPC_SIGNAL_MEDIALIB_IMPORT_PROGRESS);
+}
+
 /**
  * Request the medialib_entry_updated broadcast. This will be called
  * if a entry changes on the serverside. The argument will be an medialib
@@ -239,6 +239,36 @@ xmmsc_playlist_list_entries (xmmsc_connection_t *c, const char *playlist)
 	                       XMMSV_LIST_ENTRY_STR (playlist), XMMSV_LIST_END);
 }
 
+/**
+ * List the changes made to a playlist since a generation.
+ *
+ * The generation is the one carried by the last playlist changed
+ * broadcast or list_changes result the client has seen. The result is
+ * a dict holding the current "generation" and either a list of
+ * "changes" to apply, or all "entries" of the playlist when the
+ * server no longer remembers that far back.
+ *
+ * @param c The connection structure.
+ * @param playlist The playlist, or NULL for the active playlist.
+ * @param generation The last known generation, or 0 to fetch all entries.
+ */
+xmmsc_result_t *
+xmmsc_playlist_list_changes (xmmsc_connection_t *c, const char *playlist, int64_t generation)
+{
+	x_check_conn (c, NULL);
+
+	/* default to the active playlist */
+	if (playlist == NULL) {
+		playlist = XMMS_ACTIVE_PLAYLIST;
+	}
+
+	return xmmsc_send_cmd (c, XMMS_IPC_OBJECT_PLAYLIST,
+	                       XMMS_IPC_COMMAND_PLAYLIST_LIST_CHANGES,
+	                       XMMSV_LIST_ENTRY_STR (playlist),
+	                       XMMSV_LIST_ENTRY_INT (generation),
+	                       XMMSV_LIST_END);
+}
+
 /**
  * Insert a medialib id at given position in playlist.
  *
@@ -131,8 +131,17 @@ xmmsc_visualization_start (xmmsc_connection_t *c, int vv)
 	case VIS_ERRORED:
 		break;
 	case VIS_NEW:
+		/* first try a memfd ring, only possible over a local socket */
+		v->type = VIS_MEMFD;
+		res = setup_memfd_prepare (c, vv);
+		if (res) {
+			v->state = VIS_TRYING_MEMFD;
+			break;
+		}
+		/* fall through */
+	case VIS_TO_TRY_UNIXSHM:
 #ifdef HAVE_SEMTIMEDOP
-		/* first try unixshm */
+		/* then try unixshm */
 		v->type = VIS_UNIXSHM;
 		res = setup_shm_prepare (c, vv);
 		if (res) {
@@ -175,6 +184,14 @@ xmmsc_visualization_start_handle (xmmsc_connection_t *c, xmmsc_result_t *res)
 	case VIS_WORKING:
 	case VIS_ERRORED:
 		break;
+	case VIS_TRYING_MEMFD:
+		ret = setup_memfd_handle (res);
+		if (!ret) {
+			v->state = VIS_TO_TRY_UNIXSHM;
+		} else {
+			v->state = VIS_WORKING;
+		}
+		break;
 	case VIS_TRYING_UNIXSHM:
 		ret = setup_shm_handle (res);
 		if (!ret) {
@@ -296,6 +313,9 @@ xmmsc_visualization_shutdown (xmmsc_connection_t *c, int vv)
 	if (v->type == VIS_UDP) {
 		cleanup_udp (&v->transport.udp);
 	}
+	if (v->type == VIS_MEMFD) {
+		cleanup_memfd (&v->transport.memfd);
+	}
 
 	free (v);
 	c->visv[vv] = NULL;
@@ -308,6 +328,8 @@ package_read_do (xmmsc_visualization_t *v, short *buffer, int drawtime, unsigned
 		return read_do_shm (&v->transport.shm, v, buffer, drawtime, blocking);
 	} else if (v->type == VIS_UDP) {
 		return read_do_udp (&v->transport.udp, v, buffer, drawtime, blocking);
+	} else if (v->type == VIS_MEMFD) {
+		return read_do_memfd (&v->transport.memfd, v, buffer, drawtime, blocking);
 	}
 
 	return -1;
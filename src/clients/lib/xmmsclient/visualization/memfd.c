@@ -0,0 +1,213 @@
+#define _GNU_SOURCE /* memfd_create is a GNU extension */
+#include <xmmsclientpriv/visualization/common.h>
+#include <xmmsclientpriv/xmmsclient_ipc.h>
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <errno.h>
+
+xmmsc_result_t *
+setup_memfd_prepare (xmmsc_connection_t *c, int32_t vv)
+{
+	xmmsc_result_t *res;
+	xmmsc_vis_memfd_t *t;
+	xmmsc_visualization_t *v;
+	xmms_ipc_msg_t *msg;
+	xmmsv_t *args;
+	size_t length;
+	int memfd, sv[2];
+
+	x_check_conn (c, 0);
+	v = get_dataset (c, vv);
+
+	/* descriptors can only travel over a local socket */
+	if (!xmmsc_ipc_can_pass_fds (c->ipc)) {
+		return NULL;
+	}
+
+	t = &v->transport.memfd;
+	length = XMMS_VISPACKET_MEMFD_LENGTH (XMMS_VISPACKET_MEMFD_COUNT);
+
+	memfd = memfd_create ("xmms2-vis", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (memfd == -1) {
+		return NULL;
+	}
+
+	if (ftruncate (memfd, length) == -1 ||
+	    fcntl (memfd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+		close (memfd);
+		return NULL;
+	}
+
+	t->ring = mmap (NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if (t->ring == MAP_FAILED) {
+		close (memfd);
+		return NULL;
+	}
+	t->length = length;
+	t->size = XMMS_VISPACKET_MEMFD_COUNT;
+	t->pos = 0;
+
+	/* a fresh memfd is zero filled, so all slots are empty */
+	t->ring->magic = XMMS_VISPACKET_MEMFD_MAGIC;
+	t->ring->size = XMMS_VISPACKET_MEMFD_COUNT;
+
+	/* the server watches its end to notice when we are gone, and we
+	   watch ours to notice when the server is */
+	if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+		munmap (t->ring, length);
+		close (memfd);
+		return NULL;
+	}
+	t->alive = sv[0];
+
+	msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_VISUALIZATION,
+	                        XMMS_IPC_COMMAND_VISUALIZATION_INIT_MEMFD);
+	args = xmmsv_build_list (XMMSV_LIST_ENTRY_INT (v->id), XMMSV_LIST_END);
+	xmms_ipc_msg_put_value (msg, args);
+	xmmsv_unref (args);
+
+	/* the message owns the descriptors from here on */
+	xmms_ipc_msg_add_fd (msg, memfd);
+	xmms_ipc_msg_add_fd (msg, sv[1]);
+
+	res = xmmsc_send_msg (c, msg);
+	if (res) {
+		xmmsc_result_visc_set (res, v);
+	}
+
+	return res;
+}
+
+bool
+setup_memfd_handle (xmmsc_result_t *res)
+{
+	xmmsc_visualization_t *visc;
+	xmmsc_vis_memfd_t *t;
+
+	visc = xmmsc_result_visc_get (res);
+	if (!visc) {
+		x_api_error_if (1, "non vis result?", -1);
+	}
+
+	t = &visc->transport.memfd;
+
+	if (xmmsc_result_iserror (res)) {
+		cleanup_memfd (t);
+		return false;
+	}
+
+	return true;
+}
+
+void
+cleanup_memfd (xmmsc_vis_memfd_t *t)
+{
+	munmap (t->ring, t->length);
+	close (t->alive);
+}
+
+static bool
+server_alive (xmmsc_vis_memfd_t *t)
+{
+	struct pollfd pfd = { t->alive, 0, 0 };
+
+	while (poll (&pfd, 1, 0) == -1) {
+		if (errno != EINTR) {
+			return false;
+		}
+	}
+
+	return !(pfd.revents & (POLLHUP | POLLERR | POLLNVAL));
+}
+
+/**
+ * Sleeps until the server wrote past pos, or blocking ms passed.
+ * Returns 1 if there is a chunk, 0 on timeout and -1 if the server
+ * went away.
+ */
+static int
+wait_written (xmmsc_vis_memfd_t *t, unsigned int blocking)
+{
+	xmmsc_vis_memfd_ring_t *ring = t->ring;
+	struct timespec time;
+	uint32_t written;
+
+	written = __atomic_load_n (&ring->written, __ATOMIC_ACQUIRE);
+	if (written != t->pos) {
+		return 1;
+	}
+
+	if (blocking) {
+		time.tv_sec = blocking / 1000;
+		time.tv_nsec = (blocking % 1000) * 1000000;
+
+		__atomic_store_n (&ring->waiting, 1, __ATOMIC_SEQ_CST);
+		/* the server may have written before it saw us waiting */
+		written = __atomic_load_n (&ring->written, __ATOMIC_SEQ_CST);
+		if (written == t->pos) {
+			syscall (SYS_futex, &ring->written, FUTEX_WAIT, written, &time, NULL, 0);
+		}
+		__atomic_store_n (&ring->waiting, 0, __ATOMIC_SEQ_CST);
+
+		written = __atomic_load_n (&ring->written, __ATOMIC_ACQUIRE);
+		if (written != t->pos) {
+			return 1;
+		}
+	}
+
+	return server_alive (t) ? 0 : -1;
+}
+
+int
+read_do_memfd (xmmsc_vis_memfd_t *t, xmmsc_visualization_t *v, short *buffer, int drawtime, unsigned int blocking)
+{
+	xmmsc_vis_memfd_ring_t *ring = t->ring;
+	xmmsc_vis_memfd_slot_t *slot;
+	xmmsc_vischunk_t chunk;
+	uint32_t written, seq;
+	int ret, i, size;
+
+	ret = wait_written (t, blocking);
+	if (ret < 1) {
+		return ret;
+	}
+
+	/* when we fell a whole ring behind, skip to the oldest chunk left */
+	written = __atomic_load_n (&ring->written, __ATOMIC_ACQUIRE);
+	if (written - t->pos > t->size) {
+		t->pos = written - t->size;
+	}
+
+	slot = &ring->slots[t->pos % t->size];
+	seq = 2 * t->pos + 2;
+	t->pos++;
+
+	if (__atomic_load_n (&slot->seq, __ATOMIC_ACQUIRE) != seq) {
+		/* overwritten while we looked */
+		return 0;
+	}
+	memcpy (&chunk, &slot->chunk, sizeof (chunk));
+	__atomic_thread_fence (__ATOMIC_ACQUIRE);
+	if (__atomic_load_n (&slot->seq, __ATOMIC_RELAXED) != seq) {
+		return 0;
+	}
+
+	if (check_drawtime (net2ts (chunk.timestamp), drawtime)) {
+		return 0;
+	}
+
+	size = ntohs (chunk.size);
+	for (i = 0; i < size; ++i) {
+		buffer[i] = (int16_t)ntohs (chunk.data[i]);
+	}
+
+	return size;
+}
@@ -0,0 +1,24 @@
+#include <xmmsclientpriv/visualization/common.h>
+
+xmmsc_result_t *
+setup_memfd_prepare (xmmsc_connection_t *c, int32_t vv)
+{
+	return NULL;
+}
+
+bool
+setup_memfd_handle (xmmsc_result_t *res)
+{
+	return false;
+}
+
+void
+cleanup_memfd (xmmsc_vis_memfd_t *t)
+{
+}
+
+int
+read_do_memfd (xmmsc_vis_memfd_t *t, xmmsc_visualization_t *v, short *buffer, int drawtime, unsigned int blocking)
+{
+	return -1;
+}
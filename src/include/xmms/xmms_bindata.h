@@ -25,6 +25,7 @@ G_BEGIN_DECLS
 
 gchar *xmms_bindata_calculate_md5 (const guchar *data, gsize size, gchar ret[33]) XMMS_PUBLIC;
 gboolean xmms_bindata_plugin_add (const guchar *data, gsize size, gchar hash[33]) XMMS_PUBLIC;
+gboolean xmms_bindata_plugin_get (const gchar *hash, guchar **data, gsize *size) XMMS_PUBLIC;
 
 G_END_DECLS
 
@@ -45,7 +45,7 @@ typedef struct xmms_output_St xmms_output_t;
 /**
  * The current API version.
  */
-#define XMMS_OUTPUT_API_VERSION 8
+#define XMMS_OUTPUT_API_VERSION 9
 
 struct xmms_output_plugin_St;
 typedef struct xmms_output_plugin_St xmms_output_plugin_t;
@@ -212,6 +212,24 @@ typedef struct xmms_output_methods_St {
 	 * @return the number of bytes in the soundcard buffer or 0 on failure
 	 */
 	guint (*latency_get)(xmms_output_t *);
+
+	/**
+	 * Start or stop reporting volume changes.
+	 *
+	 * When enabled the plugin should call #xmms_output_volume_changed
+	 * whenever the volume of the output device changes, for example
+	 * when another application touches the mixer. After the function
+	 * has returned with enable set to FALSE no more notifications may
+	 * be sent. Plugins that can't tell when the volume changes should
+	 * not provide this function, or return FALSE, and the volume will
+	 * be polled instead. If watching the volume fails later on, the
+	 * plugin should call #xmms_output_volume_monitor_failed.
+	 *
+	 * @param output an output object
+	 * @param enable TRUE to start reporting changes, FALSE to stop
+	 * @return TRUE if volume changes will be reported, otherwise FALSE
+	 */
+	gboolean (*volume_monitor)(xmms_output_t *output, gboolean enable);
 } xmms_output_methods_t;
 
 /**
@@ -310,6 +328,32 @@ void xmms_output_stream_type_add (xmms_output_t *output, ...) XMMS_PUBLIC;
  */
 gint xmms_output_read (xmms_output_t *output, char *buffer, gint len) XMMS_PUBLIC;
 
+/**
+ * Get a pointer to data in the output buffer without copying it.
+ *
+ * Like #xmms_output_read, but instead of copying the data into a
+ * buffer, a pointer to the data inside the output buffer is returned.
+ * The region holds whole frames only, and may be shorter than
+ * requested if the data wraps around the end of the output buffer.
+ * If 0 is returned while data is available, the next frame is split
+ * by the end of the buffer and has to be fetched with
+ * #xmms_output_read. Release the data with #xmms_output_read_consume.
+ *
+ * @param output an output object
+ * @param buffer where to store a pointer to the data
+ * @param len the maximum number of bytes wanted
+ * @return the number of bytes available at buffer, or -1 at end of stream
+ */
+gint xmms_output_read_region (xmms_output_t *output, gconstpointer *buffer, gint len) XMMS_PUBLIC;
+
+/**
+ * Release data returned by #xmms_output_read_region.
+ *
+ * @param output an output object
+ * @param len the number of bytes that were written to the soundcard
+ */
+void xmms_output_read_consume (xmms_output_t *output, gint len) XMMS_PUBLIC;
+
 /**
  * Gets Number of available bytes in the output buffer
  *
@@ -335,6 +379,29 @@ gint xmms_output_bytes_available (xmms_output_t *output) XMMS_PUBLIC;
  */
 void xmms_output_set_error (xmms_output_t *output, xmms_error_t *error) XMMS_PUBLIC;
 
+/**
+ * Tell the output that the volume has changed.
+ *
+ * Used by plugins that provide #volume_monitor. The volume is read
+ * back using #volume_get and broadcasted to the clients if it differs
+ * from the last known volume. This may be called from any thread, and
+ * never blocks on the plugin.
+ *
+ * @param output an output object
+ */
+void xmms_output_volume_changed (xmms_output_t *output) XMMS_PUBLIC;
+
+/**
+ * Tell the output that volume changes can no longer be reported.
+ *
+ * Used by plugins that provide #volume_monitor when watching the
+ * device fails. The volume is polled using #volume_get from then on.
+ * The plugin is still told to stop reporting changes as usual.
+ *
+ * @param output an output object
+ */
+void xmms_output_volume_monitor_failed (xmms_output_t *output) XMMS_PUBLIC;
+
 /**
  * Check if an output plugin needs format updates on each track change.
  *
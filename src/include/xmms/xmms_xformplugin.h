@@ -429,6 +429,17 @@ xmms_config_property_t *xmms_xform_config_lookup (xmms_xform_t *xform, const gch
  * @returns
  */
 xmms_medialib_entry_t xmms_xform_entry_get (xmms_xform_t *xform) XMMS_PUBLIC;
+/**
+ * Get a string property stored in the medialib for the entry played
+ * by this xform, for instance one saved by the plugin on an earlier
+ * run. Only valid during init, later on the entry may already have
+ * been refreshed with the current metadata.
+ *
+ * @param xform
+ * @param key Property to look up.
+ * @returns A newly allocated string, or NULL if not set.
+ */
+gchar *xmms_xform_entry_property_get_str (xmms_xform_t *xform, const gchar *key) XMMS_PUBLIC;
 const gchar *xmms_xform_get_url (xmms_xform_t *xform) XMMS_PUBLIC;
 
 #define XMMS_XFORM_BROWSE_FLAG_DIR (1 << 0)
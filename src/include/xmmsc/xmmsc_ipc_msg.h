@@ -27,6 +27,7 @@
 
 #define XMMS_IPC_MSG_DEFAULT_SIZE 128 /*32768*/
 #define XMMS_IPC_MSG_HEAD_LEN 16 /* all but data */
+#define XMMS_IPC_MSG_READ_CHUNK 65536 /* smallest step a body is read in */
 
 typedef struct xmms_ipc_msg_St xmms_ipc_msg_t;
 
@@ -38,7 +39,12 @@ void xmms_ipc_msg_set_cookie (xmms_ipc_msg_t *msg, uint32_t cookie);
 xmms_ipc_msg_t *xmms_ipc_msg_new (uint32_t object, uint32_t cmd);
 xmms_ipc_msg_t * xmms_ipc_msg_alloc (void);
 void xmms_ipc_msg_destroy (xmms_ipc_msg_t *msg);
+xmms_ipc_msg_t *xmms_ipc_msg_copy_shared (xmms_ipc_msg_t *msg, uint32_t cookie);
 
+bool xmms_ipc_msg_add_fd (xmms_ipc_msg_t *msg, int fd);
+int xmms_ipc_msg_take_fd (xmms_ipc_msg_t *msg);
+
+bool xmms_ipc_msg_write_transport_many (xmms_ipc_msg_t **msgs, int count, xmms_ipc_transport_t *transport, int *written, bool *disconnected);
 bool xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg, xmms_ipc_transport_t *transport, bool *disconnected);
 bool xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg, xmms_ipc_transport_t *transport, bool *disconnected);
 
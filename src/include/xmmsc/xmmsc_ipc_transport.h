@@ -23,14 +23,31 @@
 
 typedef struct xmms_ipc_transport_St xmms_ipc_transport_t;
 
+/* descriptors that can be passed along with one write */
+#define XMMS_IPC_TRANSPORT_MAX_FDS 4
+
+/* pieces of data that can be gathered into one write */
+#define XMMS_IPC_TRANSPORT_MAX_IOV 64
+
+typedef struct xmms_ipc_iovec_St {
+	char *base;
+	int len;
+} xmms_ipc_iovec_t;
+
 typedef int (*xmms_ipc_read_func) (xmms_ipc_transport_t *, char *, int);
 typedef int (*xmms_ipc_write_func) (xmms_ipc_transport_t *, char *, int);
+typedef int (*xmms_ipc_writev_func) (xmms_ipc_transport_t *, const xmms_ipc_iovec_t *, int);
+typedef int (*xmms_ipc_write_fds_func) (xmms_ipc_transport_t *, char *, int, const int *, int);
 typedef xmms_ipc_transport_t *(*xmms_ipc_accept_func) (xmms_ipc_transport_t *);
 typedef void (*xmms_ipc_destroy_func) (xmms_ipc_transport_t *);
 
 void xmms_ipc_transport_destroy (xmms_ipc_transport_t *ipct);
 int xmms_ipc_transport_read (xmms_ipc_transport_t *ipct, char *buffer, int len);
 int xmms_ipc_transport_write (xmms_ipc_transport_t *ipct, char *buffer, int len);
+int xmms_ipc_transport_writev (xmms_ipc_transport_t *ipct, const xmms_ipc_iovec_t *iov, int iovcnt);
+int xmms_ipc_transport_write_fds (xmms_ipc_transport_t *ipct, char *buffer, int len, const int *fds, int fdc);
+int xmms_ipc_transport_can_pass_fds (xmms_ipc_transport_t *ipct);
+int xmms_ipc_transport_fd_take (xmms_ipc_transport_t *ipct);
 xmms_socket_t xmms_ipc_transport_fd_get (xmms_ipc_transport_t *ipct);
 xmms_ipc_transport_t * xmms_ipc_server_accept (xmms_ipc_transport_t *ipct);
 xmms_ipc_transport_t * xmms_ipc_client_init (const char *path);
@@ -48,6 +65,12 @@ struct xmms_ipc_transport_St {
 	xmms_ipc_write_func write_func;
 	xmms_ipc_read_func read_func;
 	xmms_ipc_destroy_func destroy_func;
+	xmms_ipc_write_fds_func write_fds_func;
+	xmms_ipc_writev_func writev_func;
+
+	/* descriptors received by read_func, not yet taken */
+	int passed_fds[XMMS_IPC_TRANSPORT_MAX_FDS];
+	int passed_fdc;
 };
 
 #endif
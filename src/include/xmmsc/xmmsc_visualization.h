@@ -30,6 +30,7 @@
 extern "C" {
 #endif
 
+#include <stddef.h>
 #include <sys/time.h>
 
 #include <xmmsc/xmmsc_stdint.h>
@@ -64,6 +65,36 @@ typedef struct {
 	int16_t data[2 * XMMSC_VISUALIZATION_WINDOW_SIZE];
 } xmmsc_vischunk_t;
 
+/**
+ * Shared ring of vis chunks for the memfd transport. The client creates
+ * and seals the memory and passes it to the server, which is the only
+ * writer. Chunk n goes to slot n % size; the slot's seq is 2n + 1 while
+ * it is written and 2n + 2 once it is complete, so a reader that was
+ * overtaken by the writer notices and skips ahead instead of blocking
+ * the server. The written counter doubles as futex word, the server
+ * only wakes it up while the client has set waiting.
+ */
+
+#define XMMS_VISPACKET_MEMFD_MAGIC 0x584d5646 /* "XMVF" */
+#define XMMS_VISPACKET_MEMFD_COUNT 64
+
+typedef struct {
+	uint32_t seq;
+	uint32_t reserved;
+	xmmsc_vischunk_t chunk;
+} xmmsc_vis_memfd_slot_t;
+
+typedef struct {
+	uint32_t magic;
+	uint32_t size;
+	uint32_t written;
+	uint32_t waiting;
+	xmmsc_vis_memfd_slot_t slots[1];
+} xmmsc_vis_memfd_ring_t;
+
+#define XMMS_VISPACKET_MEMFD_LENGTH(count) \
+	(offsetof (xmmsc_vis_memfd_ring_t, slots) + (count) * sizeof (xmmsc_vis_memfd_slot_t))
+
 /**
  * UDP package _descriptor_ to deliver a vis chunk
  */
@@ -144,7 +175,8 @@ typedef struct {
 typedef enum {
 	VIS_UNIXSHM,
 	VIS_UDP,
-	VIS_NONE
+	VIS_NONE,
+	VIS_MEMFD
 } xmmsc_vis_transport_t;
 
 typedef enum {
@@ -154,6 +186,8 @@ typedef enum {
 	VIS_TRYING_UDP,
 	VIS_ERRORED,
 	VIS_WORKING,
+	VIS_TRYING_MEMFD,
+	VIS_TO_TRY_UNIXSHM,
 } xmmsc_vis_state_t;
 
 /**
@@ -167,6 +201,23 @@ typedef struct {
 	int pos, size;
 } xmmsc_vis_unixshm_t;
 
+/**
+ * data describing a memfd transport
+ */
+
+typedef struct {
+	xmmsc_vis_memfd_ring_t *ring;
+	size_t length;
+	// number of slots, never read back from the shared memory
+	uint32_t size;
+	// end of the socketpair that tells the server whether the client lives
+	int alive;
+	// next chunk to read, used by the client
+	uint32_t pos;
+	// chunks written since the last liveness check, used by the server
+	int writes;
+} xmmsc_vis_memfd_t;
+
 /**
  * data describing a udp transport
  */
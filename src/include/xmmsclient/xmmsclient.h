@@ -94,6 +94,7 @@ xmmsc_result_t *xmmsc_playlist_clear (xmmsc_connection_t *c, const char *playlis
 xmmsc_result_t *xmmsc_playlist_replace (xmmsc_connection_t *c, const char *playlist, xmmsv_t *coll, xmms_playlist_position_action_t action) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_playlist_remove (xmmsc_connection_t *c, const char *playlist) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_playlist_list_entries (xmmsc_connection_t *c, const char *playlist) XMMS_PUBLIC;
+xmmsc_result_t *xmmsc_playlist_list_changes (xmmsc_connection_t *c, const char *playlist, int64_t generation) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_playlist_sort (xmmsc_connection_t *c, const char *playlist, xmmsv_t *properties) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_playlist_set_next (xmmsc_connection_t *c, int32_t) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_playlist_set_next_rel (xmmsc_connection_t *c, int32_t) XMMS_PUBLIC;
@@ -219,11 +220,15 @@ xmmsc_result_t *xmmsc_medialib_path_import (xmmsc_connection_t *conn, const char
 xmmsc_result_t *xmmsc_medialib_path_import_encoded (xmmsc_connection_t *conn, const char *path) XMMS_PUBLIC XMMS_DEPRECATED;
 xmmsc_result_t *xmmsc_medialib_import_path (xmmsc_connection_t *conn, const char *path) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_import_path_encoded (xmmsc_connection_t *conn, const char *path) XMMS_PUBLIC;
+xmmsc_result_t *xmmsc_medialib_import_path_async (xmmsc_connection_t *conn, const char *path) XMMS_PUBLIC;
+xmmsc_result_t *xmmsc_medialib_import_path_async_encoded (xmmsc_connection_t *conn, const char *path) XMMS_PUBLIC;
+xmmsc_result_t *xmmsc_medialib_import_cancel (xmmsc_connection_t *conn, int job) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_rehash (xmmsc_connection_t *conn, int id) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_get_id (xmmsc_connection_t *conn, const char *url) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_get_id_encoded (xmmsc_connection_t *conn, const char *url) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_remove_entry (xmmsc_connection_t *conn, int entry) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_move_entry (xmmsc_connection_t *conn, int entry, const char *url) XMMS_PUBLIC;
+xmmsc_result_t *xmmsc_medialib_get_query_stats (xmmsc_connection_t *conn) XMMS_PUBLIC;
 
 xmmsc_result_t *xmmsc_medialib_entry_property_set_int (xmmsc_connection_t *c, int id, const char *key, int32_t value) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_medialib_entry_property_set_int_with_source (xmmsc_connection_t *c, int id, const char *source, const char *key, int32_t value) XMMS_PUBLIC;
@@ -249,6 +254,7 @@ xmmsc_result_t *xmmsc_broadcast_medialib_entry_changed (xmmsc_connection_t *c) X
 xmmsc_result_t *xmmsc_broadcast_medialib_entry_updated (xmmsc_connection_t *c) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_broadcast_medialib_entry_added (xmmsc_connection_t *c) XMMS_PUBLIC;
 xmmsc_result_t *xmmsc_broadcast_medialib_entry_removed (xmmsc_connection_t *c) XMMS_PUBLIC;
+xmmsc_result_t *xmmsc_broadcast_medialib_import_progress (xmmsc_connection_t *c) XMMS_PUBLIC;
 
 
 /*
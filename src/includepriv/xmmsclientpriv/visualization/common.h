@@ -10,6 +10,7 @@ struct xmmsc_visualization_St {
 	union {
 		xmmsc_vis_unixshm_t shm;
 		xmmsc_vis_udp_t udp;
+		xmmsc_vis_memfd_t memfd;
 	} transport;
 	xmmsc_vis_transport_t type;
 	xmmsc_vis_state_t state;
@@ -29,6 +30,12 @@ bool setup_shm_handle (xmmsc_result_t *res);
 void cleanup_shm (xmmsc_vis_unixshm_t *t);
 int read_do_shm (xmmsc_vis_unixshm_t *t, xmmsc_visualization_t *v, short *buffer, int drawtime, unsigned int blocking);
 
+/* provided by memfd.c / memfd_dummy.c */
+xmmsc_result_t *setup_memfd_prepare (xmmsc_connection_t *c, int32_t vv);
+bool setup_memfd_handle (xmmsc_result_t *res);
+void cleanup_memfd (xmmsc_vis_memfd_t *t);
+int read_do_memfd (xmmsc_vis_memfd_t *t, xmmsc_visualization_t *v, short *buffer, int drawtime, unsigned int blocking);
+
 /* provided by udp.c */
 xmmsc_result_t *setup_udp_prepare (xmmsc_connection_t *c, int32_t vv);
 bool setup_udp_handle (xmmsc_result_t *res);
@@ -60,4 +60,9 @@ void _xmmsv_list_free (xmmsv_list_internal_t *dict);
 void _xmmsv_dict_free (xmmsv_dict_internal_t *dict);
 void _xmmsv_coll_free (xmmsv_coll_internal_t *coll);
 
+unsigned char *_xmmsv_bitbuffer_reserve_data (xmmsv_t *v, int size);
+
+int _xmmsv_list_get_packed (xmmsv_t *listv, const int64_t **ints);
+int _xmmsv_list_append_packed (xmmsv_t *listv, const int64_t *ints, int count);
+
 #endif
@@ -65,7 +65,7 @@ void xmms_collection_apply_to_collection (xmms_coll_dag_t *dag, xmmsv_t *coll, F
 xmmsv_t * xmms_collection_get_pointer (xmms_coll_dag_t *dag, const gchar *collname, guint namespace);
 void xmms_collection_update_pointer (xmms_coll_dag_t *dag, const gchar *name, xmms_collection_namespace_id_t nsid, xmmsv_t *newtarget);
 gchar * xmms_collection_find_alias (xmms_coll_dag_t *dag, xmms_collection_namespace_id_t nsid, xmmsv_t *value, const gchar *key);
-xmms_medialib_entry_t xmms_collection_get_random_media (xmms_coll_dag_t *dag, xmmsv_t *source);
+xmms_medialib_entry_t xmms_collection_get_random_media (xmms_coll_dag_t *dag, xmmsv_t *source, GHashTable *avoid);
 
 xmms_collection_namespace_id_t xmms_collection_get_namespace_id (const gchar *namespace);
 const gchar *xmms_collection_get_namespace_string (xmms_collection_namespace_id_t nsid);
@@ -77,6 +77,7 @@ xmmsv_t *xmms_collection_changed_msg_new (xmms_collection_changed_action_t type,
 void xmms_collection_changed_msg_send (xmms_coll_dag_t *colldag, xmmsv_t *dict);
 
 xmmsv_t *xmms_collection_snapshot (xmms_coll_dag_t *dag);
+xmmsv_t *xmms_collection_snapshot_partial (xmms_coll_dag_t *dag, GList *collections, GList *playlists);
 void xmms_collection_restore (xmms_coll_dag_t *dag, xmmsv_t *snapshot);
 
 #define XMMS_COLLECTION_PLAYLIST_CHANGED_MSG(dag, name) xmms_collection_changed_msg_send (dag, xmms_collection_changed_msg_new (XMMS_COLLECTION_CHANGED_UPDATE, name, XMMS_COLLECTION_NS_PLAYLISTS))
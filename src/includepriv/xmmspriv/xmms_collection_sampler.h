@@ -0,0 +1,29 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_COLLECTION_SAMPLER_H__
+#define __XMMS_PRIV_COLLECTION_SAMPLER_H__
+
+#include <glib.h>
+#include <xmmspriv/xmms_medialib.h>
+
+typedef struct xmms_collection_sampler_St xmms_collection_sampler_t;
+
+xmms_collection_sampler_t *xmms_collection_sampler_new (xmms_medialib_t *medialib, guint capacity);
+void xmms_collection_sampler_free (xmms_collection_sampler_t *sampler);
+xmms_medialib_entry_t xmms_collection_sampler_pick (xmms_collection_sampler_t *sampler, xmmsv_t *coll, GHashTable *avoid);
+
+#endif
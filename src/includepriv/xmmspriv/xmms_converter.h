@@ -20,11 +20,14 @@
 #include <xmmspriv/xmms_streamtype.h>
 #include <xmms/xmms_sample.h>
 #include <xmms/xmms_medialib.h>
+#include <xmmspriv/xmms_resampler.h>
 
 typedef struct xmms_sample_converter_St xmms_sample_converter_t;
 typedef guint (*xmms_sample_conv_func_t) (xmms_sample_converter_t *, xmms_sample_t *, guint , xmms_sample_t *);
 
 xmms_sample_converter_t *xmms_sample_converter_init (xmms_stream_type_t *from, xmms_stream_type_t *to);
+xmms_sample_converter_t *xmms_sample_converter_init_full (xmms_stream_type_t *from, xmms_stream_type_t *to, xmms_resampler_quality_t quality);
+xmms_sample_conv_func_t xmms_sample_conv_simd_get (guint inchannels, xmms_sample_format_t intype, guint outchannels, xmms_sample_format_t outtype);
 
 gint64 xmms_sample_convert_scale (xmms_sample_converter_t *conv, gint64 samples);
 gint64 xmms_sample_convert_rev_scale (xmms_sample_converter_t *conv, gint64 samples);
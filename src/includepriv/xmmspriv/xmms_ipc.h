@@ -16,6 +16,7 @@ xmms_ipc_manager_t *xmms_ipc_manager_get (void);
 
 gboolean xmms_ipc_has_pending (guint signalid);
 void xmms_ipc_send_message (gint cli, xmms_ipc_msg_t *msg, xmms_error_t *err);
+gint xmms_ipc_passed_fd_take (void);
 void xmms_ipc_send_broadcast (guint broadcastid, gint cli, xmmsv_t *arg, xmms_error_t *err);
 GList *xmms_ipc_get_connected_clients (void);
 
@@ -0,0 +1,47 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_IPC_POLLER_H__
+#define __XMMS_PRIV_IPC_POLLER_H__
+
+#include <glib.h>
+
+/**
+ * Readiness flags understood and reported by the poller.
+ */
+typedef enum {
+	XMMS_IPC_POLLER_IN = 1 << 0,
+	XMMS_IPC_POLLER_OUT = 1 << 1,
+	XMMS_IPC_POLLER_ERR = 1 << 2,
+	XMMS_IPC_POLLER_HUP = 1 << 3
+} xmms_ipc_poller_flags_t;
+
+typedef struct xmms_ipc_poller_event_St {
+	gpointer data;
+	guint flags;
+} xmms_ipc_poller_event_t;
+
+typedef struct xmms_ipc_poller_St xmms_ipc_poller_t;
+
+xmms_ipc_poller_t *xmms_ipc_poller_new (void);
+void xmms_ipc_poller_free (xmms_ipc_poller_t *poller);
+gboolean xmms_ipc_poller_add (xmms_ipc_poller_t *poller, gint fd, guint flags, gpointer data);
+gboolean xmms_ipc_poller_modify (xmms_ipc_poller_t *poller, gint fd, guint flags, gpointer data);
+void xmms_ipc_poller_remove (xmms_ipc_poller_t *poller, gint fd);
+gint xmms_ipc_poller_wait (xmms_ipc_poller_t *poller, xmms_ipc_poller_event_t *events, gint max_events);
+void xmms_ipc_poller_wakeup (xmms_ipc_poller_t *poller);
+
+#endif
@@ -34,10 +34,12 @@ xmms_medialib_t *xmms_medialib_init (void);
 s4_t *xmms_medialib_get_database_backend (xmms_medialib_t *medialib);
 s4_sourcepref_t *xmms_medialib_get_source_preferences (xmms_medialib_t *medialib);
 char *xmms_medialib_uuid (xmms_medialib_t *mlib);
+guint xmms_medialib_get_generation (xmms_medialib_t *medialib);
 s4_resultset_t *xmms_medialib_session_query (xmms_medialib_session_t *s, s4_fetchspec_t *spec, s4_condition_t *cond);
 
 guint xmms_medialib_num_not_resolved (xmms_medialib_session_t *s);
 xmms_medialib_entry_t xmms_medialib_entry_not_resolved_get (xmms_medialib_session_t *s);
+GList *xmms_medialib_entry_not_resolved_list (xmms_medialib_session_t *s);
 
 xmms_medialib_entry_t xmms_medialib_entry_new (xmms_medialib_session_t *s, const char *url, xmms_error_t *error);
 xmms_medialib_entry_t xmms_medialib_entry_new_encoded (xmms_medialib_session_t *s, const char *url, xmms_error_t *error);
@@ -60,11 +62,18 @@ gboolean xmms_medialib_decode_url (char *url);
 gboolean xmms_medialib_check_id (xmms_medialib_session_t *s, xmms_medialib_entry_t entry);
 
 xmmsv_t *xmms_medialib_add_recursive (xmms_medialib_t *medialib, const gchar *path, xmms_error_t *error);
+guint xmms_medialib_add_encoded_batch (xmms_medialib_t *medialib, const gchar **urls, guint count, xmmsv_t *entries);
+void xmms_medialib_cancel_imports (xmms_medialib_t *medialib);
 
 xmms_medialib_entry_t xmms_medialib_query_random_id (xmms_medialib_session_t *s, xmmsv_t *coll);
 
 xmmsv_t *xmms_medialib_query (xmms_medialib_session_t *s, xmmsv_t *coll, xmmsv_t *fetch, xmms_error_t *err);
 s4_resultset_t *xmms_medialib_query_recurs (xmms_medialib_session_t *session, xmmsv_t *coll, xmms_fetch_info_t *fetch);
+xmmsv_t *xmms_medialib_query_normalize (xmmsv_t *coll, gboolean *data_dependent, gboolean *uncacheable);
+xmmsv_t *xmms_medialib_query_normalize_value (xmmsv_t *value);
+s4_condition_t *xmms_medialib_query_compile (xmms_medialib_session_t *session, xmmsv_t *coll, xmms_fetch_info_t *fetch, xmmsv_t *order);
+s4_resultset_t *xmms_medialib_query_execute (xmms_medialib_session_t *session, s4_condition_t *cond, xmms_fetch_info_t *fetch, xmmsv_t *order);
+void xmms_medialib_query_plans_invalidate (xmms_medialib_t *medialib);
 xmmsv_t *xmms_medialib_query_to_xmmsv (s4_resultset_t *set, xmms_fetch_spec_t *spec);
 
 
@@ -75,6 +84,9 @@ gboolean xmms_medialib_session_commit (xmms_medialib_session_t *session);
 s4_resultset_t *xmms_medialib_session_query (xmms_medialib_session_t *session, s4_fetchspec_t *specification, s4_condition_t *condition);
 s4_sourcepref_t *xmms_medialib_session_get_source_preferences (xmms_medialib_session_t *session);
 void xmms_medialib_session_track_garbage (xmms_medialib_session_t *session, xmmsv_t *data);
+xmms_medialib_t *xmms_medialib_session_get_medialib (xmms_medialib_session_t *session);
+guint xmms_medialib_session_get_generation (xmms_medialib_session_t *session);
+gboolean xmms_medialib_session_is_dirty (xmms_medialib_session_t *session);
 gint xmms_medialib_session_property_set (xmms_medialib_session_t *session, xmms_medialib_entry_t entry, const gchar *key, const s4_val_t *value, const gchar *source);
 gint xmms_medialib_session_property_unset (xmms_medialib_session_t *session, xmms_medialib_entry_t entry, const gchar *key, const s4_val_t *value, const gchar *source);
 
@@ -0,0 +1,31 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_MEDIALIB_IMPORT_H__
+#define __XMMS_PRIV_MEDIALIB_IMPORT_H__
+
+#include <glib.h>
+#include <xmmspriv/xmms_medialib.h>
+
+typedef struct xmms_medialib_importer_St xmms_medialib_importer_t;
+
+xmms_medialib_importer_t *xmms_medialib_importer_new (xmms_medialib_t *medialib, gint num_threads, guint batch_size);
+void xmms_medialib_importer_free (xmms_medialib_importer_t *importer);
+gint32 xmms_medialib_importer_start (xmms_medialib_importer_t *importer, const gchar *path);
+gboolean xmms_medialib_importer_cancel (xmms_medialib_importer_t *importer, gint32 id);
+void xmms_medialib_importer_shutdown (xmms_medialib_importer_t *importer);
+
+#endif
@@ -0,0 +1,38 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PRIV_MEDIALIB_PLAN_H__
+#define __XMMS_PRIV_MEDIALIB_PLAN_H__
+
+#include <glib.h>
+#include <xmmspriv/xmms_medialib.h>
+#include <xmms/xmms_error.h>
+
+typedef struct xmms_medialib_plan_St xmms_medialib_plan_t;
+typedef struct xmms_medialib_plan_cache_St xmms_medialib_plan_cache_t;
+
+xmms_medialib_plan_cache_t *xmms_medialib_plan_cache_new (guint capacity);
+void xmms_medialib_plan_cache_free (xmms_medialib_plan_cache_t *cache);
+void xmms_medialib_plan_cache_set_capacity (xmms_medialib_plan_cache_t *cache, guint capacity);
+guint xmms_medialib_plan_cache_generation (xmms_medialib_plan_cache_t *cache);
+void xmms_medialib_plan_cache_invalidate (xmms_medialib_plan_cache_t *cache, gboolean data_changed);
+xmmsv_t *xmms_medialib_plan_cache_stats (xmms_medialib_plan_cache_t *cache);
+
+xmms_medialib_plan_t *xmms_medialib_plan_cache_get (xmms_medialib_plan_cache_t *cache, xmms_medialib_session_t *session, xmmsv_t *coll, xmmsv_t *fetch, xmms_error_t *err);
+xmmsv_t *xmms_medialib_plan_run (xmms_medialib_plan_t *plan, xmms_medialib_session_t *session);
+void xmms_medialib_plan_unref (xmms_medialib_plan_cache_t *cache, xmms_medialib_plan_t *plan);
+
+#endif
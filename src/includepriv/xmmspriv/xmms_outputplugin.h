@@ -35,6 +35,7 @@ gboolean xmms_output_plugin_method_volume_set_available (xmms_output_plugin_t *p
 gboolean xmms_output_plugin_methods_volume_set (xmms_output_plugin_t *plugin, xmms_output_t *output, const gchar *chan, guint val);
 gboolean xmms_output_plugin_method_volume_get_available (xmms_output_plugin_t *plugin);
 gboolean xmms_output_plugin_method_volume_get (xmms_output_plugin_t *plugin, xmms_output_t *output, const gchar **n, guint *x, guint *y);
+gboolean xmms_output_plugin_method_volume_monitor (xmms_output_plugin_t *plugin, xmms_output_t *output, gboolean enable);
 
 
 #endif
@@ -54,6 +54,7 @@ void xmms_playlist_update (xmms_playlist_t *playlist, const gchar *plname);
 
 gboolean xmms_playlist_advance (xmms_playlist_t *playlist);
 xmms_medialib_entry_t xmms_playlist_current_entry (xmms_playlist_t *playlist);
+xmms_medialib_entry_t xmms_playlist_peek_next_entry (xmms_playlist_t *playlist);
 void xmms_playlist_add_entry_unlocked (xmms_playlist_t *playlist, const gchar *plname, xmmsv_t *plcoll, xmms_medialib_entry_t file, xmms_error_t *err);
 GList * xmms_playlist_list (xmms_playlist_t *playlist, const gchar *plname, xmms_error_t *err);
 
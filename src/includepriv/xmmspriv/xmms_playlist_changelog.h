@@ -0,0 +1,36 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __XMMS_PLAYLIST_CHANGELOG_H__
+#define __XMMS_PLAYLIST_CHANGELOG_H__
+
+#include <glib.h>
+#include <xmmsc/xmmsv.h>
+
+typedef struct xmms_playlist_changelog_St xmms_playlist_changelog_t;
+
+xmms_playlist_changelog_t *xmms_playlist_changelog_new (guint max_weight);
+void xmms_playlist_changelog_free (xmms_playlist_changelog_t *log);
+void xmms_playlist_changelog_set_max_weight (xmms_playlist_changelog_t *log, guint max_weight);
+
+gint64 xmms_playlist_changelog_insert (xmms_playlist_changelog_t *log, const gchar *name, xmmsv_t *plcoll, gint pos, gint count);
+gint64 xmms_playlist_changelog_remove (xmms_playlist_changelog_t *log, const gchar *name, xmmsv_t *plcoll, gint pos, gint count);
+gint64 xmms_playlist_changelog_move (xmms_playlist_changelog_t *log, const gchar *name, xmmsv_t *plcoll, gint pos, gint newpos);
+gint64 xmms_playlist_changelog_replace (xmms_playlist_changelog_t *log, const gchar *name, xmmsv_t *plcoll, const gint32 *old_ids, gint old_len);
+
+xmmsv_t *xmms_playlist_changelog_since (xmms_playlist_changelog_t *log, const gchar *name, xmmsv_t *plcoll, gint64 generation);
+
+#endif
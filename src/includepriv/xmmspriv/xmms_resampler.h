@@ -0,0 +1,42 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+
+
+
+#ifndef __XMMS_RESAMPLER_H__
+#define __XMMS_RESAMPLER_H__
+
+#include <glib.h>
+
+typedef enum {
+	XMMS_RESAMPLER_QUALITY_LINEAR,
+	XMMS_RESAMPLER_QUALITY_LOW,
+	XMMS_RESAMPLER_QUALITY_MEDIUM,
+	XMMS_RESAMPLER_QUALITY_HIGH
+} xmms_resampler_quality_t;
+
+typedef struct xmms_resampler_St xmms_resampler_t;
+
+xmms_resampler_t *xmms_resampler_new (guint channels, guint from, guint to, xmms_resampler_quality_t quality);
+void xmms_resampler_free (xmms_resampler_t *rs);
+void xmms_resampler_reset (xmms_resampler_t *rs);
+guint xmms_resampler_process (xmms_resampler_t *rs, const gfloat *in, guint frames, gfloat *out);
+guint xmms_resampler_max_output (xmms_resampler_t *rs, guint frames);
+
+xmms_resampler_quality_t xmms_resampler_quality_from_string (const gchar *name);
+
+#endif
@@ -25,6 +25,7 @@
 typedef struct xmms_ringbuf_St xmms_ringbuf_t;
 
 xmms_ringbuf_t *xmms_ringbuf_new (guint size);
+xmms_ringbuf_t *xmms_ringbuf_new_spsc (guint size);
 void xmms_ringbuf_destroy (xmms_ringbuf_t *ringbuf);
 void xmms_ringbuf_clear (xmms_ringbuf_t *ringbuf);
 guint xmms_ringbuf_bytes_free (const xmms_ringbuf_t *ringbuf);
@@ -39,6 +40,11 @@ void xmms_ringbuf_hotspot_set (xmms_ringbuf_t *ringbuf, gboolean (*cb) (void *),
 guint xmms_ringbuf_write (xmms_ringbuf_t *ringbuf, gconstpointer data, guint length);
 guint xmms_ringbuf_write_wait (xmms_ringbuf_t *ringbuf, gconstpointer data, guint length, GMutex *mtx);
 
+guint xmms_ringbuf_peek_region (xmms_ringbuf_t *ringbuf, gconstpointer *data, guint length);
+gboolean xmms_ringbuf_consume (xmms_ringbuf_t *ringbuf, guint length);
+guint xmms_ringbuf_reserve (xmms_ringbuf_t *ringbuf, gpointer *data, guint length);
+void xmms_ringbuf_commit (xmms_ringbuf_t *ringbuf, guint length);
+
 void xmms_ringbuf_wait_free (xmms_ringbuf_t *ringbuf, guint len, GMutex *mtx);
 void xmms_ringbuf_wait_used (xmms_ringbuf_t *ringbuf, guint len, GMutex *mtx);
 
@@ -36,6 +36,8 @@ xmms_xform_t *xmms_xform_chain_setup (xmms_medialib_t *medialib, xmms_medialib_e
 xmms_xform_t *xmms_xform_chain_setup_session (xmms_medialib_t *medialib, xmms_medialib_session_t *session, xmms_medialib_entry_t entry, GList *goal_fmts, gboolean rehash);
 xmms_xform_t *xmms_xform_chain_setup_url_session (xmms_medialib_t *medialib, xmms_medialib_session_t *session, xmms_medialib_entry_t entry, const gchar *url, GList *goal_fmts, gboolean rehash);
 xmms_xform_t *xmms_xform_chain_setup_url (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats, gboolean rehash);
+xmms_xform_t *xmms_xform_chain_probe (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, const gchar *url, GList *goal_formats, gboolean rehash);
+void xmms_xform_chain_finalize (xmms_medialib_session_t *session, xmms_xform_t *xform, xmms_medialib_entry_t entry, const gchar *url, gboolean rehash);
 
 gint64 xmms_xform_this_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *err);
 int xmms_xform_this_read (xmms_xform_t *xform, gpointer buf, int siz, xmms_error_t *err);
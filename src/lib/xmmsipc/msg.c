@@ -23,6 +23,8 @@
 #include <assert.h>
 
 #include <xmmscpriv/xmms_list.h>
+#include <xmmscpriv/xmmsv.h>
+#include <xmmscpriv/xmmsc_util.h>
 #include <xmmsc/xmmsc_ipc_transport.h>
 #include <xmmsc/xmmsc_ipc_msg.h>
 #include <xmmsc/xmmsc_util.h>
@@ -30,11 +32,46 @@
 #include <xmmsc/xmmsc_stdint.h>
 #include <xmmsc/xmmsv_coll.h>
 
+#if !defined(_WIN32)
+# include <unistd.h>
+#endif
+
+#if defined(_MSC_VER)
+# include <windows.h>
+# define x_atomic_inc(p) InterlockedIncrement ((volatile LONG *) (p))
+# define x_atomic_dec_and_test(p) (InterlockedDecrement ((volatile LONG *) (p)) == 0)
+#else
+# define x_atomic_inc(p) __sync_add_and_fetch ((p), 1)
+# define x_atomic_dec_and_test(p) (__sync_sub_and_fetch ((p), 1) == 0)
+#endif
+
+/**
+ * A serialized message, header included, that is never modified again
+ * and may be written out by several threads at once.
+ */
+typedef struct xmms_ipc_msg_payload_St {
+	xmmsv_t *bb;
+	int ref;
+} xmms_ipc_msg_payload_t;
+
 struct xmms_ipc_msg_St {
+	/* the whole message, or only the header if payload is set */
 	xmmsv_t *bb;
 	uint32_t xfered;
+	xmms_ipc_msg_payload_t *payload;
+
+	/* descriptors to send with, or received with the message */
+	int fds[XMMS_IPC_TRANSPORT_MAX_FDS];
+	int fdc;
 };
 
+static void
+xmms_ipc_msg_fd_close (int fd)
+{
+#if !defined(_WIN32)
+	close (fd);
+#endif
+}
 
 
 xmms_ipc_msg_t *
@@ -55,10 +92,60 @@ xmms_ipc_msg_destroy (xmms_ipc_msg_t *msg)
 {
 	x_return_if_fail (msg);
 
+	while (msg->fdc > 0) {
+		xmms_ipc_msg_fd_close (msg->fds[--msg->fdc]);
+	}
+
+	if (msg->payload && x_atomic_dec_and_test (&msg->payload->ref)) {
+		xmmsv_unref (msg->payload->bb);
+		free (msg->payload);
+	}
+
 	xmmsv_unref (msg->bb);
 	free (msg);
 }
 
+/**
+ * Create a message with the same object, command and body as msg but
+ * with a different cookie.
+ *
+ * The body is not copied: the first call freezes msg and every copy
+ * refers to the same serialized data, so the cost of serializing a
+ * large value is paid once no matter how many clients it is sent to.
+ * Neither msg nor the copies may have values put into or read from
+ * them afterwards. Copies can be written and destroyed from any thread.
+ */
+xmms_ipc_msg_t *
+xmms_ipc_msg_copy_shared (xmms_ipc_msg_t *msg, uint32_t cookie)
+{
+	xmms_ipc_msg_t *copy;
+
+	x_return_val_if_fail (msg, NULL);
+
+	if (!msg->payload) {
+		msg->payload = x_new0 (xmms_ipc_msg_payload_t, 1);
+		msg->payload->bb = msg->bb;
+		msg->payload->ref = 1;
+
+		xmmsv_bitbuffer_align (msg->bb);
+		msg->bb = xmmsv_new_bitbuffer ();
+		xmmsv_bitbuffer_put_data (msg->bb,
+		                          xmmsv_bitbuffer_buffer (msg->payload->bb),
+		                          XMMS_IPC_MSG_HEAD_LEN);
+	}
+
+	copy = x_new0 (xmms_ipc_msg_t, 1);
+	copy->bb = xmmsv_new_bitbuffer ();
+	xmmsv_bitbuffer_put_data (copy->bb, xmmsv_bitbuffer_buffer (msg->bb),
+	                          XMMS_IPC_MSG_HEAD_LEN);
+	xmms_ipc_msg_set_cookie (copy, cookie);
+
+	copy->payload = msg->payload;
+	x_atomic_inc (&copy->payload->ref);
+
+	return copy;
+}
+
 static void
 xmms_ipc_msg_update_length (xmmsv_t *bb)
 {
@@ -177,32 +264,119 @@ xmms_ipc_msg_new (uint32_t object, uint32_t cmd)
 
 
 /**
- * Try to write message to transport. If full message isn't written
- * the message will keep track of the amount of data written and not
- * write already written data next time.
+ * Attach a file descriptor to be passed to the peer along with the
+ * message. The message owns the descriptor from now on and closes it
+ * once it has been sent. Only transports for which
+ * #xmms_ipc_transport_can_pass_fds is true deliver it.
  *
- * @returns TRUE if full message was written, FALSE otherwise.
- *               disconnected is set if transport was disconnected
+ * @returns false if no more descriptors can be attached
  */
 bool
-xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg,
-                              xmms_ipc_transport_t *transport,
-                              bool *disconnected)
+xmms_ipc_msg_add_fd (xmms_ipc_msg_t *msg, int fd)
+{
+	x_return_val_if_fail (msg, false);
+	x_return_val_if_fail (!msg->payload, false);
+
+	if (msg->fdc == XMMS_IPC_TRANSPORT_MAX_FDS) {
+		return false;
+	}
+
+	msg->fds[msg->fdc++] = fd;
+
+	return true;
+}
+
+/**
+ * Take the next descriptor that was received with the message, in the
+ * order they were attached. The caller owns it afterwards.
+ *
+ * @returns the descriptor, or -1 if there are no more
+ */
+int
+xmms_ipc_msg_take_fd (xmms_ipc_msg_t *msg)
+{
+	int fd;
+
+	x_return_val_if_fail (msg, -1);
+
+	if (!msg->fdc) {
+		return -1;
+	}
+
+	fd = msg->fds[0];
+	msg->fdc--;
+	memmove (msg->fds, msg->fds + 1, msg->fdc * sizeof (int));
+
+	return fd;
+}
+
+/**
+ * Describe the unwritten part of a message as pieces for a gathered
+ * write. Messages created by xmms_ipc_msg_copy_shared are written as
+ * their private header followed by the shared body; the payload keeps
+ * its template header, so offsets into it line up with msg->xfered.
+ *
+ * @returns the number of pieces, at most two
+ */
+static int
+xmms_ipc_msg_fill_iov (xmms_ipc_msg_t *msg, xmms_ipc_iovec_t *iov,
+                       unsigned int *len)
+{
+	unsigned char *buf;
+	unsigned int offset;
+	int n = 0;
+
+	if (!msg->payload) {
+		xmmsv_bitbuffer_align (msg->bb);
+		*len = xmmsv_bitbuffer_len (msg->bb) / 8;
+
+		buf = (unsigned char *) xmmsv_bitbuffer_buffer (msg->bb);
+		iov[n].base = (char *) buf + msg->xfered;
+		iov[n].len = *len - msg->xfered;
+		n++;
+
+		return n;
+	}
+
+	*len = xmmsv_bitbuffer_len (msg->payload->bb) / 8;
+
+	if (msg->xfered < XMMS_IPC_MSG_HEAD_LEN) {
+		buf = (unsigned char *) xmmsv_bitbuffer_buffer (msg->bb);
+		iov[n].base = (char *) buf + msg->xfered;
+		iov[n].len = XMMS_IPC_MSG_HEAD_LEN - msg->xfered;
+		n++;
+	}
+
+	offset = MAX (msg->xfered, XMMS_IPC_MSG_HEAD_LEN);
+	if (offset < *len) {
+		buf = (unsigned char *) xmmsv_bitbuffer_buffer (msg->payload->bb);
+		iov[n].base = (char *) buf + offset;
+		iov[n].len = *len - offset;
+		n++;
+	}
+
+	return n;
+}
+
+/**
+ * Write a message that has descriptors attached, they go along with
+ * its first byte.
+ */
+static bool
+xmms_ipc_msg_write_fds (xmms_ipc_msg_t *msg,
+                        xmms_ipc_transport_t *transport,
+                        bool *disconnected)
 {
 	char *buf;
 	unsigned int ret, len;
 
-	x_return_val_if_fail (msg, false);
-	x_return_val_if_fail (transport, false);
-
 	xmmsv_bitbuffer_align (msg->bb);
 
 	len = xmmsv_bitbuffer_len (msg->bb) / 8;
 
-	x_return_val_if_fail (len > msg->xfered, true);
-
-	buf = (char *) (xmmsv_bitbuffer_buffer (msg->bb) + msg->xfered);
-	ret = xmms_ipc_transport_write (transport, buf, len - msg->xfered);
+	buf = (char *) xmmsv_bitbuffer_buffer (msg->bb);
+	ret = xmms_ipc_transport_write_fds (transport, buf, len,
+	                                    msg->fds, msg->fdc);
 
 	if (ret == SOCKET_ERROR) {
 		if (xmms_socket_error_recoverable ()) {
@@ -219,6 +393,10 @@ xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg,
 			*disconnected = true;
 		}
 	} else {
+		/* the peer has its own copies of the descriptors now */
+		while (msg->fdc > 0) {
+			xmms_ipc_msg_fd_close (msg->fds[--msg->fdc]);
+		}
 		msg->xfered += ret;
 	}
 
@@ -226,7 +404,123 @@ xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg,
 }
 
 /**
- * Try to read message from transport into msg.
+ * Write as many of the given messages, in order, as the transport
+ * accepts, gathering them into as few writes as possible. A message
+ * that is only partially written keeps track of the amount of data
+ * written, and won't write that data again next time.
+ *
+ * @param written Set to the number of leading messages that were
+ *                written completely, the caller is done with them.
+ * @returns TRUE if the transport took everything it was offered, so
+ *               that the caller may go on with the messages that did
+ *               not fit in this call. FALSE if it is full or gone,
+ *               disconnected is set if transport was disconnected.
+ */
+bool
+xmms_ipc_msg_write_transport_many (xmms_ipc_msg_t **msgs, int count,
+                                   xmms_ipc_transport_t *transport,
+                                   int *written, bool *disconnected)
+{
+	xmms_ipc_iovec_t iov[XMMS_IPC_TRANSPORT_MAX_IOV];
+	unsigned int lens[XMMS_IPC_TRANSPORT_MAX_IOV];
+	unsigned int ret, remaining;
+	int i, n;
+
+	x_return_val_if_fail (msgs, false);
+	x_return_val_if_fail (transport, false);
+	x_return_val_if_fail (written, false);
+
+	*written = 0;
+
+	if (count <= 0) {
+		return true;
+	}
+
+	/* descriptors are sent with a write of their own */
+	if (msgs[0]->fdc) {
+		if (!xmms_ipc_msg_write_fds (msgs[0], transport, disconnected)) {
+			return false;
+		}
+		*written = 1;
+		return true;
+	}
+
+	n = 0;
+	for (i = 0; i < count && n + 2 <= XMMS_IPC_TRANSPORT_MAX_IOV; i++) {
+		if (msgs[i]->fdc) {
+			break;
+		}
+		n += xmms_ipc_msg_fill_iov (msgs[i], iov + n, &lens[i]);
+	}
+	count = i;
+
+	if (n > 0) {
+		ret = xmms_ipc_transport_writev (transport, iov, n);
+	} else {
+		ret = 0;
+	}
+
+	if (ret == SOCKET_ERROR) {
+		if (xmms_socket_error_recoverable ()) {
+			return false;
+		}
+
+		if (disconnected) {
+			*disconnected = true;
+		}
+
+		return false;
+	} else if (!ret && n > 0) {
+		if (disconnected) {
+			*disconnected = true;
+		}
+
+		return false;
+	}
+
+	for (i = 0; i < count; i++) {
+		remaining = lens[i] - msgs[i]->xfered;
+		if (ret < remaining) {
+			/* short write, the socket is full */
+			msgs[i]->xfered += ret;
+			break;
+		}
+
+		msgs[i]->xfered = lens[i];
+		ret -= remaining;
+	}
+
+	*written = i;
+
+	return i == count;
+}
+
+/**
+ * Try to write message to transport. If full message isn't written
+ * the message will keep track of the amount of data written and not
+ * write already written data next time.
+ *
+ * @returns TRUE if full message was written, FALSE otherwise.
+ *               disconnected is set if transport was disconnected
+ */
+bool
+xmms_ipc_msg_write_transport (xmms_ipc_msg_t *msg,
+                              xmms_ipc_transport_t *transport,
+                              bool *disconnected)
+{
+	int written;
+
+	x_return_val_if_fail (msg, false);
+	x_return_val_if_fail (transport, false);
+
+	return xmms_ipc_msg_write_transport_many (&msg, 1, transport,
+	                                          &written, disconnected)
+	       && written == 1;
+}
+
+/**
+ * Try to read message from transport into msg. The body is read
+ * straight into the message once the header tells its length.
  *
  * @returns TRUE if message is fully read.
  */
@@ -235,8 +529,9 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
                              xmms_ipc_transport_t *transport,
                              bool *disconnected)
 {
-	char buf[512];
+	unsigned char *buf;
 	unsigned int ret, len, rlen;
+	int fd;
 
 	x_return_val_if_fail (msg, false);
 	x_return_val_if_fail (transport, false);
@@ -254,11 +549,21 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
 
 		x_return_val_if_fail (msg->xfered < len, false);
 
+		/* grow by at most what has arrived so far, a bogus length
+		 * must not make us allocate much more than was sent */
 		rlen = len - msg->xfered;
-		if (rlen > sizeof (buf))
-			rlen = sizeof (buf);
+		rlen = MIN (rlen, MAX (msg->xfered, XMMS_IPC_MSG_READ_CHUNK));
 
-		ret = xmms_ipc_transport_read (transport, buf, rlen);
+		buf = _xmmsv_bitbuffer_reserve_data (msg->bb, msg->xfered + rlen);
+		if (!buf) {
+			if (disconnected) {
+				*disconnected = true;
+			}
+
+			return false;
+		}
+
+		ret = xmms_ipc_transport_read (transport, (char *) buf + msg->xfered, rlen);
 
 		if (ret == SOCKET_ERROR) {
 			if (xmms_socket_error_recoverable ()) {
@@ -277,10 +582,16 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
 
 			return false;
 		} else {
-			xmmsv_bitbuffer_goto (msg->bb, msg->xfered * 8);
-			xmmsv_bitbuffer_put_data (msg->bb, (unsigned char *) buf, ret);
 			msg->xfered += ret;
 			xmmsv_bitbuffer_goto (msg->bb, XMMS_IPC_MSG_HEAD_LEN * 8);
+
+			/* the reads stop at the message boundary, so anything
+			 * passed along was sent with this message */
+			while ((fd = xmms_ipc_transport_fd_take (transport)) != -1) {
+				if (!xmms_ipc_msg_add_fd (msg, fd)) {
+					xmms_ipc_msg_fd_close (fd);
+				}
+			}
 		}
 	}
 }
@@ -288,6 +599,8 @@ xmms_ipc_msg_read_transport (xmms_ipc_msg_t *msg,
 uint32_t
 xmms_ipc_msg_put_value (xmms_ipc_msg_t *msg, xmmsv_t *v)
 {
+	x_return_val_if_fail (!msg->payload, false);
+
 	if (!xmmsv_bitbuffer_serialize_value (msg->bb, v))
 		return false;
 	xmms_ipc_msg_update_length (msg->bb);
@@ -298,5 +611,7 @@ xmms_ipc_msg_put_value (xmms_ipc_msg_t *msg, xmmsv_t *v)
 bool
 xmms_ipc_msg_get_value (xmms_ipc_msg_t *msg, xmmsv_t **val)
 {
+	x_return_val_if_fail (!msg->payload, false);
+
 	return xmmsv_bitbuffer_deserialize_value (msg->bb, val);
 }
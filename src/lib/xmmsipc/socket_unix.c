@@ -33,28 +33,132 @@
 #include "url.h"
 #include "socket_unix.h"
 
+#ifndef MSG_CMSG_CLOEXEC
+# define MSG_CMSG_CLOEXEC 0
+#endif
+
+typedef union {
+	struct cmsghdr hdr;
+	char buf[CMSG_SPACE (sizeof (int) * XMMS_IPC_TRANSPORT_MAX_FDS)];
+} xmms_ipc_usocket_control_t;
+
 static void
 xmms_ipc_usocket_destroy (xmms_ipc_transport_t *ipct)
 {
+	int fd;
+
+	while ((fd = xmms_ipc_transport_fd_take (ipct)) != -1) {
+		close (fd);
+	}
+
 	free (ipct->path);
 	close (ipct->fd);
 }
 
+/* keep the descriptors that came with the data for fd_take */
+static void
+xmms_ipc_usocket_collect_fds (xmms_ipc_transport_t *ipct, struct msghdr *mh)
+{
+	struct cmsghdr *cmsg;
+	int i, n, fd;
+
+	for (cmsg = CMSG_FIRSTHDR (mh); cmsg; cmsg = CMSG_NXTHDR (mh, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+			continue;
+		}
+
+		n = (cmsg->cmsg_len - CMSG_LEN (0)) / sizeof (int);
+		for (i = 0; i < n; i++) {
+			memcpy (&fd, CMSG_DATA (cmsg) + i * sizeof (int), sizeof (int));
+			if (ipct->passed_fdc < XMMS_IPC_TRANSPORT_MAX_FDS) {
+				ipct->passed_fds[ipct->passed_fdc++] = fd;
+			} else {
+				close (fd);
+			}
+		}
+	}
+}
+
 static int
 xmms_ipc_usocket_read (xmms_ipc_transport_t *ipct, char *buffer, int len)
 {
-	int fd;
+	xmms_ipc_usocket_control_t control;
+	struct msghdr mh;
+	struct iovec iov;
 	int ret;
 	x_return_val_if_fail (ipct, -1);
 	x_return_val_if_fail (buffer, -1);
 
-	fd = ipct->fd;
+	iov.iov_base = buffer;
+	iov.iov_len = len;
 
-	ret =  recv (fd, buffer, len, 0);
+	memset (&mh, 0, sizeof (mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = control.buf;
+	mh.msg_controllen = sizeof (control.buf);
+
+	ret = recvmsg (ipct->fd, &mh, MSG_CMSG_CLOEXEC);
+	if (ret > 0 && mh.msg_controllen > 0) {
+		xmms_ipc_usocket_collect_fds (ipct, &mh);
+	}
 
 	return ret;
 }
 
+static int
+xmms_ipc_usocket_write_fds (xmms_ipc_transport_t *ipct, char *buffer, int len,
+                            const int *fds, int fdc)
+{
+	xmms_ipc_usocket_control_t control;
+	struct cmsghdr *cmsg;
+	struct msghdr mh;
+	struct iovec iov;
+	x_return_val_if_fail (ipct, -1);
+	x_return_val_if_fail (buffer, -1);
+	x_return_val_if_fail (fdc > 0 && fdc <= XMMS_IPC_TRANSPORT_MAX_FDS, -1);
+
+	iov.iov_base = buffer;
+	iov.iov_len = len;
+
+	memset (&control, 0, sizeof (control));
+	memset (&mh, 0, sizeof (mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+	mh.msg_control = control.buf;
+	mh.msg_controllen = CMSG_SPACE (fdc * sizeof (int));
+
+	cmsg = CMSG_FIRSTHDR (&mh);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN (fdc * sizeof (int));
+	memcpy (CMSG_DATA (cmsg), fds, fdc * sizeof (int));
+
+	return sendmsg (ipct->fd, &mh, 0);
+}
+
+static int
+xmms_ipc_usocket_writev (xmms_ipc_transport_t *ipct,
+                         const xmms_ipc_iovec_t *vec, int count)
+{
+	struct iovec iov[XMMS_IPC_TRANSPORT_MAX_IOV];
+	struct msghdr mh;
+	int i;
+	x_return_val_if_fail (ipct, -1);
+	x_return_val_if_fail (count > 0 && count <= XMMS_IPC_TRANSPORT_MAX_IOV, -1);
+
+	for (i = 0; i < count; i++) {
+		iov[i].iov_base = vec[i].base;
+		iov[i].iov_len = vec[i].len;
+	}
+
+	memset (&mh, 0, sizeof (mh));
+	mh.msg_iov = iov;
+	mh.msg_iovlen = count;
+
+	return sendmsg (ipct->fd, &mh, 0);
+}
+
 static int
 xmms_ipc_usocket_write (xmms_ipc_transport_t *ipct, char *buffer, int len)
 {
@@ -110,6 +214,8 @@ xmms_ipc_usocket_client_init (const xmms_url_t *url)
 	ipct->path = strdup (url->path);
 	ipct->read_func = xmms_ipc_usocket_read;
 	ipct->write_func = xmms_ipc_usocket_write;
+	ipct->writev_func = xmms_ipc_usocket_writev;
+	ipct->write_fds_func = xmms_ipc_usocket_write_fds;
 	ipct->destroy_func = xmms_ipc_usocket_destroy;
 
 	return ipct;
@@ -151,6 +257,8 @@ xmms_ipc_usocket_accept (xmms_ipc_transport_t *transport)
 		ret->fd = fd;
 		ret->read_func = xmms_ipc_usocket_read;
 		ret->write_func = xmms_ipc_usocket_write;
+		ret->writev_func = xmms_ipc_usocket_writev;
+		ret->write_fds_func = xmms_ipc_usocket_write_fds;
 		ret->destroy_func = xmms_ipc_usocket_destroy;
 
 		return ret;
@@ -213,6 +321,7 @@ xmms_ipc_usocket_server_init (const xmms_url_t *url)
 	ipct->path = strdup (url->path);
 	ipct->read_func = xmms_ipc_usocket_read;
 	ipct->write_func = xmms_ipc_usocket_write;
+	ipct->writev_func = xmms_ipc_usocket_writev;
 	ipct->accept_func = xmms_ipc_usocket_accept;
 	ipct->destroy_func = xmms_ipc_usocket_destroy;
 
@@ -47,6 +47,96 @@ xmms_ipc_transport_write (xmms_ipc_transport_t *ipct, char *buffer, int len)
 	return ipct->write_func (ipct, buffer, len);
 }
 
+/**
+ * Write several pieces of data with a single call. Transports without
+ * gathered writes get the pieces one at a time, until one of them is
+ * written short. Like any other write it may stop short, anywhere in
+ * any of the pieces.
+ *
+ * @returns the number of bytes written, or SOCKET_ERROR
+ */
+int
+xmms_ipc_transport_writev (xmms_ipc_transport_t *ipct,
+                           const xmms_ipc_iovec_t *iov, int iovcnt)
+{
+	int i, ret, total = 0;
+
+	x_return_val_if_fail (iovcnt > 0, SOCKET_ERROR);
+
+	if (ipct->writev_func && iovcnt > 1) {
+		return ipct->writev_func (ipct, iov, iovcnt);
+	}
+
+	for (i = 0; i < iovcnt; i++) {
+		if (!iov[i].len) {
+			continue;
+		}
+
+		ret = ipct->write_func (ipct, iov[i].base, iov[i].len);
+		if (ret <= 0) {
+			/* report what made it, the next write sees the error again */
+			return total ? total : ret;
+		}
+
+		total += ret;
+
+		if (ret < iov[i].len) {
+			break;
+		}
+	}
+
+	return total;
+}
+
+/**
+ * Write data, passing file descriptors along with it. The peer receives
+ * its own copies of the descriptors, the callers are left untouched.
+ * Transports that can't pass descriptors only write the data, check
+ * #xmms_ipc_transport_can_pass_fds first.
+ */
+int
+xmms_ipc_transport_write_fds (xmms_ipc_transport_t *ipct, char *buffer, int len,
+                              const int *fds, int fdc)
+{
+	if (!ipct->write_fds_func || !fdc) {
+		return ipct->write_func (ipct, buffer, len);
+	}
+
+	return ipct->write_fds_func (ipct, buffer, len, fds, fdc);
+}
+
+int
+xmms_ipc_transport_can_pass_fds (xmms_ipc_transport_t *ipct)
+{
+	x_return_val_if_fail (ipct, 0);
+	return ipct->write_fds_func != NULL;
+}
+
+/**
+ * Take the oldest descriptor that was received with the data read so
+ * far. The caller owns it afterwards.
+ *
+ * @returns the descriptor, or -1 if there is none
+ */
+int
+xmms_ipc_transport_fd_take (xmms_ipc_transport_t *ipct)
+{
+	int fd;
+
+	x_return_val_if_fail (ipct, -1);
+
+	if (!ipct->passed_fdc) {
+		return -1;
+	}
+
+	fd = ipct->passed_fds[0];
+	ipct->passed_fdc--;
+	memmove (ipct->passed_fds, ipct->passed_fds + 1,
+	         ipct->passed_fdc * sizeof (int));
+
+	return fd;
+}
+
 xmms_socket_t
 xmms_ipc_transport_fd_get (xmms_ipc_transport_t *ipct)
 {
@@ -19,6 +19,7 @@
 
 #include <xmmsc/xmmsc_stdbool.h>
 #include <xmmsc/xmmsv.h>
+#include <xmmscpriv/xmmsv.h>
 #include <xmmscpriv/xmmsc_util.h>
 
 static bool _internal_put_on_bb_bin (xmmsv_t *bb, const unsigned char *data, unsigned int len);
@@ -89,6 +90,35 @@ _internal_put_on_bb_int64 (xmmsv_t *bb, int64_t v)
 	return xmmsv_bitbuffer_put_bits (bb, 64, v);
 }
 
+/* Packed integer lists are converted in chunks of this many entries */
+#define PACKED_CHUNK 512
+
+static bool
+_internal_put_on_bb_packed_int64 (xmmsv_t *bb, const int64_t *ints, int count)
+{
+	unsigned char buf[PACKED_CHUNK * 8];
+	uint64_t v;
+	int i, j, k, n;
+
+	for (i = 0; i < count; i += n) {
+		n = MIN (count - i, PACKED_CHUNK);
+
+		for (j = 0; j < n; j++) {
+			v = ints[i + j];
+			for (k = 7; k >= 0; k--) {
+				buf[j * 8 + k] = v & 0xff;
+				v >>= 8;
+			}
+		}
+
+		if (!xmmsv_bitbuffer_put_data (bb, buf, n * 8)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static bool
 _internal_put_on_bb_float (xmmsv_t *bb, float v)
 {
@@ -174,6 +204,8 @@ _internal_put_on_bb_value_list (xmmsv_t *bb, xmmsv_t *v)
 	xmmsv_list_iter_t *it;
 	xmmsv_type_t type;
 	xmmsv_t *entry;
+	const int64_t *ints;
+	int count;
 
 	if (!xmmsv_get_list_iter (v, &it)) {
 		return false;
@@ -192,6 +224,13 @@ _internal_put_on_bb_value_list (xmmsv_t *bb, xmmsv_t *v)
 		return false;
 	}
 
+	/* Packed integers go out as one block, in the same encoding */
+	count = _xmmsv_list_get_packed (v, &ints);
+	if (count >= 0) {
+		xmmsv_list_iter_explicit_destroy (it);
+		return _internal_put_on_bb_packed_int64 (bb, ints, count);
+	}
+
 	if (type != XMMSV_TYPE_NONE) {
 		while (xmmsv_list_iter_entry (it, &entry)) {
 			if (!_internal_put_on_bb_value_of_type (bb, type, entry)) {
@@ -286,6 +325,37 @@ _internal_get_from_bb_int64 (xmmsv_t *bb, int64_t *v)
 	return xmmsv_bitbuffer_get_bits (bb, 64, v);
 }
 
+static bool
+_internal_get_from_bb_packed_int64 (xmmsv_t *bb, xmmsv_t *list, int count)
+{
+	unsigned char buf[PACKED_CHUNK * 8];
+	int64_t ints[PACKED_CHUNK];
+	uint64_t v;
+	int i, j, k, n;
+
+	for (i = 0; i < count; i += n) {
+		n = MIN (count - i, PACKED_CHUNK);
+
+		if (!xmmsv_bitbuffer_get_data (bb, buf, n * 8)) {
+			return false;
+		}
+
+		for (j = 0; j < n; j++) {
+			v = 0;
+			for (k = 0; k < 8; k++) {
+				v = (v << 8) | buf[j * 8 + k];
+			}
+			ints[j] = v;
+		}
+
+		if (!_xmmsv_list_append_packed (list, ints, n)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static bool
 _internal_get_from_bb_float (xmmsv_t *bb, float *v)
 {
@@ -467,7 +537,13 @@ _internal_get_from_bb_value_list_alloc (xmmsv_t *bb, xmmsv_t **val)
 	}
 
 	/* If list is restricted, avoid reading type for each entry */
-	if (type != XMMSV_TYPE_NONE) {
+	if (type == XMMSV_TYPE_INT64) {
+		xmmsv_list_restrict_type (list, type);
+
+		if (!_internal_get_from_bb_packed_int64 (bb, list, len)) {
+			goto err;
+		}
+	} else if (type != XMMSV_TYPE_NONE) {
 		xmmsv_list_restrict_type (list, type);
 
 		while (len--) {
@@ -72,41 +72,131 @@ xmmsv_new_bitbuffer (void)
 	return val;
 }
 
+/* Read a whole number of bytes at a byte aligned position, most
+ * significant byte first. */
+static int64_t
+_bitbuffer_load_be (const unsigned char *p, int bytes)
+{
+	uint64_t r;
+
+	switch (bytes) {
+		case 4:
+			return ((uint32_t) p[0] << 24) | ((uint32_t) p[1] << 16) |
+			       ((uint32_t) p[2] << 8) | (uint32_t) p[3];
+		case 8:
+			r = ((uint64_t) p[0] << 56) | ((uint64_t) p[1] << 48) |
+			    ((uint64_t) p[2] << 40) | ((uint64_t) p[3] << 32) |
+			    ((uint64_t) p[4] << 24) | ((uint64_t) p[5] << 16) |
+			    ((uint64_t) p[6] << 8) | (uint64_t) p[7];
+			return (int64_t) r;
+		default:
+			r = 0;
+			while (bytes--) {
+				r = (r << 8) | *p++;
+			}
+			return (int64_t) r;
+	}
+}
+
+static void
+_bitbuffer_store_be (unsigned char *p, int bytes, int64_t d)
+{
+	uint64_t u = (uint64_t) d;
+
+	switch (bytes) {
+		case 4:
+			p[0] = u >> 24; p[1] = u >> 16; p[2] = u >> 8; p[3] = u;
+			break;
+		case 8:
+			p[0] = u >> 56; p[1] = u >> 48; p[2] = u >> 40; p[3] = u >> 32;
+			p[4] = u >> 24; p[5] = u >> 16; p[6] = u >> 8; p[7] = u;
+			break;
+		default:
+			while (bytes--) {
+				p[bytes] = u;
+				u >>= 8;
+			}
+			break;
+	}
+}
+
+/* Make room for writing bits more bits at the current position. The
+ * buffer grows by doubling, and new space is zeroed as the bitwise
+ * writes only touch their own bits. */
+static int
+_bitbuffer_reserve (xmmsv_t *v, int bits)
+{
+	unsigned char *buf;
+	int ol, nl, need;
+
+	need = v->value.bit.pos + bits;
+	if (need <= v->value.bit.alloclen)
+		return 1;
+
+	ol = v->value.bit.alloclen;
+	nl = ol < 128 ? 128 : ol;
+	while (nl < need) {
+		nl *= 2;
+	}
+	nl = (nl + 7) & ~7;
+
+	buf = realloc (v->value.bit.buf, nl / 8);
+	if (!buf) {
+		x_oom ();
+		return 0;
+	}
+
+	memset (buf + ol / 8, 0, (nl - ol) / 8);
+	v->value.bit.buf = buf;
+	v->value.bit.alloclen = nl;
+
+	return 1;
+}
+
 int
 xmmsv_bitbuffer_get_bits (xmmsv_t *v, int bits, int64_t *res)
 {
-	int64_t r, t;
-	int i;
+	const unsigned char *buf;
+	uint64_t r;
+	int pos, i;
 
 	x_api_error_if (bits < 1, "less than one bit requested", 0);
 
-	if (bits == 1) {
-		int pos = v->value.bit.pos;
+	pos = v->value.bit.pos;
+	if (bits > v->value.bit.len - pos)
+		return 0;
 
-		if (pos >= v->value.bit.len)
-			return 0;
-		r = (v->value.bit.buf[pos / 8] >> (7-(pos % 8)) & 1);
-		v->value.bit.pos += 1;
-		*res = r;
-		return 1;
-	}
+	buf = v->value.bit.buf;
 
-	r = 0;
-	for (i = 0; i < bits; i++) {
-		t = 0;
-		if (!xmmsv_bitbuffer_get_bits (v, 1, &t))
-			return 0;
-		r = (r << 1) | t;
+	if ((pos % 8) == 0 && (bits % 8) == 0) {
+		*res = _bitbuffer_load_be (buf + pos / 8, bits / 8);
+	} else {
+		r = 0;
+		for (i = 0; i < bits; i++, pos++) {
+			r = (r << 1) | ((buf[pos / 8] >> (7 - (pos % 8))) & 1);
+		}
+		*res = (int64_t) r;
 	}
-	*res = r;
+
+	v->value.bit.pos += bits;
+
 	return 1;
 }
 
 int
 xmmsv_bitbuffer_get_data (xmmsv_t *v, unsigned char *b, int len)
 {
+	int64_t t;
+
+	if ((v->value.bit.pos % 8) == 0) {
+		if (len > (v->value.bit.len - v->value.bit.pos) / 8)
+			return 0;
+		memcpy (b, v->value.bit.buf + v->value.bit.pos / 8, len);
+		v->value.bit.pos += len * 8;
+		return 1;
+	}
+
 	while (len) {
-		int64_t t;
 		if (!xmmsv_bitbuffer_get_bits (v, 8, &t))
 			return 0;
 		*b = t;
@@ -119,42 +209,31 @@ xmmsv_bitbuffer_get_data (xmmsv_t *v, unsigned char *b, int len)
 int
 xmmsv_bitbuffer_put_bits (xmmsv_t *v, int bits, int64_t d)
 {
-	unsigned char t;
-	int pos;
-	int i;
+	unsigned char *buf;
+	int pos, i, shift;
 
 	x_api_error_if (v->value.bit.ro, "write to readonly bitbuffer", 0);
 	x_api_error_if (bits < 1, "less than one bit requested", 0);
 
-	if (bits == 1) {
-		pos = v->value.bit.pos;
-
-		if (pos >= v->value.bit.alloclen) {
-			int ol, nl;
-			nl = v->value.bit.alloclen * 2;
-			ol = v->value.bit.alloclen;
-			nl = nl < 128 ? 128 : nl;
-			nl = (nl + 7) & ~7;
-			v->value.bit.buf = realloc (v->value.bit.buf, nl / 8);
-			memset (v->value.bit.buf + ol / 8, 0, (nl - ol) / 8);
-			v->value.bit.alloclen = nl;
-		}
-		t = v->value.bit.buf[pos / 8];
-
-		t = (t & (~(1<<(7-(pos % 8))))) | (d << (7-(pos % 8)));
+	if (!_bitbuffer_reserve (v, bits))
+		return 0;
 
-		v->value.bit.buf[pos / 8] = t;
+	pos = v->value.bit.pos;
+	buf = v->value.bit.buf;
 
-		v->value.bit.pos += 1;
-		if (v->value.bit.pos > v->value.bit.len)
-			v->value.bit.len = v->value.bit.pos;
-		return 1;
+	if ((pos % 8) == 0 && (bits % 8) == 0) {
+		_bitbuffer_store_be (buf + pos / 8, bits / 8, d);
+	} else {
+		for (i = bits - 1; i >= 0; i--, pos++) {
+			shift = 7 - (pos % 8);
+			buf[pos / 8] = (buf[pos / 8] & ~(1 << shift)) |
+			               (((d >> i) & 1) << shift);
+		}
 	}
 
-	for (i = 0; i < bits; i++) {
-		if (!xmmsv_bitbuffer_put_bits (v, 1, !!(d & (1LL << (bits-i-1)))))
-			return 0;
-	}
+	v->value.bit.pos += bits;
+	if (v->value.bit.pos > v->value.bit.len)
+		v->value.bit.len = v->value.bit.pos;
 
 	return 1;
 }
@@ -174,6 +253,18 @@ xmmsv_bitbuffer_put_bits_at (xmmsv_t *v, int bits, int64_t d, int offset)
 int
 xmmsv_bitbuffer_put_data (xmmsv_t *v, const unsigned char *b, int len)
 {
+	x_api_error_if (v->value.bit.ro, "write to readonly bitbuffer", 0);
+
+	if ((v->value.bit.pos % 8) == 0) {
+		if (!_bitbuffer_reserve (v, len * 8))
+			return 0;
+		memcpy (v->value.bit.buf + v->value.bit.pos / 8, b, len);
+		v->value.bit.pos += len * 8;
+		if (v->value.bit.pos > v->value.bit.len)
+			v->value.bit.len = v->value.bit.pos;
+		return 1;
+	}
+
 	while (len) {
 		int t;
 		t = *b;
@@ -185,10 +276,34 @@ xmmsv_bitbuffer_put_data (xmmsv_t *v, const unsigned char *b, int len)
 	return 1;
 }
 
+/**
+ * Grow a byte aligned bitbuffer to at least size bytes and return its
+ * storage for writing, so that data can be read from a socket straight
+ * into it. The pointer is only valid until the bitbuffer is modified.
+ */
+unsigned char *
+_xmmsv_bitbuffer_reserve_data (xmmsv_t *v, int size)
+{
+	x_api_error_if (v->value.bit.ro, "write to readonly bitbuffer", NULL);
+	x_api_error_if (v->value.bit.len % 8, "unaligned bitbuffer", NULL);
+	x_api_error_if (size < 0 || size > INT32_MAX / 8, "size out of range", NULL);
+
+	if (size * 8 > v->value.bit.len) {
+		v->value.bit.pos = v->value.bit.len;
+		if (!_bitbuffer_reserve (v, size * 8 - v->value.bit.len))
+			return NULL;
+		v->value.bit.len = size * 8;
+	}
+
+	return v->value.bit.buf;
+}
+
 int
 xmmsv_bitbuffer_align (xmmsv_t *v)
 {
-	v->value.bit.pos = (v->value.bit.pos + 7) % 8;
+	v->value.bit.pos = (v->value.bit.pos + 7) & ~7;
+	if (v->value.bit.pos > v->value.bit.len)
+		v->value.bit.len = v->value.bit.pos;
 	return 1;
 }
 
@@ -113,9 +113,25 @@ duplicate_list_value (xmmsv_t *val)
 	xmmsv_list_iter_t *it;
 	xmmsv_t *v;
 	xmmsv_t *new_elem;
+	xmmsv_type_t type;
+	const int64_t *ints;
+	int count;
 
 	x_return_val_if_fail (xmmsv_get_list_iter (val, &it), NULL);
 	dup_val = xmmsv_new_list ();
+
+	if (xmmsv_list_get_type (val, &type) && type != XMMSV_TYPE_NONE) {
+		xmmsv_list_restrict_type (dup_val, type);
+	}
+
+	/* packed integers are copied without boxing them */
+	count = _xmmsv_list_get_packed (val, &ints);
+	if (count >= 0) {
+		_xmmsv_list_append_packed (dup_val, ints, count);
+		xmmsv_list_iter_explicit_destroy (it);
+		return dup_val;
+	}
+
 	while (xmmsv_list_iter_entry (it, &v)) {
 		new_elem = xmmsv_copy (v);
 		xmmsv_list_append (dup_val, new_elem);
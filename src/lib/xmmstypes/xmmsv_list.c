@@ -18,6 +18,7 @@
 #include <string.h>
 
 #include <xmmscpriv/xmmsv.h>
+#include <xmmscpriv/xmmsc_util.h>
 #include <xmmscpriv/xmms_list.h>
 
 #include <xmmsc/xmmsv.h>
@@ -27,12 +28,19 @@ struct xmmsv_list_iter_St {
 	int position;
 };
 
+/* Lists restricted to XMMSV_TYPE_INT64 are packed: the elements live
+ * unboxed in ints, and list is only allocated once a borrowed
+ * reference is handed out, caching the boxed value of each position
+ * (NULL until requested).
+ */
 struct xmmsv_list_internal_St {
 	xmmsv_t **list;
+	int64_t *ints;
 	xmmsv_t *parent_value;
 	int size;
 	int allocated;
 	bool restricted;
+	bool packed;
 	xmmsv_type_t restricttype;
 	x_list_t *iterators;
 };
@@ -75,6 +83,39 @@ _xmmsv_list_new (void)
 	return list;
 }
 
+/* Drop the reference held at the given position, if any. */
+static void
+_xmmsv_list_release (xmmsv_list_internal_t *l, int pos)
+{
+	if (l->list && l->list[pos]) {
+		xmmsv_unref (l->list[pos]);
+	}
+}
+
+/* Borrowed reference to the element at the given position, boxing
+ * it first if the list is packed. */
+static xmmsv_t *
+_xmmsv_list_entry (xmmsv_list_internal_t *l, int pos)
+{
+	if (!l->packed) {
+		return l->list[pos];
+	}
+
+	if (!l->list) {
+		l->list = calloc (l->allocated, sizeof (xmmsv_t *));
+		if (!l->list) {
+			x_oom ();
+			return NULL;
+		}
+	}
+
+	if (!l->list[pos]) {
+		l->list[pos] = xmmsv_new_int (l->ints[pos]);
+	}
+
+	return l->list[pos];
+}
+
 void
 _xmmsv_list_free (xmmsv_list_internal_t *l)
 {
@@ -89,10 +130,11 @@ _xmmsv_list_free (xmmsv_list_internal_t *l)
 
 	/* unref contents */
 	for (i = 0; i < l->size; i++) {
-		xmmsv_unref (l->list[i]);
+		_xmmsv_list_release (l, i);
 	}
 
 	free (l->list);
+	free (l->ints);
 	free (l);
 }
 
@@ -100,6 +142,24 @@ static int
 _xmmsv_list_resize (xmmsv_list_internal_t *l, int newsize)
 {
 	xmmsv_t **newmem;
+	int64_t *newints;
+
+	if (l->packed) {
+		newints = realloc (l->ints, newsize * sizeof (int64_t));
+
+		if (newsize != 0 && newints == NULL) {
+			x_oom ();
+			return 0;
+		}
+
+		l->ints = newints;
+
+		/* boxes are allocated on demand */
+		if (!l->list) {
+			l->allocated = newsize;
+			return 1;
+		}
+	}
 
 	newmem = realloc (l->list, newsize * sizeof (xmmsv_t *));
 
@@ -114,19 +174,26 @@ _xmmsv_list_resize (xmmsv_list_internal_t *l, int newsize)
 	return 1;
 }
 
-static int
-_xmmsv_list_insert (xmmsv_list_internal_t *l, int pos, xmmsv_t *val)
+/* Move count elements from position src to position dst. */
+static void
+_xmmsv_list_shift (xmmsv_list_internal_t *l, int dst, int src, int count)
 {
-	xmmsv_list_iter_t *it;
-	x_list_t *n;
-
-	if (!_xmmsv_list_position_normalize (&pos, l->size, 1)) {
-		return 0;
+	if (l->list) {
+		memmove (l->list + dst, l->list + src, count * sizeof (xmmsv_t *));
 	}
 
-	if (l->restricted) {
-		x_return_val_if_fail (xmmsv_is_type (val, l->restricttype), 0);
+	if (l->packed) {
+		memmove (l->ints + dst, l->ints + src, count * sizeof (int64_t));
 	}
+}
+
+/* Make room for a new element at the given, already normalized,
+ * position. The caller fills the slot. */
+static int
+_xmmsv_list_open (xmmsv_list_internal_t *l, int pos)
+{
+	xmmsv_list_iter_t *it;
+	x_list_t *n;
 
 	/* We need more memory, reallocate */
 	if (l->size == l->allocated) {
@@ -143,11 +210,13 @@ _xmmsv_list_insert (xmmsv_list_internal_t *l, int pos, xmmsv_t *val)
 
 	/* move existing items out of the way */
 	if (l->size > pos) {
-		memmove (l->list + pos + 1, l->list + pos,
-		         (l->size - pos) * sizeof (xmmsv_t *));
+		_xmmsv_list_shift (l, pos + 1, pos, l->size - pos);
+	}
+
+	if (l->list) {
+		l->list[pos] = NULL;
 	}
 
-	l->list[pos] = xmmsv_ref (val);
 	l->size++;
 
 	/* update iterators pos */
@@ -161,6 +230,59 @@ _xmmsv_list_insert (xmmsv_list_internal_t *l, int pos, xmmsv_t *val)
 	return 1;
 }
 
+static int
+_xmmsv_list_insert (xmmsv_list_internal_t *l, int pos, xmmsv_t *val)
+{
+	if (!_xmmsv_list_position_normalize (&pos, l->size, 1)) {
+		return 0;
+	}
+
+	if (l->restricted) {
+		x_return_val_if_fail (xmmsv_is_type (val, l->restricttype), 0);
+	}
+
+	if (!_xmmsv_list_open (l, pos)) {
+		return 0;
+	}
+
+	if (l->packed) {
+		l->ints[pos] = val->value.int64;
+	}
+
+	if (l->list) {
+		l->list[pos] = xmmsv_ref (val);
+	}
+
+	return 1;
+}
+
+static int
+_xmmsv_list_insert_int (xmmsv_list_internal_t *l, int pos, int64_t val)
+{
+	xmmsv_t *v;
+	int ret;
+
+	if (!l->packed) {
+		v = xmmsv_new_int (val);
+		ret = _xmmsv_list_insert (l, pos, v);
+		xmmsv_unref (v);
+
+		return ret;
+	}
+
+	if (!_xmmsv_list_position_normalize (&pos, l->size, 1)) {
+		return 0;
+	}
+
+	if (!_xmmsv_list_open (l, pos)) {
+		return 0;
+	}
+
+	l->ints[pos] = val;
+
+	return 1;
+}
+
 static int
 _xmmsv_list_append (xmmsv_list_internal_t *l, xmmsv_t *val)
 {
@@ -179,14 +301,13 @@ _xmmsv_list_remove (xmmsv_list_internal_t *l, int pos)
 		return 0;
 	}
 
-	xmmsv_unref (l->list[pos]);
+	_xmmsv_list_release (l, pos);
 
 	l->size--;
 
 	/* fill the gap */
 	if (pos < l->size) {
-		memmove (l->list + pos, l->list + pos + 1,
-		         (l->size - pos) * sizeof (xmmsv_t *));
+		_xmmsv_list_shift (l, pos, pos + 1, l->size - pos);
 	}
 
 	/* Reduce memory usage by two if possible */
@@ -211,7 +332,8 @@ _xmmsv_list_remove (xmmsv_list_internal_t *l, int pos)
 static int
 _xmmsv_list_move (xmmsv_list_internal_t *l, int old_pos, int new_pos)
 {
-	xmmsv_t *v;
+	xmmsv_t *v = NULL;
+	int64_t i = 0;
 	xmmsv_list_iter_t *it;
 	x_list_t *n;
 
@@ -222,11 +344,15 @@ _xmmsv_list_move (xmmsv_list_internal_t *l, int old_pos, int new_pos)
 		return 0;
 	}
 
-	v = l->list[old_pos];
+	if (l->list) {
+		v = l->list[old_pos];
+	}
+	if (l->packed) {
+		i = l->ints[old_pos];
+	}
+
 	if (old_pos < new_pos) {
-		memmove (l->list + old_pos, l->list + old_pos + 1,
-		         (new_pos - old_pos) * sizeof (xmmsv_t *));
-		l->list[new_pos] = v;
+		_xmmsv_list_shift (l, old_pos, old_pos + 1, new_pos - old_pos);
 
 		/* update iterator pos */
 		for (n = l->iterators; n; n = n->next) {
@@ -240,9 +366,7 @@ _xmmsv_list_move (xmmsv_list_internal_t *l, int old_pos, int new_pos)
 			}
 		}
 	} else {
-		memmove (l->list + new_pos + 1, l->list + new_pos,
-		         (old_pos - new_pos) * sizeof (xmmsv_t *));
-		l->list[new_pos] = v;
+		_xmmsv_list_shift (l, new_pos + 1, new_pos, old_pos - new_pos);
 
 		/* update iterator pos */
 		for (n = l->iterators; n; n = n->next) {
@@ -257,6 +381,13 @@ _xmmsv_list_move (xmmsv_list_internal_t *l, int old_pos, int new_pos)
 		}
 	}
 
+	if (l->list) {
+		l->list[new_pos] = v;
+	}
+	if (l->packed) {
+		l->ints[new_pos] = i;
+	}
+
 	return 1;
 }
 
@@ -269,13 +400,16 @@ _xmmsv_list_clear (xmmsv_list_internal_t *l)
 
 	/* unref all stored values */
 	for (i = 0; i < l->size; i++) {
-		xmmsv_unref (l->list[i]);
+		_xmmsv_list_release (l, i);
 	}
 
 	/* free list, declare empty */
 	free (l->list);
 	l->list = NULL;
 
+	free (l->ints);
+	l->ints = NULL;
+
 	l->size = 0;
 	l->allocated = 0;
 
@@ -286,11 +420,121 @@ _xmmsv_list_clear (xmmsv_list_internal_t *l)
 	}
 }
 
-static void
+static int
 _xmmsv_list_sort (xmmsv_list_internal_t *l, xmmsv_list_compare_func_t comparator)
 {
+	int i;
+
+	/* the comparator works on boxed values */
+	for (i = 0; i < l->size; i++) {
+		x_return_val_if_fail (_xmmsv_list_entry (l, i), 0);
+	}
+
 	qsort (l->list, l->size, sizeof (xmmsv_t *),
 	       (int (*)(const void *, const void *)) comparator);
+
+	if (l->packed) {
+		for (i = 0; i < l->size; i++) {
+			l->ints[i] = l->list[i]->value.int64;
+		}
+	}
+
+	return 1;
+}
+
+/* Switch a list of integers to the packed representation, the
+ * existing values are kept as cached boxes. */
+static int
+_xmmsv_list_pack (xmmsv_list_internal_t *l)
+{
+	int i;
+
+	if (l->allocated > 0) {
+		l->ints = malloc (l->allocated * sizeof (int64_t));
+		if (!l->ints) {
+			x_oom ();
+			return 0;
+		}
+	}
+
+	for (i = 0; i < l->size; i++) {
+		l->ints[i] = l->list[i]->value.int64;
+	}
+
+	l->packed = true;
+
+	return 1;
+}
+
+/**
+ * Get the packed integers of a list restricted to #XMMSV_TYPE_INT64.
+ *
+ * @param listv A #xmmsv_t containing a list.
+ * @param ints Pointer set to the elements, owned by the list and only
+ *             valid until it is modified.
+ * @return The number of elements, or -1 if the list is not packed.
+ */
+int
+_xmmsv_list_get_packed (xmmsv_t *listv, const int64_t **ints)
+{
+	xmmsv_list_internal_t *l;
+
+	x_return_val_if_fail (listv, -1);
+	x_return_val_if_fail (xmmsv_is_type (listv, XMMSV_TYPE_LIST), -1);
+
+	l = listv->value.list;
+	if (!l->packed) {
+		return -1;
+	}
+
+	*ints = l->ints;
+
+	return l->size;
+}
+
+/**
+ * Append integers to the end of a list restricted to #XMMSV_TYPE_INT64.
+ *
+ * @param listv A #xmmsv_t containing a list.
+ * @param ints The integers to append.
+ * @param count The number of integers.
+ * @return 1 upon success otherwise 0
+ */
+int
+_xmmsv_list_append_packed (xmmsv_t *listv, const int64_t *ints, int count)
+{
+	xmmsv_list_internal_t *l;
+	int needed, newsize;
+
+	x_return_val_if_fail (listv, 0);
+	x_return_val_if_fail (xmmsv_is_type (listv, XMMSV_TYPE_LIST), 0);
+	x_return_val_if_fail (count >= 0, 0);
+
+	l = listv->value.list;
+	x_return_val_if_fail (l->packed, 0);
+	x_return_val_if_fail (count <= INT32_MAX - l->size, 0);
+
+	if (count == 0) {
+		return 1;
+	}
+
+	needed = l->size + count;
+	if (needed > l->allocated) {
+		newsize = l->allocated > 0 ? l->allocated : 1;
+		while (newsize < needed) {
+			newsize = newsize > INT32_MAX / 2 ? needed : newsize << 1;
+		}
+		x_return_val_if_fail (_xmmsv_list_resize (l, newsize), 0);
+	}
+
+	memcpy (l->ints + l->size, ints, count * sizeof (int64_t));
+	if (l->list) {
+		memset (l->list + l->size, 0, count * sizeof (xmmsv_t *));
+	}
+
+	l->size = needed;
+
+	return 1;
 }
 
 /**
@@ -339,7 +583,8 @@ xmmsv_list_get (xmmsv_t *listv, int pos, xmmsv_t **val)
 	}
 
 	if (val) {
-		*val = l->list[pos];
+		*val = _xmmsv_list_entry (l, pos);
+		x_return_val_if_fail (*val, 0);
 	}
 
 	return 1;
@@ -370,9 +615,19 @@ xmmsv_list_set (xmmsv_t *listv, int pos, xmmsv_t *val)
 		return 0;
 	}
 
+	if (l->packed) {
+		x_return_val_if_fail (xmmsv_is_type (val, XMMSV_TYPE_INT64), 0);
+		l->ints[pos] = val->value.int64;
+		if (!l->list) {
+			return 1;
+		}
+	}
+
 	old_val = l->list[pos];
 	l->list[pos] = xmmsv_ref (val);
-	xmmsv_unref (old_val);
+	if (old_val) {
+		xmmsv_unref (old_val);
+	}
 
 	return 1;
 }
@@ -485,9 +740,7 @@ xmmsv_list_sort (xmmsv_t *listv, xmmsv_list_compare_func_t comparator)
 	x_return_val_if_fail (listv, 0);
 	x_return_val_if_fail (xmmsv_is_type (listv, XMMSV_TYPE_LIST), 0);
 
-	_xmmsv_list_sort (listv->value.list, comparator);
-
-	return 1;
+	return _xmmsv_list_sort (listv->value.list, comparator);
 }
 
 /**
@@ -535,6 +788,15 @@ xmmsv_list_get_size (xmmsv_t *listv)
 }
 
 
+/**
+ * Restrict the list to elements of the given type. Lists restricted to
+ * #XMMSV_TYPE_INT64 store their elements packed, without a separate
+ * #xmmsv_t per element.
+ *
+ * @param listv The list to restrict
+ * @param type The type all elements must have
+ * @return 1 upon success otherwise 0
+ */
 int
 xmmsv_list_restrict_type (xmmsv_t *listv, xmmsv_type_t type)
 {
@@ -542,6 +804,10 @@ xmmsv_list_restrict_type (xmmsv_t *listv, xmmsv_type_t type)
 	x_return_val_if_fail (!listv->value.list->restricted ||
 	                      listv->value.list->restricttype == type, 0);
 
+	if (type == XMMSV_TYPE_INT64 && !listv->value.list->packed) {
+		x_return_val_if_fail (_xmmsv_list_pack (listv->value.list), 0);
+	}
+
 	listv->value.list->restricted = true;
 	listv->value.list->restricttype = type;
 
@@ -602,7 +868,8 @@ xmmsv_list_has_type (xmmsv_t *listv, xmmsv_type_t type)
 
 /**
  * Get the index of an element in the list. This function compares the
- * pointers and not the actual values contained in the elements.
+ * pointers and not the actual values contained in the elements, except
+ * for packed lists of integers where the values are compared.
  *
  * @param listv The #xmmsv_t containing the list
  * @param val The element to find
@@ -611,6 +878,7 @@ xmmsv_list_has_type (xmmsv_t *listv, xmmsv_type_t type)
 int
 xmmsv_list_index_of (xmmsv_t *listv, xmmsv_t *val)
 {
+	xmmsv_list_internal_t *l;
 	xmmsv_list_iter_t *it;
 	xmmsv_t *v;
 	int i = 0, ret = -1;
@@ -618,6 +886,19 @@ xmmsv_list_index_of (xmmsv_t *listv, xmmsv_t *val)
 	x_return_val_if_fail (listv, -1);
 	x_return_val_if_fail (xmmsv_is_type (listv, XMMSV_TYPE_LIST), -1);
 
+	l = listv->value.list;
+	if (l->packed) {
+		if (!xmmsv_is_type (val, XMMSV_TYPE_INT64)) {
+			return -1;
+		}
+		for (i = 0; i < l->size; i++) {
+			if (l->ints[i] == val->value.int64) {
+				return i;
+			}
+		}
+		return -1;
+	}
+
 	if (!xmmsv_get_list_iter (listv, &it))
 		return -1;
 
@@ -725,7 +1006,8 @@ xmmsv_list_iter_entry (xmmsv_list_iter_t *it, xmmsv_t **val)
 	if (!xmmsv_list_iter_valid (it))
 		return 0;
 
-	*val = it->parent->list[it->position];
+	*val = _xmmsv_list_entry (it->parent, it->position);
+	x_return_val_if_fail (*val, 0);
 
 	return 1;
 }
@@ -957,10 +1239,48 @@ xmmsv_list_flatten (xmmsv_t *list, int depth)
 	}
 
 GEN_LIST_EXTRACTOR_FUNC (string, const char *)
-GEN_LIST_EXTRACTOR_FUNC (int32, int32_t)
-GEN_LIST_EXTRACTOR_FUNC (int64, int64_t)
 GEN_LIST_EXTRACTOR_FUNC (float, float)
 
+int
+xmmsv_list_get_int64 (xmmsv_t *val, int pos, int64_t *r)
+{
+	xmmsv_list_internal_t *l;
+	xmmsv_t *v;
+
+	x_return_val_if_fail (val, 0);
+	x_return_val_if_fail (xmmsv_is_type (val, XMMSV_TYPE_LIST), 0);
+
+	l = val->value.list;
+	if (!l->packed) {
+		if (!xmmsv_list_get (val, pos, &v)) {
+			return 0;
+		}
+		return xmmsv_get_int64 (v, r);
+	}
+
+	if (!_xmmsv_list_position_normalize (&pos, l->size, 0)) {
+		return 0;
+	}
+
+	*r = l->ints[pos];
+
+	return 1;
+}
+
+int
+xmmsv_list_get_int32 (xmmsv_t *val, int pos, int32_t *r)
+{
+	int64_t raw_val;
+
+	if (!xmmsv_list_get_int64 (val, pos, &raw_val)) {
+		return 0;
+	}
+
+	*r = INT64_TO_INT32 (raw_val);
+
+	return 1;
+}
+
 int
 xmmsv_list_get_coll (xmmsv_t *val, int pos, xmmsv_t **r)
 {
@@ -983,9 +1303,40 @@ xmmsv_list_get_coll (xmmsv_t *val, int pos, xmmsv_t **r)
 	}
 
 GEN_LIST_SET_FUNC (string, const char *)
-GEN_LIST_SET_FUNC (int, int64_t)
 GEN_LIST_SET_FUNC (float, float)
 
+int
+xmmsv_list_set_int (xmmsv_t *list, int pos, int64_t elem)
+{
+	xmmsv_list_internal_t *l;
+	int ret;
+	xmmsv_t *v;
+
+	x_return_val_if_fail (list, 0);
+	x_return_val_if_fail (xmmsv_is_type (list, XMMSV_TYPE_LIST), 0);
+
+	l = list->value.list;
+	if (!l->packed) {
+		v = xmmsv_new_int (elem);
+		ret = xmmsv_list_set (list, pos, v);
+		xmmsv_unref (v);
+
+		return ret;
+	}
+
+	if (!_xmmsv_list_position_normalize (&pos, l->size, 0)) {
+		return 0;
+	}
+
+	_xmmsv_list_release (l, pos);
+	if (l->list) {
+		l->list[pos] = NULL;
+	}
+	l->ints[pos] = elem;
+
+	return 1;
+}
+
 int
 xmmsv_list_set_coll (xmmsv_t *list, int pos, xmmsv_t *elem)
 {
@@ -1008,9 +1359,17 @@ xmmsv_list_set_coll (xmmsv_t *list, int pos, xmmsv_t *elem)
 	}
 
 GEN_LIST_INSERT_FUNC (string, const char *)
-GEN_LIST_INSERT_FUNC (int, int64_t)
 GEN_LIST_INSERT_FUNC (float, float)
 
+int
+xmmsv_list_insert_int (xmmsv_t *list, int pos, int64_t elem)
+{
+	x_return_val_if_fail (list, 0);
+	x_return_val_if_fail (xmmsv_is_type (list, XMMSV_TYPE_LIST), 0);
+
+	return _xmmsv_list_insert_int (list->value.list, pos, elem);
+}
+
 int
 xmmsv_list_insert_coll (xmmsv_t *list, int pos, xmmsv_t *elem)
 {
@@ -1033,9 +1392,17 @@ xmmsv_list_insert_coll (xmmsv_t *list, int pos, xmmsv_t *elem)
 	}
 
 GEN_LIST_APPEND_FUNC (string, const char *)
-GEN_LIST_APPEND_FUNC (int, int64_t)
 GEN_LIST_APPEND_FUNC (float, float)
 
+int
+xmmsv_list_append_int (xmmsv_t *list, int64_t elem)
+{
+	x_return_val_if_fail (list, 0);
+	x_return_val_if_fail (xmmsv_is_type (list, XMMSV_TYPE_LIST), 0);
+
+	return _xmmsv_list_insert_int (list->value.list, list->value.list->size, elem);
+}
+
 int
 xmmsv_list_append_coll (xmmsv_t *list, xmmsv_t *elem)
 {
@@ -1055,10 +1422,43 @@ xmmsv_list_append_coll (xmmsv_t *list, xmmsv_t *elem)
 	}
 
 GEN_LIST_ITER_EXTRACTOR_FUNC (string, const char *)
-GEN_LIST_ITER_EXTRACTOR_FUNC (int32, int32_t)
-GEN_LIST_ITER_EXTRACTOR_FUNC (int64, int64_t)
 GEN_LIST_ITER_EXTRACTOR_FUNC (float, float)
 
+int
+xmmsv_list_iter_entry_int64 (xmmsv_list_iter_t *it, int64_t *r)
+{
+	xmmsv_t *v;
+
+	if (!xmmsv_list_iter_valid (it)) {
+		return 0;
+	}
+
+	if (it->parent->packed) {
+		*r = it->parent->ints[it->position];
+		return 1;
+	}
+
+	if (!xmmsv_list_iter_entry (it, &v)) {
+		return 0;
+	}
+
+	return xmmsv_get_int64 (v, r);
+}
+
+int
+xmmsv_list_iter_entry_int32 (xmmsv_list_iter_t *it, int32_t *r)
+{
+	int64_t raw_val;
+
+	if (!xmmsv_list_iter_entry_int64 (it, &raw_val)) {
+		return 0;
+	}
+
+	*r = INT64_TO_INT32 (raw_val);
+
+	return 1;
+}
+
 int
 xmmsv_list_iter_entry_coll (xmmsv_list_iter_t *it, xmmsv_t **r)
 {
@@ -1081,9 +1481,16 @@ xmmsv_list_iter_entry_coll (xmmsv_list_iter_t *it, xmmsv_t **r)
 	}
 
 GEN_LIST_ITER_INSERT_FUNC (string, const char *)
-GEN_LIST_ITER_INSERT_FUNC (int, int64_t)
 GEN_LIST_ITER_INSERT_FUNC (float, float)
 
+int
+xmmsv_list_iter_insert_int (xmmsv_list_iter_t *it, int64_t elem)
+{
+	x_return_val_if_fail (it, 0);
+
+	return _xmmsv_list_insert_int (it->parent, it->position, elem);
+}
+
 int
 xmmsv_list_iter_insert_coll (xmmsv_list_iter_t *it, xmmsv_t *elem)
 {
@@ -22,6 +22,11 @@
 
 #include <glib.h>
 
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+
 /*
  *  Defines
  */
@@ -35,6 +40,13 @@ typedef struct xmms_alsa_data_St {
 	snd_pcm_t *pcm;
 	snd_mixer_t *mixer;
 	snd_mixer_elem_t *mixer_elem;
+
+	/* the mixer is shared with the monitor thread */
+	GMutex mixer_lock;
+	GThread *monitor_thread;
+	gboolean monitoring;
+	/* closing the write end stops the monitor thread */
+	gint monitor_wakeup[2];
 } xmms_alsa_data_t;
 
 static const struct {
@@ -97,6 +109,11 @@ static gboolean xmms_alsa_volume_set (xmms_output_t *output,
 static gboolean xmms_alsa_volume_get (xmms_output_t *output,
                                       const gchar **names, guint *values,
                                       guint *num_channels);
+static gboolean xmms_alsa_volume_monitor (xmms_output_t *output,
+                                          gboolean enable);
+static gpointer xmms_alsa_mixer_monitor (gpointer udata);
+static int xmms_alsa_mixer_elem_event (snd_mixer_elem_t *elem,
+                                       unsigned int mask);
 static gboolean xmms_alsa_mixer_setup (xmms_output_t *plugin,
                                        xmms_alsa_data_t *data);
 static gboolean xmms_alsa_probe_modes (xmms_output_t *output,
@@ -136,6 +153,7 @@ xmms_alsa_plugin_setup (xmms_output_plugin_t *plugin)
 
 	methods.volume_get = xmms_alsa_volume_get;
 	methods.volume_set = xmms_alsa_volume_set;
+	methods.volume_monitor = xmms_alsa_volume_monitor;
 
 	methods.write = xmms_alsa_write;
 
@@ -189,6 +207,8 @@ xmms_alsa_new (xmms_output_t *output)
 		return FALSE;
 	}
 
+	g_mutex_init (&data->mixer_lock);
+
 	xmms_alsa_mixer_setup (output, data);
 
 	xmms_output_private_data_set (output, data);
@@ -308,6 +328,8 @@ xmms_alsa_destroy (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
+	xmms_alsa_volume_monitor (output, FALSE);
+
 	if (data->mixer) {
 		err = snd_mixer_close (data->mixer);
 		if (err != 0) {
@@ -318,6 +340,7 @@ xmms_alsa_destroy (xmms_output_t *output)
 		}
 	}
 
+	g_mutex_clear (&data->mixer_lock);
 	g_free (data);
 }
 
@@ -665,8 +688,10 @@ xmms_alsa_volume_set (xmms_output_t *output,
 		return FALSE;
 	}
 
+	g_mutex_lock (&data->mixer_lock);
 	err = snd_mixer_selem_set_playback_volume (data->mixer_elem,
 	                                           channel, volume);
+	g_mutex_unlock (&data->mixer_lock);
 
 	return (err >= 0);
 }
@@ -704,11 +729,17 @@ xmms_alsa_volume_get (xmms_output_t *output, const gchar **names,
 	g_return_val_if_fail (names, FALSE);
 	g_return_val_if_fail (values, FALSE);
 
-	err = snd_mixer_handle_events (data->mixer);
-	if (err < 0) {
-		xmms_log_error ("Handling of pending mixer events failed: %s",
-		                snd_strerror (err));
-		return FALSE;
+	g_mutex_lock (&data->mixer_lock);
+
+	/* the monitor thread keeps the mixer up to date */
+	if (!data->monitoring) {
+		err = snd_mixer_handle_events (data->mixer);
+		if (err < 0) {
+			g_mutex_unlock (&data->mixer_lock);
+			xmms_log_error ("Handling of pending mixer events failed: %s",
+			                snd_strerror (err));
+			return FALSE;
+		}
 	}
 
 	for (i = 0; i < *num_channels; i++) {
@@ -726,9 +757,156 @@ xmms_alsa_volume_get (xmms_output_t *output, const gchar **names,
 		names[i] = channel_map[i].name;
 	}
 
+	g_mutex_unlock (&data->mixer_lock);
+
 	return TRUE;
 }
 
+/**
+ * Start or stop watching the mixer for volume changes.
+ *
+ * @param output The output struct containing alsa data.
+ * @param enable TRUE to start watching, FALSE to stop.
+ * @return TRUE if volume changes will be reported, otherwise FALSE.
+ */
+static gboolean
+xmms_alsa_volume_monitor (xmms_output_t *output, gboolean enable)
+{
+	xmms_alsa_data_t *data;
+
+	g_return_val_if_fail (output, FALSE);
+
+	data = xmms_output_private_data_get (output);
+	g_return_val_if_fail (data, FALSE);
+
+	if (!enable) {
+		if (data->monitor_thread) {
+			close (data->monitor_wakeup[1]);
+			g_thread_join (data->monitor_thread);
+			close (data->monitor_wakeup[0]);
+			data->monitor_thread = NULL;
+
+			g_mutex_lock (&data->mixer_lock);
+			snd_mixer_elem_set_callback (data->mixer_elem, NULL);
+			data->monitoring = FALSE;
+			g_mutex_unlock (&data->mixer_lock);
+		}
+		return TRUE;
+	}
+
+	if (data->monitor_thread) {
+		return TRUE;
+	}
+
+	if (!data->mixer || !data->mixer_elem) {
+		return FALSE;
+	}
+
+	if (pipe (data->monitor_wakeup) < 0) {
+		xmms_log_error ("Unable to create mixer monitor pipe: %s",
+		                strerror (errno));
+		return FALSE;
+	}
+
+	g_mutex_lock (&data->mixer_lock);
+	snd_mixer_elem_set_callback_private (data->mixer_elem, output);
+	snd_mixer_elem_set_callback (data->mixer_elem, xmms_alsa_mixer_elem_event);
+	data->monitoring = TRUE;
+	g_mutex_unlock (&data->mixer_lock);
+
+	data->monitor_thread = g_thread_new ("x2 alsa mixer",
+	                                     xmms_alsa_mixer_monitor, output);
+
+	return TRUE;
+}
+
+/**
+ * Called by snd_mixer_handle_events when the mixer element changes.
+ */
+static int
+xmms_alsa_mixer_elem_event (snd_mixer_elem_t *elem, unsigned int mask)
+{
+	if (mask == SND_CTL_EVENT_MASK_REMOVE || (mask & SND_CTL_EVENT_MASK_VALUE)) {
+		xmms_output_volume_changed (snd_mixer_elem_get_callback_private (elem));
+	}
+
+	return 0;
+}
+
+/**
+ * Wait for events on the mixer and dispatch them.
+ *
+ * Runs until the write end of the wakeup pipe is closed.
+ */
+static gpointer
+xmms_alsa_mixer_monitor (gpointer udata)
+{
+	xmms_output_t *output = udata;
+	xmms_alsa_data_t *data;
+	struct pollfd *fds;
+	unsigned short revents;
+	gint count, err;
+
+	data = xmms_output_private_data_get (output);
+
+	g_mutex_lock (&data->mixer_lock);
+	count = snd_mixer_poll_descriptors_count (data->mixer);
+	g_mutex_unlock (&data->mixer_lock);
+
+	fds = g_new (struct pollfd, MAX (count, 0) + 1);
+	err = count;
+
+	while (err >= 0) {
+		fds[0].fd = data->monitor_wakeup[0];
+		fds[0].events = POLLIN;
+		fds[0].revents = 0;
+
+		g_mutex_lock (&data->mixer_lock);
+		err = snd_mixer_poll_descriptors (data->mixer, fds + 1, count);
+		g_mutex_unlock (&data->mixer_lock);
+
+		if (err < 0) {
+			break;
+		}
+
+		if (poll (fds, count + 1, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			err = -errno;
+			break;
+		}
+
+		if (fds[0].revents) {
+			g_free (fds);
+			return NULL;
+		}
+
+		g_mutex_lock (&data->mixer_lock);
+		err = snd_mixer_poll_descriptors_revents (data->mixer, fds + 1,
+		                                          count, &revents);
+		if (err >= 0 && (revents & (POLLERR | POLLNVAL))) {
+			err = -EIO;
+		} else if (err >= 0 && (revents & POLLIN)) {
+			err = snd_mixer_handle_events (data->mixer);
+		}
+		g_mutex_unlock (&data->mixer_lock);
+	}
+
+	xmms_log_error ("Watching the mixer failed: %s", snd_strerror (err));
+
+	/* let volume_get pick up the changes itself from now on */
+	g_mutex_lock (&data->mixer_lock);
+	data->monitoring = FALSE;
+	g_mutex_unlock (&data->mixer_lock);
+
+	xmms_output_volume_monitor_failed (output);
+
+	g_free (fds);
+
+	return NULL;
+}
+
 /**
  * Get bytes in buffer.
  * Calculates bytes in buffer by subtract buffer size with available frames
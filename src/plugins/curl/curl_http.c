@@ -43,11 +43,35 @@ typedef struct {
 	struct curl_slist *http_200_aliases;
 	struct curl_slist *http_req_headers;
 
+	/* ring buffer between curl and xmms_curl_read */
 	gchar *buffer;
-	guint bufferpos, bufferlen;
+	guint bufferpos, bufferlen, buffersize;
+
+	/* keep up to this many bytes buffered ahead of the reader */
+	guint readahead;
+
+	/* the transfer is paused because the buffer is full */
+	gboolean paused;
+
+	/* stream position of the first byte in the buffer */
+	gint64 offset;
+
+	/* size of the whole resource, or -1 if unknown */
+	gint64 length;
+
+	/* where the current request starts, and the number of bytes to
+	 * throw away from the response if the server ignored the range */
+	gint64 range_start;
+	gint64 discard;
+
+	gint http_status;
+	gboolean accept_ranges;
 
 	gint curl_code;
 
+	/* how the last transfer ended, once done */
+	CURLcode result;
+
 	gboolean done;
 
 	xmms_error_t status;
@@ -57,7 +81,10 @@ typedef struct {
 
 typedef void (*handler_func_t) (xmms_xform_t *xform, gchar *header);
 
+static void header_handler_status (xmms_xform_t *xform, gchar *header);
 static void header_handler_contentlength (xmms_xform_t *xform, gchar *header);
+static void header_handler_contentrange (xmms_xform_t *xform, gchar *header);
+static void header_handler_acceptranges (xmms_xform_t *xform, gchar *header);
 static void header_handler_icy_metaint (xmms_xform_t *xform, gchar *header);
 static void header_handler_icy_name (xmms_xform_t *xform, gchar *header);
 static void header_handler_icy_genre (xmms_xform_t *xform, gchar *header);
@@ -69,7 +96,10 @@ typedef struct {
 } handler_t;
 
 handler_t handlers[] = {
+	{ "http/", header_handler_status },
 	{ "content-length", header_handler_contentlength },
+	{ "content-range", header_handler_contentrange },
+	{ "accept-ranges", header_handler_acceptranges },
 	{ "icy-metaint", header_handler_icy_metaint },
 	{ "icy-name", header_handler_icy_name },
 	{ "icy-genre", header_handler_icy_genre },
@@ -84,9 +114,11 @@ handler_t handlers[] = {
 static gboolean xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin);
 static gboolean xmms_curl_init (xmms_xform_t *xform);
 static void xmms_curl_destroy (xmms_xform_t *xform);
-static gint fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error);
+static gint fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, gboolean block, xmms_error_t *error);
+static void buffer_consume (xmms_curl_data_t *data, guint len);
+static gboolean xmms_curl_restart (xmms_xform_t *xform, xmms_curl_data_t *data, gint64 offset, xmms_error_t *error);
 static gint xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len, xmms_error_t *error);
-/* static gint64 xmms_curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error); */
+static gint64 xmms_curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *error);
 static size_t xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream);
 static size_t xmms_curl_callback_header (void *ptr, size_t size, size_t nmemb, void *stream);
 
@@ -110,9 +142,7 @@ xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	methods.init = xmms_curl_init;
 	methods.destroy = xmms_curl_destroy;
 	methods.read = xmms_curl_read;
-	/*
 	methods.seek = xmms_curl_seek;
-	*/
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
@@ -131,6 +161,8 @@ xmms_curl_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	/* TODO is this timeout of 10 seconds really appropriate? */
 	xmms_xform_plugin_config_property_register (xform_plugin, "readtimeout",
 	                                            "10", NULL, NULL);
+	xmms_xform_plugin_config_property_register (xform_plugin, "readahead",
+	                                            "131072", NULL, NULL);
 	xmms_xform_plugin_config_property_register (xform_plugin, "useproxy",
 	                                            "0", NULL, NULL);
 	xmms_xform_plugin_config_property_register (xform_plugin, "proxyaddress",
@@ -169,7 +201,7 @@ xmms_curl_init (xmms_xform_t *xform)
 	xmms_curl_data_t *data;
 	xmms_config_property_t *val;
 	xmms_error_t error;
-	gint metaint, verbose, connecttimeout, readtimeout, useproxy, authproxy;
+	gint metaint, verbose, connecttimeout, readtimeout, readahead, useproxy, authproxy;
 	const gchar *proxyaddress, *proxyuser, *proxypass;
 	gchar proxyuserpass[90];
 	const gchar *url;
@@ -188,6 +220,9 @@ xmms_curl_init (xmms_xform_t *xform)
 	val = xmms_xform_config_lookup (xform, "readtimeout");
 	readtimeout = xmms_config_property_get_int (val);
 
+	val = xmms_xform_config_lookup (xform, "readahead");
+	readahead = xmms_config_property_get_int (val);
+
 	val = xmms_xform_config_lookup (xform, "shoutcastinfo");
 	metaint = xmms_config_property_get_int (val);
 
@@ -212,9 +247,16 @@ xmms_curl_init (xmms_xform_t *xform)
 	g_snprintf (proxyuserpass, sizeof (proxyuserpass), "%s:%s", proxyuser,
 	            proxypass);
 
-	data->buffer = g_malloc (CURL_MAX_WRITE_SIZE);
+	/* there must always be room for one more write once the buffer
+	 * is drained below the read-ahead limit */
+	data->readahead = MAX (readahead, 0);
+	data->buffersize = data->readahead + CURL_MAX_WRITE_SIZE;
+	data->buffer = g_malloc (data->buffersize);
 	data->url = g_strdup (url);
 
+	data->length = -1;
+	data->accept_ranges = TRUE;
+
 	/* check for broken version of curl here */
 	version = curl_version_info (CURLVERSION_NOW);
 	XMMS_DBG ("Using version %s of libcurl", version->version);
@@ -289,7 +331,7 @@ xmms_curl_init (xmms_xform_t *xform)
 	xmms_xform_private_data_set (xform, data);
 
 	/* perform initial fill to see if it contains shoutcast metadata or not */
-	if (fill_buffer (xform, data, &error) <= 0) {
+	if (fill_buffer (xform, data, TRUE, &error) <= 0) {
 		/* something went wrong */
 		xmms_xform_private_data_set (xform, NULL);
 		xmms_curl_free_data (data);
@@ -314,8 +356,14 @@ xmms_curl_init (xmms_xform_t *xform)
 	return TRUE;
 }
 
+/*
+ * Let curl move data into the buffer. If block is TRUE this waits
+ * until there is something in the buffer, otherwise it just picks
+ * up whatever has already arrived.
+ */
 static gint
-fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error)
+fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, gboolean block,
+             xmms_error_t *error)
 {
 	gint handles;
 
@@ -324,7 +372,7 @@ fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error)
 	g_return_val_if_fail (error, -1);
 
 	while (TRUE) {
-		if (data->curl_code == CURLM_OK) {
+		if (block && data->curl_code == CURLM_OK) {
 			fd_set fdread, fdwrite, fdexcp;
 			struct timeval timeout;
 			gint ret, maxfd;
@@ -378,21 +426,97 @@ fill_buffer (xmms_xform_t *xform, xmms_curl_data_t *data, xmms_error_t *error)
 					xmms_log_error ("Curl fill_buffer returned error: (%d) %s",
 					                curlmsg->data.result,
 					                curl_easy_strerror (curlmsg->data.result));
+					data->result = curlmsg->data.result;
 				} else {
 					XMMS_DBG ("Curl fill_buffer returned unknown message (%d)", curlmsg->msg);
 				}
 			} while (messages > 0);
 
 			data->done = TRUE;
+
+			/* a failed transfer, such as a refused range, is not the
+			 * end of the stream */
+			if (data->result != CURLE_OK) {
+				xmms_error_set (error, XMMS_ERROR_GENERIC,
+				                curl_easy_strerror (data->result));
+				return -1;
+			}
+
 			return 0;
 		}
 
-		if (data->bufferlen > 0) {
+		if (data->bufferlen > 0 || !block) {
 			return 1;
 		}
 	}
 }
 
+/*
+ * Drop len bytes from the front of the buffer, and let curl continue
+ * if it was waiting for room.
+ */
+static void
+buffer_consume (xmms_curl_data_t *data, guint len)
+{
+	data->bufferpos = (data->bufferpos + len) % data->buffersize;
+	data->bufferlen -= len;
+	data->offset += len;
+
+	if (data->paused &&
+	    data->buffersize - data->bufferlen >= CURL_MAX_WRITE_SIZE) {
+		data->paused = FALSE;
+		/* may call xmms_curl_callback_write right away */
+		curl_easy_pause (data->curl_easy, CURLPAUSE_CONT);
+	}
+}
+
+/*
+ * Throw away the current transfer and request the resource again,
+ * starting at offset. The connection is reused if the previous
+ * transfer has completed.
+ */
+static gboolean
+xmms_curl_restart (xmms_xform_t *xform, xmms_curl_data_t *data,
+                   gint64 offset, xmms_error_t *error)
+{
+	gchar range[32];
+
+	if (data->paused) {
+		data->paused = FALSE;
+		curl_easy_pause (data->curl_easy, CURLPAUSE_CONT);
+	}
+
+	curl_multi_remove_handle (data->curl_multi, data->curl_easy);
+
+	data->bufferpos = 0;
+	data->bufferlen = 0;
+	data->offset = offset;
+	data->range_start = offset;
+	data->discard = 0;
+	data->http_status = 0;
+	data->result = CURLE_OK;
+
+	/* nothing left to fetch */
+	if (data->length >= 0 && offset >= data->length) {
+		data->done = TRUE;
+		return TRUE;
+	}
+
+	data->done = FALSE;
+
+	if (offset > 0) {
+		g_snprintf (range, sizeof (range), "%" G_GINT64_FORMAT "-", offset);
+		curl_easy_setopt (data->curl_easy, CURLOPT_RANGE, range);
+	} else {
+		curl_easy_setopt (data->curl_easy, CURLOPT_RANGE, NULL);
+	}
+
+	data->curl_code = CURLM_CALL_MULTI_PERFORM;
+	curl_multi_add_handle (data->curl_multi, data->curl_easy);
+
+	return fill_buffer (xform, data, TRUE, error) >= 0;
+}
+
 static gint
 xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len,
                 xmms_error_t *error)
@@ -407,31 +531,109 @@ xmms_curl_read (xmms_xform_t *xform, void *buffer, gint len,
 	data = xmms_xform_private_data_get (xform);
 	g_return_val_if_fail (data, -1);
 
-	if (data->done)
-		return 0;
-
 	while (TRUE) {
 
 		/* if we have data available, just pick it up (even if there's
 		   less bytes available than was requested) */
 		if (data->bufferlen) {
+			guint head;
+
 			len = MIN (len, data->bufferlen);
-			memcpy (buffer, data->buffer, len);
-			data->bufferlen -= len;
-			if (data->bufferlen) {
-				memmove (data->buffer, data->buffer + len, data->bufferlen);
+			head = MIN (len, data->buffersize - data->bufferpos);
+
+			memcpy (buffer, data->buffer + data->bufferpos, head);
+			memcpy ((gchar *) buffer + head, data->buffer, len - head);
+			buffer_consume (data, len);
+
+			/* read ahead whatever has arrived in the meantime */
+			if (!data->done && !data->paused &&
+			    data->bufferlen < data->readahead) {
+				xmms_error_t err;
+
+				xmms_error_reset (&err);
+				fill_buffer (xform, data, FALSE, &err);
 			}
+
 			return len;
 		}
 
-		ret = fill_buffer (xform, data, error);
+		if (data->done) {
+			if (data->result != CURLE_OK) {
+				xmms_error_set (error, XMMS_ERROR_GENERIC,
+				                curl_easy_strerror (data->result));
+				return -1;
+			}
+			return 0;
+		}
+
+		ret = fill_buffer (xform, data, TRUE, error);
 
-		if (ret == 0 || ret == -1) {
+		if (ret == -1) {
 			return ret;
 		}
 	}
 }
 
+static gint64
+xmms_curl_seek (xmms_xform_t *xform, gint64 offset,
+                xmms_xform_seek_mode_t whence, xmms_error_t *error)
+{
+	xmms_curl_data_t *data;
+	gint64 target;
+
+	g_return_val_if_fail (xform, -1);
+	g_return_val_if_fail (error, -1);
+
+	data = xmms_xform_private_data_get (xform);
+	g_return_val_if_fail (data, -1);
+
+	switch (whence) {
+		case XMMS_XFORM_SEEK_SET:
+			target = offset;
+			break;
+		case XMMS_XFORM_SEEK_CUR:
+			target = data->offset + offset;
+			break;
+		case XMMS_XFORM_SEEK_END:
+			if (data->length < 0) {
+				xmms_error_set (error, XMMS_ERROR_INVAL,
+				                "Couldn't seek, unknown stream length");
+				return -1;
+			}
+			target = data->length + offset;
+			break;
+		default:
+			xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
+			return -1;
+	}
+
+	if (target < 0 || (data->length >= 0 && target > data->length)) {
+		xmms_error_set (error, XMMS_ERROR_INVAL, "Seek out of range");
+		return -1;
+	}
+
+	/* short seeks forward are served from the buffer */
+	if (target >= data->offset && target - data->offset <= data->bufferlen) {
+		buffer_consume (data, target - data->offset);
+		return target;
+	}
+
+	if (data->meta_offset > 0 || !data->accept_ranges) {
+		xmms_error_set (error, XMMS_ERROR_INVAL,
+		                "Couldn't seek, stream is not seekable");
+		return -1;
+	}
+
+	XMMS_DBG ("Requesting %s from offset %" G_GINT64_FORMAT,
+	          data->url, target);
+
+	if (!xmms_curl_restart (xform, data, target, error)) {
+		return -1;
+	}
+
+	return target;
+}
+
 static void
 xmms_curl_destroy (xmms_xform_t *xform)
 {
@@ -454,7 +656,7 @@ xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream)
 {
 	xmms_curl_data_t *data;
 	xmms_xform_t *xform = (xmms_xform_t *) stream;
-	gint len;
+	guint len, skip, head, tail;
 
 	g_return_val_if_fail (xform, 0);
 
@@ -462,11 +664,22 @@ xmms_curl_callback_write (void *ptr, size_t size, size_t nmemb, void *stream)
 	g_return_val_if_fail (data, 0);
 
 	len = size * nmemb;
+	skip = MIN (data->discard, len);
+
+	/* curl hands us the same data again once we unpause */
+	if (data->buffersize - data->bufferlen < len - skip) {
+		data->paused = TRUE;
+		return CURL_WRITEFUNC_PAUSE;
+	}
+
+	data->discard -= skip;
 
-	g_return_val_if_fail ((data->bufferlen + len) <= CURL_MAX_WRITE_SIZE, 0);
+	tail = (data->bufferpos + data->bufferlen) % data->buffersize;
+	head = MIN (len - skip, data->buffersize - tail);
 
-	memcpy (data->buffer + data->bufferlen, ptr, len);
-	data->bufferlen = data->bufferlen + len;
+	memcpy (data->buffer + tail, (gchar *) ptr + skip, head);
+	memcpy (data->buffer, (gchar *) ptr + skip + head, len - skip - head);
+	data->bufferlen += len - skip;
 
 	return len;
 }
@@ -529,19 +742,80 @@ header_handler_find (gchar *header)
 	return NULL;
 }
 
+static void
+header_handler_status (xmms_xform_t *xform,
+                       gchar *header)
+{
+	xmms_curl_data_t *data;
+	gchar *code;
+
+	data = xmms_xform_private_data_get (xform);
+
+	code = strchr (header, ' ');
+	if (!code) {
+		return;
+	}
+
+	data->http_status = strtoul (code, NULL, 10);
+
+	/* the server ignored the range and sends everything */
+	if (data->http_status == 200 && data->range_start > 0) {
+		XMMS_DBG ("Range not supported, skipping %" G_GINT64_FORMAT " bytes",
+		          data->range_start);
+		data->discard = data->range_start;
+	}
+}
+
 static void
 header_handler_contentlength (xmms_xform_t *xform,
                               gchar *header)
 {
+	xmms_curl_data_t *data;
 	int length;
 	const gchar *metakey;
 
+	data = xmms_xform_private_data_get (xform);
+
+	/* this is the length of the range, see content-range */
+	if (data->http_status == 206) {
+		return;
+	}
+
+	data->length = g_ascii_strtoll (header, NULL, 10);
+
 	length = strtoul (header, NULL, 10);
 
 	metakey = XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE,
 	xmms_xform_metadata_set_int (xform, metakey, length);
 }
 
+static void
+header_handler_contentrange (xmms_xform_t *xform,
+                             gchar *header)
+{
+	xmms_curl_data_t *data;
+	gchar *total;
+
+	data = xmms_xform_private_data_get (xform);
+
+	/* bytes <first>-<last>/<total> */
+	total = strchr (header, '/');
+	if (total && total[1] != '*') {
+		data->length = g_ascii_strtoll (total + 1, NULL, 10);
+	}
+}
+
+static void
+header_handler_acceptranges (xmms_xform_t *xform,
+                             gchar *header)
+{
+	xmms_curl_data_t *data;
+
+	data = xmms_xform_private_data_get (xform);
+
+	data->accept_ranges = g_ascii_strcasecmp (header, "none") != 0;
+}
+
 static void
 header_handler_icy_metaint (xmms_xform_t *xform,
                             gchar *header)
@@ -586,11 +860,3 @@ xmms_curl_free_data (xmms_curl_data_t *data)
 	g_free (data);
 }
 
-/*
-static gint64
-xmms_curl_seek (xmms_xform_t *xform, gint64 offset,
-                xmms_xform_seek_mode_t whence, xmms_error_t *error) {
-	xmms_error_set (error, XMMS_ERROR_INVAL, "Couldn't seek");
-	return -1;
-}
-*/
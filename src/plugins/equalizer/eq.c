@@ -45,8 +45,24 @@ typedef struct xmms_equalizer_priv_St {
 	xmms_config_property_t *gain[EQ_MAX_BANDS];
 	xmms_config_property_t *legacy[EQ_BANDS_LEGACY];
 	gboolean enabled;
+
+	/* the filters of this instance, guarded against the config
+	 * callbacks by lock */
+	GMutex lock;
+	eq_state_t *eq;
+	eq_format_t format;
+	gint srate;
 } xmms_equalizer_data_t;
 
+static void xmms_eq_gains_load (xmms_equalizer_data_t *priv);
+static void xmms_eq_filters_configure (xmms_equalizer_data_t *priv);
+
+static const xmms_sample_format_t formats[] = {
+	XMMS_SAMPLE_FORMAT_FLOAT,
+	XMMS_SAMPLE_FORMAT_S32,
+	XMMS_SAMPLE_FORMAT_S16
+};
+
 XMMS_XFORM_PLUGIN_DEFINE ("equalizer",
                           "Equalizer effect",
                           XMMS_VERSION,
@@ -89,41 +105,15 @@ xmms_eq_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 		                                            NULL, NULL);
 	}
 
-	xmms_xform_plugin_indata_add (xform_plugin,
-	                              XMMS_STREAM_TYPE_MIMETYPE,
-	                              "audio/pcm",
-	                              XMMS_STREAM_TYPE_FMT_FORMAT,
-	                              XMMS_SAMPLE_FORMAT_S16,
-	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE,
-	                              48000,
-	                              XMMS_STREAM_TYPE_END);
-
-	xmms_xform_plugin_indata_add (xform_plugin,
-	                              XMMS_STREAM_TYPE_MIMETYPE,
-	                              "audio/pcm",
-	                              XMMS_STREAM_TYPE_FMT_FORMAT,
-	                              XMMS_SAMPLE_FORMAT_S16,
-	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE,
-	                              44100,
-	                              XMMS_STREAM_TYPE_END);
-
-	xmms_xform_plugin_indata_add (xform_plugin,
-	                              XMMS_STREAM_TYPE_MIMETYPE,
-	                              "audio/pcm",
-	                              XMMS_STREAM_TYPE_FMT_FORMAT,
-	                              XMMS_SAMPLE_FORMAT_S16,
-	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE,
-	                              22050,
-	                              XMMS_STREAM_TYPE_END);
-
-	xmms_xform_plugin_indata_add (xform_plugin,
-	                              XMMS_STREAM_TYPE_MIMETYPE,
-	                              "audio/pcm",
-	                              XMMS_STREAM_TYPE_FMT_FORMAT,
-	                              XMMS_SAMPLE_FORMAT_S16,
-	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE,
-	                              11025,
-	                              XMMS_STREAM_TYPE_END);
+	/* the coefficients are computed for whatever rate comes in */
+	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+		xmms_xform_plugin_indata_add (xform_plugin,
+		                              XMMS_STREAM_TYPE_MIMETYPE,
+		                              "audio/pcm",
+		                              XMMS_STREAM_TYPE_FMT_FORMAT,
+		                              formats[i],
+		                              XMMS_STREAM_TYPE_END);
+	}
 
 	return TRUE;
 }
@@ -133,14 +123,35 @@ xmms_eq_init (xmms_xform_t *xform)
 {
 	xmms_equalizer_data_t *priv;
 	xmms_config_property_t *config;
-	gint i, j, srate;
-	gfloat gain;
+	gint i, channels;
 
 	g_return_val_if_fail (xform, FALSE);
 
 	priv = g_new0 (xmms_equalizer_data_t, 1);
 	g_return_val_if_fail (priv, FALSE);
 
+	channels = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	priv->srate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+
+	switch (xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT)) {
+		case XMMS_SAMPLE_FORMAT_S16:
+			priv->format = EQ_FORMAT_S16;
+			break;
+		case XMMS_SAMPLE_FORMAT_S32:
+			priv->format = EQ_FORMAT_S32;
+			break;
+		default:
+			priv->format = EQ_FORMAT_FLOAT;
+			break;
+	}
+
+	priv->eq = iir_new (channels);
+	if (!priv->eq) {
+		g_free (priv);
+		return FALSE;
+	}
+
+	g_mutex_init (&priv->lock);
 	xmms_xform_private_data_set (xform, priv);
 
 	config = xmms_xform_config_lookup (xform, "enabled");
@@ -166,11 +177,7 @@ xmms_eq_init (xmms_xform_t *xform)
 	config = xmms_xform_config_lookup (xform, "preamp");
 	g_return_val_if_fail (config, FALSE);
 	xmms_config_property_callback_set (config, xmms_eq_gain_changed, priv);
-	gain = xmms_config_property_get_float (config);
-
-	for (i=0; i<EQ_CHANNELS; i++) {
-		set_preamp (i, xmms_eq_gain_scale (gain, TRUE));
-	}
+	set_preamp (priv->eq, xmms_eq_gain_scale (xmms_config_property_get_float (config), TRUE));
 
 	for (i=0; i<EQ_BANDS_LEGACY; i++) {
 		gchar buf[16];
@@ -181,13 +188,6 @@ xmms_eq_init (xmms_xform_t *xform)
 
 		priv->legacy[i] = config;
 		xmms_config_property_callback_set (config, xmms_eq_gain_changed, priv);
-
-		gain = xmms_config_property_get_float (config);
-		if (priv->use_legacy) {
-			for (j = 0; j < EQ_CHANNELS; j++) {
-				set_gain (i, j, xmms_eq_gain_scale (gain, FALSE));
-			}
-		}
 	}
 
 	for (i=0; i<EQ_MAX_BANDS; i++) {
@@ -199,22 +199,9 @@ xmms_eq_init (xmms_xform_t *xform)
 
 		priv->gain[i] = config;
 		xmms_config_property_callback_set (config, xmms_eq_gain_changed, priv);
-
-		gain = xmms_config_property_get_float (config);
-		if (!priv->use_legacy) {
-			for (j = 0; j < EQ_CHANNELS; j++) {
-				set_gain (i, j, xmms_eq_gain_scale (gain, FALSE));
-			}
-		}
 	}
 
-	init_iir ();
-	srate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
-	if (priv->use_legacy) {
-		config_iir (srate, EQ_BANDS_LEGACY, 1);
-	} else {
-		config_iir (srate, priv->bands, 0);
-	}
+	xmms_eq_filters_configure (priv);
 
 	xmms_xform_outdata_type_copy (xform);
 
@@ -227,7 +214,7 @@ static void
 xmms_eq_destroy (xmms_xform_t *xform)
 {
 	xmms_config_property_t *config;
-	gpointer priv;
+	xmms_equalizer_data_t *priv;
 	gchar buf[16];
 	gint i;
 
@@ -262,6 +249,8 @@ xmms_eq_destroy (xmms_xform_t *xform)
 		xmms_config_property_callback_remove (config, xmms_eq_gain_changed, priv);
 	}
 
+	iir_free (priv->eq);
+	g_mutex_clear (&priv->lock);
 	g_free (priv);
 }
 
@@ -270,7 +259,7 @@ xmms_eq_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
               xmms_error_t *error)
 {
 	xmms_equalizer_data_t *priv;
-	gint read, chan;
+	gint read;
 
 	g_return_val_if_fail (xform, -1);
 
@@ -278,9 +267,10 @@ xmms_eq_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
 	g_return_val_if_fail (priv, -1);
 
 	read = xmms_xform_read (xform, buf, len, error);
-	chan = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
 	if (read > 0 && priv->enabled) {
-		iir (buf, read, chan, priv->extra_filtering);
+		g_mutex_lock (&priv->lock);
+		iir (priv->eq, buf, read, priv->format, priv->extra_filtering);
+		g_mutex_unlock (&priv->lock);
 	}
 
 	return read;
@@ -289,7 +279,20 @@ xmms_eq_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
 static gint64
 xmms_eq_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *err)
 {
-	return xmms_xform_seek (xform, offset, whence, err);
+	xmms_equalizer_data_t *priv;
+	gint64 ret;
+
+	priv = xmms_xform_private_data_get (xform);
+
+	ret = xmms_xform_seek (xform, offset, whence, err);
+	if (ret >= 0) {
+		/* don't ring out the old position into the new one */
+		g_mutex_lock (&priv->lock);
+		clean_history (priv->eq);
+		g_mutex_unlock (&priv->lock);
+	}
+
+	return ret;
 }
 
 static void
@@ -299,7 +302,6 @@ xmms_eq_gain_changed (xmms_object_t *object, xmmsv_t *_data,
 	xmms_config_property_t *val;
 	xmms_equalizer_data_t *priv;
 	const gchar *name;
-	gint i;
 	gfloat gain;
 
 	g_return_if_fail (object);
@@ -329,11 +331,10 @@ xmms_eq_gain_changed (xmms_object_t *object, xmmsv_t *_data,
 	 */
 	name = strrchr (name, '.') + 1;
 
+	g_mutex_lock (&priv->lock);
 	if (!strcmp (name, "preamp")) {
 		/* scale the -20.0 - 20.0 value to correct one */
-		for (i=0; i<EQ_CHANNELS; i++) {
-			set_preamp (i, xmms_eq_gain_scale (gain, TRUE));
-		}
+		set_preamp (priv->eq, xmms_eq_gain_scale (gain, TRUE));
 	} else {
 		gint band = -1;
 
@@ -343,13 +344,12 @@ xmms_eq_gain_changed (xmms_object_t *object, xmmsv_t *_data,
 			band = atoi (name + 6);
 		}
 
-		if (band >= 0) {
+		if (band >= 0 && band < EQ_MAX_BANDS) {
 			/* scale the -20.0 - 20.0 value to correct one */
-			for (i=0; i<EQ_CHANNELS; i++) {
-				set_gain (band, i, xmms_eq_gain_scale (gain, FALSE));
-			}
+			set_gain (priv->eq, band, xmms_eq_gain_scale (gain, FALSE));
 		}
 	}
+	g_mutex_unlock (&priv->lock);
 }
 
 static void
@@ -358,7 +358,7 @@ xmms_eq_config_changed (xmms_object_t * object, xmmsv_t *_data, gpointer userdat
 	xmms_config_property_t *val;
 	xmms_equalizer_data_t *priv;
 	const gchar *name;
-	gint value, i, j;
+	gint value, i;
 
 	g_return_if_fail (object);
 	g_return_if_fail (userdata);
@@ -382,24 +382,8 @@ xmms_eq_config_changed (xmms_object_t * object, xmmsv_t *_data, gpointer userdat
 	} else if (!strcmp (name, "extra_filtering")) {
 		priv->extra_filtering = value;
 	} else if (!strcmp (name, "use_legacy")) {
-		gfloat gain;
-
 		priv->use_legacy = value;
-		if (priv->use_legacy) {
-			for (i=0; i<EQ_BANDS_LEGACY; i++) {
-				gain = xmms_config_property_get_float (priv->legacy[i]);
-				for (j=0; j<EQ_CHANNELS; j++) {
-					set_gain (j, i, xmms_eq_gain_scale (gain, FALSE));
-				}
-			}
-		} else {
-			for (i=0; i<priv->bands; i++) {
-				gain = xmms_config_property_get_float (priv->gain[i]);
-				for (j=0; j<EQ_CHANNELS; j++) {
-					set_gain (j, i, xmms_eq_gain_scale (gain, FALSE));
-				}
-			}
-		}
+		xmms_eq_filters_configure (priv);
 	} else if (!strcmp (name, "bands")) {
 		if (value != 10 && value != 15 && value != 25 && value != 31) {
 			gchar buf[20];
@@ -411,14 +395,41 @@ xmms_eq_config_changed (xmms_object_t * object, xmmsv_t *_data, gpointer userdat
 			priv->bands = value;
 			for (i=0; i<EQ_MAX_BANDS; i++) {
 				xmms_config_property_set_data (priv->gain[i], "0.0");
-				if (!priv->use_legacy) {
-					for (j=0; j<EQ_CHANNELS; j++) {
-						set_gain (j, i, xmms_eq_gain_scale (0.0, FALSE));
-					}
-				}
 			}
+			xmms_eq_filters_configure (priv);
+		}
+	}
+}
+
+/* Load the gains of the band set in use */
+static void
+xmms_eq_gains_load (xmms_equalizer_data_t *priv)
+{
+	gfloat gain;
+	gint i;
+
+	for (i=0; i<EQ_MAX_BANDS; i++) {
+		if (priv->use_legacy) {
+			gain = i < EQ_BANDS_LEGACY ? xmms_config_property_get_float (priv->legacy[i]) : 0.0;
+		} else {
+			gain = xmms_config_property_get_float (priv->gain[i]);
 		}
+		set_gain (priv->eq, i, xmms_eq_gain_scale (gain, FALSE));
+	}
+}
+
+/* Compute the filters for the current band set and the stream's rate */
+static void
+xmms_eq_filters_configure (xmms_equalizer_data_t *priv)
+{
+	g_mutex_lock (&priv->lock);
+	if (priv->use_legacy) {
+		config_iir (priv->eq, priv->srate, EQ_BANDS_LEGACY, 1);
+	} else {
+		config_iir (priv->eq, priv->srate, priv->bands, 0);
 	}
+	xmms_eq_gains_load (priv);
+	g_mutex_unlock (&priv->lock);
 }
 
 static gfloat
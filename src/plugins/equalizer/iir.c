@@ -20,61 +20,226 @@
  *   $Id: iir.c,v 1.16 2006/01/15 00:26:32 liebremx Exp $
  */
 
+#include <stdlib.h>
+#include <math.h>
 #include "iir.h"
 
-/* Coefficients */
-sIIRCoefficients *iir_cf;
+/*
+ * Flush-to-zero and denormals-are-zero, to avoid flooding the CPU with
+ * underflow exceptions while the filters decay in silence. The old
+ * mode is restored afterwards as the thread is shared with other
+ * plugins.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__SSE__))
+#define FTZ_DAZ 0x8040
+#define FTZ_ON(saved) { \
+  unsigned int ftz; \
+  __asm__ __volatile__ ("stmxcsr %0" : "=m" (*&saved)); \
+  ftz = saved | FTZ_DAZ; \
+  __asm__ __volatile__ ("ldmxcsr %0" : : "m" (*&ftz)); \
+}
+#define FTZ_OFF(saved) { \
+  __asm__ __volatile__ ("ldmxcsr %0" : : "m" (*&saved)); \
+}
+#else
+#define FTZ_ON(saved) (void) saved
+#define FTZ_OFF(saved)
+#endif
 
-/* Volume gain
- * values should be between 0.0 and 1.0
- * Use the preamp from XMMS for now
- * */
-float preamp[EQ_CHANNELS];
+#define S16_SCALE 32768.0
+#define S32_SCALE 2147483648.0
 
-#ifdef BENCHMARK
-#include "benchmark.h"
-double timex = 0.0;
-int count = 0;
-unsigned int blength = 0;
-#endif
+eq_state_t *iir_new(int channels)
+{
+  eq_state_t *eq;
 
-/*
- * Global vars
- */
-int band_count;
+  eq = calloc(1, sizeof(eq_state_t));
+  if (!eq)
+    return NULL;
+
+  eq->history = calloc(channels, sizeof(eq_history_t));
+  eq->extra_history = calloc(channels, sizeof(eq_extra_history_t));
+  if (!eq->history || !eq->extra_history) {
+    iir_free(eq);
+    return NULL;
+  }
+
+  eq->channels = channels;
+  eq->preamp = 1.0;
+  eq->cascade = iir_cascade_simd_get();
+  if (!eq->cascade)
+    eq->cascade = iir_cascade_fpu;
 
-void set_preamp(int chn, float val)
+  return eq;
+}
+
+void iir_free(eq_state_t *eq)
+{
+  free(eq->history);
+  free(eq->extra_history);
+  free(eq);
+}
+
+void set_preamp(eq_state_t *eq, float val)
 {
-  preamp[chn] = val;
+  eq->preamp = val;
 }
 
-/* Init the filters */
-void init_iir(void)
+void set_gain(eq_state_t *eq, int index, float val)
 {
-  calc_coeffs();
+  eq->gain[index] = val;
+}
+
+void config_iir(eq_state_t *eq, int srate, int bands, int original)
+{
+  sIIRCoefficients cf[EQ_MAX_BANDS];
+  int i;
+
+  eq->rate = srate;
+  eq->band_count = calc_coeffs(cf, bands, srate, original);
+
+  memset(eq->alpha, 0, sizeof(eq->alpha));
+  memset(eq->beta, 0, sizeof(eq->beta));
+  memset(eq->gamma, 0, sizeof(eq->gamma));
+  for (i = 0; i < eq->band_count; i++)
+  {
+    eq->alpha[i] = cf[i].alpha;
+    eq->beta[i] = cf[i].beta;
+    eq->gamma[i] = cf[i].gamma;
+  }
+
+  clean_history(eq);
 }
 
-void config_iir(int srate, int bands, int original)
+void clean_history(eq_state_t *eq)
 {
-  band_count = bands;
-  iir_cf = get_coeffs(&band_count, srate, original);
-  clean_history();
+  memset(eq->history, 0, eq->channels * sizeof(eq_history_t));
+  memset(eq->extra_history, 0, eq->channels * sizeof(eq_extra_history_t));
 }
 
-#ifdef ARCH_X86
-/* Round function provided by Frank Klemm which saves around 100K
- * CPU cycles in my PIII for each call to the IIR function with 4K samples
+static void load(double *x, const void *d, eq_format_t format,
+                 int offset, int stride, int frames, double preamp)
+{
+  int index;
+
+  switch (format)
+  {
+    case EQ_FORMAT_S16:
+      for (index = 0; index < frames; index++)
+        x[index] = ((const short *)d)[offset + index*stride] * (preamp / S16_SCALE);
+      break;
+    case EQ_FORMAT_S32:
+      for (index = 0; index < frames; index++)
+        x[index] = ((const int *)d)[offset + index*stride] * (preamp / S32_SCALE);
+      break;
+    case EQ_FORMAT_FLOAT:
+      for (index = 0; index < frames; index++)
+        x[index] = ((const float *)d)[offset + index*stride] * preamp;
+      break;
+  }
+}
+
+static void store(void *d, const double *y, eq_format_t format,
+                  int offset, int stride, int frames)
+{
+  int index;
+  double tempdouble;
+
+  switch (format)
+  {
+    case EQ_FORMAT_S16:
+      for (index = 0; index < frames; index++)
+      {
+        /* Round and limit the output */
+        tempdouble = rint(y[index] * S16_SCALE);
+        if (tempdouble < -S16_SCALE)
+          tempdouble = -S16_SCALE;
+        else if (tempdouble > S16_SCALE - 1)
+          tempdouble = S16_SCALE - 1;
+        ((short *)d)[offset + index*stride] = tempdouble;
+      }
+      break;
+    case EQ_FORMAT_S32:
+      for (index = 0; index < frames; index++)
+      {
+        tempdouble = rint(y[index] * S32_SCALE);
+        if (tempdouble < -S32_SCALE)
+          tempdouble = -S32_SCALE;
+        else if (tempdouble > S32_SCALE - 1)
+          tempdouble = S32_SCALE - 1;
+        ((int *)d)[offset + index*stride] = tempdouble;
+      }
+      break;
+    case EQ_FORMAT_FLOAT:
+      for (index = 0; index < frames; index++)
+        ((float *)d)[offset + index*stride] = y[index];
+      break;
+  }
+}
+
+/*
+ * Filter length bytes of interleaved samples in place.
+ *
+ * The samples are scaled to [-1.0, 1.0) first, so the same filters
+ * serve every format. The filters run in double precision, as the low
+ * bands sit so close to the unit circle that single precision history
+ * adds audible noise. Each channel is run through the band cascade one
+ * block at a time, the input has its last two samples in front so the
+ * filters can look back across blocks.
+ *
+ * With extra filtering, the summed output of the bands is filtered
+ * once more and added on top, which gives steeper bands at the cost
+ * of more than twice the CPU time.
  */
-int round_trick(float floatvalue_to_round)
+int iir(eq_state_t *eq, void *d, int length, eq_format_t format,
+        int extra_filtering)
 {
-  float   floattmp ;
-  int     rounded_value ;
+  double x[EQ_BLOCK + 2], out[EQ_BLOCK];
+  eq_history_t *h;
+  int nch = eq->channels;
+  int frames, done, block, channel, index;
+  unsigned int mxcsr;
 
-  floattmp      = (int) 0x00FD8000L + (floatvalue_to_round);
-  rounded_value = *(int*)(&floattmp) - (int)0x4B7D8000L;
+  if (format == EQ_FORMAT_S16)
+    frames = length / (nch * sizeof(short));
+  else if (format == EQ_FORMAT_S32)
+    frames = length / (nch * sizeof(int));
+  else
+    frames = length / (nch * sizeof(float));
 
-  if ( rounded_value != (short) rounded_value )
-    rounded_value = ( rounded_value >> 31 ) ^ 0x7FFF;
-  return rounded_value;
+  FTZ_ON(mxcsr);
+
+  for (done = 0; done < frames; done += block)
+  {
+    block = frames - done;
+    if (block > EQ_BLOCK)
+      block = EQ_BLOCK;
+
+    for (channel = 0; channel < nch; channel++)
+    {
+      h = &eq->history[channel];
+
+      x[0] = h->x2;
+      x[1] = h->x1;
+      load(x + 2, d, format, done*nch + channel, nch, block, eq->preamp);
+
+      eq->cascade(eq, h, x + 2, out, block);
+      h->x2 = x[block];
+      h->x1 = x[block + 1];
+
+      if (extra_filtering)
+        iir_cascade_extra(eq, &eq->extra_history[channel], out, block);
+
+      /* Scale down original PCM sample and add it to the filters
+       * output. This substitutes the multiplication by 0.25 */
+      for (index = 0; index < block; index++)
+        out[index] += x[index + 2] * 0.25;
+
+      store(d, out, format, done*nch + channel, nch, block);
+    }
+  }
+
+  FTZ_OFF(mxcsr);
+
+  return length;
 }
-#endif
@@ -25,60 +25,87 @@
 #include <string.h>
 #include "iir_cfs.h"
 
+#define EQ_MAX_BANDS 31
+/* bands are processed two or four at a time, unused ones have
+ * zero coefficients and gain */
+#define EQ_PADDED_BANDS 32
+/* frames filtered per pass, bounds the scratch buffers */
+#define EQ_BLOCK 256
+
+typedef enum {
+  EQ_FORMAT_S16,
+  EQ_FORMAT_S32,
+  EQ_FORMAT_FLOAT
+} eq_format_t;
+
+/* Filter history of one channel */
+typedef struct
+{
+  double y1[EQ_PADDED_BANDS]; /* y[n-1] */
+  double y2[EQ_PADDED_BANDS]; /* y[n-2] */
+  double x1, x2; /* x[n-1], x[n-2] */
+} eq_history_t;
+
+/* Filter history of one channel for the extra filtering pass, where
+ * every band has its own input */
+typedef struct
+{
+  double y1[EQ_PADDED_BANDS];
+  double y2[EQ_PADDED_BANDS];
+  double x1[EQ_PADDED_BANDS];
+  double x2[EQ_PADDED_BANDS];
+} eq_extra_history_t;
+
+typedef struct eq_state_St eq_state_t;
+
 /*
- * Flush-to-zero to avoid flooding the CPU with underflow exceptions 
+ * Runs the band filters over one channel. x has two samples of history
+ * in front, x[-2] and x[-1], and out receives the sum of the gained
+ * band outputs.
  */
-#ifdef SSE_MATH
-#define FTZ 0x8000
-#define FTZ_ON { \
-    unsigned int mxcsr; \
-  __asm__  __volatile__ ("stmxcsr %0" : "=m" (*&mxcsr)); \
-  mxcsr |= FTZ; \
-  __asm__  __volatile__ ("ldmxcsr %0" : : "m" (*&mxcsr)); \
-}
-#define FTZ_OFF { \
-    unsigned int mxcsr; \
-  __asm__  __volatile__ ("stmxcsr %0" : "=m" (*&mxcsr)); \
-  mxcsr &= ~FTZ; \
-  __asm__  __volatile__ ("ldmxcsr %0" : : "m" (*&mxcsr)); \
-}
-#else
-#define FTZ_ON
-#define FTZ_OFF
-#endif
+typedef void (*eq_cascade_func_t)(const eq_state_t *eq, eq_history_t *h,
+                                  const double *x, double *out, int frames);
 
 /*
- * Function prototypes
+ * One equalizer. Everything the filters need lives here, so any number
+ * of instances can run at the same time.
  */
-void init_iir(void);
-void config_iir(int srate, int bands, int original);
-void clean_history(void);
-void set_gain(int index, int chn, float val);
-void set_preamp(int chn, float val);
+struct eq_state_St
+{
+  double alpha[EQ_PADDED_BANDS];
+  double beta[EQ_PADDED_BANDS];
+  double gamma[EQ_PADDED_BANDS];
+  double gain[EQ_PADDED_BANDS];
+  double preamp;
+  int band_count;
+  int rate;
+  int channels;
+  /* one of each per channel */
+  eq_history_t *history;
+  eq_extra_history_t *extra_history;
+  eq_cascade_func_t cascade;
+};
 
+/*
+ * Function prototypes
+ */
+eq_state_t *iir_new(int channels);
+void iir_free(eq_state_t *eq);
+void config_iir(eq_state_t *eq, int srate, int bands, int original);
+void clean_history(eq_state_t *eq);
+void set_gain(eq_state_t *eq, int index, float val);
+void set_preamp(eq_state_t *eq, float val);
 
-int iir(void *d, int length, int nch, int extra_filtering);
-
-#ifdef ARCH_X86
-int round_trick(float floatvalue_to_round);
-#endif
-#ifdef ARCH_PPC
-int round_ppc(float x);
-#endif
-
-#define EQ_CHANNELS 2
-#define EQ_MAX_BANDS 31
+int iir(eq_state_t *eq, void *d, int length, eq_format_t format,
+        int extra_filtering);
 
-extern float preamp[EQ_CHANNELS];
-extern sIIRCoefficients *iir_cf;
-extern int rate;
-extern int band_count;
+/* provided by iir_fpu.c */
+void iir_cascade_fpu(const eq_state_t *eq, eq_history_t *h,
+                     const double *x, double *out, int frames);
+void iir_cascade_extra(const eq_state_t *eq, eq_extra_history_t *h,
+                       double *x, int frames);
 
-#ifdef BENCHMARK
-extern double timex;
-extern int count;
-extern unsigned int blength;
-#endif
+/* provided by iir_sse.c, NULL where the CPU can't run them */
+eq_cascade_func_t iir_cascade_simd_get(void);
 
 #endif /* #define IIR_H */
-
@@ -25,22 +25,6 @@
 #include <math.h>
 #include "iir_cfs.h"
 
-/***************************
- * IIR filter coefficients *
- ***************************/
-static sIIRCoefficients iir_cf10_11k_11025[10] __attribute__((aligned));
-static sIIRCoefficients iir_cf10_22k_22050[10] __attribute__((aligned));
-static sIIRCoefficients iir_cforiginal10_44100[10] __attribute__((aligned));
-static sIIRCoefficients iir_cforiginal10_48000[10] __attribute__((aligned));
-static sIIRCoefficients iir_cf10_44100[10] __attribute__((aligned));
-static sIIRCoefficients iir_cf10_48000[10] __attribute__((aligned));
-static sIIRCoefficients iir_cf15_44100[15] __attribute__((aligned));
-static sIIRCoefficients iir_cf15_48000[15] __attribute__((aligned));
-static sIIRCoefficients iir_cf25_44100[25] __attribute__((aligned));
-static sIIRCoefficients iir_cf25_48000[25] __attribute__((aligned));
-static sIIRCoefficients iir_cf31_44100[31] __attribute__((aligned));
-static sIIRCoefficients iir_cf31_48000[31] __attribute__((aligned));
-
 /******************************************************************
  * Definitions and data structures to calculate the coefficients
  ******************************************************************/
@@ -71,8 +55,7 @@ static const double band_f031[] =
 #define GAIN_F0 1.0
 #define GAIN_F1 GAIN_F0 / M_SQRT2
 
-#define SAMPLING_FREQ 44100.0
-#define TETA(f) (2*M_PI*(double)f/bands[n].sfreq)
+#define TETA(f) (2*M_PI*(double)f/sfreq)
 #define TWOPOWER(value) (value * value)
 
 #define BETA2(tf0, tf) \
@@ -94,25 +77,15 @@ static const double band_f031[] =
 #define GAMMA(beta, tf0) ((0.5 + beta) * cos(tf0))
 #define ALPHA(beta) ((0.5 - beta)/2.0)
 
-struct {
-    sIIRCoefficients *coeffs;
+static const struct {
     const double *cfs;
     double octave;
     int band_count;
-    double sfreq;
 } bands[] = {
-  { iir_cf10_11k_11025,     band_f011k,         1.0,     10, 11025.0 },
-  { iir_cf10_22k_22050,     band_f022k,         1.0,     10, 22050.0 },
-  { iir_cforiginal10_44100, band_original_f010, 1.0,     10, 44100.0 },
-  { iir_cforiginal10_48000, band_original_f010, 1.0,     10, 48000.0 },
-  { iir_cf10_44100,         band_f010,          1.0,     10, 44100.0 },
-  { iir_cf10_48000,         band_f010,          1.0,     10, 48000.0 },
-  { iir_cf15_44100,         band_f015,          2.0/3.0, 15, 44100.0 },
-  { iir_cf15_48000,         band_f015,          2.0/3.0, 15, 48000.0 },
-  { iir_cf25_44100,         band_f025,          1.0/3.0, 25, 44100.0 },
-  { iir_cf25_48000,         band_f025,          1.0/3.0, 25, 48000.0 },
-  { iir_cf31_44100,         band_f031,          1.0/3.0, 31, 44100.0 },
-  { iir_cf31_48000,         band_f031,          1.0/3.0, 31, 48000.0 },
+  { band_f010,          1.0,     10 },
+  { band_f015,          2.0/3.0, 15 },
+  { band_f025,          1.0/3.0, 25 },
+  { band_f031,          1.0/3.0, 31 },
   { 0 }
 };
 
@@ -120,48 +93,6 @@ struct {
  * Functions *
  *************/
 
-/* Get the coeffs for a given number of bands and sampling frequency */
-sIIRCoefficients* get_coeffs(int *bands, int sfreq, int use_xmms_original_freqs)
-{
-  sIIRCoefficients *iir_cf = 0;
-  switch(sfreq)
-  {
-    case 11025: iir_cf = iir_cf10_11k_11025;
-                *bands = 10;
-                break;
-    case 22050: iir_cf = iir_cf10_22k_22050;
-                *bands = 10;
-                break;
-    case 48000:
-                switch(*bands)
-                {
-                  case 31: iir_cf = iir_cf31_48000; break;
-                  case 25: iir_cf = iir_cf25_48000; break;
-                  case 15: iir_cf = iir_cf15_48000; break;
-                  default:
-                           iir_cf = use_xmms_original_freqs ?
-                             iir_cforiginal10_48000 :
-                             iir_cf10_48000;
-                           break;
-                }
-                break;
-    default:
-                switch(*bands)
-                {
-                  case 31: iir_cf = iir_cf31_44100; break;
-                  case 25: iir_cf = iir_cf25_44100; break;
-                  case 15: iir_cf = iir_cf15_44100; break;
-                  default:
-                           iir_cf = use_xmms_original_freqs ?
-                             iir_cforiginal10_44100 :
-                             iir_cf10_44100;
-                           break;
-                }
-                break;
-  }
-  return iir_cf;
-}
-
 /* Get the freqs at both sides of F0. These will be cut at -3dB */
 static void find_f1_and_f2(double f0, double octave_percent, double *f1, double *f2)
 {
@@ -185,51 +116,71 @@ static int find_root(double a, double b, double c, double *x0) {
   return 0;
 }
 
-/* Calculate all the coefficients as specified in the bands[] array */
-void calc_coeffs(void)
+/* Calculate the coefficients for the given number of bands at the
+ * given sampling frequency. Returns the number of bands actually used,
+ * which is 10 if the count isn't one of 10, 15, 25 or 31. Bands at or
+ * above the Nyquist frequency get zero coefficients and do nothing. */
+int calc_coeffs(sIIRCoefficients *coeffs, int band_count, double sfreq,
+                int use_xmms_original_freqs)
 {
+  const double *freqs;
+  double octave, f1, f2, x0;
   int i, n;
-  double f1, f2;
-  double x0;
 
-  n = 0;
-  for (; bands[n].cfs; n++) {
-    double *freqs = (double *)bands[n].cfs;
-    for (i=0; i<bands[n].band_count; i++)
-    {
+  for (n = 0; bands[n].cfs; n++) {
+    if (bands[n].band_count == band_count)
+      break;
+  }
+  if (!bands[n].cfs)
+    n = 0;
+
+  freqs = bands[n].cfs;
+  octave = bands[n].octave;
+  band_count = bands[n].band_count;
+
+  if (band_count == 10) {
+    /* the low rates had their own tables that stay below Nyquist */
+    if (sfreq <= 11025.0)
+      freqs = band_f011k;
+    else if (sfreq <= 22050.0)
+      freqs = band_f022k;
+    else if (use_xmms_original_freqs)
+      freqs = band_original_f010;
+  }
 
-      /* Find -3dB frequencies for the center freq */
-      find_f1_and_f2(freqs[i], bands[n].octave, &f1, &f2);
-      /* Find Beta */
-      if ( find_root(
-            BETA2(TETA(freqs[i]), TETA(f1)),
-            BETA1(TETA(freqs[i]), TETA(f1)),
-            BETA0(TETA(freqs[i]), TETA(f1)),
-            &x0) == 0)
-      {
-        /* Got a solution, now calculate the rest of the factors */
-        /* Take the smallest root always (find_root returns the smallest one)
-         *
-         * NOTE: The IIR equation is
-         *	y[n] = 2 * (alpha*(x[n]-x[n-2]) + gamma*y[n-1] - beta*y[n-2])
-         *  Now the 2 factor has been distributed in the coefficients
-         */
-        /* Now store the coefficients */
-        bands[n].coeffs[i].beta = 2.0 * x0;
-        bands[n].coeffs[i].alpha = 2.0 * ALPHA(x0);
-        bands[n].coeffs[i].gamma = 2.0 * GAMMA(x0, TETA(freqs[i]));
+  for (i = 0; i < band_count; i++)
+  {
+    /* Find -3dB frequencies for the center freq */
+    find_f1_and_f2(freqs[i], octave, &f1, &f2);
+    /* Find Beta */
+    if (freqs[i] < sfreq / 2.0 &&
+        find_root(
+          BETA2(TETA(freqs[i]), TETA(f1)),
+          BETA1(TETA(freqs[i]), TETA(f1)),
+          BETA0(TETA(freqs[i]), TETA(f1)),
+          &x0) == 0)
+    {
+      /* Got a solution, now calculate the rest of the factors */
+      /* Take the smallest root always (find_root returns the smallest one)
+       *
+       * NOTE: The IIR equation is
+       *	y[n] = 2 * (alpha*(x[n]-x[n-2]) + gamma*y[n-1] - beta*y[n-2])
+       *  Now the 2 factor has been distributed in the coefficients
+       */
+      /* Now store the coefficients */
+      coeffs[i].beta = 2.0 * x0;
+      coeffs[i].alpha = 2.0 * ALPHA(x0);
+      coeffs[i].gamma = 2.0 * GAMMA(x0, TETA(freqs[i]));
 #ifdef DEBUG
-        printf("Freq[%d]: %f. Beta: %.10e Alpha: %.10e Gamma %.10e\n",
-            i, freqs[i], bands[n].coeffs[i].beta,
-            bands[n].coeffs[i].alpha, bands[n].coeffs[i].gamma);
+      printf("Freq[%d]: %f. Beta: %.10e Alpha: %.10e Gamma %.10e\n",
+          i, freqs[i], coeffs[i].beta, coeffs[i].alpha, coeffs[i].gamma);
 #endif
-      } else {
-        /* Shouldn't happen */
-        bands[n].coeffs[i].beta = 0.;
-        bands[n].coeffs[i].alpha = 0.;
-        bands[n].coeffs[i].gamma = 0.;
-        printf("  **** Where are the roots?\n");
-      }
-    }/* for i */
-  }/* for n */
+    } else {
+      coeffs[i].beta = 0.;
+      coeffs[i].alpha = 0.;
+      coeffs[i].gamma = 0.;
+    }
+  }/* for i */
+
+  return band_count;
 }
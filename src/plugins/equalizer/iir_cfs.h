@@ -31,8 +31,7 @@ typedef struct
     float dummy; /* Word alignment */
 }sIIRCoefficients;
 
-sIIRCoefficients* get_coeffs(int *bands, int sfreq, 
-                             int use_xmms_original_freqs);
-void calc_coeffs(void);
+int calc_coeffs(sIIRCoefficients *coeffs, int bands, double sfreq,
+                int use_xmms_original_freqs);
 
 #endif
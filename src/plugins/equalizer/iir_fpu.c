@@ -20,183 +20,87 @@
  *   $Id: iir_fpu.c,v 1.4 2006/01/15 00:26:32 liebremx Exp $
  */
 
-#include <stdlib.h>
 #include "iir.h"
-#include "iir_fpu.h"
 
-#ifdef BENCHMARK
-#include <stdio.h>
-#include "benchmark.h"
-#endif /* BENCHMARK */
-
-static sXYData data_history[EQ_MAX_BANDS][EQ_CHANNELS] __attribute__((aligned));
-static sXYData data_history2[EQ_MAX_BANDS][EQ_CHANNELS] __attribute__((aligned));
-static float gain[EQ_MAX_BANDS][EQ_CHANNELS] __attribute__((aligned));
-/* random noise */
-static sample_t dither[256];
-static int di;
-
-void set_gain(int index, int chn, float val)
+/*
+ * Plain C version of the band cascade, used where no vector unit is
+ * available and as the reference for the vectorized one.
+ *
+ * IIR filter equation is
+ * y[n] = 2 * (alpha*(x[n]-x[n-2]) + gamma*y[n-1] - beta*y[n-2])
+ *
+ * NOTE: The 2 factor was introduced in the coefficients to save
+ * 			a multiplication
+ */
+void iir_cascade_fpu(const eq_state_t *eq, eq_history_t *h,
+                     const double *x, double *out, int frames)
 {
-  gain[index][chn] = val;
-}
+  int index, band;
+  double y;
 
-void clean_history(void)
-{
-  int n;
-  /* Zero the history arrays */
-  memset(data_history, 0, sizeof(sXYData) * EQ_MAX_BANDS * EQ_CHANNELS);
-  memset(data_history2, 0, sizeof(sXYData) * EQ_MAX_BANDS * EQ_CHANNELS);
-  /* this is only needed if we use fpu code and there's no other place for
-  the moment to init the dither array*/
-  for (n = 0; n < 256; n++) {
-      dither[n] = (rand() % 4) - 2;
+  for (index = 0; index < frames; index++)
+    out[index] = 0.;
+
+  /* Every band only depends on its own history, so run them one at
+   * a time over the whole block */
+  for (band = 0; band < eq->band_count; band++)
+  {
+    double alpha = eq->alpha[band];
+    double beta = eq->beta[band];
+    double gamma = eq->gamma[band];
+    double gain = eq->gain[band];
+    double y1 = h->y1[band];
+    double y2 = h->y2[band];
+
+    for (index = 0; index < frames; index++)
+    {
+      y = alpha * (x[index] - x[index-2]) + gamma * y1 - beta * y2;
+      out[index] += y * gain;
+      y2 = y1;
+      y1 = y;
+    }
+
+    h->y1[band] = y1;
+    h->y2[band] = y2;
   }
-  di = 0;
 }
 
-int iir(void *d, int length, int nch, int extra_filtering)
+/*
+ * The extra filtering pass. Here every band filters the output of the
+ * first pass plus what the bands before it added, so the bands have to
+ * run one after the other. x is filtered in place.
+ */
+void iir_cascade_extra(const eq_state_t *eq, eq_extra_history_t *h,
+                       double *x, int frames)
 {
-/*  FTZ_ON; */
-  short *data = d;
-  /* Indexes for the history arrays
-   * These have to be kept between calls to this function
-   * hence they are static */
-  static int i = 2, j = 1, k = 0;	
-
-  int index, band, channel;
-  int tempint, halflength;
-  sample_t out[EQ_CHANNELS], pcm[EQ_CHANNELS];
+  int index, band;
+  double y, xn;
 
-#ifdef BENCHMARK
-  start_counter();
-#endif /* BENCHMARK */
-
-  /**
-   * IIR filter equation is
-   * y[n] = 2 * (alpha*(x[n]-x[n-2]) + gamma*y[n-1] - beta*y[n-2])
-   *
-   * NOTE: The 2 factor was introduced in the coefficients to save
-   * 			a multiplication
-   *
-   * This algorithm cascades two filters to get nice filtering
-   * at the expense of extra CPU cycles
-   */
-  /* 16bit, 2 bytes per sample, so divide by two the length of
-   * the buffer (length is in bytes)
-   */
-  halflength = (length >> 1);
-  for (index = 0; index < halflength; index+=nch)
+  for (band = 0; band < eq->band_count; band++)
   {
-    /* For each channel */
-    for (channel = 0; channel < nch; channel++)
+    double alpha = eq->alpha[band];
+    double beta = eq->beta[band];
+    double gamma = eq->gamma[band];
+    double gain = eq->gain[band];
+    double x1 = h->x1[band];
+    double x2 = h->x2[band];
+    double y1 = h->y1[band];
+    double y2 = h->y2[band];
+
+    for (index = 0; index < frames; index++)
     {
-      pcm[channel] = data[index+channel];
-      /* Preamp gain */
-      pcm[channel] *= preamp[channel];
-
-      /* add random noise */
-      pcm[channel] += dither[di];
-
-      out[channel] = 0.;
-      /* For each band */
-      for (band = 0; band < band_count; band++)
-      {
-        /* Store Xi(n) */
-        data_history[band][channel].x[i] = pcm[channel];
-        /* Calculate and store Yi(n) */
-        data_history[band][channel].y[i] =
-          (
-           /* 		= alpha * [x(n)-x(n-2)] */
-           iir_cf[band].alpha * ( data_history[band][channel].x[i]
-             -  data_history[band][channel].x[k])
-           /* 		+ gamma * y(n-1) */
-           + iir_cf[band].gamma * data_history[band][channel].y[j]
-           /* 		- beta * y(n-2) */
-           - iir_cf[band].beta * data_history[band][channel].y[k]
-          );
-        /*
-         * The multiplication by 2.0 was 'moved' into the coefficients to save
-         * CPU cycles here */
-        /* Apply the gain  */
-        out[channel] +=  data_history[band][channel].y[i]*gain[band][channel]; /* * 2.0; */
-      } /* For each band */
-
-      if (extra_filtering)
-      {
-        /* Filter the sample again */
-        for (band = 0; band < band_count; band++)
-        {
-          /* Store Xi(n) */
-          data_history2[band][channel].x[i] = out[channel];
-          /* Calculate and store Yi(n) */
-          data_history2[band][channel].y[i] =
-            (
-             /* y(n) = alpha * [x(n)-x(n-2)] */
-             iir_cf[band].alpha * (data_history2[band][channel].x[i]
-               -  data_history2[band][channel].x[k])
-             /* 	    + gamma * y(n-1) */
-             + iir_cf[band].gamma * data_history2[band][channel].y[j]
-             /* 		- beta * y(n-2) */
-             - iir_cf[band].beta * data_history2[band][channel].y[k]
-            );
-          /* Apply the gain */
-          out[channel] +=  data_history2[band][channel].y[i]*gain[band][channel];
-        } /* For each band */
-      }
-
-      /* Volume stuff
-         Scale down original PCM sample and add it to the filters
-         output. This substitutes the multiplication by 0.25
-         Go back to use the floating point multiplication before the
-         conversion to give more dynamic range
-         */
-      out[channel] += pcm[channel]*0.25;
-
-      /* remove random noise */
-      out[channel] -= dither[di]*0.25;
-
-      /* Round and convert to integer */
-#ifdef ARCH_PPC
-      tempint = round_ppc(out[channel]);
-#else
-#ifdef ARCH_X86
-      tempint = round_trick(out[channel]);
-#else
-      tempint = (int)out[channel];
-#endif
-#endif
-
-      /* Limit the output */
-      if (tempint < -32768)
-        data[index+channel] = -32768;
-      else if (tempint > 32767)
-        data[index+channel] = 32767;
-      else
-        data[index+channel] = tempint;
-    } /* For each channel */
-
-    /* Wrap around the indexes */
-    i = (i+1)%3;
-    j = (j+1)%3;
-    k = (k+1)%3;
-    /* random noise index */
-    di = (di + 1) % 256;
-
-  }/* For each pair of samples */
-
-#ifdef BENCHMARK
-  timex += get_counter();
-  blength += length;
-  if (count++ == 1024)
-  {
-    printf("FLOATING POINT: %f %d\n",timex/1024.0, blength/1024);
-    blength = 0;
-    timex = 0.;
-    count = 0;
+      xn = x[index];
+      y = alpha * (xn - x2) + gamma * y1 - beta * y2;
+      x[index] = xn + y * gain;
+      x2 = x1;
+      x1 = xn;
+      y2 = y1;
+      y1 = y;
+    }
+
+    h->x1[band] = x1;
+    h->x2[band] = x2;
+    h->y1[band] = y1;
+    h->y2[band] = y2;
   }
-#endif /* BENCHMARK */
-
-/*  FTZ_OFF; */
-  return length;
 }
@@ -29,6 +29,7 @@
 #include <xmms/xmms_xformplugin.h>
 #include <xmms/xmms_sample.h>
 #include <xmms/xmms_log.h>
+#include <xmms/xmms_bindata.h>
 #include "xing.h"
 #include <mad.h>
 
@@ -44,6 +45,22 @@
  * Type definitions
  */
 
+/* Seek index, saved as bindata and referenced from the medialib entry */
+#define XMMS_MAD_INDEX_PROPERTY "mad_seekindex"
+#define XMMS_MAD_INDEX_MAGIC "MSIX"
+#define XMMS_MAD_INDEX_VERSION 1
+#define XMMS_MAD_INDEX_HEADER_SIZE 28
+
+/* Frames decoded ahead of the seek target to refill the bit reservoir
+ * and the synthesis filterbank. */
+#define XMMS_MAD_SEEK_PRIME_FRAMES 4
+
+typedef enum {
+	XMMS_MAD_INDEX_NONE,
+	XMMS_MAD_INDEX_BUILDING,
+	XMMS_MAD_INDEX_COMPLETE
+} xmms_mad_index_state_t;
+
 typedef struct xmms_mad_data_St {
 	struct mad_stream stream;
 	struct mad_frame frame;
@@ -62,6 +79,19 @@ typedef struct xmms_mad_data_St {
 	gint frames_to_skip;
 
 	xmms_xing_t *xing;
+
+	/* stream offset of buffer[0] */
+	guint64 buffer_offset;
+
+	guint frame_samples;
+	guint skip_frames;
+	guint start_delay;
+	gint64 total_samples;
+
+	/* byte offset of every frame, in stream order */
+	GArray *index;
+	xmms_mad_index_state_t index_state;
+	gint64 seek_frame;
 } xmms_mad_data_t;
 
 
@@ -110,6 +140,9 @@ xmms_mad_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 	xmms_xform_plugin_config_property_register (xform_plugin, "id3v1_enable",
 	                                            "1", NULL, NULL);
 
+	xmms_xform_plugin_config_property_register (xform_plugin, "seek_index",
+	                                            "1", NULL, NULL);
+
 	/* xmms_xform_indata_constraint_add */
 	xmms_xform_plugin_indata_add (xform_plugin,
 	                              XMMS_STREAM_TYPE_MIMETYPE,
@@ -145,10 +178,284 @@ xmms_mad_destroy (xmms_xform_t *xform)
 		xmms_xing_free (data->xing);
 	}
 
+	if (data->index) {
+		g_array_free (data->index, TRUE);
+	}
+
 	g_free (data);
 
 }
 
+static void
+xmms_mad_index_abandon (xmms_mad_data_t *data)
+{
+	if (data->index) {
+		g_array_free (data->index, TRUE);
+		data->index = NULL;
+	}
+	data->index_state = XMMS_MAD_INDEX_NONE;
+}
+
+static void
+xmms_mad_index_append (xmms_mad_data_t *data, guint64 offset)
+{
+	if (data->index->len &&
+	    g_array_index (data->index, guint64, data->index->len - 1) >= offset) {
+		return;
+	}
+
+	g_array_append_val (data->index, offset);
+}
+
+/**
+ * Find the number of the frame starting at offset, or of the last
+ * frame before it.
+ */
+static gint64
+xmms_mad_index_lookup (xmms_mad_data_t *data, guint64 offset)
+{
+	guint lo, hi;
+
+	lo = 0;
+	hi = data->index->len;
+
+	while (lo < hi) {
+		guint mid = lo + (hi - lo) / 2;
+
+		if (g_array_index (data->index, guint64, mid) <= offset) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return (gint64) lo - 1;
+}
+
+static gint
+xmms_mad_index_file_size (xmms_xform_t *xform)
+{
+	gint size;
+
+	if (!xmms_xform_metadata_get_int (xform, XMMS_MEDIALIB_ENTRY_PROPERTY_SIZE, &size)) {
+		size = 0;
+	}
+
+	return size;
+}
+
+/**
+ * Serialize the finished index into bindata and reference it from the
+ * entry so the next playback can seek exactly right away.
+ *
+ * Layout, all little endian: magic, version, samplerate, samples per
+ * frame, file size (64 bit), frame count and then the distance of
+ * each frame from the previous one.
+ */
+static void
+xmms_mad_index_save (xmms_xform_t *xform, xmms_mad_data_t *data)
+{
+	gchar hash[33];
+	guchar *buf, *ptr;
+	guint64 prev;
+	gsize len;
+	guint32 v32;
+	guint64 v64;
+	guint i;
+
+	if (!data->index->len) {
+		xmms_mad_index_abandon (data);
+		return;
+	}
+
+	len = XMMS_MAD_INDEX_HEADER_SIZE + 4 * data->index->len;
+	buf = ptr = g_malloc (len);
+
+	memcpy (ptr, XMMS_MAD_INDEX_MAGIC, 4);
+	ptr += 4;
+
+#define PUT32(x) v32 = GUINT32_TO_LE (x); memcpy (ptr, &v32, 4); ptr += 4;
+	PUT32 (XMMS_MAD_INDEX_VERSION);
+	PUT32 (data->samplerate);
+	PUT32 (data->frame_samples);
+	v64 = GUINT64_TO_LE ((guint64) xmms_mad_index_file_size (xform));
+	memcpy (ptr, &v64, 8);
+	ptr += 8;
+	PUT32 (data->index->len);
+
+	prev = 0;
+	for (i = 0; i < data->index->len; i++) {
+		guint64 offset = g_array_index (data->index, guint64, i);
+
+		if (offset - prev > G_MAXUINT32) {
+			XMMS_DBG ("Gap between frames too large, not saving seek index");
+			g_free (buf);
+			xmms_mad_index_abandon (data);
+			return;
+		}
+
+		PUT32 ((guint32) (offset - prev));
+		prev = offset;
+	}
+#undef PUT32
+
+	if (xmms_bindata_plugin_add (buf, len, hash)) {
+		XMMS_DBG ("Saved seek index with %u frames", data->index->len);
+		xmms_xform_metadata_set_str (xform, XMMS_MAD_INDEX_PROPERTY, hash);
+		data->index_state = XMMS_MAD_INDEX_COMPLETE;
+	} else {
+		xmms_mad_index_abandon (data);
+	}
+
+	g_free (buf);
+}
+
+/**
+ * Load the index saved on an earlier playback, if there is one and it
+ * still matches the stream.
+ */
+static gboolean
+xmms_mad_index_load (xmms_xform_t *xform, xmms_mad_data_t *data)
+{
+	gchar *hash;
+	guchar *buf, *ptr;
+	gsize len;
+	guint32 v32, count;
+	guint64 v64, offset;
+	gboolean ret = FALSE;
+	guint i;
+
+	hash = xmms_xform_entry_property_get_str (xform, XMMS_MAD_INDEX_PROPERTY);
+	if (!hash) {
+		return FALSE;
+	}
+
+	if (!xmms_bindata_plugin_get (hash, &buf, &len)) {
+		XMMS_DBG ("Seek index %s is gone", hash);
+		g_free (hash);
+		return FALSE;
+	}
+
+	ptr = buf;
+
+#define GET32(x) memcpy (&v32, ptr, 4); ptr += 4; x = GUINT32_FROM_LE (v32);
+	if (len < XMMS_MAD_INDEX_HEADER_SIZE ||
+	    memcmp (ptr, XMMS_MAD_INDEX_MAGIC, 4) != 0) {
+		goto out;
+	}
+	ptr += 4;
+
+	GET32 (v32);
+	if (v32 != XMMS_MAD_INDEX_VERSION) {
+		goto out;
+	}
+
+	GET32 (v32);
+	if (v32 != data->samplerate) {
+		goto out;
+	}
+
+	GET32 (v32);
+	if (v32 != data->frame_samples) {
+		goto out;
+	}
+
+	memcpy (&v64, ptr, 8);
+	ptr += 8;
+	if (GUINT64_FROM_LE (v64) != (guint64) xmms_mad_index_file_size (xform)) {
+		goto out;
+	}
+
+	GET32 (count);
+	if (!count || len != XMMS_MAD_INDEX_HEADER_SIZE + 4 * (gsize) count) {
+		goto out;
+	}
+
+	data->index = g_array_sized_new (FALSE, FALSE, sizeof (guint64), count);
+
+	offset = 0;
+	for (i = 0; i < count; i++) {
+		GET32 (v32);
+		offset += v32;
+		g_array_append_val (data->index, offset);
+	}
+#undef GET32
+
+	/* keep the reference, the entry is refreshed after init */
+	xmms_xform_metadata_set_str (xform, XMMS_MAD_INDEX_PROPERTY, hash);
+	data->index_state = XMMS_MAD_INDEX_COMPLETE;
+
+	XMMS_DBG ("Loaded seek index with %u frames", count);
+
+	ret = TRUE;
+
+out:
+	if (!ret) {
+		XMMS_DBG ("Seek index %s doesn't match the stream, rebuilding", hash);
+	}
+
+	g_free (buf);
+	g_free (hash);
+
+	return ret;
+}
+
+/**
+ * Sample accurate seek: restart decoding a few frames before the
+ * target frame and drop output until the target sample is reached.
+ */
+static gint64
+xmms_mad_seek_indexed (xmms_xform_t *xform, xmms_mad_data_t *data,
+                       gint64 samples, xmms_error_t *err)
+{
+	gint64 raw, frame, start, res;
+	guint64 offset;
+	guint skip;
+
+	raw = samples + data->start_delay;
+	frame = raw / data->frame_samples + data->skip_frames;
+	skip = raw % data->frame_samples;
+
+	if (frame >= data->index->len) {
+		frame = data->index->len - 1;
+		skip = 0;
+	}
+
+	start = MAX (frame - XMMS_MAD_SEEK_PRIME_FRAMES, 0);
+	offset = g_array_index (data->index, guint64, start);
+
+	XMMS_DBG ("Seek %" G_GINT64_FORMAT " samples -> frame %" G_GINT64_FORMAT
+	          " decoding from %" G_GUINT64_FORMAT " bytes",
+	          samples, frame, offset);
+
+	res = xmms_xform_seek (xform, offset, XMMS_XFORM_SEEK_SET, err);
+	if (res == -1) {
+		return -1;
+	}
+
+	/* drop the bit reservoir and filterbank state of the old position */
+	mad_stream_finish (&data->stream);
+	mad_stream_init (&data->stream);
+	mad_frame_mute (&data->frame);
+	mad_synth_mute (&data->synth);
+
+	data->buffer_length = 0;
+	data->buffer_offset = res;
+	data->synthpos = 0x7fffffff;
+
+	data->seek_frame = frame;
+	data->frames_to_skip = 0;
+	data->samples_to_skip = skip;
+
+	if (data->total_samples >= 0) {
+		data->samples_to_play = MAX (data->total_samples - samples, 0);
+	} else {
+		data->samples_to_play = -1;
+	}
+
+	return samples;
+}
+
 static gint64
 xmms_mad_seek (xmms_xform_t *xform, gint64 samples, xmms_xform_seek_mode_t whence, xmms_error_t *err)
 {
@@ -161,6 +468,13 @@ xmms_mad_seek (xmms_xform_t *xform, gint64 samples, xmms_xform_seek_mode_t whenc
 
 	data = xmms_xform_private_data_get (xform);
 
+	if (data->index_state == XMMS_MAD_INDEX_COMPLETE) {
+		return xmms_mad_seek_indexed (xform, data, samples, err);
+	}
+
+	/* the index only covers a stream decoded from start to end */
+	xmms_mad_index_abandon (data);
+
 	if (data->xing &&
 	    xmms_xing_has_flag (data->xing, XMMS_XING_FRAMES) &&
 	    xmms_xing_has_flag (data->xing, XMMS_XING_TOC)) {
@@ -197,6 +511,7 @@ xmms_mad_init (xmms_xform_t *xform)
 	xmms_error_t err;
 	guchar buf[40960];
 	xmms_mad_data_t *data;
+	xmms_config_property_t *config;
 	int len;
 	const gchar *metakey;
 
@@ -213,6 +528,8 @@ xmms_mad_init (xmms_xform_t *xform)
 	data->buffer_length = 0;
 
 	data->synthpos = 0x7fffffff;
+	data->total_samples = -1;
+	data->seek_frame = -1;
 
 	mad_stream_init (&stream);
 	mad_frame_init (&frame);
@@ -231,6 +548,7 @@ xmms_mad_init (xmms_xform_t *xform)
 
 	data->channels = frame.header.mode == MAD_MODE_SINGLE_CHANNEL ? 1 : 2;
 	data->samplerate = frame.header.samplerate;
+	data->frame_samples = 32 * MAD_NSBSAMPLES (&frame.header);
 
 
 	if (frame.header.flags & MAD_FLAG_PROTECTION) {
@@ -280,6 +598,9 @@ xmms_mad_init (xmms_xform_t *xform)
 			data->samples_to_skip = lame->start_delay;
 			data->samples_to_play = ((guint64) xmms_xing_get_frames (data->xing) * 1152ULL) -
 			                        lame->start_delay - lame->end_padding;
+			data->skip_frames = 1;
+			data->start_delay = lame->start_delay;
+			data->total_samples = data->samples_to_play;
 			XMMS_DBG ("Samples to skip in the beginning: %d, total: %" G_GINT64_FORMAT,
 			          data->samples_to_skip, data->samples_to_play);
 			/*
@@ -318,6 +639,13 @@ xmms_mad_init (xmms_xform_t *xform)
 	/* seeking needs bitrate */
 	data->bitrate = frame.header.bitrate;
 
+	config = xmms_xform_config_lookup (xform, "seek_index");
+	if (config && xmms_config_property_get_int (config) &&
+	    xmms_xform_entry_get (xform) && !xmms_mad_index_load (xform, data)) {
+		data->index = g_array_new (FALSE, FALSE, sizeof (guint64));
+		data->index_state = XMMS_MAD_INDEX_BUILDING;
+	}
+
 	if (xmms_id3v1_get_tags (xform) < 0) {
 		mad_stream_finish (&data->stream);
 		mad_frame_finish (&data->frame);
@@ -325,6 +653,9 @@ xmms_mad_init (xmms_xform_t *xform)
 		if (data->xing) {
 			xmms_xing_free (data->xing);
 		}
+		if (data->index) {
+			g_array_free (data->index, TRUE);
+		}
 		return FALSE;
 	}
 
@@ -389,10 +720,27 @@ xmms_mad_read (xmms_xform_t *xform, gpointer buf, gint len, xmms_error_t *err)
 
 		/* then try to decode another frame */
 		if (mad_frame_decode (&data->frame, &data->stream) != -1) {
+			guint64 offset;
 
 			/* mad_synthpop_frame - go Depeche! */
 			mad_synth_frame (&data->synth, &data->frame);
 
+			offset = data->buffer_offset +
+			         (data->stream.this_frame - data->buffer);
+
+			if (data->index_state == XMMS_MAD_INDEX_BUILDING) {
+				xmms_mad_index_append (data, offset);
+			}
+
+			if (data->seek_frame >= 0) {
+				/* still priming the decoder after an indexed seek */
+				if (xmms_mad_index_lookup (data, offset) < data->seek_frame) {
+					data->synthpos = 0x7fffffff;
+					continue;
+				}
+				data->seek_frame = -1;
+			}
+
 			if (data->frames_to_skip) {
 				data->frames_to_skip--;
 				data->synthpos = 0x7fffffff;
@@ -418,11 +766,19 @@ xmms_mad_read (xmms_xform_t *xform, gpointer buf, gint len, xmms_error_t *err)
 			continue;
 		}
 
+		/* a frame with a valid header that failed to decode still
+		 * takes up its place in the timeline */
+		if (data->index_state == XMMS_MAD_INDEX_BUILDING &&
+		    data->stream.error >= MAD_ERROR_BADCRC) {
+			xmms_mad_index_append (data, data->buffer_offset +
+			                       (data->stream.this_frame - data->buffer));
+		}
 
 		/* if there is no frame to decode stream more data */
 		if (data->stream.next_frame) {
 			guchar *buffer = data->buffer;
 			const guchar *nf = data->stream.next_frame;
+			data->buffer_offset += nf - buffer;
 			memmove (data->buffer, data->stream.next_frame,
 			         data->buffer_length = (&buffer[data->buffer_length] - nf));
 		}
@@ -432,6 +788,10 @@ xmms_mad_read (xmms_xform_t *xform, gpointer buf, gint len, xmms_error_t *err)
 		                       4096 - data->buffer_length,
 		                       err);
 
+		if (ret == 0 && data->index_state == XMMS_MAD_INDEX_BUILDING) {
+			xmms_mad_index_save (xform, data);
+		}
+
 		if (ret <= 0) {
 			return ret;
 		}
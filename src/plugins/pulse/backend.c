@@ -53,6 +53,9 @@ struct xmms_pulse {
 	pa_channel_map channel_map;
 	int operation_success;
 	int volume;
+	int subscribed;
+	xmms_pulse_volume_cb volume_cb;
+	void *volume_userdata;
 };
 
 static gboolean check_pulse_health (xmms_pulse *p, int *rerror)
@@ -127,6 +130,25 @@ static void stream_request_cb (pa_stream *s, size_t length, void *userdata)
 	signal_mainloop (userdata);
 }
 
+static void context_subscribe_cb (pa_context *c,
+                                  pa_subscription_event_type_t t,
+                                  uint32_t idx, void *userdata)
+{
+	xmms_pulse *p = userdata;
+	assert (p);
+
+	if ((t & PA_SUBSCRIPTION_EVENT_FACILITY_MASK) != PA_SUBSCRIPTION_EVENT_SINK_INPUT ||
+	    (t & PA_SUBSCRIPTION_EVENT_TYPE_MASK) != PA_SUBSCRIPTION_EVENT_CHANGE)
+		return;
+
+	/* Only our own stream is interesting */
+	if (!p->stream || pa_stream_get_index (p->stream) != idx)
+		return;
+
+	if (p->volume_cb)
+		p->volume_cb (p->volume_userdata);
+}
+
 static void drain_result_cb (pa_stream *s, int success, void *userdata)
 {
 	xmms_pulse *p = userdata;
@@ -638,3 +660,33 @@ int xmms_pulse_backend_volume_get (xmms_pulse *p, unsigned int *vol)
 
 	return *vol != -1;
 }
+
+
+/*
+ * Call cb whenever the volume of the stream changes, or stop doing so
+ * if cb is NULL. Once this returns the previous cb won't be called.
+ */
+void xmms_pulse_backend_volume_notify (xmms_pulse *p, xmms_pulse_volume_cb cb,
+                                       void *userdata)
+{
+	pa_operation *o;
+	assert (p);
+
+	pa_threaded_mainloop_lock (p->mainloop);
+
+	p->volume_cb = cb;
+	p->volume_userdata = userdata;
+
+	if (cb && !p->subscribed) {
+		pa_context_set_subscribe_callback (p->context, context_subscribe_cb, p);
+
+		o = pa_context_subscribe (p->context, PA_SUBSCRIPTION_MASK_SINK_INPUT,
+		                          NULL, NULL);
+		if (o) {
+			pa_operation_unref (o);
+			p->subscribed = 1;
+		}
+	}
+
+	pa_threaded_mainloop_unlock (p->mainloop);
+}
@@ -2,6 +2,7 @@
 #define __PULSE_BACKEND_H__
 
 typedef struct xmms_pulse xmms_pulse;
+typedef void (*xmms_pulse_volume_cb) (void *userdata);
 
 xmms_pulse* xmms_pulse_backend_new(const char *server, const char *name,
                                    int *rerror);
@@ -20,5 +21,7 @@ gboolean xmms_pulse_backend_flush(xmms_pulse *p, int *rerror);
 int xmms_pulse_backend_get_latency(xmms_pulse *s, int *rerror);
 int xmms_pulse_backend_volume_set(xmms_pulse *p, unsigned int vol);
 int xmms_pulse_backend_volume_get(xmms_pulse *p, unsigned int *vol);
+void xmms_pulse_backend_volume_notify(xmms_pulse *p, xmms_pulse_volume_cb cb,
+                                      void *userdata);
 
 #endif
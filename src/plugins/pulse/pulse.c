@@ -27,6 +27,9 @@
  */
 typedef struct {
 	xmms_pulse *pulse;
+	/* protects pulse from the volume functions */
+	GMutex lock;
+	gboolean volume_monitor;
 } xmms_pulse_data_t;
 
 #define XMMS_PULSE_DEFAULT_NAME "XMMS2"
@@ -51,6 +54,8 @@ static gboolean xmms_pulse_volume_get (xmms_output_t *output,
                                        const gchar **names,
                                        guint *values,
                                        guint *num_channels);
+static gboolean xmms_pulse_volume_monitor (xmms_output_t *output,
+                                           gboolean enable);
 
 
 /*
@@ -76,6 +81,7 @@ xmms_pulse_plugin_setup (xmms_output_plugin_t *plugin)
 	methods.format_set = xmms_pulse_format_set;
 	methods.volume_set = xmms_pulse_volume_set;
 	methods.volume_get = xmms_pulse_volume_get;
+	methods.volume_monitor = xmms_pulse_volume_monitor;
 
 	xmms_output_plugin_methods_set (plugin, &methods);
 
@@ -99,6 +105,8 @@ xmms_pulse_new (xmms_output_t *output)
 	data = g_new0 (xmms_pulse_data_t, 1);
 	g_return_val_if_fail (data, FALSE);
 
+	g_mutex_init (&data->lock);
+
 	xmms_output_private_data_set (output, data);
 
 	xmms_output_stream_type_add (output,
@@ -131,14 +139,23 @@ xmms_pulse_destroy (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
+	g_mutex_clear (&data->lock);
 	g_free (data);
 }
 
 
+static void
+xmms_pulse_volume_changed (void *userdata)
+{
+	xmms_output_volume_changed ((xmms_output_t *) userdata);
+}
+
+
 static gboolean
 xmms_pulse_open (xmms_output_t *output)
 {
 	xmms_pulse_data_t *data;
+	xmms_pulse *pulse;
 	const xmms_config_property_t *val;
 	const gchar *server, *name;
 
@@ -156,10 +173,17 @@ xmms_pulse_open (xmms_output_t *output)
 	if (!name || *name == '\0')
 		name = XMMS_PULSE_DEFAULT_NAME;
 
-	data->pulse = xmms_pulse_backend_new (server, name, NULL);
-	if (!data->pulse)
+	pulse = xmms_pulse_backend_new (server, name, NULL);
+	if (!pulse)
 		return FALSE;
 
+	g_mutex_lock (&data->lock);
+	data->pulse = pulse;
+	if (data->volume_monitor)
+		xmms_pulse_backend_volume_notify (pulse, xmms_pulse_volume_changed,
+		                                  output);
+	g_mutex_unlock (&data->lock);
+
 	return TRUE;
 }
 
@@ -173,10 +197,16 @@ xmms_pulse_close (xmms_output_t *output)
 	data = xmms_output_private_data_get (output);
 	g_return_if_fail (data);
 
+	g_mutex_lock (&data->lock);
 	if (data->pulse) {
 		xmms_pulse_backend_free (data->pulse);
 		data->pulse = NULL;
 	}
+	g_mutex_unlock (&data->lock);
+
+	/* the volume is gone along with the stream */
+	if (data->volume_monitor)
+		xmms_output_volume_changed (output);
 }
 
 
@@ -215,6 +245,10 @@ xmms_pulse_format_set (xmms_output_t *output, const xmms_stream_type_t *format)
 	                                    samplerate, channels, NULL))
 		return FALSE;
 
+	/* a new stream comes with a volume of its own */
+	if (data->volume_monitor)
+		xmms_output_volume_changed (output);
+
 	return TRUE;
 }
 
@@ -238,6 +272,7 @@ xmms_pulse_volume_set (xmms_output_t *output,
                       const gchar *channel_name, guint volume)
 {
 	xmms_pulse_data_t *data;
+	gboolean ret;
 
 	g_return_val_if_fail (output, FALSE);
 	g_return_val_if_fail (channel_name, FALSE);
@@ -247,7 +282,11 @@ xmms_pulse_volume_set (xmms_output_t *output,
 
 	g_return_val_if_fail (volume <= 100, FALSE);
 
-	return xmms_pulse_backend_volume_set (data->pulse, volume);
+	g_mutex_lock (&data->lock);
+	ret = xmms_pulse_backend_volume_set (data->pulse, volume);
+	g_mutex_unlock (&data->lock);
+
+	return ret;
 }
 
 
@@ -256,6 +295,7 @@ xmms_pulse_volume_get (xmms_output_t *output, const gchar **names,
                        guint *values, guint *num_channels)
 {
 	xmms_pulse_data_t *data;
+	gboolean ret;
 
 	g_return_val_if_fail (output, FALSE);
 
@@ -275,7 +315,33 @@ xmms_pulse_volume_get (xmms_output_t *output, const gchar **names,
 
 	names[0] = "master";
 
-	return xmms_pulse_backend_volume_get (data->pulse, &values[0]);
+	g_mutex_lock (&data->lock);
+	ret = xmms_pulse_backend_volume_get (data->pulse, &values[0]);
+	g_mutex_unlock (&data->lock);
+
+	return ret;
+}
+
+
+static gboolean
+xmms_pulse_volume_monitor (xmms_output_t *output, gboolean enable)
+{
+	xmms_pulse_data_t *data;
+
+	g_return_val_if_fail (output, FALSE);
+
+	data = xmms_output_private_data_get (output);
+	g_return_val_if_fail (data, FALSE);
+
+	g_mutex_lock (&data->lock);
+	data->volume_monitor = enable;
+	if (data->pulse)
+		xmms_pulse_backend_volume_notify (data->pulse,
+		                                  enable ? xmms_pulse_volume_changed : NULL,
+		                                  output);
+	g_mutex_unlock (&data->lock);
+
+	return TRUE;
 }
 
 
@@ -21,6 +21,7 @@
 #include <unistd.h>
 #include <sys/time.h>
 #include <errno.h>
+#include <fcntl.h>
 
 #include <xmmsc/xmmsc_idnumbers.h>
 #include <xmmsc/xmmsc_ipc_transport.h>
@@ -37,9 +38,24 @@
 #include <xmmspriv/xmms_bindata.h>
 #include <xmmspriv/xmms_utils.h>
 
+/* A blob kept mapped for fast retrieval and duplicate detection. */
+typedef struct xmms_bindata_blob_St {
+	gchar hash[33];
+	guint64 fast_hash;
+	GMappedFile *map;
+	GList *link;
+} xmms_bindata_blob_t;
+
 struct xmms_bindata_St {
 	xmms_object_t obj;
 	const gchar *bindir;
+
+	GMutex cache_lock;
+	GHashTable *cache;
+	GHashTable *cache_fast;
+	GQueue cache_lru;
+	gsize cache_bytes;
+	xmms_config_property_t *cache_size;
 };
 
 static xmms_bindata_t *global_bindata;
@@ -62,6 +78,9 @@ static void md5_append (md5_state_t *pms, const md5_byte_t *data, int nbytes);
 static void md5_finish (md5_state_t *pms, md5_byte_t digest[16]);
 
 static gchar *xmms_bindata_build_path (xmms_bindata_t *bindata, const gchar *hash);
+static GMappedFile *xmms_bindata_map (xmms_bindata_t *bindata, const gchar *hash);
+static void xmms_bindata_cache_remove (xmms_bindata_t *bindata, const gchar *hash);
+static void xmms_bindata_blob_free (xmms_bindata_blob_t *blob);
 
 static gchar *xmms_bindata_client_add (xmms_bindata_t *bindata, GString *data, xmms_error_t *err);
 static xmmsv_t *xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash, xmms_error_t *err);
@@ -88,6 +107,15 @@ xmms_bindata_init ()
 
 	obj->bindir = xmms_config_property_get_string (cv);
 
+	obj->cache_size = xmms_config_property_register ("bindata.cache_size",
+	                                                 "16777216", NULL, NULL);
+
+	g_mutex_init (&obj->cache_lock);
+	g_queue_init (&obj->cache_lru);
+	obj->cache = g_hash_table_new_full (g_str_hash, g_str_equal, NULL,
+	                                    (GDestroyNotify) xmms_bindata_blob_free);
+	obj->cache_fast = g_hash_table_new (g_int64_hash, g_int64_equal);
+
 	if (!g_file_test (obj->bindir, G_FILE_TEST_IS_DIR)) {
 		if (g_mkdir_with_parents (obj->bindir, 0755) == -1) {
 			xmms_log_error ("Couldn't create bindir %s", obj->bindir);
@@ -102,9 +130,204 @@ xmms_bindata_init ()
 static void
 xmms_bindata_destroy (xmms_object_t *obj)
 {
+	xmms_bindata_t *bindata = (xmms_bindata_t *) obj;
+
 	XMMS_DBG ("Deactivating bindata object.");
 
 	xmms_bindata_unregister_ipc_commands ();
+
+	g_hash_table_destroy (bindata->cache_fast);
+	g_hash_table_destroy (bindata->cache);
+	g_queue_clear (&bindata->cache_lru);
+	g_mutex_clear (&bindata->cache_lock);
+
+	global_bindata = NULL;
+}
+
+/**
+ * Cheap 64 bit hash used to spot data that is already stored before
+ * paying for MD5. Matches are always verified against the stored
+ * data, so collisions only cost a comparison.
+ */
+static guint64
+xmms_bindata_fast_hash (const guchar *data, gsize len)
+{
+	guint64 h, k;
+
+	h = 0x9e3779b97f4a7c15ULL ^ (len * 0xc6a4a7935bd1e995ULL);
+
+	while (len >= 8) {
+		memcpy (&k, data, 8);
+		k *= 0x87c37b91114253d5ULL;
+		k = (k << 31) | (k >> 33);
+		k *= 0x4cf5ad432745937fULL;
+		h ^= k;
+		h = ((h << 27) | (h >> 37)) * 5 + 0x52dce729;
+		data += 8;
+		len -= 8;
+	}
+
+	if (len) {
+		k = 0;
+		memcpy (&k, data, len);
+		k *= 0x87c37b91114253d5ULL;
+		k = (k << 31) | (k >> 33);
+		k *= 0x4cf5ad432745937fULL;
+		h ^= k;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+
+	return h;
+}
+
+static void
+xmms_bindata_blob_free (xmms_bindata_blob_t *blob)
+{
+	g_mapped_file_unref (blob->map);
+	g_free (blob);
+}
+
+static void
+xmms_bindata_cache_unlink (xmms_bindata_t *bindata, xmms_bindata_blob_t *blob)
+{
+	if (g_hash_table_lookup (bindata->cache_fast, &blob->fast_hash) == blob) {
+		g_hash_table_remove (bindata->cache_fast, &blob->fast_hash);
+	}
+
+	g_queue_delete_link (&bindata->cache_lru, blob->link);
+	bindata->cache_bytes -= g_mapped_file_get_length (blob->map);
+
+	g_hash_table_remove (bindata->cache, blob->hash);
+}
+
+/**
+ * Keep a mapped blob around, evicting the least recently used ones
+ * beyond bindata.cache_size. Must be called with cache_lock held.
+ */
+static void
+xmms_bindata_cache_insert (xmms_bindata_t *bindata, const gchar *hash,
+                           GMappedFile *map, guint64 fast_hash)
+{
+	xmms_bindata_blob_t *blob;
+	gsize limit, len;
+
+	len = g_mapped_file_get_length (map);
+	limit = MAX (xmms_config_property_get_int (bindata->cache_size), 0);
+
+	if (len == 0 || len > limit) {
+		return;
+	}
+
+	if (g_hash_table_lookup (bindata->cache, hash)) {
+		return;
+	}
+
+	while (bindata->cache_bytes + len > limit) {
+		xmms_bindata_cache_unlink (bindata, g_queue_peek_tail (&bindata->cache_lru));
+	}
+
+	blob = g_new0 (xmms_bindata_blob_t, 1);
+	g_strlcpy (blob->hash, hash, sizeof (blob->hash));
+	blob->fast_hash = fast_hash;
+	blob->map = g_mapped_file_ref (map);
+
+	g_queue_push_head (&bindata->cache_lru, blob);
+	blob->link = g_queue_peek_head_link (&bindata->cache_lru);
+	bindata->cache_bytes += len;
+
+	g_hash_table_insert (bindata->cache, blob->hash, blob);
+	/* a blob with the same fast hash loses its entry, and the key must
+	 * point into the blob that stays, as the old one may be freed first */
+	g_hash_table_replace (bindata->cache_fast, &blob->fast_hash, blob);
+}
+
+static void
+xmms_bindata_cache_touch (xmms_bindata_t *bindata, xmms_bindata_blob_t *blob)
+{
+	g_queue_unlink (&bindata->cache_lru, blob->link);
+	g_queue_push_head_link (&bindata->cache_lru, blob->link);
+}
+
+static void
+xmms_bindata_cache_remove (xmms_bindata_t *bindata, const gchar *hash)
+{
+	xmms_bindata_blob_t *blob;
+
+	g_mutex_lock (&bindata->cache_lock);
+	blob = g_hash_table_lookup (bindata->cache, hash);
+	if (blob) {
+		xmms_bindata_cache_unlink (bindata, blob);
+	}
+	g_mutex_unlock (&bindata->cache_lock);
+}
+
+/**
+ * Look for data that is already stored, by fast hash and a full
+ * comparison. On a hit hash is filled in with its name.
+ */
+static gboolean
+xmms_bindata_cache_find (xmms_bindata_t *bindata, const guchar *data,
+                         gsize len, guint64 fast_hash, gchar hash[33])
+{
+	xmms_bindata_blob_t *blob;
+	gboolean ret = FALSE;
+
+	g_mutex_lock (&bindata->cache_lock);
+
+	blob = g_hash_table_lookup (bindata->cache_fast, &fast_hash);
+	if (blob && g_mapped_file_get_length (blob->map) == len &&
+	    memcmp (g_mapped_file_get_contents (blob->map), data, len) == 0) {
+		xmms_bindata_cache_touch (bindata, blob);
+		g_strlcpy (hash, blob->hash, 33);
+		ret = TRUE;
+	}
+
+	g_mutex_unlock (&bindata->cache_lock);
+
+	return ret;
+}
+
+/**
+ * Get the stored data for hash mapped into memory, through the cache.
+ * The caller owns a reference to the returned mapping.
+ */
+static GMappedFile *
+xmms_bindata_map (xmms_bindata_t *bindata, const gchar *hash)
+{
+	xmms_bindata_blob_t *blob;
+	GMappedFile *map;
+	gchar *path;
+
+	g_mutex_lock (&bindata->cache_lock);
+	blob = g_hash_table_lookup (bindata->cache, hash);
+	if (blob) {
+		xmms_bindata_cache_touch (bindata, blob);
+		map = g_mapped_file_ref (blob->map);
+		g_mutex_unlock (&bindata->cache_lock);
+		return map;
+	}
+	g_mutex_unlock (&bindata->cache_lock);
+
+	path = xmms_bindata_build_path (bindata, hash);
+	map = g_mapped_file_new (path, FALSE, NULL);
+	g_free (path);
+
+	if (!map) {
+		return NULL;
+	}
+
+	g_mutex_lock (&bindata->cache_lock);
+	xmms_bindata_cache_insert (bindata, hash, map,
+	                           xmms_bindata_fast_hash ((const guchar *) g_mapped_file_get_contents (map),
+	                                                   g_mapped_file_get_length (map)));
+	g_mutex_unlock (&bindata->cache_lock);
+
+	return map;
 }
 
 gchar *
@@ -144,13 +367,56 @@ xmms_bindata_plugin_add (const guchar *data, gsize size, gchar hash[33])
 	return _xmms_bindata_add (global_bindata, data, size, hash, &err);
 }
 
+/**
+ * Retrieve binary data previously added by a plugin.
+ *
+ * @param hash The hash returned by #xmms_bindata_plugin_add.
+ * @param data Set to newly allocated contents, free with g_free.
+ * @param size Set to the length of data.
+ * @return TRUE if the data was found and read.
+ */
+gboolean
+xmms_bindata_plugin_get (const gchar *hash, guchar **data, gsize *size)
+{
+	GMappedFile *map;
+
+	g_return_val_if_fail (global_bindata, FALSE);
+	g_return_val_if_fail (hash, FALSE);
+
+	if (strchr (hash, G_DIR_SEPARATOR)) {
+		return FALSE;
+	}
+
+	map = xmms_bindata_map (global_bindata, hash);
+	if (!map) {
+		return FALSE;
+	}
+
+	*size = g_mapped_file_get_length (map);
+	*data = g_malloc (*size);
+	memcpy (*data, g_mapped_file_get_contents (map), *size);
+	g_mapped_file_unref (map);
+
+	return TRUE;
+}
+
 static gboolean
 _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar hash[33], xmms_error_t *err)
 {
 	const guchar *ptr;
+	guint64 fast_hash;
+	GMappedFile *map;
 	gsize left;
-	gchar *path;
+	gchar *path, *tmp;
+	gboolean stored;
 	FILE *fp;
+	gint fd;
+
+	/* the same cover art tends to be added once per track */
+	fast_hash = xmms_bindata_fast_hash (data, len);
+	if (xmms_bindata_cache_find (bindata, data, len, fast_hash, hash)) {
+		return TRUE;
+	}
 
 	xmms_bindata_calculate_md5 (data, len, hash);
 
@@ -158,15 +424,34 @@ _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar
 
 	if (g_file_test (path, G_FILE_TEST_IS_REGULAR)) {
 		XMMS_DBG ("file %s is already in bindata dir", hash);
+		map = g_mapped_file_new (path, FALSE, NULL);
+		if (map) {
+			g_mutex_lock (&bindata->cache_lock);
+			xmms_bindata_cache_insert (bindata, hash, map, fast_hash);
+			g_mutex_unlock (&bindata->cache_lock);
+			g_mapped_file_unref (map);
+		}
 		g_free (path);
 		return TRUE;
 	}
 
+	/* Another thread may add the same data at the same time. The data
+	 * is written to a temporary file which is renamed into place once
+	 * complete, so a file under the hash is never seen half written
+	 * nor truncated while mapped. */
+	tmp = g_strdup_printf ("%s%c.%s.XXXXXX", bindata->bindir, G_DIR_SEPARATOR, hash);
+
 	XMMS_DBG ("Creating %s", path);
-	fp = fopen (path, "wb");
+	fd = g_mkstemp_full (tmp, O_WRONLY, 0644);
+	fp = fd == -1 ? NULL : fdopen (fd, "wb");
 	if (!fp) {
-		xmms_log_error ("Couldn't create %s", path);
+		if (fd != -1) {
+			close (fd);
+			unlink (tmp);
+		}
+		xmms_log_error ("Couldn't create %s", tmp);
 		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't create file on server!");
+		g_free (tmp);
 		g_free (path);
 		return FALSE;
 	}
@@ -181,11 +466,12 @@ _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar
 		w = fwrite (ptr, 1, left, fp);
 		if (!w && ferror (fp)) {
 			fclose (fp);
-			unlink (path);
+			unlink (tmp);
 
 			xmms_log_error ("Couldn't write data");
 			xmms_error_set (err, XMMS_ERROR_GENERIC,
 			                "Couldn't write data!");
+			g_free (tmp);
 			g_free (path);
 			return FALSE;
 		}
@@ -194,7 +480,28 @@ _xmms_bindata_add (xmms_bindata_t *bindata, const guchar *data, gsize len, gchar
 		ptr += w;
 	}
 
-	fclose (fp);
+	stored = fflush (fp) == 0 && fsync (fileno (fp)) == 0;
+	stored = fclose (fp) == 0 && stored;
+
+	if (!stored || rename (tmp, path) != 0) {
+		xmms_log_error ("Couldn't store %s: %s", path, strerror (errno));
+		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't write data!");
+		unlink (tmp);
+		g_free (tmp);
+		g_free (path);
+		return FALSE;
+	}
+
+	g_free (tmp);
+
+	map = g_mapped_file_new (path, FALSE, NULL);
+	if (map) {
+		g_mutex_lock (&bindata->cache_lock);
+		xmms_bindata_cache_insert (bindata, hash, map, fast_hash);
+		g_mutex_unlock (&bindata->cache_lock);
+		g_mapped_file_unref (map);
+	}
+
 	g_free (path);
 
 	return TRUE;
@@ -214,43 +521,19 @@ xmms_bindata_client_retrieve (xmms_bindata_t *bindata, const gchar *hash,
                               xmms_error_t *err)
 {
 	xmmsv_t *res;
-	gchar *path;
-	GString *str;
-	FILE *fp;
-
-	path = xmms_bindata_build_path (bindata, hash);
+	GMappedFile *map;
 
-	fp = fopen (path, "rb");
-	if (!fp) {
+	map = xmms_bindata_map (bindata, hash);
+	if (!map) {
 		xmms_log_error ("Requesting '%s' which is not on the server", hash);
 		xmms_error_set (err, XMMS_ERROR_NOENT, "File not found!");
-		g_free (path);
 		return NULL;
 	}
 
-	g_free (path);
-
-	str = g_string_new (NULL);
-	while (!feof (fp)) {
-		gchar buf[1024];
-		gint l;
-
-		l = fread (buf, 1, 1024, fp);
-		if (ferror (fp)) {
-			g_string_free (str, TRUE);
-			xmms_log_error ("Error reading bindata '%s'", hash);
-			xmms_error_set (err, XMMS_ERROR_GENERIC, "Error reading file");
-			fclose (fp);
-			return NULL;
-		}
-		g_string_append_len (str, buf, l);
-	}
-
-	fclose (fp);
-
-	res = xmmsv_new_bin ((unsigned char *)str->str, str->len);
+	res = xmmsv_new_bin ((unsigned char *) g_mapped_file_get_contents (map),
+	                     g_mapped_file_get_length (map));
 
-	g_string_free (str, TRUE);
+	g_mapped_file_unref (map);
 
 	return res;
 }
@@ -260,6 +543,9 @@ xmms_bindata_client_remove (xmms_bindata_t *bindata, const gchar *hash,
                             xmms_error_t *err)
 {
 	gchar *path;
+
+	xmms_bindata_cache_remove (bindata, hash);
+
 	path = xmms_bindata_build_path (bindata, hash);
 	if (unlink (path) == -1) {
 		xmms_error_set (err, XMMS_ERROR_GENERIC, "Couldn't remove file");
@@ -289,6 +575,9 @@ xmms_bindata_client_list (xmms_bindata_t *bindata, xmms_error_t *err)
 	entries = xmmsv_new_list ();
 
 	while ((file = g_dir_read_name (dir))) {
+		/* skip data that is still being written */
+		if (file[0] == '.')
+			continue;
 		xmmsv_list_append_string (entries, file);
 	}
 
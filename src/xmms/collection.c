@@ -30,6 +30,7 @@
 #include <xmmspriv/xmms_xform.h>
 #include <xmmspriv/xmms_streamtype.h>
 #include <xmmspriv/xmms_medialib.h>
+#include <xmmspriv/xmms_collection_sampler.h>
 #include <xmms/xmms_ipc.h>
 #include <xmms/xmms_log.h>
 
@@ -145,6 +146,9 @@ xmms_collection_changed_msg_send (xmms_coll_dag_t *colldag, xmmsv_t *dict)
 
 #define XMMS_COLLECTION_CHANGED_MSG(type, name, namespace) xmms_collection_changed_msg_send (dag, xmms_collection_changed_msg_new (type, name, namespace))
 
+/* Number of party shuffle sources to keep the ids of */
+#define XMMS_COLLECTION_SAMPLER_SETS 4
+
 
 /** @defgroup Collection Collection
   * @ingroup XMMSServer
@@ -166,8 +170,19 @@ struct xmms_coll_dag_St {
 	GMutex mutex;
 
 	xmms_medialib_t *medialib;
+
+	/* ids of party shuffle sources */
+	xmms_collection_sampler_t *sampler;
 };
 
+/* Query plans compiled from the old collection are of no use anymore */
+static void
+on_collection_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_coll_dag_t *dag = (xmms_coll_dag_t *) udata;
+	xmms_medialib_query_plans_invalidate (dag->medialib);
+}
+
 /** Initializes a new xmms_coll_dag_t.
  *
  * @returns  The newly allocated collection DAG.
@@ -184,6 +199,8 @@ xmms_collection_init (xmms_medialib_t *medialib)
 	xmms_object_ref (medialib);
 	ret->medialib = medialib;
 
+	ret->sampler = xmms_collection_sampler_new (medialib, XMMS_COLLECTION_SAMPLER_SETS);
+
 	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; ++i) {
 		ret->collrefs[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
 		                                          g_free, coll_unref);
@@ -191,6 +208,10 @@ xmms_collection_init (xmms_medialib_t *medialib)
 
 	xmms_collection_register_ipc_commands (XMMS_OBJECT (ret));
 
+	xmms_object_connect (XMMS_OBJECT (ret),
+	                     XMMS_IPC_SIGNAL_COLLECTION_CHANGED,
+	                     on_collection_changed, ret);
+
 	return ret;
 }
 
@@ -962,22 +983,20 @@ xmms_collection_find_alias (xmms_coll_dag_t *dag, xmms_collection_namespace_id_t
  * Get a random media entry from the given collection.
  *
  * @param dag  The collection DAG.
- * @param source  The collection to query.
+ * @param source  The collection to query.
+ * @param avoid  Media ids to avoid if the collection has others, or NULL.
  * @return  A random media from the source collection, or 0 if none found.
  */
 xmms_medialib_entry_t
-xmms_collection_get_random_media (xmms_coll_dag_t *dag, xmmsv_t *source)
+xmms_collection_get_random_media (xmms_coll_dag_t *dag, xmmsv_t *source,
+                                  GHashTable *avoid)
 {
-	xmms_medialib_session_t *session;
 	xmms_medialib_entry_t ret;
 
 	g_mutex_lock (&dag->mutex);
 	xmms_collection_apply_to_collection (dag, source, bind_all_references, NULL);
 
-	do {
-		session = xmms_medialib_session_begin_ro (dag->medialib);
-		ret = xmms_medialib_query_random_id (session, source);
-	} while (!xmms_medialib_session_commit (session));
+	ret = xmms_collection_sampler_pick (dag->sampler, source, avoid);
 
 	g_mutex_unlock (&dag->mutex);
 
@@ -1002,6 +1021,10 @@ xmms_collection_destroy (xmms_object_t *object)
 
 	g_return_if_fail (dag);
 
+	xmms_object_disconnect (object, XMMS_IPC_SIGNAL_COLLECTION_CHANGED,
+	                        on_collection_changed, dag);
+
+	xmms_collection_sampler_free (dag->sampler);
 	xmms_object_unref (dag->medialib);
 	g_mutex_clear (&dag->mutex);
 
@@ -1644,6 +1667,94 @@ xmms_collection_snapshot (xmms_coll_dag_t *dag)
 	return result;
 }
 
+static void
+xmms_collection_snapshot_names (xmms_coll_dag_t *dag,
+                                xmms_collection_namespace_id_t nsid,
+                                GList *names, xmmsv_t *result)
+{
+	xmmsv_t *coll, *copy;
+	GList *n;
+
+	for (n = names; n; n = g_list_next (n)) {
+		gchar *alias = NULL;
+		const gchar *name = n->data;
+
+		coll = xmms_collection_get_pointer (dag, name, nsid);
+
+		/* the active playlist is stored under its real name */
+		if (coll != NULL && nsid == XMMS_COLLECTION_NSID_PLAYLISTS &&
+		    strcmp (name, XMMS_ACTIVE_PLAYLIST) == 0) {
+			alias = xmms_collection_find_alias (dag, nsid, coll, XMMS_ACTIVE_PLAYLIST);
+			if (alias == NULL) {
+				continue;
+			}
+			name = alias;
+		}
+
+		if (coll == NULL) {
+			copy = xmmsv_new_none ();
+		} else {
+			xmms_collection_apply_to_collection (dag, coll, unbind_all_references, NULL);
+			copy = xmmsv_copy (coll);
+			xmms_collection_apply_to_collection (dag, coll, bind_all_references, NULL);
+		}
+
+		xmmsv_dict_set (result, name, copy);
+		xmmsv_unref (copy);
+
+		g_free (alias);
+	}
+}
+
+/**
+ * Take a snapshot of some saved collections only, in the same format
+ * as #xmms_collection_snapshot. Names that no longer exist map to a
+ * none value, so the result can be applied on top of an older
+ * snapshot.
+ *
+ * @param dag  The collection DAG.
+ * @param collections  Names in the collections namespace.
+ * @param playlists  Names in the playlists namespace.
+ * @returns  A dict with the requested collections and the name of the
+ *           active playlist.
+ */
+xmmsv_t *
+xmms_collection_snapshot_partial (xmms_coll_dag_t *dag, GList *collections,
+                                  GList *playlists)
+{
+	xmmsv_t *result, *dict, *active_playlist;
+	gchar *name;
+
+	result = xmmsv_new_dict ();
+
+	g_mutex_lock (&dag->mutex);
+
+	dict = xmmsv_new_dict ();
+	xmms_collection_snapshot_names (dag, XMMS_COLLECTION_NSID_COLLECTIONS,
+	                                collections, dict);
+	xmmsv_dict_set (result, "collections", dict);
+	xmmsv_unref (dict);
+
+	dict = xmmsv_new_dict ();
+	xmms_collection_snapshot_names (dag, XMMS_COLLECTION_NSID_PLAYLISTS,
+	                                playlists, dict);
+	xmmsv_dict_set (result, "playlists", dict);
+	xmmsv_unref (dict);
+
+	active_playlist = xmms_collection_get_pointer (dag, XMMS_ACTIVE_PLAYLIST,
+	                                               XMMS_COLLECTION_NSID_PLAYLISTS);
+	name = xmms_collection_find_alias (dag, XMMS_COLLECTION_NSID_PLAYLISTS,
+	                                   active_playlist, XMMS_ACTIVE_PLAYLIST);
+	if (name != NULL) {
+		xmmsv_dict_set_string (result, "active-playlist", name);
+		g_free (name);
+	}
+
+	g_mutex_unlock (&dag->mutex);
+
+	return result;
+}
+
 static void
 xmms_collection_restore_collection (const gchar *name, xmmsv_t *coll, void *udata)
 {
@@ -0,0 +1,527 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Random sampling of collections.
+ *
+ * Party shuffle playlists pick random media from their source collection
+ * every time an entry is played. Running the whole collection as a query
+ * for each pick is slow on large medialibs, so the ids matching a
+ * collection are kept in a sorted array, from which a uniformly random
+ * id is picked in constant time. The sets are kept in a small LRU cache
+ * keyed by the serialized, normalized collection, so they don't depend
+ * on later changes to the collections.
+ *
+ * The ids of entries that are added or changed are remembered, and only
+ * those are run against the collection before the next pick. Removed
+ * entries are dropped from the sets right away. Sets of collections
+ * that query the medialib while being compiled, or that saw too many
+ * changes, are rebuilt from scratch instead.
+ */
+
+#include <string.h>
+
+#include <xmmspriv/xmms_collection_sampler.h>
+#include <xmms/xmms_ipc.h>
+#include <xmms/xmms_log.h>
+
+/* Changed entries re-checked one by one before rebuilding a set */
+#define XMMS_COLLECTION_SAMPLER_MAX_CHANGES 256
+
+/* Random picks that may land on media to avoid before searching */
+#define XMMS_COLLECTION_SAMPLER_ATTEMPTS 8
+
+typedef struct xmms_collection_sample_set_St {
+	/* serialized normalized collection */
+	xmmsv_t *key;
+	const guchar *key_data;
+	guint key_len;
+	guint hash;
+
+	/* normalized collection, owned by the set */
+	xmmsv_t *coll;
+	gboolean data_dependent;
+	/* rebuilt for every pick, as it is shuffled */
+	gboolean uncacheable;
+
+	/* ids of the matching media, sorted */
+	GArray *ids;
+
+	/* ids of entries changed since the set was brought up to date */
+	GHashTable *changed;
+	gboolean stale;
+
+	/* position in the LRU list of the sampler */
+	GList *link;
+} xmms_collection_sample_set_t;
+
+struct xmms_collection_sampler_St {
+	GMutex mutex;
+
+	xmms_medialib_t *medialib;
+
+	GHashTable *sets;
+	/* most recently used first */
+	GQueue lru;
+	guint capacity;
+};
+
+static guint
+xmms_collection_sample_set_hash (gconstpointer key)
+{
+	const xmms_collection_sample_set_t *set = key;
+	return set->hash;
+}
+
+static gboolean
+xmms_collection_sample_set_equal (gconstpointer a, gconstpointer b)
+{
+	const xmms_collection_sample_set_t *x = a, *y = b;
+
+	return x->key_len == y->key_len &&
+	       memcmp (x->key_data, y->key_data, x->key_len) == 0;
+}
+
+/* Serialize the normalized collection into the cache key */
+static gboolean
+xmms_collection_sample_set_key (xmms_collection_sample_set_t *set, xmmsv_t *coll)
+{
+	guint i, hash = 5381;
+
+	set->key = xmmsv_serialize (coll);
+
+	if (set->key == NULL ||
+	    !xmmsv_get_bin (set->key, &set->key_data, &set->key_len)) {
+		return FALSE;
+	}
+
+	for (i = 0; i < set->key_len; i++) {
+		hash = hash * 33 + set->key_data[i];
+	}
+	set->hash = hash;
+
+	return TRUE;
+}
+
+static void
+xmms_collection_sample_set_free (xmms_collection_sample_set_t *set)
+{
+	if (set->key != NULL)
+		xmmsv_unref (set->key);
+	if (set->ids != NULL)
+		g_array_free (set->ids, TRUE);
+	if (set->changed != NULL)
+		g_hash_table_destroy (set->changed);
+
+	xmmsv_unref (set->coll);
+
+	g_free (set);
+}
+
+/**
+ * Find an id in a sorted array.
+ *
+ * @param pos Set to the position of the id, or where it would be inserted
+ * @return TRUE if the id was found
+ */
+static gboolean
+xmms_collection_sampler_find (GArray *ids, gint id, guint *pos)
+{
+	guint lo = 0, hi = ids->len, mid;
+	gint value;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		value = g_array_index (ids, gint, mid);
+		if (value == id) {
+			*pos = mid;
+			return TRUE;
+		}
+		if (value < id) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*pos = lo;
+
+	return FALSE;
+}
+
+static gint
+xmms_collection_sampler_compare_ids (gconstpointer a, gconstpointer b)
+{
+	gint x = *(const gint *) a, y = *(const gint *) b;
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * Run a collection against the medialib.
+ *
+ * @return The sorted ids of the matching media
+ */
+static GArray *
+xmms_collection_sampler_query (xmms_medialib_t *medialib, xmmsv_t *coll)
+{
+	xmms_medialib_session_t *session;
+	const s4_resultrow_t *row;
+	const s4_result_t *result;
+	s4_sourcepref_t *sourcepref;
+	xmms_fetch_info_t *info;
+	s4_resultset_t *set;
+	GArray *ret = NULL;
+	guint i, j;
+	gint id;
+
+	do {
+		if (ret != NULL)
+			g_array_free (ret, TRUE);
+		ret = g_array_new (FALSE, FALSE, sizeof (gint));
+
+		session = xmms_medialib_session_begin_ro (medialib);
+
+		sourcepref = xmms_medialib_session_get_source_preferences (session);
+		info = xmms_fetch_info_new (sourcepref);
+		s4_sourcepref_unref (sourcepref);
+
+		set = xmms_medialib_query_recurs (session, coll, info);
+
+		for (i = 0; s4_resultset_get_row (set, i, &row); i++) {
+			if (s4_resultrow_get_col (row, 0, &result) &&
+			    s4_val_get_int (s4_result_get_val (result), &id)) {
+				g_array_append_val (ret, id);
+			}
+		}
+
+		s4_resultset_free (set);
+		xmms_fetch_info_free (info);
+	} while (!xmms_medialib_session_commit (session));
+
+	g_array_sort (ret, xmms_collection_sampler_compare_ids);
+
+	/* the same media may be matched more than once */
+	for (i = 0, j = 0; i < ret->len; i++) {
+		if (j == 0 || g_array_index (ret, gint, i) != g_array_index (ret, gint, j - 1)) {
+			g_array_index (ret, gint, j++) = g_array_index (ret, gint, i);
+		}
+	}
+	g_array_set_size (ret, j);
+
+	return ret;
+}
+
+/* Must be called with the sampler locked */
+static void
+xmms_collection_sample_set_update (xmms_collection_sampler_t *sampler,
+                                   xmms_collection_sample_set_t *set)
+{
+	xmmsv_t *idlist, *intersection;
+	GHashTableIter iter;
+	GArray *members;
+	gpointer key;
+	guint pos, unused;
+	gboolean present;
+	gint id;
+
+	if (set->stale) {
+		if (set->ids != NULL)
+			g_array_free (set->ids, TRUE);
+		set->ids = xmms_collection_sampler_query (sampler->medialib, set->coll);
+		g_hash_table_remove_all (set->changed);
+		set->stale = FALSE;
+
+		XMMS_DBG ("Sampling from %u media.", set->ids->len);
+		return;
+	}
+
+	if (g_hash_table_size (set->changed) == 0) {
+		return;
+	}
+
+	/* find out which of the changed entries match the collection */
+	idlist = xmmsv_new_coll (XMMS_COLLECTION_TYPE_IDLIST);
+	g_hash_table_iter_init (&iter, set->changed);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		xmmsv_coll_idlist_append (idlist, GPOINTER_TO_INT (key));
+	}
+
+	intersection = xmmsv_new_coll (XMMS_COLLECTION_TYPE_INTERSECTION);
+	xmmsv_coll_add_operand (intersection, idlist);
+	xmmsv_coll_add_operand (intersection, set->coll);
+	xmmsv_unref (idlist);
+
+	members = xmms_collection_sampler_query (sampler->medialib, intersection);
+	xmmsv_unref (intersection);
+
+	g_hash_table_iter_init (&iter, set->changed);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		id = GPOINTER_TO_INT (key);
+
+		present = xmms_collection_sampler_find (set->ids, id, &pos);
+		if (xmms_collection_sampler_find (members, id, &unused)) {
+			if (!present) {
+				g_array_insert_val (set->ids, pos, id);
+			}
+		} else if (present) {
+			g_array_remove_index (set->ids, pos);
+		}
+	}
+
+	g_hash_table_remove_all (set->changed);
+	g_array_free (members, TRUE);
+}
+
+/* Must be called with the sampler locked */
+static void
+xmms_collection_sample_set_changed (xmms_collection_sample_set_t *set, gint id)
+{
+	if (set->stale) {
+		return;
+	}
+
+	/* other media may have moved in or out of a limit */
+	if (set->data_dependent ||
+	    g_hash_table_size (set->changed) >= XMMS_COLLECTION_SAMPLER_MAX_CHANGES) {
+		g_hash_table_remove_all (set->changed);
+		set->stale = TRUE;
+		return;
+	}
+
+	g_hash_table_add (set->changed, GINT_TO_POINTER (id));
+}
+
+static void
+on_medialib_entry_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_collection_sampler_t *sampler = (xmms_collection_sampler_t *) udata;
+	GList *l;
+	gint id;
+
+	if (!xmmsv_get_int (val, &id)) {
+		return;
+	}
+
+	g_mutex_lock (&sampler->mutex);
+	for (l = sampler->lru.head; l != NULL; l = l->next) {
+		xmms_collection_sample_set_changed (l->data, id);
+	}
+	g_mutex_unlock (&sampler->mutex);
+}
+
+static void
+on_medialib_entry_removed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_collection_sampler_t *sampler = (xmms_collection_sampler_t *) udata;
+	xmms_collection_sample_set_t *set;
+	guint pos;
+	GList *l;
+	gint id;
+
+	if (!xmmsv_get_int (val, &id)) {
+		return;
+	}
+
+	g_mutex_lock (&sampler->mutex);
+	for (l = sampler->lru.head; l != NULL; l = l->next) {
+		set = l->data;
+
+		if (set->stale || set->data_dependent) {
+			xmms_collection_sample_set_changed (set, id);
+			continue;
+		}
+
+		g_hash_table_remove (set->changed, GINT_TO_POINTER (id));
+		if (xmms_collection_sampler_find (set->ids, id, &pos)) {
+			g_array_remove_index (set->ids, pos);
+		}
+	}
+	g_mutex_unlock (&sampler->mutex);
+}
+
+/* Must be called with the sampler locked */
+static void
+xmms_collection_sampler_trim (xmms_collection_sampler_t *sampler)
+{
+	xmms_collection_sample_set_t *set;
+
+	while (g_queue_get_length (&sampler->lru) > sampler->capacity) {
+		set = g_queue_pop_tail (&sampler->lru);
+		g_hash_table_remove (sampler->sets, set);
+		xmms_collection_sample_set_free (set);
+	}
+}
+
+/**
+ * Create a new sampler, following the changes of a medialib.
+ *
+ * @param capacity The number of collections to keep the ids of
+ */
+xmms_collection_sampler_t *
+xmms_collection_sampler_new (xmms_medialib_t *medialib, guint capacity)
+{
+	xmms_collection_sampler_t *sampler;
+
+	sampler = g_new0 (xmms_collection_sampler_t, 1);
+	g_mutex_init (&sampler->mutex);
+	g_queue_init (&sampler->lru);
+
+	sampler->sets = g_hash_table_new (xmms_collection_sample_set_hash,
+	                                  xmms_collection_sample_set_equal);
+	sampler->capacity = MAX (1, capacity);
+
+	xmms_object_ref (medialib);
+	sampler->medialib = medialib;
+
+	xmms_object_connect (XMMS_OBJECT (medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
+	                     on_medialib_entry_changed, sampler);
+	xmms_object_connect (XMMS_OBJECT (medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_CHANGED,
+	                     on_medialib_entry_changed, sampler);
+	xmms_object_connect (XMMS_OBJECT (medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_REMOVED,
+	                     on_medialib_entry_removed, sampler);
+
+	return sampler;
+}
+
+void
+xmms_collection_sampler_free (xmms_collection_sampler_t *sampler)
+{
+	xmms_collection_sample_set_t *set;
+
+	g_return_if_fail (sampler);
+
+	xmms_object_disconnect (XMMS_OBJECT (sampler->medialib),
+	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
+	                        on_medialib_entry_changed, sampler);
+	xmms_object_disconnect (XMMS_OBJECT (sampler->medialib),
+	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_CHANGED,
+	                        on_medialib_entry_changed, sampler);
+	xmms_object_disconnect (XMMS_OBJECT (sampler->medialib),
+	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_REMOVED,
+	                        on_medialib_entry_removed, sampler);
+
+	while ((set = g_queue_pop_head (&sampler->lru)) != NULL) {
+		xmms_collection_sample_set_free (set);
+	}
+
+	xmms_object_unref (sampler->medialib);
+
+	g_hash_table_destroy (sampler->sets);
+	g_mutex_clear (&sampler->mutex);
+	g_free (sampler);
+}
+
+/**
+ * Pick a random media from a collection. Every matching media is
+ * equally likely to be picked.
+ *
+ * The sampler stays locked while a set is brought up to date, so
+ * that no change to the medialib goes unnoticed.
+ *
+ * @param coll The collection to pick from, with its references bound
+ * @param avoid Media ids to avoid picking unless there are no others,
+ * or NULL
+ * @return A random media from the collection, or 0 if it's empty
+ */
+xmms_medialib_entry_t
+xmms_collection_sampler_pick (xmms_collection_sampler_t *sampler,
+                              xmmsv_t *coll, GHashTable *avoid)
+{
+	xmms_collection_sample_set_t probe, *set;
+	xmms_medialib_entry_t ret = 0;
+	gboolean data_dependent, uncacheable;
+	xmmsv_t *normalized;
+	gint i, left;
+
+	g_return_val_if_fail (sampler, 0);
+	g_return_val_if_fail (coll, 0);
+
+	normalized = xmms_medialib_query_normalize (coll, &data_dependent,
+	                                            &uncacheable);
+
+	memset (&probe, 0, sizeof (probe));
+	if (!xmms_collection_sample_set_key (&probe, normalized)) {
+		xmms_log_error ("Could not serialize collection to sample from.");
+		if (probe.key != NULL)
+			xmmsv_unref (probe.key);
+		xmmsv_unref (normalized);
+		return 0;
+	}
+
+	g_mutex_lock (&sampler->mutex);
+
+	set = g_hash_table_lookup (sampler->sets, &probe);
+	if (set != NULL) {
+		g_queue_unlink (&sampler->lru, set->link);
+		g_queue_push_head_link (&sampler->lru, set->link);
+
+		xmmsv_unref (probe.key);
+		xmmsv_unref (normalized);
+	} else {
+		set = g_new0 (xmms_collection_sample_set_t, 1);
+		set->key = probe.key;
+		set->key_data = probe.key_data;
+		set->key_len = probe.key_len;
+		set->hash = probe.hash;
+		set->coll = normalized;
+		set->data_dependent = data_dependent;
+		set->uncacheable = uncacheable;
+		set->changed = g_hash_table_new (NULL, NULL);
+		set->stale = TRUE;
+
+		g_hash_table_insert (sampler->sets, set, set);
+		g_queue_push_head (&sampler->lru, set);
+		set->link = sampler->lru.head;
+
+		xmms_collection_sampler_trim (sampler);
+	}
+
+	if (set->uncacheable) {
+		set->stale = TRUE;
+	}
+
+	xmms_collection_sample_set_update (sampler, set);
+
+	for (i = 0; set->ids->len > 0 && i < XMMS_COLLECTION_SAMPLER_ATTEMPTS; i++) {
+		ret = g_array_index (set->ids, gint,
+		                     g_random_int_range (0, set->ids->len));
+		if (avoid == NULL || !g_hash_table_contains (avoid, GINT_TO_POINTER (ret))) {
+			break;
+		}
+	}
+
+	/* most of the collection is avoided, pick one of what is left,
+	 * each with the same chance, by reservoir sampling */
+	if (i == XMMS_COLLECTION_SAMPLER_ATTEMPTS) {
+		for (i = 0, left = 0; i < set->ids->len; i++) {
+			gint id = g_array_index (set->ids, gint, i);
+			if (g_hash_table_contains (avoid, GINT_TO_POINTER (id))) {
+				continue;
+			}
+			if (g_random_int_range (0, ++left) == 0) {
+				ret = id;
+			}
+		}
+	}
+
+	g_mutex_unlock (&sampler->mutex);
+
+	return ret;
+}
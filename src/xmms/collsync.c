@@ -18,6 +18,13 @@
 /** @file
  *  Manages the synchronization of collections to the database at 10 seconds
  *  after the last collections-change.
+ *
+ *  The database is a full snapshot of all collections. Changes after that
+ *  are appended to a journal next to it, holding only the collections that
+ *  changed, and the snapshot is rewritten once the journal outgrows it.
+ *  Both files start with a header carrying a format version and the
+ *  generation of the snapshot, so a journal left behind by an older
+ *  snapshot is never replayed.
  */
 
 #include <xmmspriv/xmms_collsync.h>
@@ -28,6 +35,9 @@
 #include <xmms/xmms_log.h>
 
 #include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 
 #include <glib.h>
 #include <glib/gstdio.h>
@@ -35,7 +45,18 @@
 
 #define XMMS_COLL_SYNC_DELAY 10 * G_TIME_SPAN_SECOND
 
+#define XMMS_COLL_SYNC_MAGIC "XMMS2CDB"
+#define XMMS_COLL_SYNC_JOURNAL_MAGIC "XMMS2CJL"
+#define XMMS_COLL_SYNC_VERSION 1
+#define XMMS_COLL_SYNC_HEADER_SIZE 20
+
+/* Don't bother compacting journals smaller than this. */
+#define XMMS_COLL_SYNC_JOURNAL_MIN (256 * 1024)
+
 static void xmms_coll_sync_schedule_sync (xmms_object_t *object, xmmsv_t *val, gpointer udata);
+static void xmms_coll_sync_collection_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata);
+static void xmms_coll_sync_playlist_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata);
+static void xmms_coll_sync_playlist_loaded (xmms_object_t *object, xmmsv_t *val, gpointer udata);
 static gpointer xmms_coll_sync_loop (gpointer udata);
 static void xmms_coll_sync_destroy (xmms_object_t *object);
 
@@ -44,7 +65,7 @@ static void xmms_coll_sync_stop (xmms_coll_sync_t *sync);
 
 static void xmms_coll_sync_client_sync (xmms_coll_sync_t *sync, xmms_error_t *err);
 
-static void xmms_coll_sync_restore (xmms_coll_sync_t *sync, gboolean sad_hack);
+static void xmms_coll_sync_restore (xmms_coll_sync_t *sync);
 
 typedef enum xmms_coll_sync_state_t {
 	XMMS_COLL_SYNC_STATE_IDLE,
@@ -68,6 +89,16 @@ struct xmms_coll_sync_St {
 	GCond cond;
 
 	xmms_coll_sync_state_t state;
+
+	/* Names saved since the last sync, per namespace. */
+	GHashTable *dirty[XMMS_COLLECTION_NUM_NAMESPACES];
+	gboolean dirty_active;
+	gboolean full;
+
+	/* Only touched by the sync thread once it is running. */
+	guint64 generation;
+	gsize base_size;
+	gsize journal_size;
 };
 
 #include "collsync_ipc.c"
@@ -80,11 +111,17 @@ xmms_coll_sync_init (const gchar *uuid, xmms_coll_dag_t *dag, xmms_playlist_t *p
 {
 	xmms_coll_sync_t *sync;
 	gchar *path;
+	gint i;
 
 	sync = xmms_object_new (xmms_coll_sync_t, xmms_coll_sync_destroy);
 
 	sync->uuid = g_strdup (uuid);
 
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; i++) {
+		sync->dirty[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                        g_free, NULL);
+	}
+
 	g_cond_init (&sync->cond);
 	g_mutex_init (&sync->mutex);
 
@@ -102,25 +139,25 @@ xmms_coll_sync_init (const gchar *uuid, xmms_coll_dag_t *dag, xmms_playlist_t *p
 	/* Connection coll_sync_cb to some signals */
 	xmms_object_connect (XMMS_OBJECT (dag),
 	                     XMMS_IPC_SIGNAL_COLLECTION_CHANGED,
-	                     xmms_coll_sync_schedule_sync, sync);
+	                     xmms_coll_sync_collection_changed, sync);
 
 	/* FIXME: These signals should trigger COLLECTION_CHANGED */
 	xmms_object_connect (XMMS_OBJECT (playlist),
 	                     XMMS_IPC_SIGNAL_PLAYLIST_CHANGED,
-	                     xmms_coll_sync_schedule_sync, sync);
+	                     xmms_coll_sync_playlist_changed, sync);
 
 	xmms_object_connect (XMMS_OBJECT (playlist),
 	                     XMMS_IPC_SIGNAL_PLAYLIST_CURRENT_POS,
-	                     xmms_coll_sync_schedule_sync, sync);
+	                     xmms_coll_sync_playlist_changed, sync);
 
 	xmms_object_connect (XMMS_OBJECT (playlist),
 	                     XMMS_IPC_SIGNAL_PLAYLIST_LOADED,
-	                     xmms_coll_sync_schedule_sync, sync);
+	                     xmms_coll_sync_playlist_loaded, sync);
 
 	xmms_coll_sync_register_ipc_commands (XMMS_OBJECT (sync));
 
 	/* First restore synchronously to make sure we are in a sensible state. */
-	xmms_coll_sync_restore (sync, FALSE);
+	xmms_coll_sync_restore (sync);
 
 	xmms_coll_sync_start (sync);
 
@@ -134,6 +171,7 @@ static void
 xmms_coll_sync_destroy (xmms_object_t *object)
 {
 	xmms_coll_sync_t *sync = (xmms_coll_sync_t *) object;
+	gint i;
 
 	g_return_if_fail (sync);
 
@@ -147,25 +185,29 @@ xmms_coll_sync_destroy (xmms_object_t *object)
 
 	xmms_object_disconnect (XMMS_OBJECT (sync->playlist),
 	                        XMMS_IPC_SIGNAL_PLAYLIST_CHANGED,
-	                        xmms_coll_sync_schedule_sync, sync);
+	                        xmms_coll_sync_playlist_changed, sync);
 
 	xmms_object_disconnect (XMMS_OBJECT (sync->playlist),
 	                        XMMS_IPC_SIGNAL_PLAYLIST_CURRENT_POS,
-	                        xmms_coll_sync_schedule_sync, sync);
+	                        xmms_coll_sync_playlist_changed, sync);
 
 	xmms_object_disconnect (XMMS_OBJECT (sync->playlist),
 	                        XMMS_IPC_SIGNAL_PLAYLIST_LOADED,
-	                        xmms_coll_sync_schedule_sync, sync);
+	                        xmms_coll_sync_playlist_loaded, sync);
 
 	xmms_object_disconnect (XMMS_OBJECT (sync->dag),
 	                        XMMS_IPC_SIGNAL_COLLECTION_CHANGED,
-	                        xmms_coll_sync_schedule_sync, sync);
+	                        xmms_coll_sync_collection_changed, sync);
 
 	xmms_coll_sync_stop (sync);
 
 	xmms_object_unref (sync->playlist);
 	xmms_object_unref (sync->dag);
 
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; i++) {
+		g_hash_table_destroy (sync->dirty[i]);
+	}
+
 	g_mutex_clear (&sync->mutex);
 	g_cond_clear (&sync->cond);
 	g_free (sync->uuid);
@@ -194,73 +236,6 @@ xmms_coll_sync_move_to_legacy_path (const gchar *path, GError **error)
 	return TRUE;
 }
 
-/* TODO: Remove me before release */
-static gboolean
-xmms_coll_sync_sorry_to_revert_your_collections (const gchar *path)
-{
-	const gchar *legacy;
-	gchar *directory, *basename;
-	GDir *dir;
-	GError *error = NULL;
-	gboolean success = TRUE;
-
-	basename = g_path_get_basename (path);
-	directory = g_path_get_dirname (path);
-
-	if (!xmms_coll_sync_move_to_legacy_path (path, &error)) {
-		success = FALSE;
-		goto cleanup;
-	}
-
-	dir = g_dir_open (directory, 0, &error);
-	if (dir == NULL) {
-		success = FALSE;
-		goto cleanup;
-	}
-
-	while ((legacy = g_dir_read_name (dir)) != NULL) {
-		gchar *legacy_path;
-		gint res;
-
-		if (!g_str_has_prefix (legacy, basename))
-			continue;
-		if (!g_str_has_suffix (legacy, ".legacy"))
-			continue;
-
-		legacy_path = g_build_filename (directory, legacy, NULL);
-		if (g_file_test (path, G_FILE_TEST_IS_DIR)) {
-			g_free (legacy_path);
-			continue;
-		}
-
-		res = g_rename (legacy_path, path);
-		g_free (legacy_path);
-
-		if (res != 0) {
-			g_set_error (&error, G_FILE_ERROR,
-			             g_file_error_from_errno (errno),
-			             "%s", g_strerror (errno));
-			success = FALSE;
-		}
-		break;
-	}
-
-	g_dir_close (dir);
-
-cleanup:
-	if (success == FALSE) {
-		xmms_log_error ("Could not ressurect collections, sorry...");
-		if (error != NULL) {
-			XMMS_DBG ("%s", error->message);
-		}
-	}
-
-	g_free (basename);
-	g_free (directory);
-
-	return success;
-}
-
 static gboolean
 xmms_coll_sync_prepare_path (const gchar *path, GError **error)
 {
@@ -375,7 +350,7 @@ xmms_coll_sync_stop (xmms_coll_sync_t *sync)
 }
 
 /**
- * Schedule a collection-to-database-synchronization in 10 seconds.
+ * Schedule a full collection-to-database-synchronization in 10 seconds.
  */
 static void
 xmms_coll_sync_schedule_sync (xmms_object_t *object, xmmsv_t *val,
@@ -385,6 +360,96 @@ xmms_coll_sync_schedule_sync (xmms_object_t *object, xmmsv_t *val,
 
 	g_return_if_fail (sync);
 
+	g_mutex_lock (&sync->mutex);
+	sync->full = TRUE;
+	g_mutex_unlock (&sync->mutex);
+
+	xmms_coll_sync_set_state (sync, XMMS_COLL_SYNC_STATE_DELAYED);
+}
+
+/**
+ * Remember that a saved collection changed and schedule a sync of it.
+ */
+static void
+xmms_coll_sync_schedule_name (xmms_coll_sync_t *sync,
+                              xmms_collection_namespace_id_t nsid,
+                              const gchar *name)
+{
+	g_mutex_lock (&sync->mutex);
+
+	if (name == NULL || nsid == XMMS_COLLECTION_NSID_ALL ||
+	    nsid == XMMS_COLLECTION_NSID_INVALID) {
+		sync->full = TRUE;
+	} else {
+		g_hash_table_replace (sync->dirty[nsid], g_strdup (name), NULL);
+	}
+
+	g_mutex_unlock (&sync->mutex);
+
+	xmms_coll_sync_set_state (sync, XMMS_COLL_SYNC_STATE_DELAYED);
+}
+
+static void
+xmms_coll_sync_collection_changed (xmms_object_t *object, xmmsv_t *val,
+                                   gpointer udata)
+{
+	xmms_coll_sync_t *sync = (xmms_coll_sync_t *) udata;
+	const gchar *name = NULL, *namespace = NULL;
+	xmms_collection_namespace_id_t nsid = XMMS_COLLECTION_NSID_INVALID;
+	gint type = -1;
+
+	g_return_if_fail (sync);
+
+	xmmsv_dict_entry_get_int (val, "type", &type);
+	xmmsv_dict_entry_get_string (val, "name", &name);
+	if (xmmsv_dict_entry_get_string (val, "namespace", &namespace)) {
+		nsid = xmms_collection_get_namespace_id (namespace);
+	}
+
+	/* Renames and removals may rewrite references in other collections. */
+	if (type != XMMS_COLLECTION_CHANGED_ADD &&
+	    type != XMMS_COLLECTION_CHANGED_UPDATE) {
+		name = NULL;
+	}
+
+	xmms_coll_sync_schedule_name (sync, nsid, name);
+}
+
+static void
+xmms_coll_sync_playlist_changed (xmms_object_t *object, xmmsv_t *val,
+                                 gpointer udata)
+{
+	xmms_coll_sync_t *sync = (xmms_coll_sync_t *) udata;
+	const gchar *name = NULL;
+
+	g_return_if_fail (sync);
+
+	xmmsv_dict_entry_get_string (val, "name", &name);
+
+	xmms_coll_sync_schedule_name (sync, XMMS_COLLECTION_NSID_PLAYLISTS, name);
+}
+
+static void
+xmms_coll_sync_playlist_loaded (xmms_object_t *object, xmmsv_t *val,
+                                gpointer udata)
+{
+	xmms_coll_sync_t *sync = (xmms_coll_sync_t *) udata;
+
+	g_return_if_fail (sync);
+
+	g_mutex_lock (&sync->mutex);
+
+	/* Changes to the previously active playlist have only been recorded
+	 * as changes to the active one, which is no longer the same. */
+	if (g_hash_table_lookup_extended (sync->dirty[XMMS_COLLECTION_NSID_PLAYLISTS],
+	                                  XMMS_ACTIVE_PLAYLIST, NULL, NULL)) {
+		sync->full = TRUE;
+	}
+
+	sync->dirty_active = TRUE;
+
+	g_mutex_unlock (&sync->mutex);
+
 	xmms_coll_sync_set_state (sync, XMMS_COLL_SYNC_STATE_DELAYED);
 }
 
@@ -399,32 +464,224 @@ xmms_coll_sync_client_sync (xmms_coll_sync_t *sync, xmms_error_t *err)
 	xmms_coll_sync_set_state (sync, XMMS_COLL_SYNC_STATE_IMMEDIATE);
 }
 
+static gchar *
+xmms_coll_sync_get_journal_path (const gchar *path)
+{
+	return g_strconcat (path, ".journal", NULL);
+}
+
+static void
+xmms_coll_sync_header_fill (guchar *header, const gchar *magic,
+                            guint64 generation)
+{
+	guint32 version = GUINT32_TO_BE (XMMS_COLL_SYNC_VERSION);
+
+	generation = GUINT64_TO_BE (generation);
+
+	memcpy (header, magic, 8);
+	memcpy (header + 8, &version, 4);
+	memcpy (header + 12, &generation, 8);
+}
+
+/**
+ * Check for a header with the given magic.
+ *
+ * @return TRUE if found, with version and generation filled in.
+ */
+static gboolean
+xmms_coll_sync_header_parse (const gchar *buffer, gsize length,
+                             const gchar *magic, guint32 *version,
+                             guint64 *generation)
+{
+	if (length < XMMS_COLL_SYNC_HEADER_SIZE || memcmp (buffer, magic, 8) != 0) {
+		return FALSE;
+	}
+
+	memcpy (version, buffer + 8, 4);
+	*version = GUINT32_FROM_BE (*version);
+
+	memcpy (generation, buffer + 12, 8);
+	*generation = GUINT64_FROM_BE (*generation);
+
+	return TRUE;
+}
+
+/**
+ * Write a full snapshot and start over with an empty journal.
+ */
+static gboolean
+xmms_coll_sync_save_full (xmms_coll_sync_t *sync, const gchar *path,
+                          GError **error)
+{
+	xmmsv_t *snapshot, *serialized;
+	const guchar *buffer;
+	gchar *data, *journal;
+	guint length;
+	gsize size;
+	gboolean ret;
+
+	snapshot = xmms_collection_snapshot (sync->dag);
+
+	serialized = xmmsv_serialize (snapshot);
+	xmmsv_unref (snapshot);
+
+	xmmsv_get_bin (serialized, &buffer, &length);
+
+	size = XMMS_COLL_SYNC_HEADER_SIZE + length;
+	data = g_malloc (size);
+	xmms_coll_sync_header_fill ((guchar *) data, XMMS_COLL_SYNC_MAGIC,
+	                            sync->generation + 1);
+	memcpy (data + XMMS_COLL_SYNC_HEADER_SIZE, buffer, length);
+
+	xmmsv_unref (serialized);
+
+	ret = g_file_set_contents (path, data, (gssize) size, error);
+	g_free (data);
+
+	if (!ret) {
+		xmms_log_error ("Could not save collections to disk.");
+		return FALSE;
+	}
+
+	sync->generation++;
+	sync->base_size = size;
+	sync->journal_size = 0;
+
+	/* The journal belongs to the previous generation, so even if this
+	 * fails it will not be replayed. */
+	journal = xmms_coll_sync_get_journal_path (path);
+	g_unlink (journal);
+	g_free (journal);
+
+	return TRUE;
+}
+
+/**
+ * Append the collections that changed to the journal.
+ */
+static gboolean
+xmms_coll_sync_save_journal (xmms_coll_sync_t *sync, const gchar *path,
+                             GHashTable **dirty, GError **error)
+{
+	GList *collections, *playlists;
+	xmmsv_t *snapshot, *serialized;
+	guchar header[XMMS_COLL_SYNC_HEADER_SIZE];
+	const guchar *buffer;
+	gchar *journal;
+	guint32 record;
+	guint length;
+	gsize written;
+	FILE *fp;
+	gboolean ret = FALSE;
+
+	collections = g_hash_table_get_keys (dirty[XMMS_COLLECTION_NSID_COLLECTIONS]);
+	playlists = g_hash_table_get_keys (dirty[XMMS_COLLECTION_NSID_PLAYLISTS]);
+
+	snapshot = xmms_collection_snapshot_partial (sync->dag, collections, playlists);
+
+	g_list_free (collections);
+	g_list_free (playlists);
+
+	serialized = xmmsv_serialize (snapshot);
+	xmmsv_unref (snapshot);
+
+	xmmsv_get_bin (serialized, &buffer, &length);
+
+	journal = xmms_coll_sync_get_journal_path (path);
+
+	fp = g_fopen (journal, sync->journal_size ? "ab" : "wb");
+	if (fp == NULL) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+		             "%s", g_strerror (errno));
+		goto out;
+	}
+
+	written = 0;
+
+	if (sync->journal_size == 0) {
+		xmms_coll_sync_header_fill (header, XMMS_COLL_SYNC_JOURNAL_MAGIC,
+		                            sync->generation);
+		written += fwrite (header, 1, sizeof (header), fp);
+	}
+
+	record = GUINT32_TO_BE (length);
+	written += fwrite (&record, 1, sizeof (record), fp);
+	written += fwrite (buffer, 1, length, fp);
+
+	if (fflush (fp) != 0 || fsync (fileno (fp)) != 0 ||
+	    written != (sync->journal_size ? 0 : sizeof (header)) + sizeof (record) + length) {
+		g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errno),
+		             "%s", g_strerror (errno));
+		fclose (fp);
+		goto out;
+	}
+
+	fclose (fp);
+
+	sync->journal_size += written;
+	ret = TRUE;
+
+out:
+	xmmsv_unref (serialized);
+	g_free (journal);
+
+	return ret;
+}
+
 static void
 xmms_coll_sync_save (xmms_coll_sync_t *sync)
 {
+	GHashTable *dirty[XMMS_COLLECTION_NUM_NAMESPACES];
+	gboolean full, changed, saved = FALSE;
 	GError *error = NULL;
+	gchar *path;
+	gint i;
 
-	gchar *path = xmms_coll_sync_get_path (sync);
+	g_mutex_lock (&sync->mutex);
 
-	XMMS_DBG ("Syncing collections to '%s'.", path);
+	changed = sync->dirty_active;
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; i++) {
+		dirty[i] = sync->dirty[i];
+		sync->dirty[i] = g_hash_table_new_full (g_str_hash, g_str_equal,
+		                                        g_free, NULL);
+		changed |= g_hash_table_size (dirty[i]) > 0;
+	}
 
-	if (xmms_coll_sync_prepare_path (path, &error)) {
-		xmmsv_t *snapshot, *serialized;
-		const guchar *buffer;
-		guint length;
+	full = sync->full || sync->base_size == 0;
 
-		snapshot = xmms_collection_snapshot (sync->dag);
+	sync->full = FALSE;
+	sync->dirty_active = FALSE;
 
-		serialized = xmmsv_serialize (snapshot);
-		xmmsv_unref (snapshot);
+	g_mutex_unlock (&sync->mutex);
+
+	if (!full && !changed) {
+		goto out;
+	}
 
-		xmmsv_get_bin (serialized, &buffer, &length);
+	path = xmms_coll_sync_get_path (sync);
 
-		if (!g_file_set_contents (path, (const gchar *) buffer, (gssize) length, &error)) {
-			xmms_log_error ("Could not save collections to disk.");
+	if (xmms_coll_sync_prepare_path (path, &error)) {
+		if (!full) {
+			XMMS_DBG ("Journaling collection changes to '%s'.", path);
+
+			saved = xmms_coll_sync_save_journal (sync, path, dirty, &error);
+			if (!saved) {
+				xmms_log_error ("Could not journal collection changes, saving everything.");
+				full = TRUE;
+			} else if (sync->journal_size > MAX (sync->base_size, XMMS_COLL_SYNC_JOURNAL_MIN)) {
+				full = TRUE;
+			}
+
+			if (error != NULL) {
+				XMMS_DBG ("%s", error->message);
+				g_clear_error (&error);
+			}
 		}
 
-		xmmsv_unref (serialized);
+		if (full) {
+			XMMS_DBG ("Syncing collections to '%s'.", path);
+			saved = xmms_coll_sync_save_full (sync, path, &error) || saved;
+		}
 	}
 
 	if (error != NULL) {
@@ -432,11 +689,193 @@ xmms_coll_sync_save (xmms_coll_sync_t *sync)
 		g_error_free (error);
 	}
 
+	/* Which changes got lost is unknown, write everything next time. */
+	if (!saved) {
+		g_mutex_lock (&sync->mutex);
+		sync->full = TRUE;
+		g_mutex_unlock (&sync->mutex);
+	}
+
 	g_free (path);
+
+out:
+	for (i = 0; i < XMMS_COLLECTION_NUM_NAMESPACES; i++) {
+		g_hash_table_destroy (dirty[i]);
+	}
 }
 
 static void
-xmms_coll_sync_restore (xmms_coll_sync_t *sync, gboolean sad_hack)
+xmms_coll_sync_replay_namespace (const gchar *key, xmmsv_t *snapshot,
+                                 xmmsv_t *record)
+{
+	xmmsv_dict_iter_t *it;
+	xmmsv_t *changes, *target, *value;
+	const gchar *name;
+
+	if (!xmmsv_dict_get (record, key, &changes) ||
+	    !xmmsv_is_type (changes, XMMSV_TYPE_DICT)) {
+		return;
+	}
+
+	if (!xmmsv_dict_get (snapshot, key, &target) ||
+	    !xmmsv_is_type (target, XMMSV_TYPE_DICT)) {
+		target = xmmsv_new_dict ();
+		xmmsv_dict_set (snapshot, key, target);
+		xmmsv_unref (target);
+	}
+
+	xmmsv_get_dict_iter (changes, &it);
+	while (xmmsv_dict_iter_pair (it, &name, &value)) {
+		if (xmmsv_is_type (value, XMMSV_TYPE_NONE)) {
+			xmmsv_dict_remove (target, name);
+		} else {
+			xmmsv_dict_set (target, name, value);
+		}
+		xmmsv_dict_iter_next (it);
+	}
+	xmmsv_dict_iter_explicit_destroy (it);
+}
+
+/**
+ * Apply one journal record on top of a snapshot.
+ */
+static void
+xmms_coll_sync_replay (xmmsv_t *snapshot, xmmsv_t *record)
+{
+	xmmsv_t *value;
+
+	xmms_coll_sync_replay_namespace ("collections", snapshot, record);
+	xmms_coll_sync_replay_namespace ("playlists", snapshot, record);
+
+	if (xmmsv_dict_get (record, "active-playlist", &value) &&
+	    xmmsv_is_type (value, XMMSV_TYPE_STRING)) {
+		xmmsv_dict_set (snapshot, "active-playlist", value);
+	}
+}
+
+/**
+ * Parse the snapshot in the database file.
+ *
+ * @return The snapshot, or NULL if the file could not be understood.
+ */
+static xmmsv_t *
+xmms_coll_sync_restore_base (xmms_coll_sync_t *sync, const gchar *path,
+                             const gchar *buffer, gsize length)
+{
+	xmmsv_t *serialized, *snapshot = NULL;
+	guint64 generation = 0;
+	guint32 version;
+
+	if (xmms_coll_sync_header_parse (buffer, length, XMMS_COLL_SYNC_MAGIC,
+	                                 &version, &generation)) {
+		if (version == XMMS_COLL_SYNC_VERSION) {
+			serialized = xmmsv_new_bin ((const guchar *) buffer + XMMS_COLL_SYNC_HEADER_SIZE,
+			                            (guint) (length - XMMS_COLL_SYNC_HEADER_SIZE));
+			snapshot = xmmsv_deserialize (serialized);
+			xmmsv_unref (serialized);
+		} else {
+			xmms_log_error ("Collections in '%s' use unknown format version %u.",
+			                path, version);
+		}
+	} else {
+		/* Written before the database had a header, the next sync
+		 * converts it. */
+		serialized = xmmsv_new_bin ((const guchar *) buffer, (guint) length);
+		snapshot = xmmsv_deserialize (serialized);
+		xmmsv_unref (serialized);
+
+		sync->full = TRUE;
+	}
+
+	if (snapshot == NULL) {
+		xmms_log_error ("Could not read collections, moving '%s' aside.", path);
+		xmms_coll_sync_move_to_legacy_path (path, NULL);
+		sync->full = TRUE;
+		return NULL;
+	}
+
+	sync->generation = generation;
+	sync->base_size = length;
+
+	return snapshot;
+}
+
+/**
+ * Replay the journal belonging to the restored snapshot, if any.
+ */
+static void
+xmms_coll_sync_restore_journal (xmms_coll_sync_t *sync, const gchar *path,
+                                xmmsv_t *snapshot)
+{
+	gchar *journal, *buffer;
+	guint64 generation;
+	guint32 version, record;
+	gsize length, offset;
+	gint count = 0;
+
+	journal = xmms_coll_sync_get_journal_path (path);
+
+	if (!g_file_get_contents (journal, &buffer, &length, NULL)) {
+		g_free (journal);
+		return;
+	}
+
+	if (!xmms_coll_sync_header_parse (buffer, length, XMMS_COLL_SYNC_JOURNAL_MAGIC,
+	                                  &version, &generation) ||
+	    version != XMMS_COLL_SYNC_VERSION || generation != sync->generation) {
+		XMMS_DBG ("Ignoring stale collection journal '%s'.", journal);
+		g_free (buffer);
+		g_free (journal);
+		return;
+	}
+
+	offset = XMMS_COLL_SYNC_HEADER_SIZE;
+
+	while (length - offset >= sizeof (record)) {
+		xmmsv_t *serialized, *changes;
+
+		memcpy (&record, buffer + offset, sizeof (record));
+		record = GUINT32_FROM_BE (record);
+
+		if (record > length - offset - sizeof (record)) {
+			break;
+		}
+
+		serialized = xmmsv_new_bin ((const guchar *) buffer + offset + sizeof (record),
+		                            record);
+		changes = xmmsv_deserialize (serialized);
+		xmmsv_unref (serialized);
+
+		if (changes == NULL) {
+			break;
+		}
+
+		if (xmmsv_is_type (changes, XMMSV_TYPE_DICT)) {
+			xmms_coll_sync_replay (snapshot, changes);
+		}
+		xmmsv_unref (changes);
+
+		offset += sizeof (record) + record;
+		count++;
+	}
+
+	XMMS_DBG ("Replayed %d collection journal records.", count);
+
+	/* Anything after a torn write is lost, start over on next sync. */
+	if (offset != length) {
+		xmms_log_error ("Collection journal '%s' is damaged, ignoring the tail.",
+		                journal);
+		sync->full = TRUE;
+	}
+
+	sync->journal_size = offset;
+
+	g_free (buffer);
+	g_free (journal);
+}
+
+static void
+xmms_coll_sync_restore (xmms_coll_sync_t *sync)
 {
 	xmmsv_t *snapshot = NULL;
 	GError *error = NULL;
@@ -449,27 +888,11 @@ xmms_coll_sync_restore (xmms_coll_sync_t *sync, gboolean sad_hack)
 
 	if (xmms_coll_sync_prepare_path (path, &error)) {
 		if (g_file_get_contents (path, &buffer, &length, &error)) {
-			xmmsv_t *serialized;
-
-			serialized = xmmsv_new_bin ((const guchar *) buffer, (guint) length);
+			snapshot = xmms_coll_sync_restore_base (sync, path, buffer, length);
 			g_free (buffer);
 
-			snapshot = xmmsv_deserialize (serialized);
-			xmmsv_unref (serialized);
-
-			/* TODO: Remove me, nasty hack because the new serialization
-			 * got merged a bit too early and now is not the time to add
-			 * versioning, should be removed before release.
-			 *
-			 * Move the collection database to deprecated path, and re-run
-			 * the migration from the first new version..
-			 *
-			 * sorry for the lost changes folks <3
-			 */
-			if (snapshot == NULL && sad_hack != TRUE) {
-				xmms_coll_sync_sorry_to_revert_your_collections (path);
-				xmms_coll_sync_restore (sync, TRUE);
-				return;
+			if (snapshot != NULL) {
+				xmms_coll_sync_restore_journal (sync, path, snapshot);
 			}
 		}
 	}
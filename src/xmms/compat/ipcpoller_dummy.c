@@ -0,0 +1,67 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+
+/** @file
+ *  Dummy IPC poller, used on platforms without epoll. The IPC server
+ *  falls back to one thread per client when no poller can be created.
+ */
+
+#include <glib.h>
+
+#include <xmmspriv/xmms_ipc_poller.h>
+
+xmms_ipc_poller_t *
+xmms_ipc_poller_new (void)
+{
+	return NULL;
+}
+
+void
+xmms_ipc_poller_free (xmms_ipc_poller_t *poller)
+{
+}
+
+gboolean
+xmms_ipc_poller_add (xmms_ipc_poller_t *poller, gint fd, guint flags,
+                     gpointer data)
+{
+	return FALSE;
+}
+
+gboolean
+xmms_ipc_poller_modify (xmms_ipc_poller_t *poller, gint fd, guint flags,
+                        gpointer data)
+{
+	return FALSE;
+}
+
+void
+xmms_ipc_poller_remove (xmms_ipc_poller_t *poller, gint fd)
+{
+}
+
+gint
+xmms_ipc_poller_wait (xmms_ipc_poller_t *poller,
+                      xmms_ipc_poller_event_t *events, gint max_events)
+{
+	return -1;
+}
+
+void
+xmms_ipc_poller_wakeup (xmms_ipc_poller_t *poller)
+{
+}
@@ -0,0 +1,222 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+
+/** @file
+ *  epoll based IPC poller.
+ *
+ *  Each poller owns an epoll instance and an eventfd that is used to
+ *  interrupt a blocking wait from other threads. Wakeups are swallowed
+ *  by xmms_ipc_poller_wait and never reported as events.
+ */
+
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <glib.h>
+
+#include <xmms/xmms_log.h>
+#include <xmmspriv/xmms_ipc_poller.h>
+
+#define XMMS_IPC_POLLER_MAX_EVENTS 64
+
+struct xmms_ipc_poller_St {
+	gint epfd;
+	gint wakefd;
+};
+
+static guint32
+xmms_ipc_poller_to_epoll (guint flags)
+{
+	guint32 events = 0;
+
+	if (flags & XMMS_IPC_POLLER_IN)
+		events |= EPOLLIN;
+	if (flags & XMMS_IPC_POLLER_OUT)
+		events |= EPOLLOUT;
+
+	return events;
+}
+
+static guint
+xmms_ipc_poller_from_epoll (guint32 events)
+{
+	guint flags = 0;
+
+	if (events & EPOLLIN)
+		flags |= XMMS_IPC_POLLER_IN;
+	if (events & EPOLLOUT)
+		flags |= XMMS_IPC_POLLER_OUT;
+	if (events & EPOLLERR)
+		flags |= XMMS_IPC_POLLER_ERR;
+	if (events & (EPOLLHUP | EPOLLRDHUP))
+		flags |= XMMS_IPC_POLLER_HUP;
+
+	return flags;
+}
+
+xmms_ipc_poller_t *
+xmms_ipc_poller_new (void)
+{
+	xmms_ipc_poller_t *poller;
+	struct epoll_event ev = { 0 };
+
+	poller = g_new0 (xmms_ipc_poller_t, 1);
+
+	poller->epfd = epoll_create1 (EPOLL_CLOEXEC);
+	if (poller->epfd < 0) {
+		xmms_log_error ("Could not create epoll instance: %s", g_strerror (errno));
+		g_free (poller);
+		return NULL;
+	}
+
+	poller->wakefd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (poller->wakefd < 0) {
+		xmms_log_error ("Could not create eventfd: %s", g_strerror (errno));
+		close (poller->epfd);
+		g_free (poller);
+		return NULL;
+	}
+
+	/* data.ptr == NULL marks the wakeup descriptor */
+	ev.events = EPOLLIN;
+	ev.data.ptr = NULL;
+	if (epoll_ctl (poller->epfd, EPOLL_CTL_ADD, poller->wakefd, &ev) < 0) {
+		xmms_log_error ("Could not watch eventfd: %s", g_strerror (errno));
+		xmms_ipc_poller_free (poller);
+		return NULL;
+	}
+
+	return poller;
+}
+
+void
+xmms_ipc_poller_free (xmms_ipc_poller_t *poller)
+{
+	g_return_if_fail (poller);
+
+	close (poller->wakefd);
+	close (poller->epfd);
+	g_free (poller);
+}
+
+gboolean
+xmms_ipc_poller_add (xmms_ipc_poller_t *poller, gint fd, guint flags,
+                     gpointer data)
+{
+	struct epoll_event ev = { 0 };
+
+	g_return_val_if_fail (poller, FALSE);
+	g_return_val_if_fail (data, FALSE);
+
+	ev.events = xmms_ipc_poller_to_epoll (flags) | EPOLLRDHUP;
+	ev.data.ptr = data;
+
+	if (epoll_ctl (poller->epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+		xmms_log_error ("epoll_ctl(ADD) failed: %s", g_strerror (errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+gboolean
+xmms_ipc_poller_modify (xmms_ipc_poller_t *poller, gint fd, guint flags,
+                        gpointer data)
+{
+	struct epoll_event ev = { 0 };
+
+	g_return_val_if_fail (poller, FALSE);
+	g_return_val_if_fail (data, FALSE);
+
+	ev.events = xmms_ipc_poller_to_epoll (flags) | EPOLLRDHUP;
+	ev.data.ptr = data;
+
+	if (epoll_ctl (poller->epfd, EPOLL_CTL_MOD, fd, &ev) < 0) {
+		xmms_log_error ("epoll_ctl(MOD) failed: %s", g_strerror (errno));
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void
+xmms_ipc_poller_remove (xmms_ipc_poller_t *poller, gint fd)
+{
+	struct epoll_event ev = { 0 };
+
+	g_return_if_fail (poller);
+
+	/* Kernels before 2.6.9 require a non-NULL event for DEL */
+	epoll_ctl (poller->epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+/**
+ * Block until at least one descriptor is ready or the poller is woken
+ * up. Returns the number of events stored in events, which may be zero
+ * after a wakeup, or -1 on error.
+ */
+gint
+xmms_ipc_poller_wait (xmms_ipc_poller_t *poller,
+                      xmms_ipc_poller_event_t *events, gint max_events)
+{
+	struct epoll_event evs[XMMS_IPC_POLLER_MAX_EVENTS];
+	gint i, n, ret = 0;
+
+	g_return_val_if_fail (poller, -1);
+
+	max_events = MIN (max_events, XMMS_IPC_POLLER_MAX_EVENTS);
+
+	do {
+		n = epoll_wait (poller->epfd, evs, max_events, -1);
+	} while (n < 0 && errno == EINTR);
+
+	if (n < 0) {
+		xmms_log_error ("epoll_wait failed: %s", g_strerror (errno));
+		return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		if (evs[i].data.ptr == NULL) {
+			uint64_t count;
+			while (read (poller->wakefd, &count, sizeof (count)) > 0);
+			continue;
+		}
+		events[ret].data = evs[i].data.ptr;
+		events[ret].flags = xmms_ipc_poller_from_epoll (evs[i].events);
+		ret++;
+	}
+
+	return ret;
+}
+
+/**
+ * Interrupt a concurrent or the next xmms_ipc_poller_wait call.
+ * Several wakeups before the waiter runs collapse into one.
+ */
+void
+xmms_ipc_poller_wakeup (xmms_ipc_poller_t *poller)
+{
+	uint64_t one = 1;
+
+	g_return_if_fail (poller);
+
+	if (write (poller->wakefd, &one, sizeof (one)) < 0 && errno != EAGAIN) {
+		xmms_log_error ("Could not wake up IPC poller: %s", g_strerror (errno));
+	}
+}
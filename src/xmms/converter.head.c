@@ -18,6 +18,7 @@
 #include <glib.h>
 #include <math.h>
 #include <xmmspriv/xmms_converter.h>
+#include <xmmspriv/xmms_resampler.h>
 #include <xmms/xmms_medialib.h>
 #include <xmms/xmms_object.h>
 #include <xmms/xmms_log.h>
@@ -54,6 +55,14 @@ struct xmms_sample_converter_St {
 
 	xmms_sample_conv_func_t func;
 
+	/* polyphase resampling, converts to float first and back after */
+	xmms_resampler_t *resampler;
+	xmms_sample_conv_func_t to_float;
+	xmms_sample_conv_func_t from_float;
+	guint fbufsiz;
+	gfloat *fbuf;
+	guint rbufsiz;
+	gfloat *rbuf;
 };
 
 static void recalculate_resampler (xmms_sample_converter_t *conv, guint from, guint to);
@@ -71,14 +80,33 @@ xmms_sample_converter_destroy (xmms_object_t *obj)
 
 	g_free (conv->buf);
 	g_free (conv->state);
+	g_free (conv->fbuf);
+	g_free (conv->rbuf);
+
+	if (conv->resampler) {
+		xmms_resampler_free (conv->resampler);
+	}
 }
 
 xmms_sample_converter_t *
 xmms_sample_converter_init (xmms_stream_type_t *from, xmms_stream_type_t *to)
+{
+	return xmms_sample_converter_init_full (from, to,
+	                                        XMMS_RESAMPLER_QUALITY_MEDIUM);
+}
+
+/**
+ * Create a converter, resampling with the given quality if the
+ * samplerates differ.
+ */
+xmms_sample_converter_t *
+xmms_sample_converter_init_full (xmms_stream_type_t *from, xmms_stream_type_t *to,
+                                 xmms_resampler_quality_t quality)
 {
 	xmms_sample_converter_t *conv = xmms_object_new (xmms_sample_converter_t, xmms_sample_converter_destroy);
 	gint fformat, fsamplerate, fchannels;
 	gint tformat, tsamplerate, tchannels;
+	xmms_sample_conv_func_t func;
 
 	fformat = xmms_stream_type_get_int (from, XMMS_STREAM_TYPE_FMT_FORMAT);
 	fsamplerate = xmms_stream_type_get_int (from, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
@@ -100,6 +128,14 @@ xmms_sample_converter_init (xmms_stream_type_t *from, xmms_stream_type_t *to)
 	                                   tchannels, tformat,
 	                                   conv->resample);
 
+	/* prefer the vectorized version when there is one */
+	if (!conv->resample) {
+		func = xmms_sample_conv_simd_get (fchannels, fformat, tchannels, tformat);
+		if (func) {
+			conv->func = func;
+		}
+	}
+
 	if (!conv->func) {
 		xmms_object_unref (conv);
 		xmms_log_error ("Unable to convert from %s/%d/%d to %s/%d/%d.",
@@ -111,6 +147,30 @@ xmms_sample_converter_init (xmms_stream_type_t *from, xmms_stream_type_t *to)
 	if (conv->resample)
 		recalculate_resampler (conv, fsamplerate, tsamplerate);
 
+	if (conv->resample && quality != XMMS_RESAMPLER_QUALITY_LINEAR) {
+		conv->resampler = xmms_resampler_new (tchannels, fsamplerate,
+		                                      tsamplerate, quality);
+	}
+
+	/* fall back to the linear resampler if the ratio is too odd */
+	if (conv->resampler) {
+		conv->to_float = xmms_sample_conv_simd_get (fchannels, fformat,
+		                                            tchannels, XMMS_SAMPLE_FORMAT_FLOAT);
+		if (!conv->to_float) {
+			conv->to_float = xmms_sample_conv_get (fchannels, fformat,
+			                                       tchannels, XMMS_SAMPLE_FORMAT_FLOAT,
+			                                       FALSE);
+		}
+
+		conv->from_float = xmms_sample_conv_simd_get (tchannels, XMMS_SAMPLE_FORMAT_FLOAT,
+		                                              tchannels, tformat);
+		if (!conv->from_float) {
+			conv->from_float = xmms_sample_conv_get (tchannels, XMMS_SAMPLE_FORMAT_FLOAT,
+			                                         tchannels, tformat,
+			                                         FALSE);
+		}
+	}
+
 	return conv;
 }
 
@@ -208,6 +268,41 @@ recalculate_resampler (xmms_sample_converter_t *conv, guint from, guint to)
 }
 
 
+static void *
+ensure_size (void *buf, guint *bufsiz, guint size)
+{
+	if (size > *bufsiz) {
+		buf = g_realloc (buf, size);
+		*bufsiz = size;
+	}
+	return buf;
+}
+
+static guint
+resample_polyphase (xmms_sample_converter_t *conv, xmms_sample_t *in, guint len, xmms_sample_t *out)
+{
+	guint channels, frames, i;
+
+	channels = xmms_stream_type_get_int (conv->to, XMMS_STREAM_TYPE_FMT_CHANNELS);
+
+	conv->fbuf = ensure_size (conv->fbuf, &conv->fbufsiz,
+	                          len * channels * sizeof (gfloat));
+	conv->to_float (conv, in, len, conv->fbuf);
+
+	frames = xmms_resampler_max_output (conv->resampler, len);
+	conv->rbuf = ensure_size (conv->rbuf, &conv->rbufsiz,
+	                          frames * channels * sizeof (gfloat));
+	frames = xmms_resampler_process (conv->resampler, conv->fbuf, len, conv->rbuf);
+
+	/* the filter overshoots on loud input, and the float reader
+	 * wraps around outside [-1.0, 1.0) */
+	for (i = 0; i < frames * channels; i++) {
+		conv->rbuf[i] = CLAMP (conv->rbuf[i], -1.0f, 0.99999994f);
+	}
+
+	return conv->from_float (conv, conv->rbuf, frames, out);
+}
+
 /**
  * do the actual converstion between two audio formats.
  */
@@ -232,7 +327,9 @@ xmms_sample_convert (xmms_sample_converter_t *conv, xmms_sample_t *in, guint len
 
 	outusiz = xmms_sample_frame_size_get (conv->to);
 
-	if (conv->resample) {
+	if (conv->resampler) {
+		olen = xmms_resampler_max_output (conv->resampler, len) * outusiz;
+	} else if (conv->resample) {
 		olen = (len * conv->interpolator_ratio / conv->decimator_ratio) * outusiz + outusiz;
 	} else {
 		olen = len * outusiz;
@@ -245,7 +342,11 @@ xmms_sample_convert (xmms_sample_converter_t *conv, xmms_sample_t *in, guint len
 		conv->bufsiz = olen;
 	}
 
-	res = conv->func (conv, in, len, conv->buf);
+	if (conv->resampler) {
+		res = resample_polyphase (conv, in, len, conv->buf);
+	} else {
+		res = conv->func (conv, in, len, conv->buf);
+	}
 
 	*outlen = res * outusiz;
 	*out = conv->buf;
@@ -279,6 +380,10 @@ xmms_sample_convert_reset (xmms_sample_converter_t *conv)
 		conv->offset = 0;
 		memset (conv->state, 0, xmms_sample_frame_size_get (conv->from));
 	}
+
+	if (conv->resampler) {
+		xmms_resampler_reset (conv->resampler);
+	}
 }
 
 /**
@@ -40,6 +40,8 @@ xmms_converter_plugin_init (xmms_xform_t *xform)
 	xmms_stream_type_t *intype;
 	xmms_stream_type_t *to;
 	const GList *goal_hints;
+	xmms_config_property_t *cfg;
+	xmms_resampler_quality_t quality;
 
 	intype = xmms_xform_intype_get (xform);
 	goal_hints = xmms_xform_goal_hints_get (xform);
@@ -49,7 +51,10 @@ xmms_converter_plugin_init (xmms_xform_t *xform)
 		return FALSE;
 	}
 
-	conv = xmms_sample_converter_init (intype, to);
+	cfg = xmms_xform_config_lookup (xform, "resample_quality");
+	quality = xmms_resampler_quality_from_string (xmms_config_property_get_string (cfg));
+
+	conv = xmms_sample_converter_init_full (intype, to, quality);
 	if (!conv) {
 		return FALSE;
 	}
@@ -145,6 +150,12 @@ xmms_converter_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
+	/* linear, low, medium or high */
+	xmms_xform_plugin_config_property_register (xform_plugin,
+	                                            "resample_quality",
+	                                            "medium",
+	                                            NULL, NULL);
+
 	/*
 	 * Handle any pcm data...
 	 * Well, we don't really..
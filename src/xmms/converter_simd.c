@@ -0,0 +1,495 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include <glib.h>
+#include <math.h>
+
+#include <xmmspriv/xmms_converter.h>
+#include <xmms/xmms_log.h>
+
+/**
+  * @defgroup SampleSIMD Vectorized sample conversion
+  * @ingroup Sample
+  * @brief SSE2/SSE4.1/AVX2 versions of the common generated converters.
+  *
+  * The generated converters read every sample into an unsigned 32 bit
+  * intermediate. Here the same intermediate is kept as a signed value,
+  * which makes it a plain left aligned s32: s16 is shifted up 16 bits
+  * and float is scaled by 2^31 and rounded down. Writing it back is the
+  * exact reverse, so the result is bit for bit the same as the
+  * generated code for every float in [-1.0, 1.0). Floats outside of
+  * that range, where the generated code wraps around, are clipped.
+  *
+  * Only s16, s32 and float with mono/stereo up and down mixing are
+  * handled, everything else falls back to the generated code.
+  * @{
+  */
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+#define S32_SCALE 2147483648.0f
+/* largest float below 2^31 */
+#define S32_MAX 2147483520.0f
+
+typedef enum {
+	LAYOUT_MONO,
+	LAYOUT_STEREO,
+	LAYOUT_UPMIX,
+	LAYOUT_DOWNMIX,
+	LAYOUT_COUNT
+} layout_t;
+
+/* scalar versions, for the tail of every buffer */
+static inline gint32
+scalar_load_s16 (const gint16 *p)
+{
+	return (gint32) ((guint32) *p << 16);
+}
+
+static inline gint32
+scalar_load_s32 (const gint32 *p)
+{
+	return *p;
+}
+
+static inline gint32
+scalar_load_float (const gfloat *p)
+{
+	gfloat v = *p * S32_SCALE;
+	return (gint32) floorf (CLAMP (v, -S32_SCALE, S32_MAX));
+}
+
+static inline void
+scalar_store_s16 (gint16 *p, gint32 v)
+{
+	*p = v >> 16;
+}
+
+static inline void
+scalar_store_s32 (gint32 *p, gint32 v)
+{
+	*p = v;
+}
+
+static inline void
+scalar_store_float (gfloat *p, gint32 v)
+{
+	*p = (gfloat) v * (1.0f / S32_SCALE);
+}
+
+static inline gint32
+scalar_avg (gint32 a, gint32 b)
+{
+	return (a >> 1) + (b >> 1) + (a & b & 1);
+}
+
+/* SSE2, 4 samples per vector */
+#define ATTR_sse2 __attribute__ ((target ("sse2")))
+#define WIDTH_sse2 4
+typedef __m128i vec_sse2;
+
+ATTR_sse2 static inline __m128i
+sse2_load_s16 (const gint16 *p)
+{
+	__m128i x = _mm_loadl_epi64 ((const __m128i *) p);
+	return _mm_unpacklo_epi16 (_mm_setzero_si128 (), x);
+}
+
+ATTR_sse2 static inline __m128i
+sse2_load_s32 (const gint32 *p)
+{
+	return _mm_loadu_si128 ((const __m128i *) p);
+}
+
+ATTR_sse2 static inline __m128i
+sse2_load_float (const gfloat *p)
+{
+	__m128 v, mask;
+	__m128i t;
+
+	v = _mm_mul_ps (_mm_loadu_ps (p), _mm_set1_ps (S32_SCALE));
+	v = _mm_min_ps (v, _mm_set1_ps (S32_MAX));
+	v = _mm_max_ps (v, _mm_set1_ps (-S32_SCALE));
+
+	/* truncate, then step down where that rounded a negative up */
+	t = _mm_cvttps_epi32 (v);
+	mask = _mm_cmpgt_ps (_mm_cvtepi32_ps (t), v);
+
+	return _mm_add_epi32 (t, _mm_castps_si128 (mask));
+}
+
+ATTR_sse2 static inline void
+sse2_store_s16 (gint16 *p, __m128i v)
+{
+	v = _mm_srai_epi32 (v, 16);
+	_mm_storel_epi64 ((__m128i *) p, _mm_packs_epi32 (v, v));
+}
+
+ATTR_sse2 static inline void
+sse2_store_s32 (gint32 *p, __m128i v)
+{
+	_mm_storeu_si128 ((__m128i *) p, v);
+}
+
+ATTR_sse2 static inline void
+sse2_store_float (gfloat *p, __m128i v)
+{
+	_mm_storeu_ps (p, _mm_mul_ps (_mm_cvtepi32_ps (v),
+	                              _mm_set1_ps (1.0f / S32_SCALE)));
+}
+
+ATTR_sse2 static inline __m128i
+sse2_avg (__m128i a, __m128i b)
+{
+	__m128i odd = _mm_and_si128 (_mm_and_si128 (a, b), _mm_set1_epi32 (1));
+	return _mm_add_epi32 (_mm_add_epi32 (_mm_srai_epi32 (a, 1),
+	                                     _mm_srai_epi32 (b, 1)), odd);
+}
+
+/* split two vectors of interleaved frames into left and right */
+ATTR_sse2 static inline void
+sse2_split (__m128i a, __m128i b, __m128i *l, __m128i *r)
+{
+	__m128 fa = _mm_castsi128_ps (a), fb = _mm_castsi128_ps (b);
+	*l = _mm_castps_si128 (_mm_shuffle_ps (fa, fb, _MM_SHUFFLE (2, 0, 2, 0)));
+	*r = _mm_castps_si128 (_mm_shuffle_ps (fa, fb, _MM_SHUFFLE (3, 1, 3, 1)));
+}
+
+/* duplicate every sample of a vector into two vectors of frames */
+ATTR_sse2 static inline void
+sse2_dup (__m128i v, __m128i *lo, __m128i *hi)
+{
+	*lo = _mm_unpacklo_epi32 (v, v);
+	*hi = _mm_unpackhi_epi32 (v, v);
+}
+
+/* SSE4.1, only rounding float differs from SSE2 */
+#define ATTR_sse41 __attribute__ ((target ("sse4.1")))
+#define WIDTH_sse41 4
+typedef __m128i vec_sse41;
+
+#define sse41_load_s16 sse2_load_s16
+#define sse41_load_s32 sse2_load_s32
+#define sse41_store_s16 sse2_store_s16
+#define sse41_store_s32 sse2_store_s32
+#define sse41_store_float sse2_store_float
+#define sse41_avg sse2_avg
+#define sse41_split sse2_split
+#define sse41_dup sse2_dup
+
+ATTR_sse41 static inline __m128i
+sse41_load_float (const gfloat *p)
+{
+	__m128 v;
+
+	v = _mm_mul_ps (_mm_loadu_ps (p), _mm_set1_ps (S32_SCALE));
+	v = _mm_min_ps (v, _mm_set1_ps (S32_MAX));
+	v = _mm_max_ps (v, _mm_set1_ps (-S32_SCALE));
+
+	return _mm_cvttps_epi32 (_mm_floor_ps (v));
+}
+
+/* AVX2, 8 samples per vector */
+#define ATTR_avx2 __attribute__ ((target ("avx2")))
+#define WIDTH_avx2 8
+typedef __m256i vec_avx2;
+
+ATTR_avx2 static inline __m256i
+avx2_load_s16 (const gint16 *p)
+{
+	__m128i x = _mm_loadu_si128 ((const __m128i *) p);
+	return _mm256_slli_epi32 (_mm256_cvtepi16_epi32 (x), 16);
+}
+
+ATTR_avx2 static inline __m256i
+avx2_load_s32 (const gint32 *p)
+{
+	return _mm256_loadu_si256 ((const __m256i *) p);
+}
+
+ATTR_avx2 static inline __m256i
+avx2_load_float (const gfloat *p)
+{
+	__m256 v;
+
+	v = _mm256_mul_ps (_mm256_loadu_ps (p), _mm256_set1_ps (S32_SCALE));
+	v = _mm256_min_ps (v, _mm256_set1_ps (S32_MAX));
+	v = _mm256_max_ps (v, _mm256_set1_ps (-S32_SCALE));
+
+	return _mm256_cvttps_epi32 (_mm256_floor_ps (v));
+}
+
+ATTR_avx2 static inline void
+avx2_store_s16 (gint16 *p, __m256i v)
+{
+	v = _mm256_srai_epi32 (v, 16);
+	_mm_storeu_si128 ((__m128i *) p,
+	                  _mm_packs_epi32 (_mm256_castsi256_si128 (v),
+	                                   _mm256_extracti128_si256 (v, 1)));
+}
+
+ATTR_avx2 static inline void
+avx2_store_s32 (gint32 *p, __m256i v)
+{
+	_mm256_storeu_si256 ((__m256i *) p, v);
+}
+
+ATTR_avx2 static inline void
+avx2_store_float (gfloat *p, __m256i v)
+{
+	_mm256_storeu_ps (p, _mm256_mul_ps (_mm256_cvtepi32_ps (v),
+	                                    _mm256_set1_ps (1.0f / S32_SCALE)));
+}
+
+ATTR_avx2 static inline __m256i
+avx2_avg (__m256i a, __m256i b)
+{
+	__m256i odd = _mm256_and_si256 (_mm256_and_si256 (a, b), _mm256_set1_epi32 (1));
+	return _mm256_add_epi32 (_mm256_add_epi32 (_mm256_srai_epi32 (a, 1),
+	                                           _mm256_srai_epi32 (b, 1)), odd);
+}
+
+ATTR_avx2 static inline void
+avx2_split (__m256i a, __m256i b, __m256i *l, __m256i *r)
+{
+	const __m256i idx = _mm256_setr_epi32 (0, 2, 4, 6, 1, 3, 5, 7);
+
+	a = _mm256_permutevar8x32_epi32 (a, idx);
+	b = _mm256_permutevar8x32_epi32 (b, idx);
+	*l = _mm256_permute2x128_si256 (a, b, 0x20);
+	*r = _mm256_permute2x128_si256 (a, b, 0x31);
+}
+
+ATTR_avx2 static inline void
+avx2_dup (__m256i v, __m256i *lo, __m256i *hi)
+{
+	__m256i a = _mm256_unpacklo_epi32 (v, v);
+	__m256i b = _mm256_unpackhi_epi32 (v, v);
+
+	*lo = _mm256_permute2x128_si256 (a, b, 0x20);
+	*hi = _mm256_permute2x128_si256 (a, b, 0x31);
+}
+
+#define KERNEL_NAME(isa, layout, ifmt, ofmt) isa##_##layout##_##ifmt##_to_##ofmt
+
+#define KERNEL_FLAT(isa, layout, ch, ifmt, itype, ofmt, otype) \
+ATTR_##isa static guint \
+KERNEL_NAME (isa, layout, ifmt, ofmt) (xmms_sample_converter_t *conv, \
+                                       xmms_sample_t *tin, guint len, \
+                                       xmms_sample_t *tout) \
+{ \
+	const itype *in = (const itype *) tin; \
+	otype *out = (otype *) tout; \
+	guint i, n = len * ch; \
+	for (i = 0; i + WIDTH_##isa <= n; i += WIDTH_##isa) { \
+		isa##_store_##ofmt (out + i, isa##_load_##ifmt (in + i)); \
+	} \
+	for (; i < n; i++) { \
+		scalar_store_##ofmt (out + i, scalar_load_##ifmt (in + i)); \
+	} \
+	return len; \
+}
+
+#define KERNEL_UPMIX(isa, layout, ch, ifmt, itype, ofmt, otype) \
+ATTR_##isa static guint \
+KERNEL_NAME (isa, layout, ifmt, ofmt) (xmms_sample_converter_t *conv, \
+                                       xmms_sample_t *tin, guint len, \
+                                       xmms_sample_t *tout) \
+{ \
+	const itype *in = (const itype *) tin; \
+	otype *out = (otype *) tout; \
+	vec_##isa lo, hi; \
+	gint32 v; \
+	guint i; \
+	for (i = 0; i + WIDTH_##isa <= len; i += WIDTH_##isa) { \
+		isa##_dup (isa##_load_##ifmt (in + i), &lo, &hi); \
+		isa##_store_##ofmt (out + 2 * i, lo); \
+		isa##_store_##ofmt (out + 2 * i + WIDTH_##isa, hi); \
+	} \
+	for (; i < len; i++) { \
+		v = scalar_load_##ifmt (in + i); \
+		scalar_store_##ofmt (out + 2 * i, v); \
+		scalar_store_##ofmt (out + 2 * i + 1, v); \
+	} \
+	return len; \
+}
+
+#define KERNEL_DOWNMIX(isa, layout, ch, ifmt, itype, ofmt, otype) \
+ATTR_##isa static guint \
+KERNEL_NAME (isa, layout, ifmt, ofmt) (xmms_sample_converter_t *conv, \
+                                       xmms_sample_t *tin, guint len, \
+                                       xmms_sample_t *tout) \
+{ \
+	const itype *in = (const itype *) tin; \
+	otype *out = (otype *) tout; \
+	vec_##isa l, r; \
+	guint i; \
+	for (i = 0; i + WIDTH_##isa <= len; i += WIDTH_##isa) { \
+		isa##_split (isa##_load_##ifmt (in + 2 * i), \
+		             isa##_load_##ifmt (in + 2 * i + WIDTH_##isa), &l, &r); \
+		isa##_store_##ofmt (out + i, isa##_avg (l, r)); \
+	} \
+	for (; i < len; i++) { \
+		scalar_store_##ofmt (out + i, \
+		                     scalar_avg (scalar_load_##ifmt (in + 2 * i), \
+		                                 scalar_load_##ifmt (in + 2 * i + 1))); \
+	} \
+	return len; \
+}
+
+#define FOR_EACH_FORMAT(K, isa, layout, ch) \
+	K (isa, layout, ch, s16, gint16, s16, gint16) \
+	K (isa, layout, ch, s16, gint16, s32, gint32) \
+	K (isa, layout, ch, s16, gint16, float, gfloat) \
+	K (isa, layout, ch, s32, gint32, s16, gint16) \
+	K (isa, layout, ch, s32, gint32, s32, gint32) \
+	K (isa, layout, ch, s32, gint32, float, gfloat) \
+	K (isa, layout, ch, float, gfloat, s16, gint16) \
+	K (isa, layout, ch, float, gfloat, s32, gint32) \
+	K (isa, layout, ch, float, gfloat, float, gfloat)
+
+#define KERNELS(isa) \
+	FOR_EACH_FORMAT (KERNEL_FLAT, isa, mono, 1) \
+	FOR_EACH_FORMAT (KERNEL_FLAT, isa, stereo, 2) \
+	FOR_EACH_FORMAT (KERNEL_UPMIX, isa, upmix, 1) \
+	FOR_EACH_FORMAT (KERNEL_DOWNMIX, isa, downmix, 2)
+
+KERNELS (sse2)
+KERNELS (sse41)
+KERNELS (avx2)
+
+#define TABLE_FORMATS(isa, layout) { \
+	{ KERNEL_NAME (isa, layout, s16, s16), \
+	  KERNEL_NAME (isa, layout, s16, s32), \
+	  KERNEL_NAME (isa, layout, s16, float) }, \
+	{ KERNEL_NAME (isa, layout, s32, s16), \
+	  KERNEL_NAME (isa, layout, s32, s32), \
+	  KERNEL_NAME (isa, layout, s32, float) }, \
+	{ KERNEL_NAME (isa, layout, float, s16), \
+	  KERNEL_NAME (isa, layout, float, s32), \
+	  KERNEL_NAME (isa, layout, float, float) } }
+
+#define TABLE(isa) { \
+	TABLE_FORMATS (isa, mono), \
+	TABLE_FORMATS (isa, stereo), \
+	TABLE_FORMATS (isa, upmix), \
+	TABLE_FORMATS (isa, downmix) }
+
+typedef xmms_sample_conv_func_t kernel_table_t[LAYOUT_COUNT][3][3];
+
+static const kernel_table_t kernels_sse2 = TABLE (sse2);
+static const kernel_table_t kernels_sse41 = TABLE (sse41);
+static const kernel_table_t kernels_avx2 = TABLE (avx2);
+
+static gint
+format_index (xmms_sample_format_t format)
+{
+	switch (format) {
+		case XMMS_SAMPLE_FORMAT_S16:
+			return 0;
+		case XMMS_SAMPLE_FORMAT_S32:
+			return 1;
+		case XMMS_SAMPLE_FORMAT_FLOAT:
+			return 2;
+		default:
+			return -1;
+	}
+}
+
+static const kernel_table_t *
+kernel_table_get (void)
+{
+	static gsize isa = 0;
+
+	if (g_once_init_enter (&isa)) {
+		gsize found = 1;
+
+		__builtin_cpu_init ();
+
+		if (__builtin_cpu_supports ("avx2")) {
+			XMMS_DBG ("Using AVX2 sample converters");
+			found = 4;
+		} else if (__builtin_cpu_supports ("sse4.1")) {
+			XMMS_DBG ("Using SSE4.1 sample converters");
+			found = 3;
+		} else if (__builtin_cpu_supports ("sse2")) {
+			XMMS_DBG ("Using SSE2 sample converters");
+			found = 2;
+		}
+
+		g_once_init_leave (&isa, found);
+	}
+
+	switch (isa) {
+		case 4:
+			return &kernels_avx2;
+		case 3:
+			return &kernels_sse41;
+		case 2:
+			return &kernels_sse2;
+		default:
+			return NULL;
+	}
+}
+
+xmms_sample_conv_func_t
+xmms_sample_conv_simd_get (guint inchannels, xmms_sample_format_t intype,
+                           guint outchannels, xmms_sample_format_t outtype)
+{
+	const kernel_table_t *table;
+	gint in, out;
+	layout_t layout;
+
+	in = format_index (intype);
+	out = format_index (outtype);
+	if (in < 0 || out < 0) {
+		return NULL;
+	}
+
+	if (inchannels == 1 && outchannels == 1) {
+		layout = LAYOUT_MONO;
+	} else if (inchannels == 2 && outchannels == 2) {
+		layout = LAYOUT_STEREO;
+	} else if (inchannels == 1 && outchannels == 2) {
+		layout = LAYOUT_UPMIX;
+	} else if (inchannels == 2 && outchannels == 1) {
+		layout = LAYOUT_DOWNMIX;
+	} else {
+		return NULL;
+	}
+
+	table = kernel_table_get ();
+	if (!table) {
+		return NULL;
+	}
+
+	return (*table)[layout][in][out];
+}
+
+#else
+
+xmms_sample_conv_func_t
+xmms_sample_conv_simd_get (guint inchannels, xmms_sample_format_t intype,
+                           guint outchannels, xmms_sample_format_t outtype)
+{
+	return NULL;
+}
+
+#endif
+
+/** @} */
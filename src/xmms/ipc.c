@@ -20,6 +20,7 @@
 #include <xmms/xmms_log.h>
 #include <xmms/xmms_config.h>
 #include <xmmspriv/xmms_ipc.h>
+#include <xmmspriv/xmms_ipc_poller.h>
 #include <xmmsc/xmmsc_ipc_msg.h>
 
 
@@ -61,13 +62,56 @@ struct xmms_ipc_St {
 };
 
 
+/**
+ * The number of messages a client may have processed per wakeup.
+ * Both the poller and the GIOChannel watches are level triggered, so
+ * whatever is left is picked up on the next round, after the other
+ * clients of the same worker got their turn.
+ */
+#define XMMS_IPC_CLIENT_READ_BUDGET 16
+
+/**
+ * An event loop thread multiplexing a set of clients.
+ *
+ * Commands run inline on the worker, so a command that blocks, such as
+ * browsing a slow remote location or a heavy medialib query, delays
+ * every other client served by the same worker until it returns. The
+ * read budget only keeps a client that sends many commands from
+ * starving the others. tests/client/bench_ipc_fanout can measure the
+ * effect with a client issuing slow commands.
+ */
+typedef struct xmms_ipc_worker_St {
+	GThread *thread;
+	xmms_ipc_poller_t *poller;
+
+	/* this lock protects incoming, dirty, clients, num_clients
+	   and running */
+	GMutex lock;
+
+	/** Accepted clients not yet watched by the poller */
+	GQueue incoming;
+
+	/** Clients with queued output, flushed once per wakeup */
+	GQueue dirty;
+
+	GList *clients;
+	guint num_clients;
+	gboolean running;
+} xmms_ipc_worker_t;
+
 /**
  * A IPC client representation.
  */
 typedef struct xmms_ipc_client_St {
+	/* only used by clients running in their own thread */
 	GMainLoop *ml;
 	GIOChannel *iochan;
 
+	/* only used by clients running on a worker */
+	xmms_ipc_worker_t *worker;
+	gboolean scheduled;
+	gboolean polling_out;
+
 	xmms_ipc_transport_t *transport;
 	xmms_ipc_msg_t *read_msg;
 	xmms_ipc_t *ipc;
@@ -97,6 +141,13 @@ static xmms_ipc_manager_t *ipc_manager = NULL;
 static GMutex ipc_object_pool_lock;
 static struct xmms_ipc_object_pool_t *ipc_object_pool = NULL;
 
+/* the message whose command is running on this thread */
+static GPrivate ipc_current_msg;
+
+/* NULL when every client gets its own thread */
+static xmms_ipc_worker_t *ipc_workers = NULL;
+static guint ipc_num_workers = 0;
+
 static void xmms_ipc_close (void);
 static void xmms_ipc_client_destroy (xmms_ipc_client_t *client);
 
@@ -117,6 +168,22 @@ xmms_ipc_handle_cmd_value (xmms_ipc_msg_t *msg, xmmsv_t *val)
 	}
 }
 
+/**
+ * Create the template for a signal or broadcast. The value is only
+ * serialized once, the messages queued for each client are made with
+ * xmms_ipc_msg_copy_shared and differ in the cookie alone.
+ */
+static xmms_ipc_msg_t *
+xmms_ipc_shared_msg_new (uint32_t cmd, xmmsv_t *val)
+{
+	xmms_ipc_msg_t *msg;
+
+	msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, cmd);
+	xmms_ipc_handle_cmd_value (msg, val);
+
+	return msg;
+}
+
 static void
 xmms_ipc_register_signal (xmms_ipc_client_t *client,
                           xmms_ipc_msg_t *msg, xmmsv_t *arguments)
@@ -236,7 +303,10 @@ process_msg (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 	arg.client = client->id;
 	arg.cookie = xmms_ipc_msg_get_cookie (msg);
 
+	g_private_set (&ipc_current_msg, msg);
 	xmms_object_cmd_call (object, cmdid, &arg);
+	g_private_set (&ipc_current_msg, NULL);
+
 	if (xmms_error_isok (&arg.error)) {
 		if (!arg.retval) {
 			/* Skip reply if method is a noreply and didn't fail */
@@ -272,6 +342,27 @@ out:
 }
 
 
+/**
+ * Take a file descriptor the client passed along with the command that
+ * is being run. Only valid while inside a command handler, and only
+ * clients on a unix socket can pass descriptors. The caller owns the
+ * descriptor, the ones not taken are closed after the command.
+ *
+ * @returns the next descriptor, or -1 if there are no more
+ */
+gint
+xmms_ipc_passed_fd_take (void)
+{
+	xmms_ipc_msg_t *msg;
+
+	msg = g_private_get (&ipc_current_msg);
+	if (!msg) {
+		return -1;
+	}
+
+	return xmms_ipc_msg_take_fd (msg);
+}
+
 static gboolean
 xmms_ipc_client_read_cb (GIOChannel *iochan,
                          GIOCondition cond,
@@ -279,11 +370,12 @@ xmms_ipc_client_read_cb (GIOChannel *iochan,
 {
 	xmms_ipc_client_t *client = data;
 	bool disconnect = FALSE;
+	gint budget = XMMS_IPC_CLIENT_READ_BUDGET;
 
 	g_return_val_if_fail (client, FALSE);
 
 	if (cond & G_IO_IN) {
-		while (TRUE) {
+		while (budget > 0) {
 			if (!client->read_msg) {
 				client->read_msg = xmms_ipc_msg_alloc ();
 			}
@@ -293,10 +385,16 @@ xmms_ipc_client_read_cb (GIOChannel *iochan,
 				client->read_msg = NULL;
 				process_msg (client, msg);
 				xmms_ipc_msg_destroy (msg);
+				budget--;
 			} else {
 				break;
 			}
 		}
+
+		/* out of budget, a hangup is handled once the rest is read */
+		if (!budget && !disconnect) {
+			return TRUE;
+		}
 	}
 
 	if (disconnect || (cond & G_IO_HUP)) {
@@ -305,13 +403,17 @@ xmms_ipc_client_read_cb (GIOChannel *iochan,
 			client->read_msg = NULL;
 		}
 		XMMS_DBG ("disconnect was true!");
-		g_main_loop_quit (client->ml);
+		if (client->ml) {
+			g_main_loop_quit (client->ml);
+		}
 		return FALSE;
 	}
 
 	if (cond & G_IO_ERR) {
 		xmms_log_error ("Client got error, maybe connection died?");
-		g_main_loop_quit (client->ml);
+		if (client->ml) {
+			g_main_loop_quit (client->ml);
+		}
 		return FALSE;
 	}
 
@@ -324,23 +426,42 @@ xmms_ipc_client_write_cb (GIOChannel *iochan,
                           gpointer data)
 {
 	xmms_ipc_client_t *client = data;
+	xmms_ipc_msg_t *msgs[XMMS_IPC_TRANSPORT_MAX_IOV];
 	bool disconnect = FALSE;
+	gboolean done;
+	GList *l;
+	gint i, n, written;
 
 	g_return_val_if_fail (client, FALSE);
 
 	while (TRUE) {
-		xmms_ipc_msg_t *msg;
-
+		/* only this thread pops messages, the ones peeked at stay
+		 * valid while others are queued behind them */
 		g_mutex_lock (&client->lock);
-		msg = g_queue_peek_head (client->out_msg);
+		n = 0;
+		for (l = client->out_msg->head; l && n < G_N_ELEMENTS (msgs); l = l->next) {
+			msgs[n++] = l->data;
+		}
 		g_mutex_unlock (&client->lock);
 
-		if (!msg)
+		if (!n)
 			break;
 
-		if (!xmms_ipc_msg_write_transport (msg,
-		                                   client->transport,
-		                                   &disconnect)) {
+		done = xmms_ipc_msg_write_transport_many (msgs, n,
+		                                          client->transport,
+		                                          &written, &disconnect);
+
+		g_mutex_lock (&client->lock);
+		for (i = 0; i < written; i++) {
+			g_queue_pop_head (client->out_msg);
+		}
+		g_mutex_unlock (&client->lock);
+
+		for (i = 0; i < written; i++) {
+			xmms_ipc_msg_destroy (msgs[i]);
+		}
+
+		if (!done) {
 			if (disconnect) {
 				break;
 			} else {
@@ -348,12 +469,6 @@ xmms_ipc_client_write_cb (GIOChannel *iochan,
 				return TRUE;
 			}
 		}
-
-		g_mutex_lock (&client->lock);
-		g_queue_pop_head (client->out_msg);
-		g_mutex_unlock (&client->lock);
-
-		xmms_ipc_msg_destroy (msg);
 	}
 
 	return FALSE;
@@ -388,8 +503,282 @@ xmms_ipc_client_thread (gpointer data)
 	return NULL;
 }
 
+/**
+ * Write as much of the client's queued output as the socket accepts,
+ * and only ask the poller for writability while something is left.
+ */
+static void
+xmms_ipc_worker_flush (xmms_ipc_worker_t *worker, xmms_ipc_client_t *client)
+{
+	gboolean pending;
+	guint flags;
+
+	pending = xmms_ipc_client_write_cb (client->iochan, G_IO_OUT, client);
+	if (pending == client->polling_out) {
+		return;
+	}
+
+	flags = XMMS_IPC_POLLER_IN;
+	if (pending) {
+		flags |= XMMS_IPC_POLLER_OUT;
+	}
+
+	if (xmms_ipc_poller_modify (worker->poller,
+	                            xmms_ipc_transport_fd_get (client->transport),
+	                            flags, client)) {
+		client->polling_out = pending;
+	}
+}
+
+static void
+xmms_ipc_worker_drop (xmms_ipc_worker_t *worker, xmms_ipc_client_t *client)
+{
+	xmms_ipc_poller_remove (worker->poller,
+	                        xmms_ipc_transport_fd_get (client->transport));
+
+	xmms_object_emit (XMMS_OBJECT (ipc_manager),
+	                  XMMS_IPC_SIGNAL_IPC_MANAGER_CLIENT_DISCONNECTED,
+	                  xmmsv_new_int(client->id));
+
+	xmms_ipc_client_destroy (client);
+}
+
+/**
+ * Start watching a freshly accepted client, from the worker thread so
+ * that a client is only ever destroyed by the thread serving it.
+ */
+static void
+xmms_ipc_worker_attach (xmms_ipc_worker_t *worker, xmms_ipc_client_t *client)
+{
+	xmms_object_emit (XMMS_OBJECT (ipc_manager),
+	                  XMMS_IPC_SIGNAL_IPC_MANAGER_CLIENT_CONNECTED,
+	                  xmmsv_new_int(client->id));
+
+	if (!xmms_ipc_poller_add (worker->poller,
+	                          xmms_ipc_transport_fd_get (client->transport),
+	                          XMMS_IPC_POLLER_IN, client)) {
+		xmms_log_error ("Could not watch client %d, dropping it.", client->id);
+		xmms_ipc_worker_drop (worker, client);
+	}
+}
+
+static gpointer
+xmms_ipc_worker_thread (gpointer data)
+{
+	xmms_ipc_worker_t *worker = data;
+	xmms_ipc_poller_event_t events[64];
+	xmms_ipc_client_t *client;
+	GQueue pending;
+	GList *l;
+	gboolean running = TRUE;
+	gint i, n;
+
+	while (running) {
+		n = xmms_ipc_poller_wait (worker->poller, events, G_N_ELEMENTS (events));
+
+		for (i = 0; i < n; i++) {
+			GIOCondition cond = 0;
+
+			client = events[i].data;
+
+			if (events[i].flags & XMMS_IPC_POLLER_IN)
+				cond |= G_IO_IN;
+			if (events[i].flags & XMMS_IPC_POLLER_HUP)
+				cond |= G_IO_HUP;
+			if (events[i].flags & XMMS_IPC_POLLER_ERR)
+				cond |= G_IO_ERR;
+
+			if (cond && !xmms_ipc_client_read_cb (client->iochan, cond, client)) {
+				xmms_ipc_worker_drop (worker, client);
+				continue;
+			}
+
+			if (events[i].flags & XMMS_IPC_POLLER_OUT) {
+				xmms_ipc_worker_flush (worker, client);
+			}
+		}
+
+		g_mutex_lock (&worker->lock);
+		while ((client = g_queue_pop_head (&worker->incoming))) {
+			g_mutex_unlock (&worker->lock);
+			xmms_ipc_worker_attach (worker, client);
+			g_mutex_lock (&worker->lock);
+		}
+
+		/* Take every client that got output since the last round,
+		 * no matter how many messages were queued for it. */
+		pending = worker->dirty;
+		g_queue_init (&worker->dirty);
+		for (l = pending.head; l; l = g_list_next (l)) {
+			client = l->data;
+			client->scheduled = FALSE;
+		}
+		running = worker->running;
+		g_mutex_unlock (&worker->lock);
+
+		while ((client = g_queue_pop_head (&pending))) {
+			xmms_ipc_worker_flush (worker, client);
+		}
+
+		if (n < 0) {
+			xmms_log_error ("IPC worker lost its poller, dropping clients.");
+			running = FALSE;
+		}
+	}
+
+	g_mutex_lock (&worker->lock);
+	while (worker->clients) {
+		client = worker->clients->data;
+		g_mutex_unlock (&worker->lock);
+		xmms_ipc_worker_drop (worker, client);
+		g_mutex_lock (&worker->lock);
+	}
+	g_mutex_unlock (&worker->lock);
+
+	return NULL;
+}
+
+/**
+ * Queue a client on its worker for the next output flush. Every client
+ * is only queued once, and the worker is only woken up when its queue
+ * goes from empty to non-empty, so a broadcast to many clients costs a
+ * single wakeup per worker.
+ * Should hold client->lock.
+ */
+static void
+xmms_ipc_worker_schedule (xmms_ipc_worker_t *worker, xmms_ipc_client_t *client)
+{
+	gboolean wakeup = FALSE;
+
+	g_mutex_lock (&worker->lock);
+	if (!client->scheduled) {
+		client->scheduled = TRUE;
+		wakeup = g_queue_is_empty (&worker->dirty);
+		g_queue_push_tail (&worker->dirty, client);
+	}
+	g_mutex_unlock (&worker->lock);
+
+	if (wakeup) {
+		xmms_ipc_poller_wakeup (worker->poller);
+	}
+}
+
+/**
+ * Pick the worker currently serving the fewest clients.
+ */
+static xmms_ipc_worker_t *
+xmms_ipc_worker_pick (void)
+{
+	xmms_ipc_worker_t *best = NULL;
+	guint i, best_clients = G_MAXUINT;
+
+	for (i = 0; i < ipc_num_workers; i++) {
+		xmms_ipc_worker_t *worker = &ipc_workers[i];
+		guint num_clients;
+
+		g_mutex_lock (&worker->lock);
+		num_clients = worker->running ? worker->num_clients : G_MAXUINT;
+		g_mutex_unlock (&worker->lock);
+
+		if (num_clients < best_clients) {
+			best = worker;
+			best_clients = num_clients;
+		}
+	}
+
+	return best;
+}
+
+/**
+ * Hand an accepted client over to a worker.
+ */
+static void
+xmms_ipc_worker_add (xmms_ipc_worker_t *worker, xmms_ipc_client_t *client)
+{
+	g_mutex_lock (&worker->lock);
+	worker->clients = g_list_prepend (worker->clients, client);
+	worker->num_clients++;
+	g_queue_push_tail (&worker->incoming, client);
+	g_mutex_unlock (&worker->lock);
+
+	xmms_ipc_poller_wakeup (worker->poller);
+}
+
+/**
+ * Start the event loop workers if "core.ipc_workers" asks for them.
+ * With 0 workers, or if the platform lacks a poller, every client is
+ * served by its own thread.
+ */
+static void
+xmms_ipc_workers_start (void)
+{
+	xmms_config_property_t *cv;
+	xmms_ipc_poller_t *poller;
+	gint i, num;
+
+	/* see xmms_ipc_worker_t on why blocking commands hurt here */
+	cv = xmms_config_property_register ("core.ipc_workers", "0", NULL, NULL);
+	num = CLAMP (xmms_config_property_get_int (cv), 0, 64);
+	if (num == 0) {
+		return;
+	}
+
+	ipc_workers = g_new0 (xmms_ipc_worker_t, num);
+
+	for (i = 0; i < num; i++) {
+		xmms_ipc_worker_t *worker = &ipc_workers[ipc_num_workers];
+
+		poller = xmms_ipc_poller_new ();
+		if (!poller) {
+			break;
+		}
+
+		worker->poller = poller;
+		worker->running = TRUE;
+		g_mutex_init (&worker->lock);
+		g_queue_init (&worker->incoming);
+		g_queue_init (&worker->dirty);
+		worker->thread = g_thread_new ("x2 ipc worker", xmms_ipc_worker_thread, worker);
+		ipc_num_workers++;
+	}
+
+	if (ipc_num_workers == 0) {
+		xmms_log_info ("No IPC poller available, using one thread per client.");
+		g_free (ipc_workers);
+		ipc_workers = NULL;
+		return;
+	}
+
+	XMMS_DBG ("Serving IPC clients from %d worker threads.", ipc_num_workers);
+}
+
+static void
+xmms_ipc_workers_stop (void)
+{
+	guint i;
+
+	for (i = 0; i < ipc_num_workers; i++) {
+		xmms_ipc_worker_t *worker = &ipc_workers[i];
+
+		g_mutex_lock (&worker->lock);
+		worker->running = FALSE;
+		g_mutex_unlock (&worker->lock);
+
+		xmms_ipc_poller_wakeup (worker->poller);
+		g_thread_join (worker->thread);
+
+		xmms_ipc_poller_free (worker->poller);
+		g_mutex_clear (&worker->lock);
+	}
+
+	g_free (ipc_workers);
+	ipc_workers = NULL;
+	ipc_num_workers = 0;
+}
+
 static xmms_ipc_client_t *
-xmms_ipc_client_new (xmms_ipc_t *ipc, xmms_ipc_transport_t *transport)
+xmms_ipc_client_new (xmms_ipc_t *ipc, xmms_ipc_transport_t *transport,
+                     xmms_ipc_worker_t *worker)
 {
 	xmms_ipc_client_t *client;
 	GMainContext *context;
@@ -399,9 +788,13 @@ xmms_ipc_client_new (xmms_ipc_t *ipc, xmms_ipc_transport_t *transport)
 
 	client = g_new0 (xmms_ipc_client_t, 1);
 
-	context = g_main_context_new ();
-	client->ml = g_main_loop_new (context, FALSE);
-	g_main_context_unref (context);
+	if (worker) {
+		client->worker = worker;
+	} else {
+		context = g_main_context_new ();
+		client->ml = g_main_loop_new (context, FALSE);
+		g_main_context_unref (context);
+	}
 
 	fd = xmms_ipc_transport_fd_get (transport);
 	client->iochan = g_io_channel_unix_new (fd);
@@ -435,7 +828,20 @@ xmms_ipc_client_destroy (xmms_ipc_client_t *client)
 		g_mutex_unlock (&client->ipc->mutex_lock);
 	}
 
-	g_main_loop_unref (client->ml);
+	/* Nobody can find the client anymore, so it won't be queued
+	 * on the worker again. */
+	if (client->worker) {
+		g_mutex_lock (&client->worker->lock);
+		g_queue_remove (&client->worker->incoming, client);
+		g_queue_remove (&client->worker->dirty, client);
+		client->worker->clients = g_list_remove (client->worker->clients, client);
+		client->worker->num_clients--;
+		g_mutex_unlock (&client->worker->lock);
+	}
+
+	if (client->ml) {
+		g_main_loop_unref (client->ml);
+	}
 	g_io_channel_unref (client->iochan);
 
 	xmms_ipc_transport_destroy (client->transport);
@@ -571,8 +977,10 @@ xmms_ipc_client_msg_write (xmms_ipc_client_t *client, xmms_ipc_msg_t *msg)
 	queue_empty = g_queue_is_empty (client->out_msg);
 	g_queue_push_tail (client->out_msg, msg);
 
-	/* If there's no write in progress, add a new callback */
-	if (queue_empty) {
+	if (queue_empty && client->worker) {
+		xmms_ipc_worker_schedule (client->worker, client);
+	} else if (queue_empty) {
+		/* If there's no write in progress, add a new callback */
 		GMainContext *context = g_main_loop_get_context (client->ml);
 		GSource *source = g_io_create_watch (client->iochan, G_IO_OUT);
 
@@ -598,18 +1006,27 @@ xmms_ipc_client_broadcast_write (guint broadcastid, xmms_ipc_client_t *cli,
                                  xmmsv_t *arg)
 {
 	GList *l;
-	xmms_ipc_msg_t *msg;
+	xmms_ipc_msg_t *shared, *msg;
+	gboolean ret = TRUE;
+
+	if (!cli->broadcasts[broadcastid]) {
+		return TRUE;
+	}
+
+	shared = xmms_ipc_shared_msg_new (XMMS_IPC_COMMAND_BROADCAST, arg);
 
 	for (l = cli->broadcasts[broadcastid]; l; l = g_list_next (l)) {
-		msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_COMMAND_BROADCAST);
-		xmms_ipc_msg_set_cookie (msg, GPOINTER_TO_UINT (l->data));
-		xmms_ipc_handle_cmd_value (msg, arg);
+		msg = xmms_ipc_msg_copy_shared (shared, GPOINTER_TO_UINT (l->data));
 		if (!xmms_ipc_client_msg_write (cli, msg)) {
-			return FALSE;
+			xmms_ipc_msg_destroy (msg);
+			ret = FALSE;
+			break;
 		}
 	}
 
-	return TRUE;
+	xmms_ipc_msg_destroy (shared);
+
+	return ret;
 }
 
 
@@ -619,6 +1036,7 @@ xmms_ipc_source_accept (GIOChannel *chan, GIOCondition cond, gpointer data)
 	xmms_ipc_t *ipc = (xmms_ipc_t *) data;
 	xmms_ipc_transport_t *transport;
 	xmms_ipc_client_t *client;
+	xmms_ipc_worker_t *worker;
 	GThread * client_thread;
 
 	if (!(cond & G_IO_IN)) {
@@ -633,7 +1051,9 @@ xmms_ipc_source_accept (GIOChannel *chan, GIOCondition cond, gpointer data)
 		return TRUE;
 	}
 
-	client = xmms_ipc_client_new (ipc, transport);
+	worker = xmms_ipc_worker_pick ();
+
+	client = xmms_ipc_client_new (ipc, transport, worker);
 	if (!client) {
 		xmms_ipc_transport_destroy (transport);
 		return TRUE;
@@ -643,6 +1063,11 @@ xmms_ipc_source_accept (GIOChannel *chan, GIOCondition cond, gpointer data)
 	ipc->clients = g_list_append (ipc->clients, client);
 	g_mutex_unlock (&ipc->mutex_lock);
 
+	if (worker) {
+		xmms_ipc_worker_add (worker, client);
+		return TRUE;
+	}
+
 	/* Now that the client has been registered in the ipc->clients list
 	 * we may safely start its thread.
 	 */
@@ -710,7 +1135,7 @@ xmms_ipc_signal_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 	GList *c, *s;
 	guint signalid = GPOINTER_TO_UINT (userdata);
 	xmms_ipc_t *ipc;
-	xmms_ipc_msg_t *msg;
+	xmms_ipc_msg_t *shared = NULL, *msg;
 
 	g_mutex_lock (&ipc_servers_lock);
 
@@ -721,9 +1146,10 @@ xmms_ipc_signal_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 			xmms_ipc_client_t *cli = c->data;
 			g_mutex_lock (&cli->lock);
 			if (cli->pendingsignals[signalid]) {
-				msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_COMMAND_SIGNAL);
-				xmms_ipc_msg_set_cookie (msg, cli->pendingsignals[signalid]);
-				xmms_ipc_handle_cmd_value (msg, arg);
+				if (!shared) {
+					shared = xmms_ipc_shared_msg_new (XMMS_IPC_COMMAND_SIGNAL, arg);
+				}
+				msg = xmms_ipc_msg_copy_shared (shared, cli->pendingsignals[signalid]);
 				xmms_ipc_client_msg_write (cli, msg);
 				cli->pendingsignals[signalid] = 0;
 			}
@@ -734,6 +1160,9 @@ xmms_ipc_signal_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 
 	g_mutex_unlock (&ipc_servers_lock);
 
+	if (shared) {
+		xmms_ipc_msg_destroy (shared);
+	}
 }
 
 static void
@@ -742,7 +1171,7 @@ xmms_ipc_broadcast_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 	GList *c, *s;
 	guint broadcastid = GPOINTER_TO_UINT (userdata);
 	xmms_ipc_t *ipc;
-	xmms_ipc_msg_t *msg = NULL;
+	xmms_ipc_msg_t *shared = NULL, *msg;
 	GList *l;
 
 	g_mutex_lock (&ipc_servers_lock);
@@ -755,9 +1184,10 @@ xmms_ipc_broadcast_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 
 			g_mutex_lock (&cli->lock);
 			for (l = cli->broadcasts[broadcastid]; l; l = g_list_next (l)) {
-				msg = xmms_ipc_msg_new (XMMS_IPC_OBJECT_SIGNAL, XMMS_IPC_COMMAND_BROADCAST);
-				xmms_ipc_msg_set_cookie (msg, GPOINTER_TO_UINT (l->data));
-				xmms_ipc_handle_cmd_value (msg, arg);
+				if (!shared) {
+					shared = xmms_ipc_shared_msg_new (XMMS_IPC_COMMAND_BROADCAST, arg);
+				}
+				msg = xmms_ipc_msg_copy_shared (shared, GPOINTER_TO_UINT (l->data));
 				xmms_ipc_client_msg_write (cli, msg);
 			}
 			g_mutex_unlock (&cli->lock);
@@ -765,6 +1195,10 @@ xmms_ipc_broadcast_cb (xmms_object_t *object, xmmsv_t *arg, gpointer userdata)
 		g_mutex_unlock (&ipc->mutex_lock);
 	}
 	g_mutex_unlock (&ipc_servers_lock);
+
+	if (shared) {
+		xmms_ipc_msg_destroy (shared);
+	}
 }
 
 /**
@@ -913,6 +1347,8 @@ xmms_ipc_shutdown_server (xmms_ipc_t *ipc)
 void
 xmms_ipc_shutdown (void)
 {
+	xmms_ipc_workers_stop ();
+
 	xmms_ipc_manager_unregister_ipc_commands ();
 	xmms_object_unref (ipc_manager);
 
@@ -954,6 +1390,10 @@ xmms_ipc_setup_server (const gchar *path)
 	gint i = 0, num_init = 0;
 	g_return_val_if_fail (path, FALSE);
 
+	if (!ipc_workers) {
+		xmms_ipc_workers_start ();
+	}
+
 	split = g_strsplit (path, ";", 0);
 
 	for (i = 0; split && split[i]; i++) {
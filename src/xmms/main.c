@@ -384,6 +384,9 @@ xmms_main_destroy (xmms_object_t *object)
 	cv = xmms_config_lookup ("core.shutdownpath");
 	do_scriptdir (xmms_config_property_get_string (cv), "stop");
 
+	/* import jobs keep the medialib alive, stop them first */
+	xmms_medialib_cancel_imports (mainobj->medialib_object);
+
 	xmms_object_unref (mainobj->xform_object);
 	xmms_object_unref (mainobj->visualization_object);
 	xmms_object_unref (mainobj->output_object);
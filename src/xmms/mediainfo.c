@@ -18,7 +18,7 @@
 
 
 /** @file
- * This file controls the mediainfo reader thread.
+ * This file controls the mediainfo reader threads.
  *
  */
 
@@ -26,6 +26,7 @@
 
 #include <xmms/xmms_log.h>
 #include <xmms/xmms_ipc.h>
+#include <xmms/xmms_config.h>
 #include <xmmspriv/xmms_mediainfo.h>
 #include <xmmspriv/xmms_medialib.h>
 #include <xmmspriv/xmms_xform.h>
@@ -40,21 +41,54 @@
   * When a item is added to the playlist the mediainfo reader will
   * start extracting the information from this entry and update it
   * if additional information is found.
+  *
+  * Entries are resolved by a pool of worker threads. Each worker
+  * claims a batch of entries from a shared queue, so no entry is
+  * probed by two workers at once. The chains of a batch are probed
+  * without holding a medialib session, and the metadata found is then
+  * written in a single session that is redone if it fails to commit.
   * @{
   */
 
 struct xmms_mediainfo_reader_St {
 	xmms_object_t object;
 
-	GThread *thread;
+	GThread **threads;
+	gint num_threads;
 	GMutex mutex;
 	GCond cond;
 
-	gboolean running;
+	/** Read without the mutex, so only accessed atomically */
+	gint running;
+
+	/** Entries waiting to be claimed by a worker */
+	GQueue pending;
+	/** Entries currently being resolved by a worker */
+	GHashTable *claimed;
+	/** Set when the medialib changed since #pending was fetched */
+	gboolean dirty;
+	/** Number of workers processing a batch */
+	gint busy;
+	gboolean idle;
+	guint batch_size;
 
 	xmms_medialib_t *medialib;
 };
 
+/** The outcome of probing one entry of a batch */
+typedef struct xmms_mediainfo_reader_result_St {
+	xmms_medialib_entry_t entry;
+	gchar *url;
+	/** Unset if the reader stopped before getting to the entry */
+	gboolean probed;
+	/** The probed chain, NULL if the entry could not be resolved */
+	xmms_xform_t *xform;
+} xmms_mediainfo_reader_result_t;
+
+/** Set while a worker commits, as the medialib signals are emitted
+ * from the committing thread */
+static GPrivate mediainfo_committing;
+
 static void xmms_mediainfo_reader_stop (xmms_object_t *o);
 static gpointer xmms_mediainfo_reader_thread (gpointer data);
 
@@ -67,27 +101,56 @@ on_medialib_entry_added (xmms_object_t *object, xmmsv_t *val, gpointer udata)
 	xmms_mediainfo_reader_wakeup (mrt);
 }
 
+static void
+on_medialib_entry_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_mediainfo_reader_t *mrt = (xmms_mediainfo_reader_t *) udata;
+
+	/* the workers' own writes never leave anything to resolve */
+	if (g_private_get (&mediainfo_committing)) {
+		return;
+	}
+
+	xmms_mediainfo_reader_wakeup (mrt);
+}
+
 /**
- * Start the mediainfo reader thread
+ * Start the mediainfo reader threads
  */
 xmms_mediainfo_reader_t *
 xmms_mediainfo_reader_start (xmms_medialib_t *medialib)
 {
 	xmms_mediainfo_reader_t *mrt;
+	xmms_config_property_t *cv;
+	gint i;
 
 	mrt = xmms_object_new (xmms_mediainfo_reader_t,
 	                       xmms_mediainfo_reader_stop);
 
 	xmms_mediainfo_reader_register_ipc_commands (XMMS_OBJECT (mrt));
 
+	cv = xmms_config_property_register ("mediainfo.threads", "4", NULL, NULL);
+	mrt->num_threads = CLAMP (xmms_config_property_get_int (cv), 1, 64);
+
+	cv = xmms_config_property_register ("mediainfo.batch_size", "16", NULL, NULL);
+	mrt->batch_size = CLAMP (xmms_config_property_get_int (cv), 1, 1024);
+
 	g_mutex_init (&mrt->mutex);
 	g_cond_init (&mrt->cond);
-	mrt->running = TRUE;
-	mrt->thread = g_thread_new ("x2 media info", xmms_mediainfo_reader_thread, mrt);
+	g_queue_init (&mrt->pending);
+	mrt->claimed = g_hash_table_new (NULL, NULL);
+	mrt->dirty = TRUE;
+	mrt->idle = TRUE;
+	g_atomic_int_set (&mrt->running, TRUE);
 
 	xmms_object_ref (medialib);
 	mrt->medialib = medialib;
 
+	mrt->threads = g_new0 (GThread *, mrt->num_threads);
+	for (i = 0; i < mrt->num_threads; i++) {
+		mrt->threads[i] = g_thread_new ("x2 media info",
+		                                xmms_mediainfo_reader_thread, mrt);
+	}
 
 	xmms_object_connect (XMMS_OBJECT (mrt->medialib),
 	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
@@ -95,36 +158,43 @@ xmms_mediainfo_reader_start (xmms_medialib_t *medialib)
 
 	xmms_object_connect (XMMS_OBJECT (mrt->medialib),
 	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_CHANGED,
-	                     on_medialib_entry_added, mrt);
+	                     on_medialib_entry_changed, mrt);
 
 	return mrt;
 }
 
 /**
-  * Kill the mediainfo reader thread
+  * Kill the mediainfo reader threads
   */
 static void
 xmms_mediainfo_reader_stop (xmms_object_t *o)
 {
 	xmms_mediainfo_reader_t *mir = (xmms_mediainfo_reader_t *) o;
+	gint i;
 
 	XMMS_DBG ("Deactivating mediainfo object.");
 
 	g_mutex_lock (&mir->mutex);
-	mir->running = FALSE;
-	g_cond_signal (&mir->cond);
+	g_atomic_int_set (&mir->running, FALSE);
+	g_cond_broadcast (&mir->cond);
 	g_mutex_unlock (&mir->mutex);
 
 	xmms_mediainfo_reader_unregister_ipc_commands ();
 
-	g_thread_join (mir->thread);
+	for (i = 0; i < mir->num_threads; i++) {
+		g_thread_join (mir->threads[i]);
+	}
+	g_free (mir->threads);
+
+	g_queue_clear (&mir->pending);
+	g_hash_table_destroy (mir->claimed);
 
 	g_cond_clear (&mir->cond);
 	g_mutex_clear (&mir->mutex);
 
 	xmms_object_disconnect (XMMS_OBJECT (mir->medialib),
 	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_CHANGED,
-	                        on_medialib_entry_added, mir);
+	                        on_medialib_entry_changed, mir);
 
 	xmms_object_disconnect (XMMS_OBJECT (mir->medialib),
 	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
@@ -134,7 +204,7 @@ xmms_mediainfo_reader_stop (xmms_object_t *o)
 }
 
 /**
- * Wake the reader thread and start process the entries.
+ * Wake the reader threads and start process the entries.
  */
 
 void
@@ -143,25 +213,249 @@ xmms_mediainfo_reader_wakeup (xmms_mediainfo_reader_t *mr)
 	g_return_if_fail (mr);
 
 	g_mutex_lock (&mr->mutex);
-	g_cond_signal (&mr->cond);
+	mr->dirty = TRUE;
+	g_cond_broadcast (&mr->cond);
 	g_mutex_unlock (&mr->mutex);
 }
 
 /** @} */
 
+/**
+ * Refetch the entries waiting to be resolved, leaving out the
+ * ones already claimed by a worker.
+ *
+ * Called with the mutex held, which is dropped during the query.
+ *
+ * @returns the number of entries not yet resolved
+ */
+static guint
+xmms_mediainfo_reader_refill (xmms_mediainfo_reader_t *mrt)
+{
+	xmms_medialib_session_t *session;
+	GList *entries, *n;
+
+	mrt->dirty = FALSE;
+	g_mutex_unlock (&mrt->mutex);
+
+	session = xmms_medialib_session_begin_ro (mrt->medialib);
+	entries = xmms_medialib_entry_not_resolved_list (session);
+	xmms_medialib_session_abort (session);
+
+	g_mutex_lock (&mrt->mutex);
+
+	g_queue_clear (&mrt->pending);
+	for (n = entries; n; n = g_list_next (n)) {
+		if (!g_hash_table_contains (mrt->claimed, n->data)) {
+			g_queue_push_tail (&mrt->pending, n->data);
+		}
+	}
+	g_list_free (entries);
+
+	return g_queue_get_length (&mrt->pending) + g_hash_table_size (mrt->claimed);
+}
+
+/**
+ * Claim up to batch_size entries for the calling worker.
+ *
+ * Called with the mutex held.
+ *
+ * @param unindexed set to the number of unresolved entries if the
+ * queue was refetched and is not empty, untouched otherwise
+ * @returns the claimed entries, NULL if there is nothing to do
+ */
+static GList *
+xmms_mediainfo_reader_claim (xmms_mediainfo_reader_t *mrt, gint *unindexed)
+{
+	GList *batch = NULL;
+	gpointer entry;
+	guint count, claimed = 0;
+
+	if (mrt->dirty || g_queue_is_empty (&mrt->pending)) {
+		count = xmms_mediainfo_reader_refill (mrt);
+		if (count > 0) {
+			*unindexed = count;
+		}
+	}
+
+	while (claimed < mrt->batch_size &&
+	       (entry = g_queue_pop_head (&mrt->pending))) {
+		/* another worker may have claimed it during a refill */
+		if (g_hash_table_contains (mrt->claimed, entry)) {
+			continue;
+		}
+		g_hash_table_add (mrt->claimed, entry);
+		batch = g_list_prepend (batch, entry);
+		claimed++;
+	}
+
+	return g_list_reverse (batch);
+}
+
+static gboolean
+xmms_mediainfo_reader_is_unresolved (xmms_medialib_session_t *session,
+                                     xmms_medialib_entry_t entry,
+                                     xmmsc_medialib_entry_status_t *status)
+{
+	*status = xmms_medialib_entry_property_get_int (session, entry,
+	                                                XMMS_MEDIALIB_ENTRY_PROPERTY_STATUS);
+
+	return *status == XMMS_MEDIALIB_ENTRY_STATUS_NEW ||
+	       *status == XMMS_MEDIALIB_ENTRY_STATUS_REHASH;
+}
+
+/**
+ * Fetch the urls of the entries in a batch that still need to be
+ * resolved, and probe their chains without holding a session.
+ *
+ * @returns a list of #xmms_mediainfo_reader_result_t
+ */
+static GList *
+xmms_mediainfo_reader_probe (xmms_mediainfo_reader_t *mrt,
+                             GList *batch, GList *goal_format)
+{
+	xmms_mediainfo_reader_result_t *result;
+	xmms_medialib_session_t *session;
+	xmmsc_medialib_entry_status_t status;
+	GList *results = NULL, *n;
+
+	session = xmms_medialib_session_begin_ro (mrt->medialib);
+	for (n = batch; n; n = g_list_next (n)) {
+		xmms_medialib_entry_t entry = GPOINTER_TO_INT (n->data);
+
+		/* resolved or removed since it was queued */
+		if (!xmms_mediainfo_reader_is_unresolved (session, entry, &status)) {
+			continue;
+		}
+
+		result = g_new0 (xmms_mediainfo_reader_result_t, 1);
+		result->entry = entry;
+		result->url = xmms_medialib_entry_property_get_str (session, entry,
+		                                                    XMMS_MEDIALIB_ENTRY_PROPERTY_URL);
+		if (!result->url) {
+			xmms_log_error ("Couldn't get url for entry (%d)", entry);
+		}
+		results = g_list_prepend (results, result);
+	}
+	xmms_medialib_session_abort (session);
+
+	results = g_list_reverse (results);
+
+	for (n = results; n; n = g_list_next (n)) {
+		result = n->data;
+
+		if (!g_atomic_int_get (&mrt->running)) {
+			break;
+		}
+
+		result->probed = TRUE;
+		if (!result->url) {
+			continue;
+		}
+
+		XMMS_DBG ("resolving %d", result->entry);
+
+		result->xform = xmms_xform_chain_probe (mrt->medialib, result->entry,
+		                                        result->url, goal_format, TRUE);
+	}
+
+	return results;
+}
+
+/**
+ * Write the outcome of probing an entry, unless it was resolved or
+ * removed by someone else while it was probed.
+ */
+static void
+xmms_mediainfo_reader_store (xmms_medialib_session_t *session,
+                             xmms_mediainfo_reader_result_t *result)
+{
+	xmmsc_medialib_entry_status_t status;
+	GTimeVal timeval;
+
+	/* left unresolved when stopping */
+	if (!result->probed) {
+		return;
+	}
+
+	if (!xmms_mediainfo_reader_is_unresolved (session, result->entry, &status)) {
+		return;
+	}
+
+	if (!result->xform) {
+		if (status == XMMS_MEDIALIB_ENTRY_STATUS_NEW) {
+			xmms_medialib_entry_remove (session, result->entry);
+		} else {
+			xmms_medialib_entry_status_set (session, result->entry,
+			                                XMMS_MEDIALIB_ENTRY_STATUS_NOT_AVAILABLE);
+		}
+		return;
+	}
+
+	xmms_xform_chain_finalize (session, result->xform, result->entry,
+	                           result->url, TRUE);
+
+	g_get_current_time (&timeval);
+	xmms_medialib_entry_property_set_int (session, result->entry,
+	                                      XMMS_MEDIALIB_ENTRY_PROPERTY_ADDED,
+	                                      timeval.tv_sec);
+}
+
+static void
+xmms_mediainfo_reader_result_free (gpointer data)
+{
+	xmms_mediainfo_reader_result_t *result = data;
+
+	if (result->xform) {
+		xmms_object_unref (result->xform);
+	}
+	g_free (result->url);
+	g_free (result);
+}
+
+/**
+ * Resolve a batch of entries. The chains are probed first, and the
+ * results are then written in one session, which is redone from the
+ * probed chains until it commits.
+ */
+static void
+xmms_mediainfo_reader_resolve_batch (xmms_mediainfo_reader_t *mrt,
+                                     GList *batch, GList *goal_format)
+{
+	xmms_medialib_session_t *session;
+	GList *results, *n;
+	gboolean committed;
+
+	results = xmms_mediainfo_reader_probe (mrt, batch, goal_format);
+	if (!results) {
+		return;
+	}
+
+	do {
+		session = xmms_medialib_session_begin (mrt->medialib);
+		for (n = results; n; n = g_list_next (n)) {
+			xmms_mediainfo_reader_store (session, n->data);
+		}
+
+		g_private_set (&mediainfo_committing, GINT_TO_POINTER (TRUE));
+		committed = xmms_medialib_session_commit (session);
+		g_private_set (&mediainfo_committing, NULL);
+
+		if (!committed) {
+			XMMS_DBG ("Could not commit batch, writing it again.");
+		}
+	} while (!committed);
+
+	g_list_free_full (results, xmms_mediainfo_reader_result_free);
+}
+
 static gpointer
 xmms_mediainfo_reader_thread (gpointer data)
 {
 	GList *goal_format;
-	GTimeVal timeval;
 	xmms_stream_type_t *f;
-	guint num = 0;
 
 	xmms_mediainfo_reader_t *mrt = (xmms_mediainfo_reader_t *) data;
-
-	xmms_object_emit (XMMS_OBJECT (mrt),
-	                  XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS,
-	                  xmmsv_new_int (XMMS_MEDIAINFO_READER_STATUS_RUNNING));
+	gint unindexed = -1;
 
 	f = _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
 	                           XMMS_STREAM_TYPE_MIMETYPE,
@@ -169,67 +463,71 @@ xmms_mediainfo_reader_thread (gpointer data)
 	                           XMMS_STREAM_TYPE_END);
 	goal_format = g_list_prepend (NULL, f);
 
-	while (mrt->running) {
-		xmmsc_medialib_entry_status_t prev_status;
-		xmms_medialib_entry_t entry;
-		xmms_medialib_session_t *session;
-		xmms_xform_t *xform;
+	g_mutex_lock (&mrt->mutex);
 
-		session = xmms_medialib_session_begin (mrt->medialib);
-		entry = xmms_medialib_entry_not_resolved_get (session);
-		XMMS_DBG ("got %d as not resolved", entry);
+	while (g_atomic_int_get (&mrt->running)) {
+		GList *batch, *n;
+		gint status = -1;
 
-		if (!entry) {
-			xmms_medialib_session_abort (session);
-			xmms_object_emit (XMMS_OBJECT (mrt),
-			                  XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS,
-			                  xmmsv_new_int (XMMS_MEDIAINFO_READER_STATUS_IDLE));
+		batch = xmms_mediainfo_reader_claim (mrt, &unindexed);
+
+		if (batch && mrt->idle) {
+			mrt->idle = FALSE;
+			status = XMMS_MEDIAINFO_READER_STATUS_RUNNING;
+		} else if (!batch && !mrt->idle && mrt->busy == 0) {
+			mrt->idle = TRUE;
+			status = XMMS_MEDIAINFO_READER_STATUS_IDLE;
+		}
 
-			g_mutex_lock (&mrt->mutex);
-			g_cond_wait (&mrt->cond, &mrt->mutex);
-			g_mutex_unlock (&mrt->mutex);
+		if (batch) {
+			mrt->busy++;
+		}
 
-			num = 0;
+		g_mutex_unlock (&mrt->mutex);
 
+		if (status != -1) {
 			xmms_object_emit (XMMS_OBJECT (mrt),
 			                  XMMS_IPC_SIGNAL_MEDIAINFO_READER_STATUS,
-			                  xmmsv_new_int (XMMS_MEDIAINFO_READER_STATUS_RUNNING));
-			continue;
+			                  xmmsv_new_int (status));
 		}
 
-		prev_status = xmms_medialib_entry_property_get_int (session, entry,
-		                                                    XMMS_MEDIALIB_ENTRY_PROPERTY_STATUS);
-
-		if (num == 0) {
+		if (unindexed >= 0) {
 			xmms_object_emit (XMMS_OBJECT (mrt),
 			                  XMMS_IPC_SIGNAL_MEDIAINFO_READER_UNINDEXED,
-			                  xmmsv_new_int (xmms_medialib_num_not_resolved (session)));
-			num = 10;
-		} else {
-			num--;
+			                  xmmsv_new_int (unindexed));
+			unindexed = -1;
+		}
+
+		if (batch) {
+			xmms_mediainfo_reader_resolve_batch (mrt, batch, goal_format);
 		}
 
-		xform = xmms_xform_chain_setup_session (mrt->medialib, session, entry,
-		                                        goal_format, TRUE);
+		g_mutex_lock (&mrt->mutex);
 
-		if (!xform) {
-			if (prev_status == XMMS_MEDIALIB_ENTRY_STATUS_NEW) {
-				xmms_medialib_entry_remove (session, entry);
-			} else {
-				xmms_medialib_entry_status_set (session, entry,
-				                                XMMS_MEDIALIB_ENTRY_STATUS_NOT_AVAILABLE);
+		if (!batch) {
+			if (g_atomic_int_get (&mrt->running) && !mrt->dirty) {
+				g_cond_wait (&mrt->cond, &mrt->mutex);
 			}
-		} else {
-			xmms_object_unref (xform);
-			g_get_current_time (&timeval);
+			continue;
+		}
 
-			xmms_medialib_entry_property_set_int (session, entry,
-			                                      XMMS_MEDIALIB_ENTRY_PROPERTY_ADDED,
-			                                      timeval.tv_sec);
+		for (n = batch; n; n = g_list_next (n)) {
+			g_hash_table_remove (mrt->claimed, n->data);
+		}
+		g_list_free (batch);
+
+		/* report progress after every batch, announced on the next lap */
+		unindexed = g_queue_get_length (&mrt->pending) +
+		            g_hash_table_size (mrt->claimed);
+
+		/* the last worker to go idle has to announce it */
+		if (--mrt->busy == 0) {
+			g_cond_broadcast (&mrt->cond);
 		}
-		xmms_medialib_session_commit (session);
 	}
 
+	g_mutex_unlock (&mrt->mutex);
+
 	g_list_free (goal_format);
 	xmms_object_unref (f);
 
@@ -35,6 +35,8 @@
 
 #include <xmmspriv/xmms_fetch_info.h>
 #include <xmmspriv/xmms_fetch_spec.h>
+#include <xmmspriv/xmms_medialib_plan.h>
+#include <xmmspriv/xmms_medialib_import.h>
 #include "s4.h"
 
 
@@ -50,15 +52,19 @@ gchar *xmms_medialib_url_encode (const gchar *path);
 static void xmms_medialib_client_add_entry (xmms_medialib_t *, const gchar *, xmms_error_t *);
 static void xmms_medialib_client_move_entry (xmms_medialib_t *, gint32 entry, const gchar *, xmms_error_t *);
 static void xmms_medialib_client_import_path (xmms_medialib_t *medialib, const gchar *path, xmms_error_t *error);
+static gint32 xmms_medialib_client_import_path_async (xmms_medialib_t *medialib, const gchar *path, xmms_error_t *error);
+static void xmms_medialib_client_import_cancel (xmms_medialib_t *medialib, gint32 job, xmms_error_t *error);
 static void xmms_medialib_client_rehash (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, xmms_error_t *error);
 static void xmms_medialib_client_set_property_string (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, const gchar *source, const gchar *key, const gchar *value, xmms_error_t *error);
 static void xmms_medialib_client_set_property_int (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, const gchar *source, const gchar *key, gint32 value, xmms_error_t *error);
 static void xmms_medialib_client_remove_property (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, const gchar *source, const gchar *key, xmms_error_t *error);
 static xmmsv_t *xmms_medialib_client_get_info (xmms_medialib_t *medialib, xmms_medialib_entry_t entry, xmms_error_t *err);
 static gint32 xmms_medialib_client_get_id (xmms_medialib_t *medialib, const gchar *url, xmms_error_t *error);
+static xmmsv_t *xmms_medialib_client_get_query_stats (xmms_medialib_t *medialib, xmms_error_t *error);
 
 static s4_t *xmms_medialib_database_open (const gchar *config_path, const gchar *indices[]);
 static xmms_medialib_entry_t xmms_medialib_entry_new_insert (xmms_medialib_session_t *session, guint32 id, const gchar *url, xmms_error_t *error);
+static xmms_medialib_entry_t xmms_medialib_get_id (xmms_medialib_session_t *session, const char *url, xmms_error_t *error);
 
 #include "medialib_ipc.c"
 
@@ -80,15 +86,51 @@ struct xmms_medialib_St {
 	xmms_object_t object;
 	s4_t *s4;
 	s4_sourcepref_t *default_sp;
+	xmms_medialib_plan_cache_t *plans;
+	xmms_medialib_importer_t *importer;
+	/** Number of entries added per session when importing */
+	guint import_batch_size;
 };
 
+static void
+on_medialib_entry_changed (xmms_object_t *object, xmmsv_t *val, gpointer udata)
+{
+	xmms_medialib_t *mlib = (xmms_medialib_t *) udata;
+	xmms_medialib_plan_cache_invalidate (mlib->plans, TRUE);
+}
+
+static void
+on_query_plan_cache_size_changed (xmms_object_t *object, xmmsv_t *_data,
+                                  gpointer udata)
+{
+	xmms_medialib_t *mlib = (xmms_medialib_t *) udata;
+	gint value;
+
+	value = xmms_config_property_get_int ((xmms_config_property_t *) object);
+	xmms_medialib_plan_cache_set_capacity (mlib->plans, MAX (0, value));
+}
+
 static void
 xmms_medialib_destroy (xmms_object_t *object)
 {
 	xmms_medialib_t *mlib = (xmms_medialib_t *) object;
+	xmms_config_property_t *cfg;
 
 	XMMS_DBG ("Deactivating medialib object.");
 
+	xmms_object_disconnect (object, XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
+	                        on_medialib_entry_changed, mlib);
+	xmms_object_disconnect (object, XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_CHANGED,
+	                        on_medialib_entry_changed, mlib);
+	xmms_object_disconnect (object, XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_REMOVED,
+	                        on_medialib_entry_changed, mlib);
+
+	cfg = xmms_config_lookup ("medialib.query_plan_cache_size");
+	xmms_config_property_callback_remove (cfg, on_query_plan_cache_size_changed, mlib);
+
+	xmms_medialib_plan_cache_free (mlib->plans);
+	xmms_medialib_importer_free (mlib->importer);
+
 	s4_sourcepref_unref (mlib->default_sp);
 	s4_close (mlib->s4);
 
@@ -121,6 +163,10 @@ xmms_medialib_init (void)
 
 	xmms_medialib_register_ipc_commands (XMMS_OBJECT (medialib));
 
+	cfg = xmms_config_property_register ("medialib.query_plan_cache_size", "64",
+	                                     on_query_plan_cache_size_changed, medialib);
+	medialib->plans = xmms_medialib_plan_cache_new (MAX (0, xmms_config_property_get_int (cfg)));
+
 	path = XMMS_BUILD_PATH ("medialib.s4");
 	cfg = xmms_config_property_register ("medialib.path", path, NULL, NULL);
 	g_free (path);
@@ -135,9 +181,49 @@ xmms_medialib_init (void)
 	medialib->s4 = xmms_medialib_database_open (medialib_path, indices);
 	medialib->default_sp = s4_sourcepref_create (xmmsv_default_source_pref);
 
+	cfg = xmms_config_property_register ("medialib.import_batch_size", "256", NULL, NULL);
+	medialib->import_batch_size = CLAMP (xmms_config_property_get_int (cfg), 1, 65536);
+
+	cfg = xmms_config_property_register ("medialib.import_threads", "4", NULL, NULL);
+	medialib->importer = xmms_medialib_importer_new (medialib,
+	                                                 CLAMP (xmms_config_property_get_int (cfg), 1, 64),
+	                                                 medialib->import_batch_size);
+
+	xmms_object_connect (XMMS_OBJECT (medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_ADDED,
+	                     on_medialib_entry_changed, medialib);
+	xmms_object_connect (XMMS_OBJECT (medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_CHANGED,
+	                     on_medialib_entry_changed, medialib);
+	xmms_object_connect (XMMS_OBJECT (medialib),
+	                     XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_REMOVED,
+	                     on_medialib_entry_changed, medialib);
+
 	return medialib;
 }
 
+/**
+ * Get the generation of the medialib contents, which changes every
+ * time an entry is added, changed or removed.
+ */
+guint
+xmms_medialib_get_generation (xmms_medialib_t *medialib)
+{
+	return xmms_medialib_plan_cache_generation (medialib->plans);
+}
+
+/**
+ * Drop the cached query plans, because the collections they were
+ * compiled from changed.
+ */
+void
+xmms_medialib_query_plans_invalidate (xmms_medialib_t *medialib)
+{
+	g_return_if_fail (medialib);
+
+	xmms_medialib_plan_cache_invalidate (medialib->plans, FALSE);
+}
+
 s4_sourcepref_t *
 xmms_medialib_get_source_preferences (xmms_medialib_t *medialib)
 {
@@ -717,10 +803,10 @@ xmms_medialib_client_rehash (xmms_medialib_t *medialib,
 /**
  * Recursively scan a directory for media files.
  *
- * @return a reverse sorted list of encoded urls
+ * @param urls array the encoded urls are appended to, in traversal order
  */
 static gboolean
-process_dir (xmms_medialib_t *medialib, xmmsv_t *entries,
+process_dir (xmms_medialib_t *medialib, GPtrArray *urls,
              const gchar *directory, xmms_error_t *error)
 {
 	xmmsv_list_iter_t *it;
@@ -741,19 +827,9 @@ process_dir (xmms_medialib_t *medialib, xmmsv_t *entries,
 		xmmsv_dict_entry_get_int (val, "isdir", &isdir);
 
 		if (isdir == 1) {
-			process_dir (medialib, entries, str, error);
+			process_dir (medialib, urls, str, error);
 		} else {
-			xmms_medialib_session_t *session;
-			xmms_medialib_entry_t entry;
-
-			do {
-				session = xmms_medialib_session_begin (medialib);
-				entry = xmms_medialib_entry_new_encoded (session, str, error);
-			} while (!xmms_medialib_session_commit (session));
-
-			if (entry) {
-				xmmsv_coll_idlist_append (entries, entry);
-			}
+			g_ptr_array_add (urls, g_strdup (str));
 		}
 
 		xmmsv_list_iter_remove (it);
@@ -764,9 +840,76 @@ process_dir (xmms_medialib_t *medialib, xmmsv_t *entries,
 	return TRUE;
 }
 
+/**
+ * Add a batch of encoded urls to the medialib in a single session.
+ *
+ * Urls already in the medialib are not added again, but their entries
+ * are still appended to @a entries.
+ *
+ * @param medialib the medialib object
+ * @param urls the encoded urls to add
+ * @param count number of urls
+ * @param entries IDLIST collection the entries are appended to, or NULL
+ *
+ * @return the number of entries that were created
+ */
+guint
+xmms_medialib_add_encoded_batch (xmms_medialib_t *medialib,
+                                 const gchar **urls, guint count,
+                                 xmmsv_t *entries)
+{
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t entry, next_id;
+	xmms_error_t err;
+	GArray *ids;
+	guint i, added;
+
+	ids = g_array_sized_new (FALSE, FALSE, sizeof (xmms_medialib_entry_t), count);
+
+	do {
+		session = xmms_medialib_session_begin (medialib);
+		g_array_set_size (ids, 0);
+		next_id = 0;
+		added = 0;
+
+		for (i = 0; i < count; i++) {
+			xmms_error_reset (&err);
+
+			entry = xmms_medialib_get_id (session, urls[i], &err);
+			if (entry == 0) {
+				/* Finding the highest id walks every entry, so only do
+				 * it once and count up from there for the whole batch. */
+				if (next_id == 0) {
+					next_id = xmms_medialib_get_new_id (session);
+				}
+				if (!xmms_medialib_entry_new_insert (session, next_id, urls[i], &err)) {
+					continue;
+				}
+				entry = next_id++;
+				added++;
+			}
+
+			g_array_append_val (ids, entry);
+		}
+	} while (!xmms_medialib_session_commit (session));
+
+	if (entries != NULL) {
+		for (i = 0; i < ids->len; i++) {
+			xmmsv_coll_idlist_append (entries, g_array_index (ids, xmms_medialib_entry_t, i));
+		}
+	}
+
+	g_array_free (ids, TRUE);
+
+	return added;
+}
+
 /**
  * Recursively add files under a path to the media library.
  *
+ * The files are added in batches of "medialib.import_batch_size"
+ * entries per session, in the order they were found.
+ *
  * @param medialib the medialib object
  * @param path the directory to scan for files
  * @param error If an error occurs, it will be stored in there.
@@ -778,17 +921,40 @@ xmms_medialib_add_recursive (xmms_medialib_t *medialib, const gchar *path,
                              xmms_error_t *error)
 {
 	xmmsv_t *entries;
+	GPtrArray *urls;
+	guint i, count;
 
 	entries = xmmsv_new_coll (XMMS_COLLECTION_TYPE_IDLIST);
 
 	g_return_val_if_fail (medialib, entries);
 	g_return_val_if_fail (path, entries);
 
-	process_dir (medialib, entries, path, error);
+	urls = g_ptr_array_new_with_free_func (g_free);
+
+	process_dir (medialib, urls, path, error);
+
+	for (i = 0; i < urls->len; i += count) {
+		count = MIN (urls->len - i, medialib->import_batch_size);
+		xmms_medialib_add_encoded_batch (medialib,
+		                                 (const gchar **) urls->pdata + i,
+		                                 count, entries);
+	}
+
+	g_ptr_array_free (urls, TRUE);
 
 	return entries;
 }
 
+/**
+ * Cancel the running import jobs and wait for them to stop. No new
+ * jobs can be started afterwards, call this before shutting down.
+ */
+void
+xmms_medialib_cancel_imports (xmms_medialib_t *medialib)
+{
+	xmms_medialib_importer_shutdown (medialib->importer);
+}
+
 static void
 xmms_medialib_client_import_path (xmms_medialib_t *medialib, const gchar *path,
                                   xmms_error_t *error)
@@ -796,6 +962,30 @@ xmms_medialib_client_import_path (xmms_medialib_t *medialib, const gchar *path,
 	xmmsv_unref (xmms_medialib_add_recursive (medialib, path, error));
 }
 
+static gint32
+xmms_medialib_client_import_path_async (xmms_medialib_t *medialib,
+                                        const gchar *path,
+                                        xmms_error_t *error)
+{
+	gint32 job;
+
+	job = xmms_medialib_importer_start (medialib->importer, path);
+	if (job == 0) {
+		xmms_error_set (error, XMMS_ERROR_GENERIC, "Medialib is shutting down");
+	}
+
+	return job;
+}
+
+static void
+xmms_medialib_client_import_cancel (xmms_medialib_t *medialib, gint32 job,
+                                    xmms_error_t *error)
+{
+	if (!xmms_medialib_importer_cancel (medialib->importer, job)) {
+		xmms_error_set (error, XMMS_ERROR_NOENT, "No such import job");
+	}
+}
+
 static gboolean
 xmms_medialib_entry_new_insert (xmms_medialib_session_t *session,
                                 guint32 id,
@@ -1280,6 +1470,34 @@ xmms_medialib_entry_not_resolved_get (xmms_medialib_session_t *session)
 	return ret;
 }
 
+/**
+ * Get all entries that are waiting to be resolved.
+ *
+ * @returns a list of entry ids, to be freed with g_list_free
+ */
+GList *
+xmms_medialib_entry_not_resolved_list (xmms_medialib_session_t *session)
+{
+	const s4_result_t *res;
+	s4_resultset_t *set;
+	GList *ret = NULL;
+	gint32 entry;
+	gint i;
+
+	set = not_resolved_set (session);
+
+	for (i = s4_resultset_get_rowcount (set) - 1; i >= 0; i--) {
+		res = s4_resultset_get_result (set, i, 0);
+		if (res != NULL && s4_val_get_int (s4_result_get_val (res), &entry)) {
+			ret = g_list_prepend (ret, GINT_TO_POINTER (entry));
+		}
+	}
+
+	s4_resultset_free (set);
+
+	return ret;
+}
+
 guint
 xmms_medialib_num_not_resolved (xmms_medialib_session_t *session)
 {
@@ -1384,33 +1602,22 @@ xmmsv_t *
 xmms_medialib_query (xmms_medialib_session_t *session, xmmsv_t *coll,
                      xmmsv_t *fetch, xmms_error_t *err)
 {
-	s4_sourcepref_t *sourcepref;
-	s4_resultset_t *set;
+	xmms_medialib_plan_cache_t *plans;
+	xmms_medialib_plan_t *plan;
 	xmmsv_t *ret;
-	xmms_fetch_info_t *info;
-	xmms_fetch_spec_t *spec;
 
 	xmms_error_reset (err);
 
-	sourcepref = xmms_medialib_session_get_source_preferences (session);
-
-	info = xmms_fetch_info_new (sourcepref);
-	spec = xmms_fetch_spec_new (fetch, info, sourcepref, err);
+	plans = xmms_medialib_session_get_medialib (session)->plans;
 
-	s4_sourcepref_unref (sourcepref);
-
-	if (spec == NULL) {
-		xmms_fetch_spec_free (spec);
-		xmms_fetch_info_free (info);
+	plan = xmms_medialib_plan_cache_get (plans, session, coll, fetch, err);
+	if (plan == NULL) {
 		return NULL;
 	}
 
-	set = xmms_medialib_query_recurs (session, coll, info);
-	ret = xmms_medialib_query_to_xmmsv (set, spec);
-	s4_resultset_free (set);
+	ret = xmms_medialib_plan_run (plan, session);
 
-	xmms_fetch_spec_free (spec);
-	xmms_fetch_info_free (info);
+	xmms_medialib_plan_unref (plans, plan);
 
 	if (ret == NULL) {
 		if (err) {
@@ -1424,3 +1631,13 @@ xmms_medialib_query (xmms_medialib_session_t *session, xmmsv_t *coll,
 
 	return ret;
 }
+
+/**
+ * Get statistics about the query plan cache.
+ */
+static xmmsv_t *
+xmms_medialib_client_get_query_stats (xmms_medialib_t *medialib,
+                                      xmms_error_t *error)
+{
+	return xmms_medialib_plan_cache_stats (medialib->plans);
+}
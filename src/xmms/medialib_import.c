@@ -0,0 +1,420 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Background import jobs.
+ *
+ * An import job adds all files below a directory to the medialib
+ * without blocking the client that started it. Directories are browsed
+ * by a shared pool of threads, each directory being a separate task, so
+ * a slow share is enumerated in parallel. The files found are collected
+ * by the thread of the job, which adds them "medialib.import_batch_size"
+ * at a time in a single medialib session.
+ *
+ * The progress of a job is reported with the import_progress broadcast,
+ * at most a few times a second and once more when the job has finished
+ * or was cancelled.
+ */
+
+#include <xmmspriv/xmms_medialib_import.h>
+#include <xmmspriv/xmms_xform.h>
+#include <xmms/xmms_object.h>
+#include <xmms/xmms_ipc.h>
+#include <xmms/xmms_log.h>
+
+#define XMMS_MEDIALIB_IMPORT_PROGRESS_INTERVAL (G_TIME_SPAN_MILLISECOND * 250)
+
+typedef struct xmms_medialib_import_job_St xmms_medialib_import_job_t;
+
+struct xmms_medialib_importer_St {
+	xmms_medialib_t *medialib;
+	GThreadPool *pool;
+	guint batch_size;
+
+	GMutex mutex;
+	GCond cond;
+
+	/** Running jobs by id */
+	GHashTable *jobs;
+	gint32 next_id;
+	gboolean shutdown;
+};
+
+/**
+ * An import job. Everything but the id and path is protected by the
+ * importer mutex.
+ */
+struct xmms_medialib_import_job_St {
+	xmms_medialib_importer_t *importer;
+	gint32 id;
+	gchar *path;
+	GThread *thread;
+
+	/** Encoded urls found, but not added yet */
+	GQueue urls;
+	/** Directories waiting for or being browsed */
+	gint pending;
+	gboolean cancelled;
+
+	guint directories;
+	guint files;
+	guint added;
+	guint errors;
+};
+
+typedef struct xmms_medialib_import_task_St {
+	xmms_medialib_import_job_t *job;
+	gchar *path;
+} xmms_medialib_import_task_t;
+
+static void xmms_medialib_import_browse (gpointer data, gpointer udata);
+static gpointer xmms_medialib_import_run (gpointer data);
+
+xmms_medialib_importer_t *
+xmms_medialib_importer_new (xmms_medialib_t *medialib, gint num_threads,
+                            guint batch_size)
+{
+	xmms_medialib_importer_t *importer;
+
+	importer = g_new0 (xmms_medialib_importer_t, 1);
+	importer->medialib = medialib;
+	importer->batch_size = batch_size;
+	importer->next_id = 1;
+	importer->jobs = g_hash_table_new (NULL, NULL);
+
+	g_mutex_init (&importer->mutex);
+	g_cond_init (&importer->cond);
+
+	importer->pool = g_thread_pool_new (xmms_medialib_import_browse, importer,
+	                                    num_threads, FALSE, NULL);
+
+	return importer;
+}
+
+/**
+ * Free the importer. Jobs hold a reference to the medialib, so there
+ * can't be any left at this point.
+ */
+void
+xmms_medialib_importer_free (xmms_medialib_importer_t *importer)
+{
+	g_return_if_fail (importer);
+	g_return_if_fail (g_hash_table_size (importer->jobs) == 0);
+
+	g_thread_pool_free (importer->pool, TRUE, TRUE);
+	g_hash_table_destroy (importer->jobs);
+
+	g_cond_clear (&importer->cond);
+	g_mutex_clear (&importer->mutex);
+
+	g_free (importer);
+}
+
+/**
+ * Queue a directory of a job to be browsed, called with the importer
+ * mutex held.
+ */
+static void
+xmms_medialib_import_queue_dir (xmms_medialib_import_job_t *job,
+                                const gchar *path)
+{
+	xmms_medialib_import_task_t *task;
+
+	task = g_new0 (xmms_medialib_import_task_t, 1);
+	task->job = job;
+	task->path = g_strdup (path);
+
+	job->pending++;
+
+	g_thread_pool_push (job->importer->pool, task, NULL);
+}
+
+/**
+ * Start importing a directory in the background.
+ *
+ * @param path the encoded url of the directory
+ * @return the id of the new job, or 0 if the importer was shut down
+ */
+gint32
+xmms_medialib_importer_start (xmms_medialib_importer_t *importer,
+                              const gchar *path)
+{
+	xmms_medialib_import_job_t *job;
+	gint32 id;
+
+	g_return_val_if_fail (importer, 0);
+	g_return_val_if_fail (path, 0);
+
+	g_mutex_lock (&importer->mutex);
+
+	if (importer->shutdown) {
+		g_mutex_unlock (&importer->mutex);
+		return 0;
+	}
+
+	id = importer->next_id;
+	importer->next_id = (id == G_MAXINT32) ? 1 : id + 1;
+
+	job = g_new0 (xmms_medialib_import_job_t, 1);
+	job->importer = importer;
+	job->id = id;
+	job->path = g_strdup (path);
+	g_queue_init (&job->urls);
+
+	/* Keep the medialib alive as long as the job is using it */
+	xmms_object_ref (importer->medialib);
+
+	g_hash_table_insert (importer->jobs, GINT_TO_POINTER (id), job);
+
+	xmms_medialib_import_queue_dir (job, path);
+	job->thread = g_thread_new ("x2 import", xmms_medialib_import_run, job);
+
+	g_mutex_unlock (&importer->mutex);
+
+	XMMS_DBG ("Started import job %d of %s", id, path);
+
+	return id;
+}
+
+/**
+ * Cancel an import job. Files that were already added are kept.
+ *
+ * @return FALSE if there is no such job
+ */
+gboolean
+xmms_medialib_importer_cancel (xmms_medialib_importer_t *importer, gint32 id)
+{
+	xmms_medialib_import_job_t *job;
+
+	g_return_val_if_fail (importer, FALSE);
+
+	g_mutex_lock (&importer->mutex);
+
+	job = g_hash_table_lookup (importer->jobs, GINT_TO_POINTER (id));
+	if (job != NULL) {
+		job->cancelled = TRUE;
+		g_cond_broadcast (&importer->cond);
+	}
+
+	g_mutex_unlock (&importer->mutex);
+
+	return job != NULL;
+}
+
+/**
+ * Cancel all jobs, wait for them to finish and refuse new ones.
+ */
+void
+xmms_medialib_importer_shutdown (xmms_medialib_importer_t *importer)
+{
+	xmms_medialib_import_job_t *job;
+	GHashTableIter iter;
+	GList *threads = NULL;
+
+	g_return_if_fail (importer);
+
+	g_mutex_lock (&importer->mutex);
+
+	importer->shutdown = TRUE;
+
+	g_hash_table_iter_init (&iter, importer->jobs);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &job)) {
+		job->cancelled = TRUE;
+		threads = g_list_prepend (threads, g_thread_ref (job->thread));
+	}
+
+	g_cond_broadcast (&importer->cond);
+
+	g_mutex_unlock (&importer->mutex);
+
+	while (threads != NULL) {
+		g_thread_join (threads->data);
+		threads = g_list_delete_link (threads, threads);
+	}
+}
+
+/**
+ * Browse one directory of a job, queueing its subdirectories and
+ * collecting its files. Runs in the thread pool.
+ */
+static void
+xmms_medialib_import_browse (gpointer data, gpointer udata)
+{
+	xmms_medialib_import_task_t *task = (xmms_medialib_import_task_t *) data;
+	xmms_medialib_importer_t *importer = (xmms_medialib_importer_t *) udata;
+	xmms_medialib_import_job_t *job = task->job;
+	xmmsv_list_iter_t *it;
+	xmmsv_t *list = NULL;
+	xmmsv_t *val;
+	xmms_error_t err;
+	gboolean cancelled;
+
+	g_mutex_lock (&importer->mutex);
+	cancelled = job->cancelled;
+	g_mutex_unlock (&importer->mutex);
+
+	if (!cancelled) {
+		xmms_error_reset (&err);
+		list = xmms_xform_browse (task->path, &err);
+	}
+
+	g_mutex_lock (&importer->mutex);
+
+	if (list != NULL) {
+		xmmsv_get_list_iter (list, &it);
+
+		for (; xmmsv_list_iter_entry (it, &val); xmmsv_list_iter_next (it)) {
+			const gchar *str;
+			gint isdir;
+
+			if (!xmmsv_dict_entry_get_string (val, "path", &str)) {
+				continue;
+			}
+			xmmsv_dict_entry_get_int (val, "isdir", &isdir);
+
+			if (isdir == 1) {
+				if (!job->cancelled) {
+					xmms_medialib_import_queue_dir (job, str);
+				}
+			} else {
+				g_queue_push_tail (&job->urls, g_strdup (str));
+				job->files++;
+			}
+		}
+
+		job->directories++;
+	} else if (!cancelled) {
+		XMMS_DBG ("Import job %d could not browse %s: %s", job->id,
+		          task->path, xmms_error_message_get (&err));
+		job->errors++;
+	}
+
+	job->pending--;
+	g_cond_broadcast (&importer->cond);
+
+	g_mutex_unlock (&importer->mutex);
+
+	if (list != NULL) {
+		xmmsv_unref (list);
+	}
+
+	g_free (task->path);
+	g_free (task);
+}
+
+/**
+ * Describe the state of a job, called with the importer mutex held.
+ */
+static xmmsv_t *
+xmms_medialib_import_progress (xmms_medialib_import_job_t *job,
+                               const gchar *status)
+{
+	return xmmsv_build_dict (XMMSV_DICT_ENTRY_INT ("id", job->id),
+	                         XMMSV_DICT_ENTRY_STR ("path", job->path),
+	                         XMMSV_DICT_ENTRY_STR ("status", status),
+	                         XMMSV_DICT_ENTRY_INT ("directories", job->directories),
+	                         XMMSV_DICT_ENTRY_INT ("files", job->files),
+	                         XMMSV_DICT_ENTRY_INT ("added", job->added),
+	                         XMMSV_DICT_ENTRY_INT ("errors", job->errors),
+	                         XMMSV_DICT_END);
+}
+
+/**
+ * The thread of a job, adding the files found in batches until all
+ * directories are browsed or the job is cancelled.
+ */
+static gpointer
+xmms_medialib_import_run (gpointer data)
+{
+	xmms_medialib_import_job_t *job = (xmms_medialib_import_job_t *) data;
+	xmms_medialib_importer_t *importer = job->importer;
+	xmms_medialib_t *medialib = importer->medialib;
+	xmmsv_t *progress;
+	GPtrArray *batch;
+	gint64 now, last = 0;
+	guint added;
+
+	batch = g_ptr_array_new_with_free_func (g_free);
+
+	g_mutex_lock (&importer->mutex);
+
+	for (;;) {
+		if (job->pending == 0 && (job->cancelled || g_queue_is_empty (&job->urls))) {
+			break;
+		}
+
+		/* Wait for a full batch unless browsing is done */
+		if (job->cancelled || (job->pending > 0 && g_queue_get_length (&job->urls) < importer->batch_size)) {
+			g_cond_wait (&importer->cond, &importer->mutex);
+			continue;
+		}
+
+		while (batch->len < importer->batch_size && !g_queue_is_empty (&job->urls)) {
+			g_ptr_array_add (batch, g_queue_pop_head (&job->urls));
+		}
+
+		g_mutex_unlock (&importer->mutex);
+
+		added = xmms_medialib_add_encoded_batch (medialib,
+		                                         (const gchar **) batch->pdata,
+		                                         batch->len, NULL);
+		g_ptr_array_set_size (batch, 0);
+
+		g_mutex_lock (&importer->mutex);
+
+		job->added += added;
+
+		now = g_get_monotonic_time ();
+		if (now - last >= XMMS_MEDIALIB_IMPORT_PROGRESS_INTERVAL) {
+			last = now;
+
+			progress = xmms_medialib_import_progress (job, "running");
+
+			g_mutex_unlock (&importer->mutex);
+			xmms_object_emit (XMMS_OBJECT (medialib),
+			                  XMMS_IPC_SIGNAL_MEDIALIB_IMPORT_PROGRESS,
+			                  progress);
+			g_mutex_lock (&importer->mutex);
+		}
+	}
+
+	XMMS_DBG ("Import job %d %s: %u files in %u directories, %u new",
+	          job->id, job->cancelled ? "cancelled" : "done",
+	          job->files, job->directories, job->added);
+
+	progress = xmms_medialib_import_progress (job, job->cancelled ? "cancelled" : "done");
+
+	g_hash_table_remove (importer->jobs, GINT_TO_POINTER (job->id));
+
+	g_mutex_unlock (&importer->mutex);
+
+	xmms_object_emit (XMMS_OBJECT (medialib),
+	                  XMMS_IPC_SIGNAL_MEDIALIB_IMPORT_PROGRESS,
+	                  progress);
+
+	xmms_object_unref (medialib);
+
+	g_ptr_array_free (batch, TRUE);
+	while (!g_queue_is_empty (&job->urls)) {
+		g_free (g_queue_pop_head (&job->urls));
+	}
+
+	g_thread_unref (job->thread);
+	g_free (job->path);
+	g_free (job);
+
+	return NULL;
+}
@@ -0,0 +1,516 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Compiled query plans.
+ *
+ * Compiling a collection into an S4 condition means walking the whole
+ * collection DAG, building hash tables for idlists and running the
+ * subqueries of limits and ordered unions. Clients tend to run the same
+ * queries over and over, so compiled plans are kept in a small LRU cache
+ * keyed by the serialized, normalized collection and fetch
+ * specification.
+ *
+ * A plan only owns copies of what it was compiled from, so a cached plan
+ * can't be affected by later changes to the collections. Plans with
+ * limits or ordered unions depend on the medialib contents as well, and
+ * are dropped whenever an entry is added, changed or removed. Plans
+ * whose limits or ordered unions are shuffled without a seed are never
+ * cached. All plans are dropped when a collection changes.
+ *
+ * A plan is only used by one query at a time. A query that finds its
+ * plan busy compiles a private one instead of waiting for it.
+ */
+
+#include <string.h>
+
+#include <xmmspriv/xmms_medialib_plan.h>
+#include <xmms/xmms_log.h>
+
+struct xmms_medialib_plan_St {
+	gint ref;
+	gboolean busy;
+
+	/* serialized normalized collection and fetch spec */
+	xmmsv_t *key;
+	const guchar *key_data;
+	guint key_len;
+	guint hash;
+
+	/* normalized collection and fetch spec, owned by the plan */
+	xmmsv_t *coll;
+	xmmsv_t *fetch;
+
+	xmms_fetch_info_t *info;
+	xmms_fetch_spec_t *spec;
+	s4_condition_t *cond;
+	xmmsv_t *order;
+
+	gboolean data_dependent;
+	guint nodes;
+	gint64 compile_time;
+	guint64 hits;
+
+	/* position in the LRU list of the cache */
+	GList *link;
+};
+
+struct xmms_medialib_plan_cache_St {
+	GMutex mutex;
+
+	GHashTable *plans;
+	/* most recently used first */
+	GQueue lru;
+	guint capacity;
+
+	/* bumped every time the medialib contents change */
+	guint generation;
+
+	guint64 hits;
+	guint64 misses;
+	guint64 uncached;
+	guint64 evictions;
+	guint64 invalidations;
+};
+
+static guint
+xmms_medialib_plan_hash (gconstpointer key)
+{
+	const xmms_medialib_plan_t *plan = key;
+	return plan->hash;
+}
+
+static gboolean
+xmms_medialib_plan_equal (gconstpointer a, gconstpointer b)
+{
+	const xmms_medialib_plan_t *x = a, *y = b;
+
+	return x->key_len == y->key_len &&
+	       memcmp (x->key_data, y->key_data, x->key_len) == 0;
+}
+
+/* Serialize the normalized collection and fetch spec into the cache key */
+static gboolean
+xmms_medialib_plan_key (xmms_medialib_plan_t *plan, xmmsv_t *coll, xmmsv_t *fetch)
+{
+	xmmsv_t *list;
+	guint i, hash = 5381;
+
+	list = xmmsv_build_list (XMMSV_LIST_ENTRY (xmmsv_ref (coll)),
+	                         XMMSV_LIST_ENTRY (xmmsv_ref (fetch)),
+	                         XMMSV_LIST_END);
+	plan->key = xmmsv_serialize (list);
+	xmmsv_unref (list);
+
+	if (plan->key == NULL ||
+	    !xmmsv_get_bin (plan->key, &plan->key_data, &plan->key_len)) {
+		return FALSE;
+	}
+
+	for (i = 0; i < plan->key_len; i++) {
+		hash = hash * 33 + plan->key_data[i];
+	}
+	plan->hash = hash;
+
+	return TRUE;
+}
+
+static guint
+xmms_medialib_plan_count_nodes (xmmsv_t *coll)
+{
+	xmmsv_t *operand;
+	guint ret = 1;
+	gint i;
+
+	for (i = 0; xmmsv_list_get (xmmsv_coll_operands_get (coll), i, &operand); i++) {
+		ret += xmms_medialib_plan_count_nodes (operand);
+	}
+
+	return ret;
+}
+
+static void
+xmms_medialib_plan_free (xmms_medialib_plan_t *plan)
+{
+	if (plan->cond != NULL)
+		s4_cond_free (plan->cond);
+	if (plan->order != NULL)
+		xmmsv_unref (plan->order);
+	if (plan->spec != NULL)
+		xmms_fetch_spec_free (plan->spec);
+	if (plan->info != NULL)
+		xmms_fetch_info_free (plan->info);
+	if (plan->key != NULL)
+		xmmsv_unref (plan->key);
+
+	xmmsv_unref (plan->coll);
+	xmmsv_unref (plan->fetch);
+
+	g_free (plan);
+}
+
+/* Must be called with the cache locked, if the plan was handed out by one */
+static void
+xmms_medialib_plan_unref_unlocked (xmms_medialib_plan_t *plan)
+{
+	if (--plan->ref == 0) {
+		xmms_medialib_plan_free (plan);
+	}
+}
+
+/**
+ * Compile a plan for a normalized collection and fetch spec, taking
+ * over the references to both.
+ */
+static xmms_medialib_plan_t *
+xmms_medialib_plan_compile (xmms_medialib_session_t *session,
+                            xmmsv_t *coll, xmmsv_t *fetch,
+                            xmms_error_t *err)
+{
+	s4_sourcepref_t *sourcepref;
+	xmms_medialib_plan_t *plan;
+	gint64 start;
+
+	plan = g_new0 (xmms_medialib_plan_t, 1);
+	plan->ref = 1;
+	plan->coll = coll;
+	plan->fetch = fetch;
+
+	sourcepref = xmms_medialib_session_get_source_preferences (session);
+
+	plan->info = xmms_fetch_info_new (sourcepref);
+	plan->spec = xmms_fetch_spec_new (plan->fetch, plan->info, sourcepref, err);
+
+	s4_sourcepref_unref (sourcepref);
+
+	if (plan->spec == NULL) {
+		xmms_medialib_plan_free (plan);
+		return NULL;
+	}
+
+	start = g_get_monotonic_time ();
+
+	plan->order = xmmsv_new_list ();
+	plan->cond = xmms_medialib_query_compile (session, plan->coll,
+	                                          plan->info, plan->order);
+
+	plan->compile_time = g_get_monotonic_time () - start;
+	plan->nodes = xmms_medialib_plan_count_nodes (plan->coll);
+
+	return plan;
+}
+
+/* Must be called with the cache locked */
+static void
+xmms_medialib_plan_cache_remove (xmms_medialib_plan_cache_t *cache,
+                                 xmms_medialib_plan_t *plan)
+{
+	g_hash_table_remove (cache->plans, plan);
+	g_queue_delete_link (&cache->lru, plan->link);
+	plan->link = NULL;
+
+	xmms_medialib_plan_unref_unlocked (plan);
+}
+
+/* Must be called with the cache locked */
+static void
+xmms_medialib_plan_cache_trim (xmms_medialib_plan_cache_t *cache)
+{
+	xmms_medialib_plan_t *plan;
+
+	while (g_queue_get_length (&cache->lru) > cache->capacity) {
+		plan = g_queue_peek_tail (&cache->lru);
+		xmms_medialib_plan_cache_remove (cache, plan);
+		cache->evictions++;
+	}
+}
+
+/**
+ * Create a new plan cache.
+ *
+ * @param capacity The number of plans to keep, 0 disables the cache.
+ */
+xmms_medialib_plan_cache_t *
+xmms_medialib_plan_cache_new (guint capacity)
+{
+	xmms_medialib_plan_cache_t *cache;
+
+	cache = g_new0 (xmms_medialib_plan_cache_t, 1);
+	g_mutex_init (&cache->mutex);
+	g_queue_init (&cache->lru);
+
+	cache->plans = g_hash_table_new (xmms_medialib_plan_hash,
+	                                 xmms_medialib_plan_equal);
+	cache->capacity = capacity;
+
+	return cache;
+}
+
+void
+xmms_medialib_plan_cache_free (xmms_medialib_plan_cache_t *cache)
+{
+	g_return_if_fail (cache);
+
+	xmms_medialib_plan_cache_set_capacity (cache, 0);
+
+	g_hash_table_destroy (cache->plans);
+	g_mutex_clear (&cache->mutex);
+	g_free (cache);
+}
+
+void
+xmms_medialib_plan_cache_set_capacity (xmms_medialib_plan_cache_t *cache,
+                                       guint capacity)
+{
+	g_return_if_fail (cache);
+
+	g_mutex_lock (&cache->mutex);
+	cache->capacity = capacity;
+	xmms_medialib_plan_cache_trim (cache);
+	g_mutex_unlock (&cache->mutex);
+}
+
+/**
+ * Get the generation of the medialib contents. It changes every time
+ * the cache is invalidated because the contents changed.
+ */
+guint
+xmms_medialib_plan_cache_generation (xmms_medialib_plan_cache_t *cache)
+{
+	guint ret;
+
+	g_return_val_if_fail (cache, 0);
+
+	g_mutex_lock (&cache->mutex);
+	ret = cache->generation;
+	g_mutex_unlock (&cache->mutex);
+
+	return ret;
+}
+
+/**
+ * Drop cached plans.
+ *
+ * @param data_changed TRUE if the medialib contents changed, which only
+ * affects plans that queried the medialib while being compiled. FALSE
+ * if a collection changed, which drops all plans.
+ */
+void
+xmms_medialib_plan_cache_invalidate (xmms_medialib_plan_cache_t *cache,
+                                     gboolean data_changed)
+{
+	xmms_medialib_plan_t *plan;
+	GList *l, *next;
+
+	g_return_if_fail (cache);
+
+	g_mutex_lock (&cache->mutex);
+
+	if (data_changed) {
+		cache->generation++;
+	}
+
+	for (l = cache->lru.head; l != NULL; l = next) {
+		next = l->next;
+		plan = l->data;
+
+		if (!data_changed || plan->data_dependent) {
+			xmms_medialib_plan_cache_remove (cache, plan);
+			cache->invalidations++;
+		}
+	}
+
+	g_mutex_unlock (&cache->mutex);
+}
+
+/**
+ * Get a plan for querying a collection. The plan is either taken from
+ * the cache or compiled, and must be given back with
+ * #xmms_medialib_plan_unref once it has been run.
+ *
+ * @param coll The collection to query, with its references bound
+ * @param fetch The fetch specification
+ * @param err Set if the fetch specification is invalid
+ * @return A plan, or NULL on error
+ */
+xmms_medialib_plan_t *
+xmms_medialib_plan_cache_get (xmms_medialib_plan_cache_t *cache,
+                              xmms_medialib_session_t *session,
+                              xmmsv_t *coll, xmmsv_t *fetch,
+                              xmms_error_t *err)
+{
+	xmms_medialib_plan_t probe, *plan, *cached = NULL;
+	gboolean data_dependent, uncacheable, keyed;
+	xmmsv_t *normalized_coll, *normalized_fetch;
+
+	g_return_val_if_fail (cache, NULL);
+
+	normalized_coll = xmms_medialib_query_normalize (coll, &data_dependent,
+	                                                 &uncacheable);
+	normalized_fetch = xmms_medialib_query_normalize_value (fetch);
+
+	/* a plan that shuffles while compiling must be compiled every time */
+	memset (&probe, 0, sizeof (probe));
+	keyed = !uncacheable &&
+	        xmms_medialib_plan_key (&probe, normalized_coll, normalized_fetch);
+
+	g_mutex_lock (&cache->mutex);
+
+	if (keyed) {
+		cached = g_hash_table_lookup (cache->plans, &probe);
+	}
+
+	if (cached != NULL && !cached->busy) {
+		cached->busy = TRUE;
+		cached->ref++;
+		cached->hits++;
+		cache->hits++;
+
+		g_queue_unlink (&cache->lru, cached->link);
+		g_queue_push_head_link (&cache->lru, cached->link);
+
+		g_mutex_unlock (&cache->mutex);
+
+		if (probe.key != NULL)
+			xmmsv_unref (probe.key);
+		xmmsv_unref (normalized_coll);
+		xmmsv_unref (normalized_fetch);
+
+		return cached;
+	}
+
+	cache->misses++;
+
+	g_mutex_unlock (&cache->mutex);
+
+	plan = xmms_medialib_plan_compile (session, normalized_coll,
+	                                   normalized_fetch, err);
+	if (plan == NULL) {
+		if (probe.key != NULL)
+			xmmsv_unref (probe.key);
+		return NULL;
+	}
+
+	plan->key = probe.key;
+	plan->key_data = probe.key_data;
+	plan->key_len = probe.key_len;
+	plan->hash = probe.hash;
+	plan->data_dependent = data_dependent;
+	plan->busy = TRUE;
+
+	g_mutex_lock (&cache->mutex);
+
+	/* A plan that queried the medialib is only kept if the session saw
+	 * the contents of the current generation, and nothing else.
+	 */
+	if (!keyed || cache->capacity == 0 ||
+	    g_hash_table_lookup (cache->plans, plan) != NULL ||
+	    (data_dependent && (xmms_medialib_session_is_dirty (session) ||
+	                        xmms_medialib_session_get_generation (session) != cache->generation))) {
+		cache->uncached++;
+	} else {
+		g_hash_table_insert (cache->plans, plan, plan);
+		g_queue_push_head (&cache->lru, plan);
+		plan->link = cache->lru.head;
+		plan->ref++;
+
+		xmms_medialib_plan_cache_trim (cache);
+	}
+
+	g_mutex_unlock (&cache->mutex);
+
+	return plan;
+}
+
+/**
+ * Run a plan in a session.
+ *
+ * @return The result, structured as requested by the fetch spec
+ */
+xmmsv_t *
+xmms_medialib_plan_run (xmms_medialib_plan_t *plan,
+                        xmms_medialib_session_t *session)
+{
+	s4_resultset_t *set;
+	xmmsv_t *ret;
+
+	g_return_val_if_fail (plan, NULL);
+
+	set = xmms_medialib_query_execute (session, plan->cond, plan->info,
+	                                   plan->order);
+	ret = xmms_medialib_query_to_xmmsv (set, plan->spec);
+	s4_resultset_free (set);
+
+	return ret;
+}
+
+/**
+ * Give a plan back to the cache it was taken from.
+ */
+void
+xmms_medialib_plan_unref (xmms_medialib_plan_cache_t *cache,
+                          xmms_medialib_plan_t *plan)
+{
+	g_return_if_fail (cache);
+	g_return_if_fail (plan);
+
+	g_mutex_lock (&cache->mutex);
+	plan->busy = FALSE;
+	xmms_medialib_plan_unref_unlocked (plan);
+	g_mutex_unlock (&cache->mutex);
+}
+
+/**
+ * Get statistics about the cache and the plans in it.
+ */
+xmmsv_t *
+xmms_medialib_plan_cache_stats (xmms_medialib_plan_cache_t *cache)
+{
+	xmms_medialib_plan_t *plan;
+	xmmsv_t *ret, *plans, *dict;
+	GList *l;
+
+	g_return_val_if_fail (cache, NULL);
+
+	plans = xmmsv_new_list ();
+
+	g_mutex_lock (&cache->mutex);
+
+	for (l = cache->lru.head; l != NULL; l = l->next) {
+		plan = l->data;
+		dict = xmmsv_build_dict (XMMSV_DICT_ENTRY_INT ("hits", plan->hits),
+		                         XMMSV_DICT_ENTRY_INT ("nodes", plan->nodes),
+		                         XMMSV_DICT_ENTRY_INT ("data_dependent", plan->data_dependent),
+		                         XMMSV_DICT_ENTRY_INT ("compile_time", plan->compile_time),
+		                         XMMSV_DICT_END);
+		xmmsv_list_append (plans, dict);
+		xmmsv_unref (dict);
+	}
+
+	ret = xmmsv_build_dict (XMMSV_DICT_ENTRY_INT ("capacity", cache->capacity),
+	                        XMMSV_DICT_ENTRY_INT ("size", g_queue_get_length (&cache->lru)),
+	                        XMMSV_DICT_ENTRY_INT ("hits", cache->hits),
+	                        XMMSV_DICT_ENTRY_INT ("misses", cache->misses),
+	                        XMMSV_DICT_ENTRY_INT ("uncached", cache->uncached),
+	                        XMMSV_DICT_ENTRY_INT ("evictions", cache->evictions),
+	                        XMMSV_DICT_ENTRY_INT ("invalidations", cache->invalidations),
+	                        XMMSV_DICT_ENTRY ("plans", plans),
+	                        XMMSV_DICT_END);
+
+	g_mutex_unlock (&cache->mutex);
+
+	return ret;
+}
@@ -956,6 +956,438 @@ collection_to_condition (xmms_medialib_session_t *session, xmmsv_t *coll,
 	}
 }
 
+static gint
+compare_strings (gconstpointer a, gconstpointer b)
+{
+	return strcmp (a, b);
+}
+
+/**
+ * Deep copy a value, inserting dict keys in sorted order so that equal
+ * values serialize to the same bytes.
+ *
+ * @param value The value to copy
+ * @return A new value that shares nothing with the original
+ */
+xmmsv_t *
+xmms_medialib_query_normalize_value (xmmsv_t *value)
+{
+	xmmsv_dict_iter_t *it;
+	xmmsv_t *ret, *entry, *copy;
+	GList *keys = NULL, *k;
+	const gchar *key;
+	gint i;
+
+	switch (xmmsv_get_type (value)) {
+		case XMMSV_TYPE_DICT:
+			xmmsv_get_dict_iter (value, &it);
+			while (xmmsv_dict_iter_pair (it, &key, NULL)) {
+				keys = g_list_prepend (keys, (gpointer) key);
+				xmmsv_dict_iter_next (it);
+			}
+			keys = g_list_sort (keys, compare_strings);
+
+			ret = xmmsv_new_dict ();
+			for (k = keys; k != NULL; k = k->next) {
+				xmmsv_dict_get (value, k->data, &entry);
+				copy = xmms_medialib_query_normalize_value (entry);
+				xmmsv_dict_set (ret, k->data, copy);
+				xmmsv_unref (copy);
+			}
+			g_list_free (keys);
+			return ret;
+		case XMMSV_TYPE_LIST:
+			ret = xmmsv_new_list ();
+			for (i = 0; xmmsv_list_get (value, i, &entry); i++) {
+				copy = xmms_medialib_query_normalize_value (entry);
+				xmmsv_list_append (ret, copy);
+				xmmsv_unref (copy);
+			}
+			return ret;
+		default:
+			return xmmsv_copy (value);
+	}
+}
+
+typedef struct {
+	/* bound reference targets, and what they were normalized to */
+	GHashTable *references;
+	gboolean data_dependent;
+	/* an order is random without a seed */
+	gboolean random;
+} xmms_query_normalizer_t;
+
+static xmmsv_t *normalize_collection (xmms_query_normalizer_t *normalizer, xmmsv_t *coll);
+
+static gboolean
+is_filter (xmmsv_t *coll)
+{
+	switch (xmmsv_coll_get_type (coll)) {
+		case XMMS_COLLECTION_TYPE_HAS:
+		case XMMS_COLLECTION_TYPE_MATCH:
+		case XMMS_COLLECTION_TYPE_TOKEN:
+		case XMMS_COLLECTION_TYPE_EQUALS:
+		case XMMS_COLLECTION_TYPE_NOTEQUAL:
+		case XMMS_COLLECTION_TYPE_SMALLER:
+		case XMMS_COLLECTION_TYPE_SMALLEREQ:
+		case XMMS_COLLECTION_TYPE_GREATER:
+		case XMMS_COLLECTION_TYPE_GREATEREQ:
+			return TRUE;
+		default:
+			return FALSE;
+	}
+}
+
+/* Copy a collection node without its operands */
+static xmmsv_t *
+normalize_node (xmmsv_t *coll)
+{
+	xmmsv_t *ret, *copy;
+
+	ret = xmmsv_new_coll (xmmsv_coll_get_type (coll));
+
+	copy = xmms_medialib_query_normalize_value (xmmsv_coll_attributes_get (coll));
+	xmmsv_coll_attributes_set (ret, copy);
+	xmmsv_unref (copy);
+
+	if (xmmsv_coll_idlist_get_size (coll) > 0) {
+		copy = xmmsv_copy (xmmsv_coll_idlist_get (coll));
+		xmmsv_coll_idlist_set (ret, copy);
+		xmmsv_unref (copy);
+	}
+
+	return ret;
+}
+
+/* Normalized collections are equal if they serialize to the same bytes */
+static gboolean
+normalized_equal (xmmsv_t *a, xmmsv_t *b)
+{
+	const guchar *adata, *bdata;
+	guint alen, blen;
+	xmmsv_t *x, *y;
+	gboolean ret;
+
+	if (a == b)
+		return TRUE;
+
+	if (xmmsv_coll_get_type (a) != xmmsv_coll_get_type (b))
+		return FALSE;
+
+	x = xmmsv_serialize (a);
+	y = xmmsv_serialize (b);
+
+	ret = x != NULL && y != NULL &&
+	      xmmsv_get_bin (x, &adata, &alen) &&
+	      xmmsv_get_bin (y, &bdata, &blen) &&
+	      alen == blen && memcmp (adata, bdata, alen) == 0;
+
+	if (x != NULL)
+		xmmsv_unref (x);
+	if (y != NULL)
+		xmmsv_unref (y);
+
+	return ret;
+}
+
+/* Append an operand unless an equal one is already there */
+static void
+normalize_append_unique (xmmsv_t *operands, xmmsv_t *operand)
+{
+	xmmsv_t *other;
+	gint i;
+
+	for (i = 0; xmmsv_list_get (operands, i, &other); i++) {
+		if (normalized_equal (other, operand)) {
+			return;
+		}
+	}
+
+	xmmsv_list_append (operands, operand);
+}
+
+/* Replace a single operand set operation by its operand */
+static xmmsv_t *
+normalize_collapse (xmmsv_t *coll)
+{
+	xmmsv_t *operands, *operand;
+
+	operands = xmmsv_coll_operands_get (coll);
+	if (xmmsv_list_get_size (operands) == 1) {
+		xmmsv_list_get (operands, 0, &operand);
+		xmmsv_ref (operand);
+		xmmsv_unref (coll);
+		return operand;
+	}
+
+	return coll;
+}
+
+/* Intersection only takes the ordering from the first operand, so nested
+ * intersections can be spliced in place, later universes can be dropped
+ * and later duplicates too.
+ */
+static xmmsv_t *
+normalize_intersection (xmms_query_normalizer_t *normalizer, xmmsv_t *coll)
+{
+	xmmsv_t *ret, *operands, *operand, *child, *nested;
+	gint i, j;
+
+	ret = normalize_node (coll);
+	operands = xmmsv_coll_operands_get (ret);
+
+	for (i = 0; xmmsv_list_get (xmmsv_coll_operands_get (coll), i, &operand); i++) {
+		child = normalize_collection (normalizer, operand);
+
+		if (xmmsv_coll_is_type (child, XMMS_COLLECTION_TYPE_INTERSECTION)) {
+			for (j = 0; xmmsv_list_get (xmmsv_coll_operands_get (child), j, &nested); j++) {
+				if (xmmsv_list_get_size (operands) > 0 &&
+				    xmmsv_coll_is_type (nested, XMMS_COLLECTION_TYPE_UNIVERSE))
+					continue;
+				normalize_append_unique (operands, nested);
+			}
+		} else if (xmmsv_list_get_size (operands) == 0 ||
+		           !xmmsv_coll_is_type (child, XMMS_COLLECTION_TYPE_UNIVERSE)) {
+			normalize_append_unique (operands, child);
+		}
+
+		xmmsv_unref (child);
+	}
+
+	return normalize_collapse (ret);
+}
+
+/* An ordered union concatenates its operands, duplicates included, so
+ * only unordered unions can be flattened and deduplicated.
+ */
+static xmmsv_t *
+normalize_union (xmms_query_normalizer_t *normalizer, xmmsv_t *coll)
+{
+	xmmsv_t *ret, *children, *operands, *child, *nested;
+	gboolean ordered = TRUE;
+	gint i, j;
+
+	children = xmmsv_new_list ();
+	for (i = 0; xmmsv_list_get (xmmsv_coll_operands_get (coll), i, &child); i++) {
+		child = normalize_collection (normalizer, child);
+		ordered = ordered && has_order (child);
+		xmmsv_list_append (children, child);
+		xmmsv_unref (child);
+	}
+
+	ret = normalize_node (coll);
+	operands = xmmsv_coll_operands_get (ret);
+
+	for (i = 0; xmmsv_list_get (children, i, &child); i++) {
+		if (ordered) {
+			xmmsv_list_append (operands, child);
+		} else if (xmmsv_coll_is_type (child, XMMS_COLLECTION_TYPE_UNION)) {
+			for (j = 0; xmmsv_list_get (xmmsv_coll_operands_get (child), j, &nested); j++) {
+				normalize_append_unique (operands, nested);
+			}
+		} else {
+			normalize_append_unique (operands, child);
+		}
+	}
+
+	xmmsv_unref (children);
+
+	ret = normalize_collapse (ret);
+
+	/* the operands are queried while compiling */
+	if (xmmsv_coll_is_type (ret, XMMS_COLLECTION_TYPE_UNION) && ordered) {
+		normalizer->data_dependent = TRUE;
+	}
+
+	return ret;
+}
+
+/* A filter keeps the ordering of its operand, so filter(order(x)) is the
+ * same as order(filter(x)). Filters are pushed below orders so that both
+ * forms end up as the same plan.
+ */
+static xmmsv_t *
+normalize_filter (xmmsv_t *filter, xmmsv_t *operand)
+{
+	xmmsv_t *ret, *inner, *child;
+
+	if (!xmmsv_coll_is_type (operand, XMMS_COLLECTION_TYPE_ORDER) ||
+	    !xmmsv_list_get (xmmsv_coll_operands_get (operand), 0, &child)) {
+		ret = normalize_node (filter);
+		xmmsv_list_append (xmmsv_coll_operands_get (ret), operand);
+		return ret;
+	}
+
+	inner = normalize_filter (filter, child);
+
+	ret = normalize_node (operand);
+	xmmsv_list_append (xmmsv_coll_operands_get (ret), inner);
+	xmmsv_unref (inner);
+
+	return ret;
+}
+
+static xmmsv_t *
+normalize_reference (xmms_query_normalizer_t *normalizer, xmmsv_t *coll)
+{
+	xmmsv_t *target, *ret;
+
+	if (is_universe (coll)) {
+		return xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE);
+	}
+
+	if (!xmmsv_list_get (xmmsv_coll_operands_get (coll), 0, &target)) {
+		/* left for reference_condition to complain about */
+		return normalize_node (coll);
+	}
+
+	/* A collection referenced many times is only normalized once */
+	ret = g_hash_table_lookup (normalizer->references, target);
+	if (ret == NULL) {
+		ret = normalize_collection (normalizer, target);
+		g_hash_table_insert (normalizer->references, target, ret);
+	}
+
+	return xmmsv_ref (ret);
+}
+
+/* A random order without a seed shuffles differently every time */
+static gboolean
+is_unseeded_random (xmmsv_t *coll)
+{
+	const gchar *type;
+	gint seed;
+
+	return xmmsv_coll_attribute_get_string (coll, "type", &type) &&
+	       strcmp (type, "random") == 0 &&
+	       !xmms_collection_get_int_attr (coll, "seed", &seed);
+}
+
+static xmmsv_t *
+normalize_collection (xmms_query_normalizer_t *normalizer, xmmsv_t *coll)
+{
+	xmmsv_t *ret, *operand, *child;
+	gint i;
+
+	if (is_filter (coll) && xmmsv_list_get (xmmsv_coll_operands_get (coll), 0, &operand)) {
+		child = normalize_collection (normalizer, operand);
+		ret = normalize_filter (coll, child);
+		xmmsv_unref (child);
+		return ret;
+	}
+
+	switch (xmmsv_coll_get_type (coll)) {
+		case XMMS_COLLECTION_TYPE_REFERENCE:
+			return normalize_reference (normalizer, coll);
+		case XMMS_COLLECTION_TYPE_INTERSECTION:
+			return normalize_intersection (normalizer, coll);
+		case XMMS_COLLECTION_TYPE_UNION:
+			return normalize_union (normalizer, coll);
+		case XMMS_COLLECTION_TYPE_LIMIT:
+			/* the operand is queried while compiling */
+			normalizer->data_dependent = TRUE;
+			break;
+		case XMMS_COLLECTION_TYPE_ORDER:
+			if (is_unseeded_random (coll))
+				normalizer->random = TRUE;
+			break;
+		default:
+			break;
+	}
+
+	ret = normalize_node (coll);
+	for (i = 0; xmmsv_list_get (xmmsv_coll_operands_get (coll), i, &operand); i++) {
+		child = normalize_collection (normalizer, operand);
+		xmmsv_list_append (xmmsv_coll_operands_get (ret), child);
+		xmmsv_unref (child);
+	}
+
+	return ret;
+}
+
+/**
+ * Rewrite a collection into the canonical form a query plan is compiled
+ * from. References are replaced by what they point to, nested
+ * intersections and unordered unions are flattened, duplicate operands
+ * are dropped and filters are pushed below orderings. The result
+ * matches the same media in the same order as the original.
+ *
+ * Filters are not pushed below limits as that would change which media
+ * the limit picks.
+ *
+ * @param coll The collection, with its references bound
+ * @param data_dependent Set to TRUE if compiling the collection queries
+ * the medialib, for example to resolve a limit, so that the compiled
+ * condition depends on the contents of the medialib
+ * @param uncacheable Set to TRUE if the medialib is queried while
+ * compiling and the collection has a random order without a seed, as
+ * the compiled condition then differs every time, or NULL
+ * @return A new collection that shares nothing with coll
+ */
+xmmsv_t *
+xmms_medialib_query_normalize (xmmsv_t *coll, gboolean *data_dependent,
+                               gboolean *uncacheable)
+{
+	xmms_query_normalizer_t normalizer;
+	xmmsv_t *ret;
+
+	normalizer.references = g_hash_table_new_full (NULL, NULL, NULL,
+	                                               (GDestroyNotify) xmmsv_unref);
+	normalizer.data_dependent = FALSE;
+	normalizer.random = FALSE;
+
+	ret = normalize_collection (&normalizer, coll);
+
+	g_hash_table_destroy (normalizer.references);
+
+	if (data_dependent != NULL) {
+		*data_dependent = normalizer.data_dependent;
+	}
+
+	/* Random orders are applied when the query runs, unless they are
+	 * part of a subquery run while compiling. Which one a subquery
+	 * uses isn't tracked, so any random order counts. */
+	if (uncacheable != NULL) {
+		*uncacheable = normalizer.data_dependent && normalizer.random;
+	}
+
+	return ret;
+}
+
+/**
+ * Compile a collection into an S4 condition.
+ *
+ * @param coll The collection to compile
+ * @param fetch Information on what is being fetched, columns needed
+ * for ordering and limits are added to it
+ * @param order A list that will be filled in with the ordering to apply
+ * to the result of the condition with #xmms_medialib_query_execute
+ * @return A new S4 condition. Must be freed with s4_cond_free
+ */
+s4_condition_t *
+xmms_medialib_query_compile (xmms_medialib_session_t *session, xmmsv_t *coll,
+                             xmms_fetch_info_t *fetch, xmmsv_t *order)
+{
+	return collection_to_condition (session, coll, fetch, order);
+}
+
+/**
+ * Run a compiled condition and order the result.
+ *
+ * @return An S4 resultset. Must be freed with s4_resultset_free
+ */
+s4_resultset_t *
+xmms_medialib_query_execute (xmms_medialib_session_t *session,
+                             s4_condition_t *cond, xmms_fetch_info_t *fetch,
+                             xmmsv_t *order)
+{
+	s4_resultset_t *ret;
+
+	ret = xmms_medialib_session_query (session, fetch->fs, cond);
+
+	return xmms_medialib_result_sort (ret, fetch, order);
+}
+
 /**
  * Internal function that does the actual querying.
  *
@@ -975,12 +1407,10 @@ xmms_medialib_query_recurs (xmms_medialib_session_t *session,
 
 	order = xmmsv_new_list ();
 
-	cond = collection_to_condition (session, coll, fetch, order);
-	ret = xmms_medialib_session_query (session, fetch->fs, cond);
+	cond = xmms_medialib_query_compile (session, coll, fetch, order);
+	ret = xmms_medialib_query_execute (session, cond, fetch, order);
 	s4_cond_free (cond);
 
-	ret = xmms_medialib_result_sort (ret, fetch, order);
-
 	xmmsv_unref (order);
 
 	return ret;
@@ -20,6 +20,7 @@
 
 #include <glib.h>
 #include <glib/gstdio.h>
+#include <string.h>
 
 xmmsv_t *xmms_medialib_query_to_xmmsv (s4_resultset_t *set, xmms_fetch_spec_t *spec);
 
@@ -38,6 +39,51 @@ typedef struct {
 	xmmsv_t *list;
 } set_data_t;
 
+/* A value read from a result, either a string or an integer */
+typedef struct {
+	const gchar *str;
+	gint32 num;
+} query_value_t;
+
+/* The aggregated state of all results with the same keys */
+typedef struct {
+	guint hash;
+	gint count;
+	gint64 sum;
+	query_value_t value;
+	/* first and last collected value + 1, 0 for none */
+	guint first;
+	guint last;
+} query_group_t;
+
+/* A value collected by the list and set aggregates */
+typedef struct {
+	query_value_t value;
+	/* the next value of the same group + 1, 0 for none */
+	guint next;
+} query_item_t;
+
+/* Results aggregated in flat arrays before any xmmsv_t is created */
+typedef struct {
+	xmms_fetch_spec_t *spec;
+	gint depth;
+	/* groups in the order they were first seen, and their keys */
+	GArray *groups;
+	GArray *keys;
+	/* open addressing index of group numbers + 1, 0 for a free slot */
+	guint *index;
+	guint mask;
+	/* the group last looked up + 1, results of a group often follow each other */
+	guint last;
+	/* values of the list and set aggregates, chained by group */
+	GArray *items;
+	/* values already in the set being created */
+	GHashTable *seen_ints;
+	GHashTable *seen_strings;
+	/* which kinds of keys each level has, 1 for integers, 2 for strings */
+	guint8 kinds[METADATA_END - 1];
+} query_columns_t;
+
 static xmmsv_t *
 aggregate_first (xmmsv_t *current, gint int_value, const gchar *str_value)
 {
@@ -240,6 +286,8 @@ result_to_xmmsv (xmmsv_t *ret, gint32 id, const s4_result_t *res,
 	const gchar *str_value, *key = NULL;
 	gint32 i, int_value;
 	xmmsv_t *newval;
+	/* Big enough to hold 2^32 with minus sign */
+	gchar buf[12];
 
 	g_return_val_if_fail (spec->data.metadata.get_size > 0, ret);
 	g_return_val_if_fail (spec->data.metadata.get_size <= METADATA_END, ret);
@@ -288,8 +336,6 @@ result_to_xmmsv (xmmsv_t *ret, gint32 id, const s4_result_t *res,
 			if (i < (spec->data.metadata.get_size - 1)) {
 				/* Convert integers to strings */
 				if (str_value == NULL) {
-					/* Big enough to hold 2^32 with minus sign */
-					gchar buf[12];
 					g_sprintf (buf, "%i", int_value);
 					key = buf;
 				} else {
@@ -443,9 +489,9 @@ aggregate_result (xmmsv_t *val, gint depth, aggregate_function_t aggr_func)
 	return val;
 }
 
-/* Converts an S4 resultset to an xmmsv using the fetch specification */
+/* Converts an S4 resultset to an xmmsv one value at a time */
 static xmmsv_t *
-metadata_to_xmmsv (s4_resultset_t *set, xmms_fetch_spec_t *spec)
+metadata_to_xmmsv_by_row (s4_resultset_t *set, xmms_fetch_spec_t *spec)
 {
 	const s4_resultrow_t *row;
 	xmmsv_t *ret = NULL;
@@ -469,6 +515,489 @@ metadata_to_xmmsv (s4_resultset_t *set, xmms_fetch_spec_t *spec)
 	                         spec->data.metadata.aggr_func);
 }
 
+static guint
+query_keys_hash (const query_value_t *keys, gint depth)
+{
+	guint hash = 0;
+	gint i;
+
+	for (i = 0; i < depth; i++) {
+		if (keys[i].str != NULL) {
+			hash = hash * 31 + g_str_hash (keys[i].str);
+		} else {
+			hash = hash * 31 + (guint) keys[i].num * 2654435761U;
+		}
+	}
+
+	return hash ^ (hash >> 16);
+}
+
+static gboolean
+query_keys_equal (const query_value_t *a, const query_value_t *b, gint depth)
+{
+	gint i;
+
+	for (i = 0; i < depth; i++) {
+		if (a[i].str == NULL || b[i].str == NULL) {
+			if (a[i].str != b[i].str || a[i].num != b[i].num)
+				return FALSE;
+		} else if (a[i].str != b[i].str && strcmp (a[i].str, b[i].str) != 0) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+/* Reads what is asked for from a result, see result_to_xmmsv */
+static void
+query_value_read (query_value_t *value, gint32 id, const s4_result_t *res,
+                  gint what)
+{
+	const s4_val_t *val;
+
+	value->str = NULL;
+	value->num = 0;
+
+	switch (what) {
+		case METADATA_KEY:
+			value->str = s4_result_get_key (res);
+			break;
+		case METADATA_SOURCE:
+			value->str = s4_result_get_src (res);
+			if (value->str == NULL)
+				value->str = "server";
+			break;
+		case METADATA_ID:
+			value->num = id;
+			break;
+		case METADATA_VALUE:
+			val = s4_result_get_val (res);
+
+			if (!s4_val_get_int (val, &value->num)) {
+				s4_val_get_str (val, &value->str);
+			}
+			break;
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+/* Formats a value as a dict key, buf must hold 12 characters */
+static const gchar *
+query_value_key (const query_value_t *value, gchar *buf)
+{
+	if (value->str != NULL) {
+		return value->str;
+	}
+
+	g_snprintf (buf, 12, "%i", value->num);
+
+	return buf;
+}
+
+static xmmsv_t *
+query_value_to_xmmsv (const query_value_t *value)
+{
+	if (value->str != NULL) {
+		return xmmsv_new_string (value->str);
+	}
+	return xmmsv_new_int (value->num);
+}
+
+/* Doubles the size of the index, the groups keep their hashes */
+static void
+query_columns_grow (query_columns_t *columns)
+{
+	const query_group_t *group;
+	guint i, slot;
+
+	g_free (columns->index);
+
+	columns->mask = columns->mask * 2 + 1;
+	columns->index = g_new0 (guint, columns->mask + 1);
+
+	for (i = 0; i < columns->groups->len; i++) {
+		group = &g_array_index (columns->groups, query_group_t, i);
+		slot = group->hash & columns->mask;
+		while (columns->index[slot] != 0) {
+			slot = (slot + 1) & columns->mask;
+		}
+		columns->index[slot] = i + 1;
+	}
+}
+
+/* Finds the number of the group with the given keys, adding it if needed */
+static guint
+query_columns_lookup (query_columns_t *columns, const query_value_t *keys)
+{
+	const query_value_t *last;
+	const query_group_t *group;
+	guint hash, slot, n;
+	gint i;
+
+	/* strings from the medialib are shared, comparing them is cheap */
+	if (columns->last != 0) {
+		last = &g_array_index (columns->keys, query_value_t,
+		                       (columns->last - 1) * columns->depth);
+		for (i = 0; i < columns->depth; i++) {
+			if (keys[i].str != last[i].str || keys[i].num != last[i].num)
+				break;
+		}
+		if (i == columns->depth) {
+			return columns->last - 1;
+		}
+	}
+
+	hash = query_keys_hash (keys, columns->depth);
+
+	for (slot = hash & columns->mask; columns->index[slot] != 0;
+	     slot = (slot + 1) & columns->mask) {
+		n = columns->index[slot] - 1;
+		group = &g_array_index (columns->groups, query_group_t, n);
+		if (group->hash == hash &&
+		    query_keys_equal (keys, &g_array_index (columns->keys, query_value_t,
+		                                            n * columns->depth),
+		                      columns->depth)) {
+			columns->last = n + 1;
+			return n;
+		}
+	}
+
+	n = columns->groups->len;
+	g_array_set_size (columns->groups, n + 1);
+	g_array_index (columns->groups, query_group_t, n).hash = hash;
+	g_array_append_vals (columns->keys, keys, columns->depth);
+	columns->index[slot] = n + 1;
+	columns->last = n + 1;
+
+	for (i = 0; i < columns->depth; i++) {
+		columns->kinds[i] |= keys[i].str != NULL ? 2 : 1;
+	}
+
+	/* keep the index at most half full */
+	if (columns->groups->len * 2 > columns->mask) {
+		query_columns_grow (columns);
+	}
+
+	return n;
+}
+
+/* Same as the aggregate_* functions, on the state of a group.
+ * The first value is collected by row, see metadata_to_xmmsv.
+ */
+static void
+query_columns_aggregate (query_columns_t *columns, guint n,
+                         const query_value_t *value)
+{
+	query_group_t *group = &g_array_index (columns->groups, query_group_t, n);
+	query_item_t item = { *value, 0 }, *previous;
+
+	switch (columns->spec->data.metadata.aggr_func) {
+		case AGGREGATE_SUM:
+		case AGGREGATE_AVG:
+			/* only applies to numbers */
+			if (value->str == NULL) {
+				group->sum += value->num;
+				group->count++;
+			}
+			break;
+		case AGGREGATE_MAX:
+			if (value->str == NULL &&
+			    (group->count++ == 0 || group->value.num < value->num)) {
+				group->value = *value;
+			}
+			break;
+		case AGGREGATE_MIN:
+			if (value->str == NULL &&
+			    (group->count++ == 0 || group->value.num > value->num)) {
+				group->value = *value;
+			}
+			break;
+		case AGGREGATE_SET:
+		case AGGREGATE_LIST:
+			g_array_append_val (columns->items, item);
+			if (group->last != 0) {
+				previous = &g_array_index (columns->items, query_item_t, group->last - 1);
+				previous->next = columns->items->len;
+			} else {
+				group->first = columns->items->len;
+			}
+			group->last = columns->items->len;
+			group->count++;
+			break;
+		case AGGREGATE_RANDOM:
+			group->count++;
+			if (g_random_int_range (0, group->count) == 0) {
+				group->value = *value;
+			}
+			break;
+		default:
+			g_assert_not_reached ();
+	}
+}
+
+/* Collects the values of a column into the groups of their keys */
+static void
+query_columns_add (query_columns_t *columns, gint32 id, const s4_result_t *res)
+{
+	xmms_fetch_spec_t *spec = columns->spec;
+	query_value_t keys[METADATA_END - 1], value;
+	guint n;
+	gint i;
+
+	/* Loop through all the values the column has */
+	for (; res != NULL; res = s4_result_next (res)) {
+		if (columns->depth == 0) {
+			n = 0;
+			if (columns->groups->len == 0) {
+				g_array_set_size (columns->groups, 1);
+			}
+		} else {
+			for (i = 0; i < columns->depth; i++) {
+				query_value_read (&keys[i], id, res, spec->data.metadata.get[i]);
+			}
+			n = query_columns_lookup (columns, keys);
+		}
+
+		query_value_read (&value, id, res, spec->data.metadata.get[columns->depth]);
+		query_columns_aggregate (columns, n, &value);
+	}
+}
+
+/* Creates the list of a list or set aggregate */
+static xmmsv_t *
+query_group_to_list (query_columns_t *columns, const query_group_t *group,
+                     gboolean unique)
+{
+	GHashTable *seen_ints, *seen_strings;
+	const query_value_t *value;
+	const query_item_t *item;
+	xmmsv_t *ret;
+	guint n;
+
+	/* a single value is always unique */
+	unique = unique && group->count > 1;
+
+	if (unique && columns->seen_ints == NULL) {
+		columns->seen_ints = g_hash_table_new (NULL, NULL);
+		columns->seen_strings = g_hash_table_new (g_str_hash, g_str_equal);
+	}
+	seen_ints = columns->seen_ints;
+	seen_strings = columns->seen_strings;
+
+	/* The list is left unrestricted even if it holds only integers.
+	 * A restricted list would be packed, but clients would also
+	 * receive the restriction. */
+	ret = xmmsv_new_list ();
+
+	for (n = group->first; n != 0; n = item->next) {
+		item = &g_array_index (columns->items, query_item_t, n - 1);
+		value = &item->value;
+
+		if (value->str != NULL) {
+			if (unique) {
+				if (g_hash_table_contains (seen_strings, value->str))
+					continue;
+				g_hash_table_add (seen_strings, (gpointer) value->str);
+			}
+			xmmsv_list_append_string (ret, value->str);
+		} else {
+			if (unique) {
+				if (g_hash_table_contains (seen_ints, GINT_TO_POINTER (value->num)))
+					continue;
+				g_hash_table_add (seen_ints, GINT_TO_POINTER (value->num));
+			}
+			xmmsv_list_append_int (ret, value->num);
+		}
+	}
+
+	if (unique) {
+		g_hash_table_remove_all (seen_ints);
+		g_hash_table_remove_all (seen_strings);
+	}
+
+	return ret;
+}
+
+/* Creates the aggregated value of a group, NULL if there is none */
+static xmmsv_t *
+query_group_to_xmmsv (query_columns_t *columns, const query_group_t *group)
+{
+	switch (columns->spec->data.metadata.aggr_func) {
+		case AGGREGATE_RANDOM:
+			return query_value_to_xmmsv (&group->value);
+		case AGGREGATE_SUM:
+			return group->count ? xmmsv_new_int (group->sum) : NULL;
+		case AGGREGATE_MAX:
+		case AGGREGATE_MIN:
+			return group->count ? xmmsv_new_int (group->value.num) : NULL;
+		case AGGREGATE_SET:
+			return query_group_to_list (columns, group, TRUE);
+		case AGGREGATE_LIST:
+			return query_group_to_list (columns, group, FALSE);
+		case AGGREGATE_AVG:
+			return xmmsv_new_float (group->count ? group->sum * 1.0 / group->count : 0);
+		default:
+			g_assert_not_reached ();
+	}
+
+	return NULL;
+}
+
+/**
+ * Creates the nested dicts for the groups.
+ *
+ * @return The dicts, or NULL if an integer and a string key with the same
+ * text ended up in the same place. Their values would have been
+ * aggregated together, which only the conversion by row does.
+ */
+static xmmsv_t *
+query_columns_to_xmmsv (query_columns_t *columns)
+{
+	aggregate_function_t aggr_func = columns->spec->data.metadata.aggr_func;
+	const query_value_t *keys, *previous = NULL;
+	xmmsv_t *ret, *dict = NULL, *child, *value;
+	const query_group_t *group;
+	gboolean mixed = FALSE;
+	const gchar *key;
+	gchar buf[12];
+	guint i;
+	gint j;
+
+	if (columns->depth == 0) {
+		ret = NULL;
+		if (columns->groups->len > 0) {
+			group = &g_array_index (columns->groups, query_group_t, 0);
+			ret = query_group_to_xmmsv (columns, group);
+		}
+		if (ret == NULL) {
+			ret = aggregate_data (NULL, aggr_func);
+		}
+	} else {
+		for (j = 0; j < columns->depth; j++) {
+			mixed |= columns->kinds[j] == 3;
+		}
+
+		ret = xmmsv_new_dict ();
+
+		for (i = 0; i < columns->groups->len; i++) {
+			group = &g_array_index (columns->groups, query_group_t, i);
+			keys = &g_array_index (columns->keys, query_value_t, i * columns->depth);
+
+			/* groups of the same parent usually follow each other */
+			if (previous == NULL ||
+			    !query_keys_equal (keys, previous, columns->depth - 1)) {
+				dict = ret;
+				for (j = 0; j < columns->depth - 1; j++) {
+					key = query_value_key (&keys[j], buf);
+					if (!xmmsv_dict_get (dict, key, &child)) {
+						child = xmmsv_new_dict ();
+						xmmsv_dict_set (dict, key, child);
+						xmmsv_unref (child);
+					}
+					dict = child;
+				}
+			}
+			previous = keys;
+
+			value = query_group_to_xmmsv (columns, group);
+			if (value == NULL) {
+				continue;
+			}
+
+			key = query_value_key (&keys[columns->depth - 1], buf);
+			if (mixed && xmmsv_dict_get (dict, key, NULL)) {
+				xmmsv_unref (value);
+				xmmsv_unref (ret);
+				ret = NULL;
+				break;
+			}
+
+			xmmsv_dict_set (dict, key, value);
+			xmmsv_unref (value);
+		}
+	}
+
+	return ret;
+}
+
+/* Converts an S4 resultset to an xmmsv using the fetch specification.
+ * The values are aggregated in flat arrays first, so that each xmmsv_t
+ * of the result is only created once.
+ */
+static xmmsv_t *
+metadata_to_xmmsv (s4_resultset_t *set, xmms_fetch_spec_t *spec)
+{
+	const s4_resultrow_t *row;
+	query_columns_t columns;
+	xmmsv_t *ret;
+	gint i;
+
+	g_return_val_if_fail (spec->data.metadata.get_size > 0, NULL);
+	g_return_val_if_fail (spec->data.metadata.get_size <= METADATA_END, NULL);
+	g_return_val_if_fail (spec->data.metadata.aggr_func >= 0, NULL);
+	g_return_val_if_fail (spec->data.metadata.aggr_func < AGGREGATE_END, NULL);
+
+	/* The first value is already the result, nothing to gain */
+	if (spec->data.metadata.aggr_func == AGGREGATE_FIRST) {
+		return metadata_to_xmmsv_by_row (set, spec);
+	}
+
+	memset (&columns, 0, sizeof (columns));
+	columns.spec = spec;
+	columns.depth = spec->data.metadata.get_size - 1;
+	columns.groups = g_array_new (FALSE, TRUE, sizeof (query_group_t));
+
+	if (columns.depth > 0) {
+		columns.keys = g_array_new (FALSE, FALSE, sizeof (query_value_t));
+		columns.mask = 63;
+		columns.index = g_new0 (guint, columns.mask + 1);
+	}
+
+	if (spec->data.metadata.aggr_func == AGGREGATE_LIST ||
+	    spec->data.metadata.aggr_func == AGGREGATE_SET) {
+		/* usually one value per row */
+		columns.items = g_array_sized_new (FALSE, FALSE, sizeof (query_item_t),
+		                                   s4_resultset_get_rowcount (set));
+	}
+
+	/* Loop over the rows in the resultset */
+	for (i = 0; s4_resultset_get_row (set, i, &row); i++) {
+		gint32 id, j;
+
+		s4_val_get_int (s4_result_get_val (s4_resultset_get_result (set, i, 0)), &id);
+		for (j = 0; j < spec->data.metadata.col_count; j++) {
+			const s4_result_t *res;
+
+			if (s4_resultrow_get_col (row, spec->data.metadata.cols[j], &res)) {
+				query_columns_add (&columns, id, res);
+			}
+		}
+	}
+
+	ret = query_columns_to_xmmsv (&columns);
+
+	g_array_free (columns.groups, TRUE);
+	if (columns.keys != NULL) {
+		g_array_free (columns.keys, TRUE);
+	}
+	if (columns.items != NULL) {
+		g_array_free (columns.items, TRUE);
+	}
+	if (columns.seen_ints != NULL) {
+		g_hash_table_destroy (columns.seen_ints);
+		g_hash_table_destroy (columns.seen_strings);
+	}
+	g_free (columns.index);
+
+	if (ret == NULL) {
+		ret = metadata_to_xmmsv_by_row (set, spec);
+	}
+
+	return ret;
+}
+
 
 /* Divides an S4 set into a list of smaller sets with
  * the same values for the cluster attributes
@@ -520,8 +1049,21 @@ cluster_set (s4_resultset_t *set, xmms_fetch_spec_t *spec,
 static GList *
 cluster_list (s4_resultset_t *set, xmms_fetch_spec_t *spec)
 {
+	const s4_resultrow_t *row;
+	s4_resultset_t *cluster;
 	GHashTable *table;
 	GList *list = NULL;
+	gint position;
+
+	/* Every row is a cluster of its own, no need to look them up */
+	if (spec->data.cluster.type == CLUSTER_BY_POSITION) {
+		for (position = 0; s4_resultset_get_row (set, position, &row); position++) {
+			cluster = s4_resultset_create (s4_resultset_get_colcount (set));
+			s4_resultset_add_row (cluster, row);
+			list = g_list_prepend (list, cluster);
+		}
+		return g_list_reverse (list);
+	}
 
 	table = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 	cluster_set (set, spec, table, &list);
@@ -25,6 +25,7 @@ struct xmms_medialib_session_St {
 	GHashTable *updated;
 	GHashTable *removed;
 	xmmsv_t *vals;
+	guint generation;
 };
 
 static void xmms_medialib_session_free (xmms_medialib_session_t *session);
@@ -44,6 +45,7 @@ xmms_medialib_session_begin_internal (xmms_medialib_t *medialib,
 
 	xmms_object_ref (medialib);
 	ret->medialib = medialib;
+	ret->generation = xmms_medialib_get_generation (medialib);
 
 	s4_t *s4 = xmms_medialib_get_database_backend (medialib);
 	ret->trans = s4_begin (s4, flags);
@@ -118,6 +120,33 @@ xmms_medialib_session_commit (xmms_medialib_session_t *session)
 	return TRUE;
 }
 
+xmms_medialib_t *
+xmms_medialib_session_get_medialib (xmms_medialib_session_t *session)
+{
+	return session->medialib;
+}
+
+/**
+ * Get the generation of the medialib contents when the session began,
+ * see #xmms_medialib_get_generation.
+ */
+guint
+xmms_medialib_session_get_generation (xmms_medialib_session_t *session)
+{
+	return session->generation;
+}
+
+/**
+ * Check if the session has modified the medialib. Such changes are not
+ * seen by other sessions until they are committed.
+ */
+gboolean
+xmms_medialib_session_is_dirty (xmms_medialib_session_t *session)
+{
+	return session->added != NULL || session->updated != NULL ||
+	       session->removed != NULL;
+}
+
 s4_sourcepref_t *
 xmms_medialib_session_get_source_preferences (xmms_medialib_session_t *session)
 {
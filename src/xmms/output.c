@@ -46,6 +46,8 @@ typedef struct xmms_volume_map_St {
 
 static gboolean xmms_output_format_set (xmms_output_t *output, xmms_stream_type_t *fmt);
 static gpointer xmms_output_monitor_volume_thread (gpointer data);
+static void xmms_output_monitor_volume_start (xmms_output_t *output);
+static void xmms_output_monitor_volume_stop (xmms_output_t *output);
 
 static void xmms_playback_client_start (xmms_output_t *output, xmms_error_t *err);
 static void xmms_playback_client_stop (xmms_output_t *output, xmms_error_t *err);
@@ -69,6 +71,7 @@ static void xmms_playback_client_volume_set (xmms_output_t *output, const gchar
 static xmmsv_t *xmms_playback_client_volume_get (xmms_output_t *output, xmms_error_t *error);
 static void xmms_output_filler_state (xmms_output_t *output, xmms_output_filler_state_t state);
 static void xmms_output_filler_state_nolock (xmms_output_t *output, xmms_output_filler_state_t state);
+static void xmms_output_read_account (xmms_output_t *output, gint ret, gint len);
 
 static void xmms_volume_map_init (xmms_volume_map_t *vl);
 static void xmms_volume_map_free (xmms_volume_map_t *vl);
@@ -99,6 +102,11 @@ xmms_medialib_entry_t xmms_output_current_id (xmms_output_t *output);
  * locking order: status_mutex > write_mutex
  *                filler_mutex
  *                playtime_mutex is leaflock.
+ *
+ * filler_buffer is a single-producer/single-consumer ringbuffer, the
+ * filler writes to it with filler_mutex held while xmms_output_read
+ * reads from it without taking any lock. Hotspots run in the output
+ * thread too, and must take filler_mutex to touch the filler state.
  */
 
 struct xmms_output_St {
@@ -112,7 +120,6 @@ struct xmms_output_St {
 	guint played;
 	guint played_time;
 	xmms_medialib_entry_t current_entry;
-	guint toskip;
 
 	/* */
 	GThread *filler_thread;
@@ -124,6 +131,7 @@ struct xmms_output_St {
 	xmms_ringbuf_t *filler_buffer;
 	guint32 filler_seek;
 	gint filler_skip;
+	guint toskip;
 
 	/** Internal status, tells which state the
 	    output really is in */
@@ -151,8 +159,40 @@ struct xmms_output_St {
 
 	GThread *monitor_volume_thread;
 	gboolean monitor_volume_running;
+	/** The plugin reports volume changes, so there is no need to poll */
+	gboolean monitor_volume_push;
+	/** A volume change was reported and has not been looked at yet */
+	gboolean monitor_volume_pending;
+	/** The plugin can no longer report volume changes, poll instead */
+	gboolean monitor_volume_lost;
+	GMutex monitor_volume_mutex;
+	GCond monitor_volume_cond;
+
+	/**
+	 * How many ms before the end of the current track the chain
+	 * for the next entry should be set up, 0 disables pre-roll.
+	 */
+	gint preroll_ms;
 };
 
+/**
+ * A chain for the upcoming playlist entry that is being set up in
+ * the background while the current one is still playing.
+ */
+typedef struct xmms_output_preroll_St {
+	xmms_output_t *output;
+	GThread *thread;
+	xmms_medialib_entry_t entry;
+	xmms_xform_t *chain;
+
+	/** The first chunk of decoded data, to warm up the decoder */
+	gchar buf[4096];
+	gint buf_len;
+
+	/** Set once the thread is finished and can be joined at once */
+	gint done;
+} xmms_output_preroll_t;
+
 /** @} */
 
 /*
@@ -282,7 +322,8 @@ song_changed_arg_free (void *data)
 static gboolean
 song_changed (void *data)
 {
-	/* executes in the output thread; NOT the filler thread */
+	/* executes in the output thread; NOT the filler thread,
+	 * and without filler_mutex held */
 	xmms_output_song_changed_arg_t *arg = (xmms_output_song_changed_arg_t *)data;
 	xmms_medialib_entry_t entry;
 	xmms_stream_type_t *type;
@@ -306,7 +347,7 @@ song_changed (void *data)
 		XMMS_DBG ("Couldn't set format %s/%d/%d, stopping filler..",
 		          xmms_sample_name_get (fmt), rate, chn);
 
-		xmms_output_filler_state_nolock (arg->output, FILLER_STOP);
+		xmms_output_filler_state (arg->output, FILLER_STOP);
 		xmms_ringbuf_set_eos (arg->output->filler_buffer, TRUE);
 		return FALSE;
 	}
@@ -324,17 +365,163 @@ song_changed (void *data)
 static gboolean
 seek_done (void *data)
 {
+	/* executes in the output thread, the seek state belongs to the filler */
 	xmms_output_t *output = (xmms_output_t *)data;
+	guint frame_size;
+	guint32 seek;
+
+	frame_size = xmms_sample_frame_size_get (output->format);
+
+	g_mutex_lock (&output->filler_mutex);
+	seek = output->filler_seek;
+	output->toskip = output->filler_skip * frame_size;
+	g_mutex_unlock (&output->filler_mutex);
 
 	g_mutex_lock (&output->playtime_mutex);
-	output->played = output->filler_seek * xmms_sample_frame_size_get (output->format);
-	output->toskip = output->filler_skip * xmms_sample_frame_size_get (output->format);
+	output->played = seek * frame_size;
 	g_mutex_unlock (&output->playtime_mutex);
 
 	xmms_output_flush (output);
 	return TRUE;
 }
 
+static gpointer
+xmms_output_preroll_thread (gpointer data)
+{
+	xmms_output_preroll_t *preroll = (xmms_output_preroll_t *) data;
+	xmms_output_t *output = preroll->output;
+	xmms_error_t err;
+
+	xmms_error_reset (&err);
+
+	preroll->chain = xmms_xform_chain_setup (output->medialib, preroll->entry,
+	                                         output->format_list, FALSE);
+	if (preroll->chain) {
+		preroll->buf_len = xmms_xform_this_read (preroll->chain, preroll->buf,
+		                                         sizeof (preroll->buf), &err);
+		if (preroll->buf_len < 0) {
+			preroll->buf_len = 0;
+		}
+	}
+
+	g_atomic_int_set (&preroll->done, TRUE);
+
+	return NULL;
+}
+
+static xmms_output_preroll_t *
+xmms_output_preroll_start (xmms_output_t *output)
+{
+	xmms_output_preroll_t *preroll;
+	xmms_medialib_entry_t entry;
+
+	entry = xmms_playlist_peek_next_entry (output->playlist);
+	if (!entry) {
+		return NULL;
+	}
+
+	XMMS_DBG ("Pre-rolling next entry %d", entry);
+
+	preroll = g_new0 (xmms_output_preroll_t, 1);
+	preroll->output = output;
+	preroll->entry = entry;
+	preroll->thread = g_thread_new ("x2 out preroll",
+	                                xmms_output_preroll_thread, preroll);
+
+	return preroll;
+}
+
+static void
+xmms_output_preroll_free (xmms_output_preroll_t *preroll)
+{
+	g_thread_join (preroll->thread);
+	if (preroll->chain) {
+		xmms_object_unref (preroll->chain);
+	}
+	g_free (preroll);
+}
+
+/**
+ * Free the pre-rolls that are no longer wanted once their threads are
+ * done, so that the filler never waits for a slow chain setup. With
+ * wait set, all of them are freed. Returns what is left.
+ */
+static GList *
+xmms_output_preroll_reap (GList *abandoned, gboolean wait)
+{
+	xmms_output_preroll_t *preroll;
+	GList *l, *next;
+
+	for (l = abandoned; l != NULL; l = next) {
+		next = l->next;
+		preroll = l->data;
+
+		if (wait || g_atomic_int_get (&preroll->done)) {
+			xmms_output_preroll_free (preroll);
+			abandoned = g_list_delete_link (abandoned, l);
+		}
+	}
+
+	return abandoned;
+}
+
+/**
+ * Finish the pre-roll and hand over its chain if it was set up for
+ * entry. The first decoded chunk is copied to buf and its length
+ * stored in buf_len. Returns NULL if the pre-roll is of no use, the
+ * caller has to set up the chain itself then.
+ *
+ * This waits for the pre-roll thread, so a pre-roll for another
+ * entry should be reaped instead.
+ */
+static xmms_xform_t *
+xmms_output_preroll_take (xmms_output_preroll_t *preroll,
+                          xmms_medialib_entry_t entry,
+                          gchar *buf, gint *buf_len)
+{
+	xmms_xform_t *chain = NULL;
+
+	g_thread_join (preroll->thread);
+
+	if (preroll->entry == entry && preroll->chain) {
+		XMMS_DBG ("Using pre-rolled chain for entry %d", entry);
+		chain = preroll->chain;
+		memcpy (buf, preroll->buf, preroll->buf_len);
+		*buf_len = preroll->buf_len;
+	} else if (preroll->chain) {
+		xmms_object_unref (preroll->chain);
+	}
+
+	g_free (preroll);
+
+	return chain;
+}
+
+/**
+ * Check if the current chain is close enough to its end to start
+ * setting up the next one.
+ */
+static gboolean
+xmms_output_preroll_due (xmms_output_t *output, xmms_xform_t *chain,
+                         guint64 position)
+{
+	xmms_stream_type_t *type;
+	gint duration;
+
+	if (output->preroll_ms <= 0) {
+		return FALSE;
+	}
+
+	if (!xmms_xform_metadata_get_int (chain, XMMS_MEDIALIB_ENTRY_PROPERTY_DURATION,
+	                                  &duration) || duration <= 0) {
+		return FALSE;
+	}
+
+	type = xmms_xform_outtype_get (chain);
+
+	return duration - xmms_sample_bytes_to_ms (type, position) <= output->preroll_ms;
+}
+
 static void
 xmms_output_filler_state_nolock (xmms_output_t *output, xmms_output_filler_state_t state)
 {
@@ -370,7 +557,13 @@ xmms_output_filler (void *arg)
 {
 	xmms_output_t *output = (xmms_output_t *)arg;
 	xmms_xform_t *chain = NULL;
+	xmms_output_preroll_t *preroll = NULL;
+	GList *abandoned = NULL;
 	gboolean last_was_kill = FALSE;
+	guint64 position = 0;
+	gint primed = 0;
+	gboolean direct = FALSE;
+	gpointer region;
 	char buf[4096];
 	xmms_error_t err;
 	gint ret;
@@ -384,6 +577,10 @@ xmms_output_filler (void *arg)
 				xmms_object_unref (chain);
 				chain = NULL;
 			}
+			if (preroll) {
+				abandoned = g_list_prepend (abandoned, preroll);
+				preroll = NULL;
+			}
 			xmms_ringbuf_set_eos (output->filler_buffer, TRUE);
 			g_cond_wait (&output->filler_state_cond, &output->filler_mutex);
 			last_was_kill = FALSE;
@@ -422,6 +619,9 @@ xmms_output_filler (void *arg)
 					output->filler_seek = ret;
 				}
 
+				position = ret * xmms_sample_frame_size_get (xmms_xform_outtype_get (chain));
+				primed = 0;
+
 				xmms_ringbuf_clear (output->filler_buffer);
 				xmms_ringbuf_hotspot_set (output->filler_buffer, seek_done, NULL, output);
 			}
@@ -442,7 +642,25 @@ xmms_output_filler (void *arg)
 				continue;
 			}
 
-			chain = xmms_xform_chain_setup (output->medialib, entry, output->format_list, FALSE);
+			position = 0;
+			primed = 0;
+
+			/* a pre-roll for another entry, because the user skipped,
+			 * is left to finish on its own */
+			if (preroll && preroll->entry == entry) {
+				chain = xmms_output_preroll_take (preroll, entry, buf, &primed);
+			} else if (preroll) {
+				XMMS_DBG ("Abandoning pre-roll of entry %d", preroll->entry);
+				abandoned = g_list_prepend (abandoned, preroll);
+			}
+			preroll = NULL;
+
+			abandoned = xmms_output_preroll_reap (abandoned, FALSE);
+
+			if (!chain) {
+				chain = xmms_xform_chain_setup (output->medialib, entry, output->format_list, FALSE);
+			}
+
 			if (!chain) {
 				xmms_medialib_session_t *session;
 
@@ -475,21 +693,56 @@ xmms_output_filler (void *arg)
 			xmms_ringbuf_hotspot_set (output->filler_buffer, song_changed, song_changed_arg_free, hsarg);
 		}
 
-		xmms_ringbuf_wait_free (output->filler_buffer, sizeof (buf), &output->filler_mutex);
+		direct = FALSE;
 
-		if (output->filler_state != FILLER_RUN) {
-			XMMS_DBG ("State changed while waiting...");
-			continue;
-		}
-		g_mutex_unlock (&output->filler_mutex);
+		if (primed > 0 && output->filler_state == FILLER_RUN) {
+			/* the pre-roll already decoded the first chunk for us */
+			ret = primed;
+			primed = 0;
+		} else {
+			primed = 0;
 
-		ret = xmms_xform_this_read (chain, buf, sizeof (buf), &err);
+			xmms_ringbuf_wait_free (output->filler_buffer, sizeof (buf), &output->filler_mutex);
+
+			if (output->filler_state != FILLER_RUN) {
+				XMMS_DBG ("State changed while waiting...");
+				continue;
+			}
+
+			/* decode straight into the ringbuffer unless the chunk has
+			 * to be trimmed or would wrap around the end of it */
+			if (!output->toskip &&
+			    xmms_ringbuf_reserve (output->filler_buffer, &region,
+			                          sizeof (buf)) == sizeof (buf)) {
+				direct = TRUE;
+			}
+
+			g_mutex_unlock (&output->filler_mutex);
+
+			ret = xmms_xform_this_read (chain, direct ? region : buf,
+			                            sizeof (buf), &err);
+
+			g_mutex_lock (&output->filler_mutex);
+		}
 
-		g_mutex_lock (&output->filler_mutex);
+		if (ret > 0 && direct) {
+			position += ret;
+			if (!preroll && xmms_output_preroll_due (output, chain, position)) {
+				preroll = xmms_output_preroll_start (output);
+			}
 
-		if (ret > 0) {
+			/* the buffer may have been cleared while decoding */
+			if (output->filler_state == FILLER_RUN) {
+				xmms_ringbuf_commit (output->filler_buffer, ret);
+			}
+		} else if (ret > 0) {
 			gint skip = MIN (ret, output->toskip);
 
+			position += ret;
+			if (!preroll && xmms_output_preroll_due (output, chain, position)) {
+				preroll = xmms_output_preroll_start (output);
+			}
+
 			output->toskip -= skip;
 			if (ret > skip) {
 				xmms_ringbuf_write_wait (output->filler_buffer,
@@ -517,6 +770,11 @@ xmms_output_filler (void *arg)
 
 	g_mutex_unlock (&output->filler_mutex);
 
+	if (preroll)
+		xmms_output_preroll_free (preroll);
+
+	xmms_output_preroll_reap (abandoned, TRUE);
+
 	return NULL;
 }
 
@@ -531,16 +789,21 @@ xmms_output_read (xmms_output_t *output, char *buffer, gint len)
 	g_return_val_if_fail (output, -1);
 	g_return_val_if_fail (buffer, -1);
 
-	g_mutex_lock (&output->filler_mutex);
-	xmms_ringbuf_wait_used (output->filler_buffer, len, &output->filler_mutex);
+	xmms_ringbuf_wait_used (output->filler_buffer, len, NULL);
 	ret = xmms_ringbuf_read (output->filler_buffer, buffer, len);
 	if (ret == 0 && xmms_ringbuf_iseos (output->filler_buffer)) {
 		xmms_output_status_set (output, XMMS_PLAYBACK_STATUS_STOP);
-		g_mutex_unlock (&output->filler_mutex);
 		return -1;
 	}
-	g_mutex_unlock (&output->filler_mutex);
 
+	xmms_output_read_account (output, ret, len);
+
+	return ret;
+}
+
+static void
+xmms_output_read_account (xmms_output_t *output, gint ret, gint len)
+{
 	update_playtime (output, ret);
 
 	if (ret < len) {
@@ -556,10 +819,58 @@ xmms_output_read (xmms_output_t *output, char *buffer, gint len)
 	}
 
 	output->bytes_written += ret;
+}
+
+gint
+xmms_output_read_region (xmms_output_t *output, gconstpointer *buffer, gint len)
+{
+	gint ret, frame_size;
+
+	g_return_val_if_fail (output, -1);
+	g_return_val_if_fail (buffer, -1);
+
+	xmms_ringbuf_wait_used (output->filler_buffer, len, NULL);
+	if (xmms_ringbuf_bytes_used (output->filler_buffer) < len) {
+		output->buffer_underruns++;
+	}
+
+	ret = xmms_ringbuf_peek_region (output->filler_buffer, buffer, len);
+	if (ret == 0 && xmms_ringbuf_iseos (output->filler_buffer)) {
+		xmms_output_status_set (output, XMMS_PLAYBACK_STATUS_STOP);
+		return -1;
+	}
+
+	/* the format may have changed in a hotspot above, and a frame
+	 * split by the end of the ringbuffer has to be copied out by
+	 * xmms_output_read instead */
+	if (output->format) {
+		frame_size = xmms_sample_frame_size_get (output->format);
+		ret -= ret % frame_size;
+	}
+
+	/* let the filler write to the region again */
+	if (ret == 0) {
+		xmms_ringbuf_consume (output->filler_buffer, 0);
+	}
 
 	return ret;
 }
 
+void
+xmms_output_read_consume (xmms_output_t *output, gint len)
+{
+	g_return_if_fail (output);
+
+	/* nothing to account for if the buffer was flushed meanwhile */
+	if (!xmms_ringbuf_consume (output->filler_buffer, len)) {
+		return;
+	}
+
+	update_playtime (output, len);
+
+	output->bytes_written += len;
+}
+
 gint
 xmms_output_bytes_available (xmms_output_t *output)
 {
@@ -713,7 +1024,11 @@ xmms_playback_client_volume_set (xmms_output_t *output, const gchar *channel,
 	if (!xmms_output_plugin_methods_volume_set (output->plugin, output, channel, volume)) {
 		xmms_error_set (error, XMMS_ERROR_GENERIC,
 		                "couldn't set volume");
+		return;
 	}
+
+	/* don't make the clients wait for the next poll */
+	xmms_output_volume_changed (output);
 }
 
 static xmmsv_t *
@@ -851,18 +1166,26 @@ xmms_output_status_set (xmms_output_t *output, gint status)
 	return ret;
 }
 
+static void
+on_preroll_changed (xmms_object_t *object, xmmsv_t *_data, gpointer udata)
+{
+	xmms_output_t *output = (xmms_output_t *) udata;
+
+	output->preroll_ms = xmms_config_property_get_int ((xmms_config_property_t *) object);
+}
+
 static void
 xmms_output_destroy (xmms_object_t *object)
 {
 	xmms_output_t *output = (xmms_output_t *)object;
+	xmms_config_property_t *prop;
 
 	XMMS_DBG ("Deactivating output object.");
 
-	output->monitor_volume_running = FALSE;
-	if (output->monitor_volume_thread) {
-		g_thread_join (output->monitor_volume_thread);
-		output->monitor_volume_thread = NULL;
-	}
+	prop = xmms_config_lookup ("output.preroll_ms");
+	xmms_config_property_callback_remove (prop, on_preroll_changed, output);
+
+	xmms_output_monitor_volume_stop (output);
 
 	xmms_output_filler_state (output, FILLER_QUIT);
 	g_thread_join (output->filler_thread);
@@ -880,6 +1203,8 @@ xmms_output_destroy (xmms_object_t *object)
 	g_mutex_clear (&output->playtime_mutex);
 	g_mutex_clear (&output->filler_mutex);
 	g_cond_clear (&output->filler_state_cond);
+	g_mutex_clear (&output->monitor_volume_mutex);
+	g_cond_clear (&output->monitor_volume_cond);
 	xmms_ringbuf_destroy (output->filler_buffer);
 
 	xmms_playback_unregister_ipc_commands ();
@@ -949,6 +1274,8 @@ xmms_output_new (xmms_output_plugin_t *plugin, xmms_playlist_t *playlist, xmms_m
 
 	g_mutex_init (&output->status_mutex);
 	g_mutex_init (&output->playtime_mutex);
+	g_mutex_init (&output->monitor_volume_mutex);
+	g_cond_init (&output->monitor_volume_cond);
 
 	prop = xmms_config_property_register ("output.buffersize", "32768", NULL, NULL);
 	size = xmms_config_property_get_int (prop);
@@ -957,11 +1284,15 @@ xmms_output_new (xmms_output_plugin_t *plugin, xmms_playlist_t *playlist, xmms_m
 	g_mutex_init (&output->filler_mutex);
 	output->filler_state = FILLER_STOP;
 	g_cond_init (&output->filler_state_cond);
-	output->filler_buffer = xmms_ringbuf_new (size);
+	output->filler_buffer = xmms_ringbuf_new_spsc (size);
 	output->filler_thread = g_thread_new ("x2 out filler", xmms_output_filler, output);
 
 	xmms_config_property_register ("output.flush_on_pause", "1", NULL, NULL);
 
+	prop = xmms_config_property_register ("output.preroll_ms", "0",
+	                                      on_preroll_changed, output);
+	output->preroll_ms = xmms_config_property_get_int (prop);
+
 	xmms_playback_register_ipc_commands (XMMS_OBJECT (output));
 
 	output->status = XMMS_PLAYBACK_STATUS_STOP;
@@ -1040,11 +1371,7 @@ set_plugin (xmms_output_t *output, xmms_output_plugin_t *plugin)
 	g_assert (output);
 	g_assert (plugin);
 
-	output->monitor_volume_running = FALSE;
-	if (output->monitor_volume_thread) {
-		g_thread_join (output->monitor_volume_thread);
-		output->monitor_volume_thread = NULL;
-	}
+	xmms_output_monitor_volume_stop (output);
 
 	if (output->plugin) {
 		xmms_output_plugin_method_destroy (output->plugin, output);
@@ -1060,11 +1387,8 @@ set_plugin (xmms_output_t *output, xmms_output_plugin_t *plugin)
 
 	if (!ret) {
 		output->plugin = NULL;
-	} else if (!output->monitor_volume_thread) {
-		output->monitor_volume_running = TRUE;
-		output->monitor_volume_thread = g_thread_new ("x2 volume mon",
-		                                              xmms_output_monitor_volume_thread,
-		                                              output);
+	} else {
+		xmms_output_monitor_volume_start (output);
 	}
 
 	return ret;
@@ -1165,20 +1489,97 @@ xmms_volume_map_to_dict (xmms_volume_map_t *vl)
 	return ret;
 }
 
+void
+xmms_output_volume_changed (xmms_output_t *output)
+{
+	g_return_if_fail (output);
+
+	g_mutex_lock (&output->monitor_volume_mutex);
+	output->monitor_volume_pending = TRUE;
+	g_cond_signal (&output->monitor_volume_cond);
+	g_mutex_unlock (&output->monitor_volume_mutex);
+}
+
+void
+xmms_output_volume_monitor_failed (xmms_output_t *output)
+{
+	g_return_if_fail (output);
+
+	XMMS_DBG ("Volume changes are no longer reported, polling");
+
+	g_mutex_lock (&output->monitor_volume_mutex);
+	output->monitor_volume_lost = TRUE;
+	output->monitor_volume_pending = TRUE;
+	g_cond_signal (&output->monitor_volume_cond);
+	g_mutex_unlock (&output->monitor_volume_mutex);
+}
+
+static void
+xmms_output_monitor_volume_start (xmms_output_t *output)
+{
+	if (!xmms_output_plugin_method_volume_get_available (output->plugin)) {
+		return;
+	}
+
+	output->monitor_volume_push =
+		xmms_output_plugin_method_volume_monitor (output->plugin,
+		                                          output, TRUE);
+
+	XMMS_DBG ("%s for volume changes",
+	          output->monitor_volume_push ? "Listening" : "Polling");
+
+	output->monitor_volume_running = TRUE;
+	output->monitor_volume_pending = FALSE;
+	output->monitor_volume_lost = FALSE;
+	output->monitor_volume_thread = g_thread_new ("x2 volume mon",
+	                                              xmms_output_monitor_volume_thread,
+	                                              output);
+}
+
+static void
+xmms_output_monitor_volume_stop (xmms_output_t *output)
+{
+	if (!output->monitor_volume_thread) {
+		return;
+	}
+
+	if (output->monitor_volume_push) {
+		xmms_output_plugin_method_volume_monitor (output->plugin,
+		                                          output, FALSE);
+	}
+
+	g_mutex_lock (&output->monitor_volume_mutex);
+	output->monitor_volume_running = FALSE;
+	g_cond_signal (&output->monitor_volume_cond);
+	g_mutex_unlock (&output->monitor_volume_mutex);
+
+	g_thread_join (output->monitor_volume_thread);
+	output->monitor_volume_thread = NULL;
+	output->monitor_volume_push = FALSE;
+}
+
+/**
+ * Broadcast the volume whenever it changes.
+ *
+ * If the plugin reports volume changes this sleeps until it does,
+ * otherwise, or once the plugin gave up on it, the volume is polled
+ * once a second.
+ */
 static gpointer
 xmms_output_monitor_volume_thread (gpointer data)
 {
 	xmms_output_t *output = data;
 	xmms_volume_map_t old, cur;
-
-	if (!xmms_output_plugin_method_volume_get_available (output->plugin)) {
-		return NULL;
-	}
+	gint64 deadline;
 
 	xmms_volume_map_init (&old);
 	xmms_volume_map_init (&cur);
 
+	g_mutex_lock (&output->monitor_volume_mutex);
+
 	while (output->monitor_volume_running) {
+		g_mutex_unlock (&output->monitor_volume_mutex);
+
 		cur.num_channels = 0;
 		cur.status = xmms_output_plugin_method_volume_get (output->plugin,
 		                                                   output, NULL, NULL,
@@ -1225,9 +1626,26 @@ xmms_output_monitor_volume_thread (gpointer data)
 
 		xmms_volume_map_copy (&cur, &old);
 
-		g_usleep (G_USEC_PER_SEC);
+		g_mutex_lock (&output->monitor_volume_mutex);
+
+		deadline = g_get_monotonic_time () + G_USEC_PER_SEC;
+		while (output->monitor_volume_running &&
+		       !output->monitor_volume_pending) {
+			if (output->monitor_volume_push && !output->monitor_volume_lost) {
+				g_cond_wait (&output->monitor_volume_cond,
+				             &output->monitor_volume_mutex);
+			} else if (!g_cond_wait_until (&output->monitor_volume_cond,
+			                               &output->monitor_volume_mutex,
+			                               deadline)) {
+				break;
+			}
+		}
+
+		output->monitor_volume_pending = FALSE;
 	}
 
+	g_mutex_unlock (&output->monitor_volume_mutex);
+
 	xmms_volume_map_free (&old);
 	xmms_volume_map_free (&cur);
 
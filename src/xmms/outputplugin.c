@@ -347,6 +347,24 @@ xmms_output_plugin_method_volume_get (xmms_output_plugin_t *plugin,
 }
 
 
+gboolean
+xmms_output_plugin_method_volume_monitor (xmms_output_plugin_t *plugin,
+                                          xmms_output_t *output,
+                                          gboolean enable)
+{
+	gboolean res = FALSE;
+
+	g_return_val_if_fail (output, FALSE);
+	g_return_val_if_fail (plugin, FALSE);
+
+	if (plugin->methods.volume_monitor) {
+		res = plugin->methods.volume_monitor (output, enable);
+	}
+
+	return res;
+}
+
+
 /* Used when we have to drive the output... */
 
 static gboolean
@@ -388,6 +406,7 @@ xmms_output_plugin_writer (gpointer data)
 	xmms_output_plugin_t *plugin = (xmms_output_plugin_t *) data;
 	xmms_output_t *output = NULL;
 	gchar buffer[4096];
+	gconstpointer region = NULL, src;
 	gint ret;
 
 	g_mutex_lock (&plugin->write_mutex);
@@ -450,16 +469,29 @@ xmms_output_plugin_writer (gpointer data)
 
 			g_mutex_unlock (&plugin->write_mutex);
 
-			ret = xmms_output_read (output, buffer, 4096);
+			/* hand the output buffer straight to the plugin when
+			 * possible, and only copy frames split by its end */
+			ret = xmms_output_read_region (output, &region, sizeof (buffer));
+			if (ret > 0) {
+				src = region;
+			} else if (ret == 0) {
+				ret = xmms_output_read (output, buffer, sizeof (buffer));
+				src = buffer;
+			}
+
 			if (ret > 0) {
 				xmms_error_t err;
 
 				xmms_error_reset (&err);
 
 				g_mutex_lock (&plugin->api_mutex);
-				plugin->methods.write (output, buffer, ret, &err);
+				plugin->methods.write (output, (gpointer) src, ret, &err);
 				g_mutex_unlock (&plugin->api_mutex);
 
+				if (src == region) {
+					xmms_output_read_consume (output, ret);
+				}
+
 				if (xmms_error_iserror (&err)) {
 					XMMS_DBG ("Write method set error bit");
 
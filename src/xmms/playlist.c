@@ -34,10 +34,12 @@
 #include <xmmspriv/xmms_medialib.h>
 #include <xmmspriv/xmms_collection.h>
 #include <xmmspriv/xmms_playlist.h>
+#include <xmmspriv/xmms_playlist_changelog.h>
 
 static void xmms_playlist_destroy (xmms_object_t *object);
 static void xmms_playlist_client_replace (xmms_playlist_t *playlist, const gchar *plname, xmmsv_t *coll, xmms_playlist_position_action_t action, xmms_error_t *err);
 static xmmsv_t * xmms_playlist_client_list_entries (xmms_playlist_t *playlist, const gchar *plname, xmms_error_t *err);
+static xmmsv_t * xmms_playlist_client_list_changes (xmms_playlist_t *playlist, const gchar *plname, xmmsv_t *generation, xmms_error_t *err);
 static gchar *xmms_playlist_client_current_active (xmms_playlist_t *playlist, xmms_error_t *err);
 static void xmms_playlist_destroy (xmms_object_t *object);
 
@@ -74,6 +76,7 @@ static xmmsv_t *xmms_playlist_current_pos_msg_new (xmms_playlist_t *playlist, gi
 
 static void xmms_playlist_changed_msg_send (xmms_playlist_t *playlist, xmmsv_t *dict);
 static xmmsv_t *xmms_playlist_changed_msg_new (xmms_playlist_t *playlist, xmms_playlist_changed_action_t type, xmms_medialib_entry_t id, const gchar *plname);
+static const gchar *xmms_playlist_changed_msg_name (xmmsv_t *dict);
 
 #define XMMS_PLAYLIST_CHANGED_MSG(type, id, name) xmms_playlist_changed_msg_send (playlist, xmms_playlist_changed_msg_new (playlist, type, id, name))
 #define XMMS_PLAYLIST_CURRPOS_MSG(pos, name) xmms_playlist_current_pos_msg_send (playlist, xmms_playlist_current_pos_msg_new (playlist, pos, name))
@@ -101,6 +104,9 @@ struct xmms_playlist_St {
 	GMutex mutex;
 
 	xmms_medialib_t *medialib;
+
+	/* protected by mutex */
+	xmms_playlist_changelog_t *changelog;
 };
 
 #include "playlist_ipc.c"
@@ -119,6 +125,20 @@ on_playlist_r_all_changed (xmms_object_t *object, xmmsv_t *_data,
 	g_mutex_unlock (&playlist->mutex);
 }
 
+static void
+on_playlist_changelog_size_changed (xmms_object_t *object, xmmsv_t *_data,
+                                    gpointer udata)
+{
+	xmms_playlist_t *playlist = udata;
+	gint value;
+
+	value = xmms_config_property_get_int ((xmms_config_property_t *) object);
+
+	g_mutex_lock (&playlist->mutex);
+	xmms_playlist_changelog_set_max_weight (playlist->changelog, MAX (0, value));
+	g_mutex_unlock (&playlist->mutex);
+}
+
 static void
 on_playlist_r_one_changed (xmms_object_t *object, xmmsv_t *_data,
                            gpointer udata)
@@ -197,16 +217,31 @@ xmms_playlist_update_partyshuffle (xmms_playlist_t *playlist,
 
 	g_return_if_fail(xmmsv_list_get (xmmsv_coll_operands_get (coll), 0, &src));
 
-	/* Since getting random media can be slow on huge medialibs, we refill only
-	 * one entry at a time. This let other threads a chance to get the lock on
-	 * the playlist object as soon as possible. */
+	/* Picking random media is cheap once the ids of the source are known,
+	 * so all upcoming entries are refilled at once. Media already in the
+	 * playlist are avoided, unless the source has nothing else to offer. */
 	size = xmms_playlist_coll_get_size (coll);
 	if (size < currpos + 1 + upcoming) {
-		xmms_medialib_entry_t randentry;
-		randentry = xmms_collection_get_random_media (playlist->colldag, src);
-		if (randentry > 0) {
+		xmms_medialib_entry_t randentry, id;
+		GHashTable *avoid;
+		gint i;
+
+		avoid = g_hash_table_new (NULL, NULL);
+		for (i = 0; xmmsv_coll_idlist_get_index (coll, i, &id); i++) {
+			g_hash_table_add (avoid, GINT_TO_POINTER (id));
+		}
+
+		while (size < currpos + 1 + upcoming) {
+			randentry = xmms_collection_get_random_media (playlist->colldag, src, avoid);
+			if (randentry <= 0) {
+				break;
+			}
 			xmms_playlist_add_entry_unlocked (playlist, plname, coll, randentry, NULL);
+			g_hash_table_add (avoid, GINT_TO_POINTER (randentry));
+			size++;
 		}
+
+		g_hash_table_destroy (avoid);
 	}
 }
 
@@ -314,6 +349,10 @@ xmms_playlist_init (xmms_medialib_t *medialib, xmms_coll_dag_t *colldag)
 	                                  on_playlist_r_all_changed, ret);
 	ret->repeat_all = xmms_config_property_get_int (val);
 
+	val = xmms_config_property_register ("playlist.changelog_size", "65536",
+	                                     on_playlist_changelog_size_changed, ret);
+	ret->changelog = xmms_playlist_changelog_new (MAX (0, xmms_config_property_get_int (val)));
+
 	xmms_object_ref (medialib);
 	ret->medialib = medialib;
 
@@ -450,6 +489,49 @@ xmms_playlist_current_entry (xmms_playlist_t *playlist)
 }
 
 
+/**
+ * Retrieve the xmms_medialib_entry_t that #xmms_playlist_advance would
+ * make current, without actually advancing.
+ *
+ * Jumplists are not followed, so this returns 0 both at the end of the
+ * playlist and when the next entry lives in another playlist.
+ */
+xmms_medialib_entry_t
+xmms_playlist_peek_next_entry (xmms_playlist_t *playlist)
+{
+	gint size, currpos;
+	xmmsv_t *plcoll;
+	xmms_medialib_entry_t ent = 0;
+
+	g_return_val_if_fail (playlist, 0);
+
+	g_mutex_lock (&playlist->mutex);
+
+	plcoll = xmms_playlist_get_coll (playlist, XMMS_ACTIVE_PLAYLIST, NULL);
+	if (plcoll == NULL) {
+		g_mutex_unlock (&playlist->mutex);
+		return 0;
+	}
+
+	currpos = xmms_playlist_coll_get_currpos (plcoll);
+	size = xmms_playlist_coll_get_size (plcoll);
+
+	if (!playlist->repeat_one) {
+		currpos++;
+		if (currpos == size && playlist->repeat_all) {
+			currpos = 0;
+		}
+	}
+
+	if (currpos >= 0 && currpos < size) {
+		xmmsv_coll_idlist_get_index (plcoll, currpos, &ent);
+	}
+
+	g_mutex_unlock (&playlist->mutex);
+
+	return ent;
+}
+
 /**
  * Retrieve the position of the currently active xmms_medialib_entry_t
  *
@@ -569,6 +651,10 @@ xmms_playlist_remove_unlocked (xmms_playlist_t *playlist, const gchar *plname,
 
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_REMOVE, 0, plname);
 	xmmsv_dict_set_int (dict, "position", pos);
+	xmmsv_dict_set_int (dict, "generation",
+	                    xmms_playlist_changelog_remove (playlist->changelog,
+	                                                    xmms_playlist_changed_msg_name (dict),
+	                                                    plcoll, pos, 1));
 	xmms_playlist_changed_msg_send (playlist, dict);
 
 	/* decrease current position if removed entry was before or if it's
@@ -666,6 +752,10 @@ xmms_playlist_client_move_entry (xmms_playlist_t *playlist,
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_MOVE, id, plname);
 	xmmsv_dict_set_int (dict, "position", pos);
 	xmmsv_dict_set_int (dict, "newposition", newpos);
+	xmmsv_dict_set_int (dict, "generation",
+	                    xmms_playlist_changelog_move (playlist->changelog,
+	                                                  xmms_playlist_changed_msg_name (dict),
+	                                                  plcoll, pos, newpos));
 	xmms_playlist_changed_msg_send (playlist, dict);
 
 	XMMS_PLAYLIST_CURRPOS_MSG (currpos, plname);
@@ -824,6 +914,10 @@ xmms_playlist_insert_entry (xmms_playlist_t *playlist, const gchar *plname,
 	/** propagate the MID ! */
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_INSERT, file, plname);
 	xmmsv_dict_set_int (dict, "position", pos);
+	xmmsv_dict_set_int (dict, "generation",
+	                    xmms_playlist_changelog_insert (playlist->changelog,
+	                                                    xmms_playlist_changed_msg_name (dict),
+	                                                    plcoll, pos, 1));
 	xmms_playlist_changed_msg_send (playlist, dict);
 
 	/** update position once client is familiar with the new item. */
@@ -955,6 +1049,10 @@ xmms_playlist_add_entry_unlocked (xmms_playlist_t *playlist,
 	/** propagate the MID ! */
 	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_ADD, file, plname);
 	xmmsv_dict_set_int (dict, "position", prev_size);
+	xmmsv_dict_set_int (dict, "generation",
+	                    xmms_playlist_changelog_insert (playlist->changelog,
+	                                                    xmms_playlist_changed_msg_name (dict),
+	                                                    plcoll, prev_size, 1));
 	xmms_playlist_changed_msg_send (playlist, dict);
 }
 
@@ -1089,9 +1187,10 @@ xmms_playlist_client_replace (xmms_playlist_t *playlist, const gchar *plname,
                               xmms_error_t *err)
 {
 	xmms_medialib_entry_t id, current_id;
-	xmmsv_t *plcoll;
+	xmmsv_t *plcoll, *dict;
 	xmmsv_t *result;
-	gint current_position, i;
+	gint current_position, i, old_len;
+	gint32 *old_ids;
 
 	g_return_if_fail (playlist);
 	g_return_if_fail (coll);
@@ -1114,6 +1213,13 @@ xmms_playlist_client_replace (xmms_playlist_t *playlist, const gchar *plname,
 		return;
 	}
 
+	/* kept for the change log */
+	old_len = xmms_playlist_coll_get_size (plcoll);
+	old_ids = g_new (gint32, MAX (1, old_len));
+	for (i = 0; i < old_len; i++) {
+		xmmsv_coll_idlist_get_index_int32 (plcoll, i, &old_ids[i]);
+	}
+
 	xmmsv_coll_idlist_clear (plcoll);
 
 	current_position = -1;
@@ -1142,10 +1248,18 @@ xmms_playlist_client_replace (xmms_playlist_t *playlist, const gchar *plname,
 
 	xmms_collection_set_int_attr (plcoll, "position", current_position);
 
-	XMMS_PLAYLIST_CHANGED_MSG (XMMS_PLAYLIST_CHANGED_REPLACE,
-	                           (current_position < 0) ? 0 : current_id, plname);
+	dict = xmms_playlist_changed_msg_new (playlist, XMMS_PLAYLIST_CHANGED_REPLACE,
+	                                      (current_position < 0) ? 0 : current_id,
+	                                      plname);
+	xmmsv_dict_set_int (dict, "generation",
+	                    xmms_playlist_changelog_replace (playlist->changelog,
+	                                                     xmms_playlist_changed_msg_name (dict),
+	                                                     plcoll, old_ids, old_len));
+	xmms_playlist_changed_msg_send (playlist, dict);
 	XMMS_PLAYLIST_CURRPOS_MSG (current_position, plname);
 
+	g_free (old_ids);
+
 	g_mutex_unlock (&playlist->mutex);
 }
 
@@ -1187,6 +1301,44 @@ xmms_playlist_client_list_entries (xmms_playlist_t *playlist, const gchar *plnam
 	return entries;
 }
 
+/**
+ * List the changes made to a playlist since the given generation, or
+ * its whole contents if they are no longer known.
+ *
+ * See xmms_playlist_changelog_since for the format.
+ */
+static xmmsv_t *
+xmms_playlist_client_list_changes (xmms_playlist_t *playlist, const gchar *plname,
+                                   xmmsv_t *generation, xmms_error_t *err)
+{
+	xmmsv_t *ret, *plcoll;
+	gchar *name;
+	gint64 since;
+
+	g_return_val_if_fail (playlist, NULL);
+
+	if (!xmmsv_get_int64 (generation, &since)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "generation must be an integer");
+		return NULL;
+	}
+
+	g_mutex_lock (&playlist->mutex);
+
+	plcoll = xmms_playlist_get_coll (playlist, plname, err);
+	if (plcoll == NULL) {
+		g_mutex_unlock (&playlist->mutex);
+		return NULL;
+	}
+
+	name = xmms_playlist_canonical_name (playlist, plname);
+	ret = xmms_playlist_changelog_since (playlist->changelog, name, plcoll, since);
+	g_free (name);
+
+	g_mutex_unlock (&playlist->mutex);
+
+	return ret;
+}
+
 /** @} */
 
 /** Free the playlist and other memory in the xmms_playlist_t
@@ -1210,6 +1362,9 @@ xmms_playlist_destroy (xmms_object_t *object)
 	val = xmms_config_lookup ("playlist.repeat_all");
 	xmms_config_property_callback_remove (val, on_playlist_r_all_changed, playlist);
 
+	val = xmms_config_lookup ("playlist.changelog_size");
+	xmms_config_property_callback_remove (val, on_playlist_changelog_size_changed, playlist);
+
 	xmms_object_disconnect (XMMS_OBJECT (playlist->medialib),
 	                        XMMS_IPC_SIGNAL_MEDIALIB_ENTRY_REMOVED,
 	                        on_medialib_entry_removed, playlist);
@@ -1221,6 +1376,7 @@ xmms_playlist_destroy (xmms_object_t *object)
 	xmms_object_unref (playlist->colldag);
 	xmms_object_unref (playlist->medialib);
 
+	xmms_playlist_changelog_free (playlist->changelog);
 	g_mutex_clear (&playlist->mutex);
 
 	xmms_playlist_unregister_ipc_commands ();
@@ -1311,6 +1467,17 @@ xmms_playlist_changed_msg_new (xmms_playlist_t *playlist,
 	return dict;
 }
 
+/** Canonical playlist name of a change message, keys the change log. */
+static const gchar *
+xmms_playlist_changed_msg_name (xmmsv_t *dict)
+{
+	const gchar *name = NULL;
+
+	xmmsv_dict_entry_get_string (dict, "name", &name);
+
+	return name;
+}
+
 xmmsv_t *
 xmms_playlist_current_pos_msg_new (xmms_playlist_t *playlist,
                                    gint32 pos, const gchar *plname)
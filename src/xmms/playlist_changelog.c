@@ -0,0 +1,673 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/** @file
+ * Versioned change log for playlists.
+ *
+ * Every modification of a playlist bumps its generation and is recorded
+ * as a compact, range based change: a run of inserted ids, a run of
+ * removed positions, a move, or a permutation expressed as runs of the
+ * previous contents. Clients that know the contents at generation N
+ * can ask for the changes since N instead of refetching the whole
+ * list. When the log no longer reaches back to N, the full list is
+ * returned instead.
+ *
+ * Consecutive single entry additions at the end of an insert run and
+ * consecutive single entry removals at the same position (the queue
+ * and party shuffle updaters) are merged into one change that covers a
+ * range of generations, one generation per entry.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_playlist_changelog.h>
+#include <xmms/xmms_log.h>
+#include <xmmsc/xmmsc_idnumbers.h>
+
+typedef struct xmms_playlist_change_St {
+	xmms_playlist_changed_action_t type;
+
+	/* generations covered, first < last only for merged unit runs */
+	gint64 first;
+	gint64 last;
+
+	gint position;
+	gint count;
+	gint newposition;
+
+	/* INSERT: the inserted ids, SORT: (source, length) pairs */
+	GArray *ids;
+} xmms_playlist_change_t;
+
+typedef struct xmms_playlist_history_St {
+	gint64 generation;
+
+	/* oldest generation the changes can be replayed from */
+	gint64 floor;
+
+	GQueue changes;
+	guint weight;
+
+	/* the collection and size the history describes */
+	gconstpointer coll;
+	gint size;
+} xmms_playlist_history_t;
+
+struct xmms_playlist_changelog_St {
+	GHashTable *histories;
+	guint max_weight;
+};
+
+static void
+xmms_playlist_change_free (xmms_playlist_change_t *change)
+{
+	if (change->ids) {
+		g_array_free (change->ids, TRUE);
+	}
+	g_free (change);
+}
+
+static guint
+xmms_playlist_change_weight (xmms_playlist_change_t *change)
+{
+	return 1 + (change->ids ? change->ids->len : 0);
+}
+
+static void
+xmms_playlist_history_clear (xmms_playlist_history_t *history)
+{
+	xmms_playlist_change_t *change;
+
+	while ((change = g_queue_pop_head (&history->changes))) {
+		xmms_playlist_change_free (change);
+	}
+	history->weight = 0;
+}
+
+static void
+xmms_playlist_history_free (xmms_playlist_history_t *history)
+{
+	xmms_playlist_history_clear (history);
+	g_free (history);
+}
+
+/**
+ * Forget everything about the playlist and start over from a fresh
+ * generation. Generations are seeded from the wall clock so that they
+ * keep increasing across restarts, and a client holding a generation
+ * from a previous run can't mistake it for a current one.
+ */
+static void
+xmms_playlist_history_restart (xmms_playlist_history_t *history,
+                               xmmsv_t *plcoll, gint size)
+{
+	xmms_playlist_history_clear (history);
+
+	history->generation = MAX (history->generation + 1, g_get_real_time ());
+	history->floor = history->generation;
+	history->coll = plcoll;
+	history->size = size;
+}
+
+/**
+ * Look up the history of a playlist whose size was size before the
+ * change about to be recorded. The history is restarted if the
+ * playlist was modified behind our back, which is the case when the
+ * collection was replaced or doesn't have the size we expect.
+ */
+static xmms_playlist_history_t *
+xmms_playlist_changelog_history (xmms_playlist_changelog_t *log,
+                                 const gchar *name, xmmsv_t *plcoll,
+                                 gint size)
+{
+	xmms_playlist_history_t *history;
+
+	history = g_hash_table_lookup (log->histories, name);
+	if (!history) {
+		history = g_new0 (xmms_playlist_history_t, 1);
+		g_queue_init (&history->changes);
+		g_hash_table_insert (log->histories, g_strdup (name), history);
+		xmms_playlist_history_restart (history, plcoll, size);
+	} else if (history->coll != plcoll || history->size != size) {
+		XMMS_DBG ("Playlist '%s' changed outside of the change log", name);
+		xmms_playlist_history_restart (history, plcoll, size);
+	}
+
+	return history;
+}
+
+static void
+xmms_playlist_history_trim (xmms_playlist_history_t *history, guint max_weight)
+{
+	xmms_playlist_change_t *change;
+
+	while (history->weight > max_weight) {
+		change = g_queue_pop_head (&history->changes);
+		if (!change) {
+			break;
+		}
+
+		history->weight -= xmms_playlist_change_weight (change);
+		history->floor = change->last;
+		xmms_playlist_change_free (change);
+	}
+}
+
+static xmms_playlist_change_t *
+xmms_playlist_history_push (xmms_playlist_history_t *history,
+                            xmms_playlist_changed_action_t type, gint pos)
+{
+	xmms_playlist_change_t *change;
+
+	change = g_new0 (xmms_playlist_change_t, 1);
+	change->type = type;
+	change->position = pos;
+	change->first = change->last = ++history->generation;
+
+	g_queue_push_tail (&history->changes, change);
+
+	return change;
+}
+
+static void
+xmms_playlist_history_account (xmms_playlist_changelog_t *log,
+                               xmms_playlist_history_t *history,
+                               xmms_playlist_change_t *change,
+                               guint old_weight, gint size)
+{
+	history->weight += xmms_playlist_change_weight (change) - old_weight;
+	history->size = size;
+	xmms_playlist_history_trim (history, log->max_weight);
+}
+
+static void
+xmms_playlist_ids_append (GArray *ids, xmmsv_t *plcoll, gint pos, gint count)
+{
+	gint32 id;
+	gint i;
+
+	for (i = 0; i < count; i++) {
+		if (!xmmsv_coll_idlist_get_index_int32 (plcoll, pos + i, &id)) {
+			id = 0;
+		}
+		g_array_append_val (ids, id);
+	}
+}
+
+/**
+ * Create a new change log.
+ *
+ * @param max_weight How much history to keep per playlist, counted in
+ * changes plus the number of ids they carry.
+ */
+xmms_playlist_changelog_t *
+xmms_playlist_changelog_new (guint max_weight)
+{
+	xmms_playlist_changelog_t *log;
+
+	log = g_new0 (xmms_playlist_changelog_t, 1);
+	log->histories = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+	                                        (GDestroyNotify) xmms_playlist_history_free);
+	log->max_weight = max_weight;
+
+	return log;
+}
+
+void
+xmms_playlist_changelog_free (xmms_playlist_changelog_t *log)
+{
+	g_return_if_fail (log);
+
+	g_hash_table_destroy (log->histories);
+	g_free (log);
+}
+
+void
+xmms_playlist_changelog_set_max_weight (xmms_playlist_changelog_t *log,
+                                        guint max_weight)
+{
+	GHashTableIter iter;
+	xmms_playlist_history_t *history;
+
+	g_return_if_fail (log);
+
+	log->max_weight = max_weight;
+
+	g_hash_table_iter_init (&iter, log->histories);
+	while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &history)) {
+		xmms_playlist_history_trim (history, max_weight);
+	}
+}
+
+/**
+ * Record that count entries were inserted at pos. Must be called after
+ * plcoll was modified.
+ *
+ * @returns The new generation of the playlist.
+ */
+gint64
+xmms_playlist_changelog_insert (xmms_playlist_changelog_t *log,
+                                const gchar *name, xmmsv_t *plcoll,
+                                gint pos, gint count)
+{
+	xmms_playlist_history_t *history;
+	xmms_playlist_change_t *change;
+	guint old_weight = 0;
+	gint size;
+
+	g_return_val_if_fail (log, 0);
+	g_return_val_if_fail (name, 0);
+
+	size = xmmsv_coll_idlist_get_size (plcoll);
+	history = xmms_playlist_changelog_history (log, name, plcoll, size - count);
+
+	change = g_queue_peek_tail (&history->changes);
+	if (count == 1 && change && change->type == XMMS_PLAYLIST_CHANGED_INSERT &&
+	    change->last - change->first + 1 == change->ids->len &&
+	    change->position + change->ids->len == pos) {
+		old_weight = xmms_playlist_change_weight (change);
+		change->last = ++history->generation;
+	} else {
+		change = xmms_playlist_history_push (history, XMMS_PLAYLIST_CHANGED_INSERT, pos);
+		change->ids = g_array_sized_new (FALSE, FALSE, sizeof (gint32), count);
+	}
+
+	xmms_playlist_ids_append (change->ids, plcoll, pos, count);
+	xmms_playlist_history_account (log, history, change, old_weight, size);
+
+	return history->generation;
+}
+
+/**
+ * Record that count entries were removed at pos. Must be called after
+ * plcoll was modified.
+ *
+ * @returns The new generation of the playlist.
+ */
+gint64
+xmms_playlist_changelog_remove (xmms_playlist_changelog_t *log,
+                                const gchar *name, xmmsv_t *plcoll,
+                                gint pos, gint count)
+{
+	xmms_playlist_history_t *history;
+	xmms_playlist_change_t *change;
+	guint old_weight = 0;
+	gint size;
+
+	g_return_val_if_fail (log, 0);
+	g_return_val_if_fail (name, 0);
+
+	size = xmmsv_coll_idlist_get_size (plcoll);
+	history = xmms_playlist_changelog_history (log, name, plcoll, size + count);
+
+	change = g_queue_peek_tail (&history->changes);
+	if (count == 1 && change && change->type == XMMS_PLAYLIST_CHANGED_REMOVE &&
+	    change->last - change->first + 1 == change->count &&
+	    change->position == pos) {
+		old_weight = xmms_playlist_change_weight (change);
+		change->last = ++history->generation;
+		change->count++;
+	} else {
+		change = xmms_playlist_history_push (history, XMMS_PLAYLIST_CHANGED_REMOVE, pos);
+		change->count = count;
+	}
+
+	xmms_playlist_history_account (log, history, change, old_weight, size);
+
+	return history->generation;
+}
+
+/**
+ * Record that the entry at pos was moved to newpos.
+ *
+ * @returns The new generation of the playlist.
+ */
+gint64
+xmms_playlist_changelog_move (xmms_playlist_changelog_t *log,
+                              const gchar *name, xmmsv_t *plcoll,
+                              gint pos, gint newpos)
+{
+	xmms_playlist_history_t *history;
+	xmms_playlist_change_t *change;
+	gint size;
+
+	g_return_val_if_fail (log, 0);
+	g_return_val_if_fail (name, 0);
+
+	size = xmmsv_coll_idlist_get_size (plcoll);
+	history = xmms_playlist_changelog_history (log, name, plcoll, size);
+
+	change = xmms_playlist_history_push (history, XMMS_PLAYLIST_CHANGED_MOVE, pos);
+	change->newposition = newpos;
+
+	xmms_playlist_history_account (log, history, change, 0, size);
+
+	return history->generation;
+}
+
+typedef struct {
+	gint32 id;
+	gint pos;
+} xmms_playlist_slot_t;
+
+static gint
+xmms_playlist_slot_compare (gconstpointer a, gconstpointer b)
+{
+	const xmms_playlist_slot_t *x = a, *y = b;
+
+	if (x->id != y->id)
+		return x->id < y->id ? -1 : 1;
+	return x->pos - y->pos;
+}
+
+/**
+ * Express new[0..len) as runs of old[0..len), if it's a permutation of
+ * it and doesn't take more than max_runs runs. Duplicate ids are
+ * matched in order of appearance.
+ *
+ * @returns The (source, length) pairs, relative to the start of old,
+ * or NULL.
+ */
+static GArray *
+xmms_playlist_permutation_runs (const gint32 *old, const gint32 *new,
+                                gint len, guint max_runs)
+{
+	xmms_playlist_slot_t *slots;
+	GArray *runs;
+	gint *next;
+	gint i, lo, hi, mid, src, start = -1, run = 0;
+
+	slots = g_new (xmms_playlist_slot_t, len);
+	for (i = 0; i < len; i++) {
+		slots[i].id = old[i];
+		slots[i].pos = i;
+	}
+	qsort (slots, len, sizeof (xmms_playlist_slot_t), xmms_playlist_slot_compare);
+
+	/* next[i] is the next unused slot for the id group starting at i */
+	next = g_new (gint, len);
+	for (i = 0; i < len; i++) {
+		next[i] = i;
+	}
+
+	runs = g_array_new (FALSE, FALSE, sizeof (gint32));
+
+	for (i = 0; i < len; i++) {
+		lo = 0;
+		hi = len;
+		while (lo < hi) {
+			mid = lo + (hi - lo) / 2;
+			if (slots[mid].id < new[i])
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+
+		if (lo == len || slots[lo].id != new[i] ||
+		    next[lo] == len || slots[next[lo]].id != new[i]) {
+			break;
+		}
+
+		src = slots[next[lo]].pos;
+		next[lo]++;
+
+		if (start >= 0 && src == start + run) {
+			run++;
+			continue;
+		}
+
+		if (start >= 0) {
+			gint32 pair[2] = { start, run };
+			g_array_append_vals (runs, pair, 2);
+			if (runs->len / 2 >= max_runs) {
+				break;
+			}
+		}
+		start = src;
+		run = 1;
+	}
+
+	if (i == len && start >= 0) {
+		gint32 pair[2] = { start, run };
+		g_array_append_vals (runs, pair, 2);
+	}
+
+	g_free (next);
+	g_free (slots);
+
+	if (i < len || runs->len / 2 > max_runs) {
+		g_array_free (runs, TRUE);
+		return NULL;
+	}
+
+	return runs;
+}
+
+/**
+ * Record that the contents of the playlist were replaced. The common
+ * head and tail of the old and new contents are skipped, and what is
+ * left is recorded as a permutation if the entries were only
+ * reordered, or as a removal followed by an insertion otherwise.
+ * Must be called after plcoll was modified.
+ *
+ * @returns The new generation of the playlist.
+ */
+gint64
+xmms_playlist_changelog_replace (xmms_playlist_changelog_t *log,
+                                 const gchar *name, xmmsv_t *plcoll,
+                                 const gint32 *old_ids, gint old_len)
+{
+	xmms_playlist_history_t *history;
+	xmms_playlist_change_t *change;
+	GArray *new_ids, *runs = NULL;
+	const gint32 *new;
+	gint new_len, head = 0, tail = 0, removed, inserted;
+
+	g_return_val_if_fail (log, 0);
+	g_return_val_if_fail (name, 0);
+
+	new_len = xmmsv_coll_idlist_get_size (plcoll);
+	history = xmms_playlist_changelog_history (log, name, plcoll, old_len);
+
+	new_ids = g_array_sized_new (FALSE, FALSE, sizeof (gint32), new_len);
+	xmms_playlist_ids_append (new_ids, plcoll, 0, new_len);
+	new = (const gint32 *) new_ids->data;
+
+	while (head < old_len && head < new_len && old_ids[head] == new[head]) {
+		head++;
+	}
+	while (tail < old_len - head && tail < new_len - head &&
+	       old_ids[old_len - tail - 1] == new[new_len - tail - 1]) {
+		tail++;
+	}
+
+	removed = old_len - head - tail;
+	inserted = new_len - head - tail;
+
+	if (removed == 0 && inserted == 0) {
+		/* Nothing to replay, but every change message still gets
+		 * a generation of its own. */
+		g_array_free (new_ids, TRUE);
+		return ++history->generation;
+	}
+
+	if (removed == inserted) {
+		runs = xmms_playlist_permutation_runs (old_ids + head, new + head,
+		                                       inserted, inserted / 2);
+	}
+
+	if (runs) {
+		guint i;
+
+		for (i = 0; i < runs->len; i += 2) {
+			g_array_index (runs, gint32, i) += head;
+		}
+
+		change = xmms_playlist_history_push (history, XMMS_PLAYLIST_CHANGED_SORT, head);
+		change->count = inserted;
+		change->ids = runs;
+		xmms_playlist_history_account (log, history, change, 0, new_len);
+	} else {
+		if (removed > 0) {
+			change = xmms_playlist_history_push (history, XMMS_PLAYLIST_CHANGED_REMOVE, head);
+			change->count = removed;
+			xmms_playlist_history_account (log, history, change, 0, old_len - removed);
+		}
+		if (inserted > 0) {
+			change = xmms_playlist_history_push (history, XMMS_PLAYLIST_CHANGED_INSERT, head);
+			change->ids = g_array_sized_new (FALSE, FALSE, sizeof (gint32), inserted);
+			g_array_append_vals (change->ids, new + head, inserted);
+			xmms_playlist_history_account (log, history, change, 0, new_len);
+		}
+	}
+
+	g_array_free (new_ids, TRUE);
+
+	return history->generation;
+}
+
+static xmmsv_t *
+xmms_playlist_ids_to_list (const gint32 *ids, guint len)
+{
+	xmmsv_t *list;
+	guint i;
+
+	list = xmmsv_new_list ();
+	for (i = 0; i < len; i++) {
+		xmmsv_list_append_int (list, ids[i]);
+	}
+
+	return list;
+}
+
+/**
+ * Serialize a change, or the part of a merged change that happened
+ * after the given generation.
+ */
+static xmmsv_t *
+xmms_playlist_change_to_dict (xmms_playlist_change_t *change, gint64 since)
+{
+	xmmsv_t *dict, *list;
+	gint skip = 0;
+
+	if (change->first <= since) {
+		skip = since - change->first + 1;
+	}
+
+	dict = xmmsv_build_dict (XMMSV_DICT_ENTRY_INT ("type", change->type),
+	                         XMMSV_DICT_ENTRY_INT ("generation", change->last),
+	                         XMMSV_DICT_END);
+
+	switch (change->type) {
+		case XMMS_PLAYLIST_CHANGED_INSERT:
+			xmmsv_dict_set_int (dict, "position", change->position + skip);
+			list = xmms_playlist_ids_to_list ((gint32 *) change->ids->data + skip,
+			                                  change->ids->len - skip);
+			xmmsv_dict_set (dict, "ids", list);
+			xmmsv_unref (list);
+			break;
+		case XMMS_PLAYLIST_CHANGED_REMOVE:
+			xmmsv_dict_set_int (dict, "position", change->position);
+			xmmsv_dict_set_int (dict, "count", change->count - skip);
+			break;
+		case XMMS_PLAYLIST_CHANGED_MOVE:
+			xmmsv_dict_set_int (dict, "position", change->position);
+			xmmsv_dict_set_int (dict, "newposition", change->newposition);
+			break;
+		case XMMS_PLAYLIST_CHANGED_SORT:
+			xmmsv_dict_set_int (dict, "position", change->position);
+			xmmsv_dict_set_int (dict, "count", change->count);
+			list = xmms_playlist_ids_to_list ((gint32 *) change->ids->data,
+			                                  change->ids->len);
+			xmmsv_dict_set (dict, "runs", list);
+			xmmsv_unref (list);
+			break;
+		default:
+			break;
+	}
+
+	return dict;
+}
+
+/**
+ * Get the changes made to a playlist after the given generation.
+ *
+ * The returned dict always holds the current "generation". If the
+ * changes since the requested generation are known they are listed
+ * oldest first under "changes", otherwise the complete contents of the
+ * playlist are returned under "entries".
+ *
+ * Changes are dicts with a "type" (a playlist changed action), the
+ * "generation" after the change and a "position":
+ * - INSERT: the inserted "ids" start at position.
+ * - REMOVE: "count" entries starting at position were removed.
+ * - MOVE: the entry at position was moved to "newposition".
+ * - SORT: the "count" entries starting at position were replaced by
+ *   the concatenation of the "runs", which are (source, length) pairs
+ *   referring to positions in the playlist before the change.
+ */
+xmmsv_t *
+xmms_playlist_changelog_since (xmms_playlist_changelog_t *log,
+                               const gchar *name, xmmsv_t *plcoll,
+                               gint64 generation)
+{
+	xmms_playlist_history_t *history;
+	xmms_playlist_change_t *change;
+	xmmsv_t *ret, *changes, *dict;
+	GList *l;
+
+	g_return_val_if_fail (log, NULL);
+	g_return_val_if_fail (name, NULL);
+
+	history = xmms_playlist_changelog_history (log, name, plcoll,
+	                                           xmmsv_coll_idlist_get_size (plcoll));
+
+	ret = xmmsv_new_dict ();
+	xmmsv_dict_set_int (ret, "generation", history->generation);
+
+	if (generation < history->floor || generation > history->generation) {
+		/* the idlist keeps changing after the playlist is unlocked */
+		changes = xmmsv_copy (xmmsv_coll_idlist_get (plcoll));
+		xmmsv_dict_set (ret, "entries", changes);
+		xmmsv_unref (changes);
+		return ret;
+	}
+
+	changes = xmmsv_new_list ();
+
+	/* Find the oldest change still needed, walking from the newest */
+	for (l = history->changes.tail; l && ((xmms_playlist_change_t *) l->data)->first > generation; l = l->prev);
+	if (l) {
+		change = l->data;
+		if (change->last <= generation) {
+			l = l->next;
+		}
+	} else {
+		l = history->changes.head;
+	}
+
+	for (; l; l = l->next) {
+		dict = xmms_playlist_change_to_dict (l->data, generation);
+		xmmsv_list_append (changes, dict);
+		xmmsv_unref (dict);
+	}
+
+	xmmsv_dict_set (ret, "changes", changes);
+	xmmsv_unref (changes);
+
+	return ret;
+}
@@ -0,0 +1,417 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_resampler.h>
+#include <xmms/xmms_log.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define XMMS_RESAMPLER_X86
+#include <immintrin.h>
+#endif
+
+/**
+  * @defgroup Resampler Resampler
+  * @ingroup Sample
+  * @brief Band-limited polyphase resampling of float samples.
+  *
+  * The conversion ratio is reduced to L/M, and a windowed-sinc
+  * lowpass filter is precomputed for each of the L fractional
+  * positions an output sample can land on. Every output sample is
+  * then a single dot product between one of those phases and the
+  * input history.
+  * @{
+  */
+
+/** Largest L we build coefficient tables for, callers fall back
+ * to linear interpolation beyond that. */
+#define XMMS_RESAMPLER_MAX_PHASES 1024
+#define XMMS_RESAMPLER_MAX_TAPS 1024
+
+typedef gfloat (*xmms_resampler_dot_func_t) (const gfloat *a, const gfloat *b, guint n);
+
+struct xmms_resampler_St {
+	guint channels;
+
+	/** Interpolation and decimation factors */
+	guint interpolation;
+	guint decimation;
+	/** Input frames to advance per output frame, split in whole and fraction */
+	guint step_int;
+	guint step_frac;
+
+	/** Filter length, a multiple of 8 */
+	guint taps;
+	/** interpolation * taps coefficients, one row per phase */
+	gfloat *coeffs;
+
+	/** Deinterleaved input history, one array per channel */
+	gfloat **history;
+	guint history_len;
+	guint history_size;
+
+	/** Position of the next output frame in the history */
+	guint pos;
+	guint phase;
+
+	xmms_resampler_dot_func_t dot;
+};
+
+typedef struct {
+	guint taps;
+	gdouble beta;
+	gdouble cutoff;
+} xmms_resampler_params_t;
+
+static const xmms_resampler_params_t quality_params[] = {
+	[XMMS_RESAMPLER_QUALITY_LOW] = { 16, 5.0, 0.80 },
+	[XMMS_RESAMPLER_QUALITY_MEDIUM] = { 32, 7.0, 0.86 },
+	[XMMS_RESAMPLER_QUALITY_HIGH] = { 96, 10.0, 0.93 },
+};
+
+static gfloat
+dot_c (const gfloat *a, const gfloat *b, guint n)
+{
+	gfloat s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0;
+	guint i;
+
+	for (i = 0; i < n; i += 4) {
+		s0 += a[i] * b[i];
+		s1 += a[i + 1] * b[i + 1];
+		s2 += a[i + 2] * b[i + 2];
+		s3 += a[i + 3] * b[i + 3];
+	}
+
+	return (s0 + s1) + (s2 + s3);
+}
+
+#ifdef XMMS_RESAMPLER_X86
+__attribute__ ((target ("sse2")))
+static gfloat
+dot_sse2 (const gfloat *a, const gfloat *b, guint n)
+{
+	__m128 acc0 = _mm_setzero_ps ();
+	__m128 acc1 = _mm_setzero_ps ();
+	gfloat sum[4];
+	guint i;
+
+	for (i = 0; i < n; i += 8) {
+		acc0 = _mm_add_ps (acc0, _mm_mul_ps (_mm_loadu_ps (a + i),
+		                                     _mm_loadu_ps (b + i)));
+		acc1 = _mm_add_ps (acc1, _mm_mul_ps (_mm_loadu_ps (a + i + 4),
+		                                     _mm_loadu_ps (b + i + 4)));
+	}
+
+	_mm_storeu_ps (sum, _mm_add_ps (acc0, acc1));
+
+	return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+__attribute__ ((target ("avx2,fma")))
+static gfloat
+dot_avx2 (const gfloat *a, const gfloat *b, guint n)
+{
+	__m256 acc = _mm256_setzero_ps ();
+	__m128 half;
+	gfloat sum[4];
+	guint i;
+
+	for (i = 0; i < n; i += 8) {
+		acc = _mm256_fmadd_ps (_mm256_loadu_ps (a + i),
+		                       _mm256_loadu_ps (b + i), acc);
+	}
+
+	half = _mm_add_ps (_mm256_castps256_ps128 (acc),
+	                   _mm256_extractf128_ps (acc, 1));
+	_mm_storeu_ps (sum, half);
+
+	return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+#endif
+
+static xmms_resampler_dot_func_t
+xmms_resampler_dot_get (void)
+{
+#ifdef XMMS_RESAMPLER_X86
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma")) {
+		return dot_avx2;
+	}
+	if (__builtin_cpu_supports ("sse2")) {
+		return dot_sse2;
+	}
+#endif
+
+	return dot_c;
+}
+
+/* zeroth order modified bessel function of the first kind */
+static gdouble
+bessel_i0 (gdouble x)
+{
+	gdouble sum = 1.0, term = 1.0;
+	gint k;
+
+	for (k = 1; k < 64 && term > sum * 1e-12; k++) {
+		term *= (x / (2.0 * k)) * (x / (2.0 * k));
+		sum += term;
+	}
+
+	return sum;
+}
+
+static void
+xmms_resampler_design (xmms_resampler_t *rs, const xmms_resampler_params_t *params,
+                       guint taps)
+{
+	gdouble cutoff, ratio, d, x, sum;
+	guint p, k, half;
+	gfloat *row;
+
+	half = taps / 2;
+	ratio = (gdouble) rs->interpolation / rs->decimation;
+	cutoff = params->cutoff * MIN (1.0, ratio);
+
+	rs->coeffs = g_new0 (gfloat, rs->interpolation * rs->taps);
+
+	for (p = 0; p < rs->interpolation; p++) {
+		row = rs->coeffs + p * rs->taps;
+		sum = 0.0;
+
+		for (k = 0; k < taps; k++) {
+			/* distance from tap k to the output position */
+			d = (gdouble) k - (half - 1) - (gdouble) p / rs->interpolation;
+			x = d / half;
+
+			if (fabs (x) > 1.0) {
+				continue;
+			}
+
+			row[k] = cutoff * (d == 0.0 ? 1.0 : sin (M_PI * cutoff * d) / (M_PI * cutoff * d));
+			row[k] *= bessel_i0 (params->beta * sqrt (1.0 - x * x)) / bessel_i0 (params->beta);
+			sum += row[k];
+		}
+
+		/* unity gain at DC for every phase */
+		for (k = 0; k < taps; k++) {
+			row[k] /= sum;
+		}
+	}
+}
+
+/**
+ * Create a new resampler for interleaved float samples.
+ *
+ * @param channels number of interleaved channels
+ * @param from input samplerate
+ * @param to output samplerate
+ * @param quality one of the polyphase quality levels
+ * @returns a new resampler, or NULL if the ratio needs more phases
+ * than we are willing to tabulate or the quality level is linear.
+ */
+xmms_resampler_t *
+xmms_resampler_new (guint channels, guint from, guint to,
+                    xmms_resampler_quality_t quality)
+{
+	const xmms_resampler_params_t *params;
+	xmms_resampler_t *rs;
+	guint a, b, t, taps;
+
+	g_return_val_if_fail (channels > 0, NULL);
+	g_return_val_if_fail (from > 0 && to > 0, NULL);
+
+	if (quality == XMMS_RESAMPLER_QUALITY_LINEAR ||
+	    quality >= G_N_ELEMENTS (quality_params)) {
+		return NULL;
+	}
+
+	for (a = from, b = to; b != 0; a = b, b = t) {
+		t = a % b;
+	}
+
+	if (to / a > XMMS_RESAMPLER_MAX_PHASES) {
+		XMMS_DBG ("Resampling ratio %d:%d too large for polyphase filter",
+		          from / a, to / a);
+		return NULL;
+	}
+
+	params = &quality_params[quality];
+
+	/* keep the transition band when decimating by widening the filter */
+	taps = params->taps;
+	if (from > to) {
+		taps = MIN ((guint64) taps * from / to, XMMS_RESAMPLER_MAX_TAPS);
+	}
+	taps = (taps + 7) & ~7;
+
+	rs = g_new0 (xmms_resampler_t, 1);
+	rs->channels = channels;
+	rs->interpolation = to / a;
+	rs->decimation = from / a;
+	rs->step_int = rs->decimation / rs->interpolation;
+	rs->step_frac = rs->decimation % rs->interpolation;
+	rs->taps = taps;
+	rs->dot = xmms_resampler_dot_get ();
+	rs->history = g_new0 (gfloat *, channels);
+
+	xmms_resampler_design (rs, params, taps);
+	xmms_resampler_reset (rs);
+
+	XMMS_DBG ("Polyphase resampler %d:%d, %d taps",
+	          rs->decimation, rs->interpolation, rs->taps);
+
+	return rs;
+}
+
+void
+xmms_resampler_free (xmms_resampler_t *rs)
+{
+	guint c;
+
+	g_return_if_fail (rs);
+
+	for (c = 0; c < rs->channels; c++) {
+		g_free (rs->history[c]);
+	}
+	g_free (rs->history);
+	g_free (rs->coeffs);
+	g_free (rs);
+}
+
+/**
+ * Forget all buffered input, used when seeking.
+ */
+void
+xmms_resampler_reset (xmms_resampler_t *rs)
+{
+	guint c;
+
+	g_return_if_fail (rs);
+
+	/* centre the first output sample on the first input sample */
+	rs->history_len = rs->taps / 2 - 1;
+	rs->pos = 0;
+	rs->phase = 0;
+
+	if (rs->history_size < rs->history_len) {
+		for (c = 0; c < rs->channels; c++) {
+			rs->history[c] = g_renew (gfloat, rs->history[c], rs->history_len);
+		}
+		rs->history_size = rs->history_len;
+	}
+
+	for (c = 0; c < rs->channels; c++) {
+		memset (rs->history[c], 0, rs->history_len * sizeof (gfloat));
+	}
+}
+
+/**
+ * Upper bound of the number of frames #xmms_resampler_process
+ * produces for the given number of input frames.
+ */
+guint
+xmms_resampler_max_output (xmms_resampler_t *rs, guint frames)
+{
+	g_return_val_if_fail (rs, 0);
+
+	return (guint64) (rs->history_len + frames) * rs->interpolation / rs->decimation + 1;
+}
+
+/**
+ * Resample interleaved float frames.
+ *
+ * @param in input frames
+ * @param frames number of input frames
+ * @param out room for at least #xmms_resampler_max_output frames
+ * @returns number of frames written to out
+ */
+guint
+xmms_resampler_process (xmms_resampler_t *rs, const gfloat *in, guint frames,
+                        gfloat *out)
+{
+	const gfloat *row;
+	guint c, i, n = 0, drop;
+
+	g_return_val_if_fail (rs, 0);
+
+	if (rs->history_len + frames > rs->history_size) {
+		rs->history_size = rs->history_len + frames;
+		for (c = 0; c < rs->channels; c++) {
+			rs->history[c] = g_renew (gfloat, rs->history[c], rs->history_size);
+		}
+	}
+
+	for (c = 0; c < rs->channels; c++) {
+		gfloat *dst = rs->history[c] + rs->history_len;
+		for (i = 0; i < frames; i++) {
+			dst[i] = in[i * rs->channels + c];
+		}
+	}
+	rs->history_len += frames;
+
+	while (rs->pos + rs->taps <= rs->history_len) {
+		row = rs->coeffs + rs->phase * rs->taps;
+
+		for (c = 0; c < rs->channels; c++) {
+			*out++ = rs->dot (row, rs->history[c] + rs->pos, rs->taps);
+		}
+		n++;
+
+		rs->pos += rs->step_int;
+		rs->phase += rs->step_frac;
+		if (rs->phase >= rs->interpolation) {
+			rs->phase -= rs->interpolation;
+			rs->pos++;
+		}
+	}
+
+	/* drop the input no output sample depends on anymore */
+	drop = MIN (rs->pos, rs->history_len);
+	for (c = 0; c < rs->channels; c++) {
+		memmove (rs->history[c], rs->history[c] + drop,
+		         (rs->history_len - drop) * sizeof (gfloat));
+	}
+	rs->history_len -= drop;
+	rs->pos -= drop;
+
+	return n;
+}
+
+/**
+ * Map a config value to a quality level, unknown values map to
+ * #XMMS_RESAMPLER_QUALITY_MEDIUM.
+ */
+xmms_resampler_quality_t
+xmms_resampler_quality_from_string (const gchar *name)
+{
+	if (name == NULL) {
+		return XMMS_RESAMPLER_QUALITY_MEDIUM;
+	} else if (g_ascii_strcasecmp (name, "linear") == 0) {
+		return XMMS_RESAMPLER_QUALITY_LINEAR;
+	} else if (g_ascii_strcasecmp (name, "low") == 0) {
+		return XMMS_RESAMPLER_QUALITY_LOW;
+	} else if (g_ascii_strcasecmp (name, "high") == 0) {
+		return XMMS_RESAMPLER_QUALITY_HIGH;
+	}
+
+	return XMMS_RESAMPLER_QUALITY_MEDIUM;
+}
+
+/** @} */
@@ -28,6 +28,11 @@
 
 /**
  * A ringbuffer
+ *
+ * In single-producer/single-consumer mode (see #xmms_ringbuf_new_spsc)
+ * the indices are only ever updated with atomic operations, and the
+ * internal #mutex is only taken when a reader or writer actually has to
+ * block, when somebody is blocked, or when hotspots are present.
  */
 struct xmms_ringbuf_St {
 	/** The actual bufferdata */
@@ -38,6 +43,10 @@ struct xmms_ringbuf_St {
 	guint buffer_size_usable;
 	/** Read and write index */
 	guint rd_index, wr_index;
+	/** Region handed out by #xmms_ringbuf_peek_region and not yet
+	 *  consumed. The writer keeps clear of it, even if the buffer is
+	 *  cleared in the meantime. */
+	guint peek_index, peek_len;
 	gboolean eos;
 
 	GQueue *hotspots;
@@ -45,8 +54,19 @@ struct xmms_ringbuf_St {
 	GCond free_cond;
 	GCond used_cond;
 	GCond eos_cond;
+
+	/** Lock-free single-producer/single-consumer mode */
+	gboolean spsc;
+	/** Protects #hotspots and the conditions in #spsc mode */
+	GMutex mutex;
+	/** Number of threads blocked on each condition, #spsc mode only */
+	gint free_waiters, used_waiters, eos_waiters;
+	/** Length of #hotspots, lets the reader skip locking */
+	gint hotspot_count;
 };
 
+typedef gboolean (*xmms_ringbuf_ready_func_t) (const xmms_ringbuf_t *ringbuf, guint len);
+
 typedef struct xmms_ringbuf_hotspot_St {
 	guint pos;
 	gboolean (*callback) (void *);
@@ -55,6 +75,101 @@ typedef struct xmms_ringbuf_hotspot_St {
 } xmms_ringbuf_hotspot_t;
 
 
+static inline guint
+rd_index_get (const xmms_ringbuf_t *ringbuf)
+{
+	return (guint) g_atomic_int_get ((gint *) &ringbuf->rd_index);
+}
+
+static inline guint
+wr_index_get (const xmms_ringbuf_t *ringbuf)
+{
+	return (guint) g_atomic_int_get ((gint *) &ringbuf->wr_index);
+}
+
+static inline gboolean
+eos_get (const xmms_ringbuf_t *ringbuf)
+{
+	return g_atomic_int_get ((gint *) &ringbuf->eos);
+}
+
+/**
+ * Wake up everyone waiting on cond. In #spsc mode this is a no-op unless
+ * someone actually is blocked.
+ */
+static void
+wake (xmms_ringbuf_t *ringbuf, GCond *cond, gint *waiters)
+{
+	if (!ringbuf->spsc) {
+		g_cond_broadcast (cond);
+		return;
+	}
+
+	if (g_atomic_int_get (waiters)) {
+		g_mutex_lock (&ringbuf->mutex);
+		g_cond_broadcast (cond);
+		g_mutex_unlock (&ringbuf->mutex);
+	}
+}
+
+/**
+ * Block on cond until ready returns TRUE.
+ *
+ * In locked mode mtx has to be held by the caller and is the mutex
+ * used to wait on. In #spsc mode mtx may be NULL, and if it is not it
+ * is released while blocking so that the caller's state can change in
+ * the meantime.
+ */
+static void
+wait_until (xmms_ringbuf_t *ringbuf, GCond *cond, gint *waiters,
+            xmms_ringbuf_ready_func_t ready, guint len, GMutex *mtx)
+{
+	if (!ringbuf->spsc) {
+		while (!ready (ringbuf, len)) {
+			g_cond_wait (cond, mtx);
+		}
+		return;
+	}
+
+	if (ready (ringbuf, len)) {
+		return;
+	}
+
+	if (mtx) {
+		g_mutex_unlock (mtx);
+	}
+
+	g_mutex_lock (&ringbuf->mutex);
+	g_atomic_int_inc (waiters);
+	while (!ready (ringbuf, len)) {
+		g_cond_wait (cond, &ringbuf->mutex);
+	}
+	g_atomic_int_add (waiters, -1);
+	g_mutex_unlock (&ringbuf->mutex);
+
+	if (mtx) {
+		g_mutex_lock (mtx);
+	}
+}
+
+static gboolean
+ready_free (const xmms_ringbuf_t *ringbuf, guint len)
+{
+	return xmms_ringbuf_bytes_free (ringbuf) >= len || eos_get (ringbuf);
+}
+
+static gboolean
+ready_used (const xmms_ringbuf_t *ringbuf, guint len)
+{
+	return xmms_ringbuf_bytes_used (ringbuf) >= len || eos_get (ringbuf);
+}
+
+static gboolean
+ready_eos (const xmms_ringbuf_t *ringbuf, guint len)
+{
+	return xmms_ringbuf_iseos (ringbuf);
+}
+
 /**
  * The usable size of the ringbuffer.
  */
@@ -99,6 +214,32 @@ xmms_ringbuf_new (guint size)
 	return ringbuf;
 }
 
+/**
+ * Allocate a new lock-free single-producer/single-consumer ringbuffer.
+ *
+ * Exactly one thread may read and exactly one thread may write, while
+ * #xmms_ringbuf_clear, #xmms_ringbuf_set_eos and
+ * #xmms_ringbuf_hotspot_set may be called from anywhere. The mutex
+ * arguments to the _wait functions are optional; when given, they have
+ * to be held by the caller and are released while blocking.
+ *
+ * @param size The total size of the new ringbuffer
+ * @returns a new #xmms_ringbuf_t
+ */
+xmms_ringbuf_t *
+xmms_ringbuf_new_spsc (guint size)
+{
+	xmms_ringbuf_t *ringbuf;
+
+	ringbuf = xmms_ringbuf_new (size);
+	g_return_val_if_fail (ringbuf, NULL);
+
+	ringbuf->spsc = TRUE;
+	g_mutex_init (&ringbuf->mutex);
+
+	return ringbuf;
+}
+
 /**
  * Free all memory used by the ringbuffer
  */
@@ -111,6 +252,10 @@ xmms_ringbuf_destroy (xmms_ringbuf_t *ringbuf)
 	g_cond_clear (&ringbuf->used_cond);
 	g_cond_clear (&ringbuf->free_cond);
 
+	if (ringbuf->spsc) {
+		g_mutex_clear (&ringbuf->mutex);
+	}
+
 	g_queue_free (ringbuf->hotspots);
 	g_free (ringbuf->buffer);
 	g_free (ringbuf);
@@ -122,31 +267,68 @@ xmms_ringbuf_destroy (xmms_ringbuf_t *ringbuf)
 void
 xmms_ringbuf_clear (xmms_ringbuf_t *ringbuf)
 {
+	GQueue hotspots = G_QUEUE_INIT;
+
 	g_return_if_fail (ringbuf);
 
-	ringbuf->rd_index = 0;
-	ringbuf->wr_index = 0;
+	/* the writer owns wr_index, so drop the data by moving the read
+	 * index instead; a concurrent reader notices the change when
+	 * committing its read.
+	 */
+	if (ringbuf->spsc) {
+		g_mutex_lock (&ringbuf->mutex);
+	}
+
+	g_atomic_int_set ((gint *) &ringbuf->rd_index, wr_index_get (ringbuf));
 
+	/* hotspot destroy functions must not run under our lock */
 	while (!g_queue_is_empty (ringbuf->hotspots)) {
+		g_queue_push_tail (&hotspots, g_queue_pop_head (ringbuf->hotspots));
+	}
+	g_atomic_int_set (&ringbuf->hotspot_count, 0);
+
+	if (ringbuf->spsc) {
+		g_mutex_unlock (&ringbuf->mutex);
+	}
+
+	while (!g_queue_is_empty (&hotspots)) {
 		xmms_ringbuf_hotspot_t *hs;
-		hs = g_queue_pop_head (ringbuf->hotspots);
+		hs = g_queue_pop_head (&hotspots);
 		if (hs->destroy)
 			hs->destroy (hs->arg);
 		g_free (hs);
 	}
-	g_cond_signal (&ringbuf->free_cond);
+
+	wake (ringbuf, &ringbuf->free_cond, &ringbuf->free_waiters);
 }
 
 /**
- * Number of bytes free in the ringbuffer
+ * Number of bytes free in the ringbuffer. A region handed out by
+ * #xmms_ringbuf_peek_region only becomes free once it is consumed.
  */
 guint
 xmms_ringbuf_bytes_free (const xmms_ringbuf_t *ringbuf)
 {
+	guint rd_index, wr_index, used;
+
 	g_return_val_if_fail (ringbuf, 0);
 
-	return ringbuf->buffer_size_usable -
-	       xmms_ringbuf_bytes_used (ringbuf);
+	/* The read index must be fetched before the peeked region. A peek
+	 * is published before the reader checks that the read index did
+	 * not move, so a clear that is seen here can't have missed it. */
+	rd_index = rd_index_get (ringbuf);
+	if (g_atomic_int_get ((gint *) &ringbuf->peek_len)) {
+		rd_index = (guint) g_atomic_int_get ((gint *) &ringbuf->peek_index);
+	}
+	wr_index = wr_index_get (ringbuf);
+
+	if (wr_index >= rd_index) {
+		used = wr_index - rd_index;
+	} else {
+		used = ringbuf->buffer_size - (rd_index - wr_index);
+	}
+
+	return ringbuf->buffer_size_usable - used;
 }
 
 /**
@@ -155,34 +337,75 @@ xmms_ringbuf_bytes_free (const xmms_ringbuf_t *ringbuf)
 guint
 xmms_ringbuf_bytes_used (const xmms_ringbuf_t *ringbuf)
 {
+	guint rd_index, wr_index;
+
 	g_return_val_if_fail (ringbuf, 0);
 
-	if (ringbuf->wr_index >= ringbuf->rd_index) {
-		return ringbuf->wr_index - ringbuf->rd_index;
+	rd_index = rd_index_get (ringbuf);
+	wr_index = wr_index_get (ringbuf);
+
+	if (wr_index >= rd_index) {
+		return wr_index - rd_index;
 	}
 
-	return ringbuf->buffer_size - (ringbuf->rd_index - ringbuf->wr_index);
+	return ringbuf->buffer_size - (rd_index - wr_index);
 }
 
-static guint
-read_bytes (xmms_ringbuf_t *ringbuf, guint8 *data, guint len)
+/**
+ * Pop the first hotspot if it is located at pos, otherwise make sure
+ * to_read doesn't cross it.
+ */
+static xmms_ringbuf_hotspot_t *
+hotspot_pop (xmms_ringbuf_t *ringbuf, guint pos, guint *to_read)
 {
-	guint to_read, r = 0, cnt, tmp;
-	gboolean ok;
+	xmms_ringbuf_hotspot_t *hs;
 
-	to_read = MIN (len, xmms_ringbuf_bytes_used (ringbuf));
+	if (!g_atomic_int_get (&ringbuf->hotspot_count)) {
+		return NULL;
+	}
 
-	while (!g_queue_is_empty (ringbuf->hotspots)) {
-		xmms_ringbuf_hotspot_t *hs = g_queue_peek_head (ringbuf->hotspots);
-		if (hs->pos != ringbuf->rd_index) {
+	if (ringbuf->spsc) {
+		g_mutex_lock (&ringbuf->mutex);
+	}
+
+	hs = g_queue_peek_head (ringbuf->hotspots);
+	if (hs && hs->pos == pos) {
+		(void) g_queue_pop_head (ringbuf->hotspots);
+		g_atomic_int_add (&ringbuf->hotspot_count, -1);
+	} else {
+		if (hs) {
 			/* make sure we don't cross a hotspot */
-			to_read = MIN (to_read,
-			               (hs->pos - ringbuf->rd_index + ringbuf->buffer_size)
-			               % ringbuf->buffer_size);
-			break;
+			*to_read = MIN (*to_read,
+			                (hs->pos - pos + ringbuf->buffer_size)
+			                % ringbuf->buffer_size);
 		}
+		hs = NULL;
+	}
 
-		(void) g_queue_pop_head (ringbuf->hotspots);
+	if (ringbuf->spsc) {
+		g_mutex_unlock (&ringbuf->mutex);
+	}
+
+	return hs;
+}
+
+/**
+ * Run the hotspots at the read position and return how many bytes can
+ * be read from rd_index without crossing the next one.
+ */
+static guint
+read_prepare (xmms_ringbuf_t *ringbuf, guint len, guint *rd_index)
+{
+	xmms_ringbuf_hotspot_t *hs;
+	guint to_read;
+	gboolean ok;
+
+	*rd_index = rd_index_get (ringbuf);
+	to_read = MIN (len, xmms_ringbuf_bytes_used (ringbuf));
+
+	/* we loop here, to see if there are multiple
+	   hotspots in same position */
+	while ((hs = hotspot_pop (ringbuf, *rd_index, &to_read))) {
 		ok = hs->callback (hs->arg);
 		if (hs->destroy)
 			hs->destroy (hs->arg);
@@ -192,11 +415,21 @@ read_bytes (xmms_ringbuf_t *ringbuf, guint8 *data, guint len)
 			return 0;
 		}
 
-		/* we loop here, to see if there are multiple
-		   hotspots in same position */
+		/* the callback might have cleared the buffer */
+		*rd_index = rd_index_get (ringbuf);
+		to_read = MIN (len, xmms_ringbuf_bytes_used (ringbuf));
 	}
 
-	tmp = ringbuf->rd_index;
+	return to_read;
+}
+
+static guint
+read_bytes (xmms_ringbuf_t *ringbuf, guint8 *data, guint len, guint *rd_index)
+{
+	guint to_read, r = 0, cnt, tmp;
+
+	to_read = read_prepare (ringbuf, len, rd_index);
+	tmp = *rd_index;
 
 	while (to_read > 0) {
 		cnt = MIN (to_read, ringbuf->buffer_size - tmp);
@@ -210,6 +443,35 @@ read_bytes (xmms_ringbuf_t *ringbuf, guint8 *data, guint len)
 	return r;
 }
 
+/**
+ * Move the read index past len bytes read from rd_index.
+ *
+ * @returns FALSE if the buffer was cleared after rd_index was fetched,
+ * in which case the data that was read is stale.
+ */
+static gboolean
+read_advance (xmms_ringbuf_t *ringbuf, guint rd_index, guint len)
+{
+	guint new_index = (rd_index + len) % ringbuf->buffer_size;
+
+	if (ringbuf->spsc) {
+		if (!g_atomic_int_compare_and_exchange ((gint *) &ringbuf->rd_index,
+		                                        (gint) rd_index,
+		                                        (gint) new_index)) {
+			return FALSE;
+		}
+	} else {
+		if (ringbuf->rd_index != rd_index) {
+			return FALSE;
+		}
+		ringbuf->rd_index = new_index;
+	}
+
+	wake (ringbuf, &ringbuf->free_cond, &ringbuf->free_waiters);
+
+	return TRUE;
+}
+
 /**
  * Reads data from the ringbuffer. This is a non-blocking call and can
  * return less data than you wanted. Use #xmms_ringbuf_wait_used to
@@ -223,19 +485,15 @@ read_bytes (xmms_ringbuf_t *ringbuf, guint8 *data, guint len)
 guint
 xmms_ringbuf_read (xmms_ringbuf_t *ringbuf, gpointer data, guint len)
 {
-	guint r;
+	guint r, rd_index;
 
 	g_return_val_if_fail (ringbuf, 0);
 	g_return_val_if_fail (data, 0);
 	g_return_val_if_fail (len > 0, 0);
 
-	r = read_bytes (ringbuf, (guint8 *) data, len);
-
-	ringbuf->rd_index += r;
-	ringbuf->rd_index %= ringbuf->buffer_size;
-
-	if (r) {
-		g_cond_broadcast (&ringbuf->free_cond);
+	r = read_bytes (ringbuf, (guint8 *) data, len, &rd_index);
+	if (!r || !read_advance (ringbuf, rd_index, r)) {
+		return 0;
 	}
 
 	return r;
@@ -250,12 +508,77 @@ xmms_ringbuf_read (xmms_ringbuf_t *ringbuf, gpointer data, guint len)
 guint
 xmms_ringbuf_peek (xmms_ringbuf_t *ringbuf, gpointer data, guint len)
 {
+	guint rd_index;
+
 	g_return_val_if_fail (ringbuf, 0);
 	g_return_val_if_fail (data, 0);
 	g_return_val_if_fail (len > 0, 0);
 	g_return_val_if_fail (len <= ringbuf->buffer_size_usable, 0);
 
-	return read_bytes (ringbuf, (guint8 *) data, len);
+	return read_bytes (ringbuf, (guint8 *) data, len, &rd_index);
+}
+
+/**
+ * Get a pointer to the readable data at the read position without
+ * copying it. Hotspots at the read position are run just like in
+ * #xmms_ringbuf_read, and the returned region never crosses a hotspot
+ * or the end of the buffer, so it may be shorter than what
+ * #xmms_ringbuf_bytes_used reports. Call #xmms_ringbuf_consume when
+ * done with the data. Until then the writer won't overwrite the
+ * region, even if the buffer is cleared.
+ *
+ * @param ringbuf Buffer to read from
+ * @param data Where to store a pointer to the readable region
+ * @param len Maximum number of bytes wanted
+ * @returns Number of bytes available at data
+ */
+guint
+xmms_ringbuf_peek_region (xmms_ringbuf_t *ringbuf, gconstpointer *data, guint len)
+{
+	guint to_read, rd_index;
+
+	g_return_val_if_fail (ringbuf, 0);
+	g_return_val_if_fail (data, 0);
+	g_return_val_if_fail (len > 0, 0);
+
+	/* publish the region, then make sure it wasn't cleared before
+	 * the writer could see it */
+	do {
+		to_read = read_prepare (ringbuf, len, &rd_index);
+		to_read = MIN (to_read, ringbuf->buffer_size - rd_index);
+
+		g_atomic_int_set ((gint *) &ringbuf->peek_index, rd_index);
+		g_atomic_int_set ((gint *) &ringbuf->peek_len, to_read);
+	} while (to_read > 0 && rd_index_get (ringbuf) != rd_index);
+
+	*data = ringbuf->buffer + rd_index;
+
+	return to_read;
+}
+
+/**
+ * Release len bytes of a region returned by #xmms_ringbuf_peek_region.
+ *
+ * @returns FALSE if the buffer was cleared after the region was
+ * fetched, in which case the data in the region was stale.
+ */
+gboolean
+xmms_ringbuf_consume (xmms_ringbuf_t *ringbuf, guint len)
+{
+	g_return_val_if_fail (ringbuf, FALSE);
+	g_return_val_if_fail (len <= ringbuf->peek_len, FALSE);
+
+	/* the data has been used, the region may be written again */
+	g_atomic_int_set ((gint *) &ringbuf->peek_len, 0);
+
+	if (len > 0 && read_advance (ringbuf, ringbuf->peek_index, len)) {
+		return TRUE;
+	}
+
+	/* read_advance only wakes the writer when it moved the index */
+	wake (ringbuf, &ringbuf->free_cond, &ringbuf->free_waiters);
+
+	return len == 0;
 }
 
 /**
@@ -273,16 +596,17 @@ xmms_ringbuf_read_wait (xmms_ringbuf_t *ringbuf, gpointer data,
 	g_return_val_if_fail (ringbuf, 0);
 	g_return_val_if_fail (data, 0);
 	g_return_val_if_fail (len > 0, 0);
-	g_return_val_if_fail (mtx, 0);
+	g_return_val_if_fail (mtx || ringbuf->spsc, 0);
 
 	while (r < len) {
 		res = xmms_ringbuf_read (ringbuf, dest + r, len - r);
 		r += res;
-		if (r == len || ringbuf->eos) {
+		if (r == len || eos_get (ringbuf)) {
 			break;
 		}
 		if (!res)
-			g_cond_wait (&ringbuf->used_cond, mtx);
+			wait_until (ringbuf, &ringbuf->used_cond, &ringbuf->used_waiters,
+			            ready_used, 1, mtx);
 	}
 
 	return r;
@@ -301,7 +625,7 @@ xmms_ringbuf_peek_wait (xmms_ringbuf_t *ringbuf, gpointer data,
 	g_return_val_if_fail (data, 0);
 	g_return_val_if_fail (len > 0, 0);
 	g_return_val_if_fail (len <= ringbuf->buffer_size_usable, 0);
-	g_return_val_if_fail (mtx, 0);
+	g_return_val_if_fail (mtx || ringbuf->spsc, 0);
 
 	xmms_ringbuf_wait_used (ringbuf, len, mtx);
 
@@ -323,7 +647,7 @@ guint
 xmms_ringbuf_write (xmms_ringbuf_t *ringbuf, gconstpointer data,
                     guint len)
 {
-	guint to_write, w = 0, cnt;
+	guint to_write, w = 0, cnt, wr_index;
 	const guint8 *src = data;
 
 	g_return_val_if_fail (ringbuf, 0);
@@ -331,22 +655,81 @@ xmms_ringbuf_write (xmms_ringbuf_t *ringbuf, gconstpointer data,
 	g_return_val_if_fail (len > 0, 0);
 
 	to_write = MIN (len, xmms_ringbuf_bytes_free (ringbuf));
+	wr_index = wr_index_get (ringbuf);
 
 	while (to_write > 0) {
-		cnt = MIN (to_write, ringbuf->buffer_size - ringbuf->wr_index);
-		memcpy (ringbuf->buffer + ringbuf->wr_index, src + w, cnt);
-		ringbuf->wr_index = (ringbuf->wr_index + cnt) % ringbuf->buffer_size;
+		cnt = MIN (to_write, ringbuf->buffer_size - wr_index);
+		memcpy (ringbuf->buffer + wr_index, src + w, cnt);
+		wr_index = (wr_index + cnt) % ringbuf->buffer_size;
 		to_write -= cnt;
 		w += cnt;
 	}
 
 	if (w) {
-		g_cond_broadcast (&ringbuf->used_cond);
+		/* publish the data only after it has been copied */
+		g_atomic_int_set ((gint *) &ringbuf->wr_index, wr_index);
+		wake (ringbuf, &ringbuf->used_cond, &ringbuf->used_waiters);
 	}
 
 	return w;
 }
 
+/**
+ * Get a pointer to the free space at the write position, so that data
+ * can be produced directly into the buffer. The region never crosses
+ * the end of the buffer, so it may be shorter than what
+ * #xmms_ringbuf_bytes_free reports. Call #xmms_ringbuf_commit to make
+ * the data visible to the reader.
+ *
+ * A locked ringbuffer must not be cleared between reserve and commit,
+ * in #spsc mode the committed data is simply dropped by a clear.
+ *
+ * @param ringbuf Buffer to write to
+ * @param data Where to store a pointer to the writable region
+ * @param len Maximum number of bytes wanted
+ * @returns Number of bytes that may be written to data
+ */
+guint
+xmms_ringbuf_reserve (xmms_ringbuf_t *ringbuf, gpointer *data, guint len)
+{
+	guint wr_index;
+
+	g_return_val_if_fail (ringbuf, 0);
+	g_return_val_if_fail (data, 0);
+	g_return_val_if_fail (len > 0, 0);
+
+	wr_index = wr_index_get (ringbuf);
+
+	len = MIN (len, xmms_ringbuf_bytes_free (ringbuf));
+	len = MIN (len, ringbuf->buffer_size - wr_index);
+
+	*data = ringbuf->buffer + wr_index;
+
+	return len;
+}
+
+/**
+ * Publish len bytes written to a region returned by
+ * #xmms_ringbuf_reserve.
+ */
+void
+xmms_ringbuf_commit (xmms_ringbuf_t *ringbuf, guint len)
+{
+	guint wr_index;
+
+	g_return_if_fail (ringbuf);
+	g_return_if_fail (len <= xmms_ringbuf_bytes_free (ringbuf));
+
+	if (!len) {
+		return;
+	}
+
+	wr_index = (wr_index_get (ringbuf) + len) % ringbuf->buffer_size;
+	g_atomic_int_set ((gint *) &ringbuf->wr_index, wr_index);
+
+	wake (ringbuf, &ringbuf->used_cond, &ringbuf->used_waiters);
+}
+
 /**
  * Same as #xmms_ringbuf_write but blocks until there is enough free space.
  */
@@ -361,15 +744,16 @@ xmms_ringbuf_write_wait (xmms_ringbuf_t *ringbuf, gconstpointer data,
 	g_return_val_if_fail (ringbuf, 0);
 	g_return_val_if_fail (data, 0);
 	g_return_val_if_fail (len > 0, 0);
-	g_return_val_if_fail (mtx, 0);
+	g_return_val_if_fail (mtx || ringbuf->spsc, 0);
 
 	while (w < len) {
 		w += xmms_ringbuf_write (ringbuf, src + w, len - w);
-		if (w == len || ringbuf->eos) {
+		if (w == len || eos_get (ringbuf)) {
 			break;
 		}
 
-		g_cond_wait (&ringbuf->free_cond, mtx);
+		wait_until (ringbuf, &ringbuf->free_cond, &ringbuf->free_waiters,
+		            ready_free, 1, mtx);
 	}
 
 	return w;
@@ -384,11 +768,10 @@ xmms_ringbuf_wait_free (xmms_ringbuf_t *ringbuf, guint len, GMutex *mtx)
 	g_return_if_fail (ringbuf);
 	g_return_if_fail (len > 0);
 	g_return_if_fail (len <= ringbuf->buffer_size_usable);
-	g_return_if_fail (mtx);
+	g_return_if_fail (mtx || ringbuf->spsc);
 
-	while ((xmms_ringbuf_bytes_free (ringbuf) < len) && !ringbuf->eos) {
-		g_cond_wait (&ringbuf->free_cond, mtx);
-	}
+	wait_until (ringbuf, &ringbuf->free_cond, &ringbuf->free_waiters,
+	            ready_free, len, mtx);
 }
 
 /**
@@ -401,11 +784,10 @@ xmms_ringbuf_wait_used (xmms_ringbuf_t *ringbuf, guint len, GMutex *mtx)
 	g_return_if_fail (ringbuf);
 	g_return_if_fail (len > 0);
 	g_return_if_fail (len <= ringbuf->buffer_size_usable);
-	g_return_if_fail (mtx);
+	g_return_if_fail (mtx || ringbuf->spsc);
 
-	while ((xmms_ringbuf_bytes_used (ringbuf) < len) && !ringbuf->eos) {
-		g_cond_wait (&ringbuf->used_cond, mtx);
-	}
+	wait_until (ringbuf, &ringbuf->used_cond, &ringbuf->used_waiters,
+	            ready_used, len, mtx);
 }
 
 /**
@@ -419,7 +801,7 @@ xmms_ringbuf_iseos (const xmms_ringbuf_t *ringbuf)
 {
 	g_return_val_if_fail (ringbuf, TRUE);
 
-	return !xmms_ringbuf_bytes_used (ringbuf) && ringbuf->eos;
+	return !xmms_ringbuf_bytes_used (ringbuf) && eos_get (ringbuf);
 }
 
 /**
@@ -430,12 +812,12 @@ xmms_ringbuf_set_eos (xmms_ringbuf_t *ringbuf, gboolean eos)
 {
 	g_return_if_fail (ringbuf);
 
-	ringbuf->eos = eos;
+	g_atomic_int_set (&ringbuf->eos, eos);
 
 	if (eos) {
-		g_cond_broadcast (&ringbuf->eos_cond);
-		g_cond_broadcast (&ringbuf->used_cond);
-		g_cond_broadcast (&ringbuf->free_cond);
+		wake (ringbuf, &ringbuf->eos_cond, &ringbuf->eos_waiters);
+		wake (ringbuf, &ringbuf->used_cond, &ringbuf->used_waiters);
+		wake (ringbuf, &ringbuf->free_cond, &ringbuf->free_waiters);
 	}
 }
 
@@ -447,11 +829,10 @@ void
 xmms_ringbuf_wait_eos (xmms_ringbuf_t *ringbuf, GMutex *mtx)
 {
 	g_return_if_fail (ringbuf);
-	g_return_if_fail (mtx);
+	g_return_if_fail (mtx || ringbuf->spsc);
 
-	while (!xmms_ringbuf_iseos (ringbuf)) {
-		g_cond_wait (&(ringbuf->eos_cond), mtx);
-	}
+	wait_until (ringbuf, &ringbuf->eos_cond, &ringbuf->eos_waiters,
+	            ready_eos, 0, mtx);
 
 }
 /** @} */
@@ -467,10 +848,19 @@ xmms_ringbuf_hotspot_set (xmms_ringbuf_t *ringbuf, gboolean (*cb) (void *), void
 	g_return_if_fail (ringbuf);
 
 	hs = g_new0 (xmms_ringbuf_hotspot_t, 1);
-	hs->pos = ringbuf->wr_index;
+	hs->pos = wr_index_get (ringbuf);
 	hs->callback = cb;
 	hs->destroy = destroy;
 	hs->arg = arg;
 
+	if (ringbuf->spsc) {
+		g_mutex_lock (&ringbuf->mutex);
+	}
+
 	g_queue_push_tail (ringbuf->hotspots, hs);
+	g_atomic_int_inc (&ringbuf->hotspot_count);
+
+	if (ringbuf->spsc) {
+		g_mutex_unlock (&ringbuf->mutex);
+	}
 }
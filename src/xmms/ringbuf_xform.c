@@ -32,7 +32,6 @@ typedef struct xmms_ringbuf_priv_St {
 	GThread *thread;
 
 	xmms_ringbuf_t *buffer;
-	GMutex buffer_lock;
 
 	xmms_buffer_state_t state;
 	GCond state_cond;
@@ -63,10 +62,9 @@ xmms_ringbuf_plugin_init (xmms_xform_t *xform)
 
 	g_cond_init (&priv->state_cond);
 	g_mutex_init (&priv->state_lock);
-	g_mutex_init (&priv->buffer_lock);
 
 	priv->state = STATE_WANT_BUFFER;
-	priv->buffer = xmms_ringbuf_new (MAX (4096, buffer_size));
+	priv->buffer = xmms_ringbuf_new_spsc (MAX (4096, buffer_size));
 
 	priv->thread = g_thread_new ("x2 ringbuf", xmms_ringbuf_xform_thread, xform);
 
@@ -100,7 +98,7 @@ xmms_ringbuf_plugin_read (xmms_xform_t *xform, void *buffer, gint len, xmms_erro
 	xmms_ringbuf_priv_t *priv;
 	priv = xmms_xform_private_data_get (xform);
 
-	return xmms_ringbuf_read_wait (priv->buffer, buffer, len, &priv->buffer_lock);
+	return xmms_ringbuf_read_wait (priv->buffer, buffer, len, NULL);
 }
 
 static gint64
@@ -167,7 +165,7 @@ fill (xmms_xform_t *xform, xmms_ringbuf_priv_t *priv)
 
 	res = xmms_xform_read (xform, buf, sizeof (buf), &err);
 	if (res > 0) {
-		xmms_ringbuf_write_wait (priv->buffer, buf, res, &priv->buffer_lock);
+		xmms_ringbuf_write_wait (priv->buffer, buf, res, NULL);
 	} else if (res == -1) {
 		/* XXX copy error */
 		g_mutex_lock (&priv->state_lock);
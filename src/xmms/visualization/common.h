@@ -31,16 +31,35 @@ typedef struct {
 	union {
 		xmmsc_vis_unixshm_t shm;
 		xmmsc_vis_udp_t udp;
+		xmmsc_vis_memfd_t memfd;
 	} transport;
 	xmmsc_vis_transport_t type;
 	unsigned short format;
 	xmmsc_vis_properties_t prop;
 } xmms_vis_client_t;
 
+/**
+ * One window of decoded data, waiting to be sent to the clients
+ */
+
+typedef struct {
+	struct timeval time;
+	int channels;
+	int size;
+	int allocated;
+	short *buf;
+	gboolean have_spectrum;
+	gfloat spectrum[XMMSC_VISUALIZATION_WINDOW_SIZE / 2];
+} xmms_vis_window_t;
+
+/* number of windows queued for the analysis thread */
+#define XMMS_VIS_WINDOW_QUEUE 4
+
 /* provided by object.c */
 xmms_vis_client_t *get_client (int32_t id);
 void delete_client (int32_t id);
 void send_data (int channels, int size, int16_t *buf);
+gboolean clients_attached (void);
 
 /* provided by unixshm.c / dummy.c */
 int32_t init_shm (xmms_visualization_t *vis, int32_t id, int32_t shmid, xmms_error_t *err);
@@ -48,16 +67,24 @@ void cleanup_shm (xmmsc_vis_unixshm_t *t);
 gboolean write_start_shm (int32_t id, xmmsc_vis_unixshm_t *t, xmmsc_vischunk_t **dest);
 void write_finish_shm (int32_t id, xmmsc_vis_unixshm_t *t, xmmsc_vischunk_t *dest);
 
-gboolean write_shm (xmmsc_vis_unixshm_t *t, xmms_vis_client_t *c, int32_t id, struct timeval *time, int channels, int size, short *buf);
+gboolean write_shm (xmmsc_vis_unixshm_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window);
+
+/* provided by memfd.c / memfd_dummy.c */
+int32_t init_memfd (xmms_visualization_t *vis, int32_t id, xmms_error_t *err);
+void cleanup_memfd (xmmsc_vis_memfd_t *t);
+gboolean write_memfd (xmmsc_vis_memfd_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window);
 
 /* provided by udp.c */
 int32_t init_udp (xmms_visualization_t *vis, int32_t id, xmms_error_t *err);
 void cleanup_udp (xmmsc_vis_udp_t *t, xmms_socket_t socket);
-gboolean write_udp (xmmsc_vis_udp_t *t, xmms_vis_client_t *c, int32_t id, struct timeval *time, int channels, int size, short *buf, int socket);
+gboolean write_udp (xmmsc_vis_udp_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window, int socket);
 
 /* provided by format.c */
-void fft_init (void);
-short fill_buffer (int16_t *dest, xmmsc_vis_properties_t* prop, int channels, int size, short *src);
+short fill_buffer (int16_t *dest, xmmsc_vis_properties_t* prop, xmms_vis_window_t *window);
+
+/* provided by spectrum.c */
+void spectrum_init (void);
+void spectrum_compute (const short *src, gint channels, gfloat *spec);
 
 /* never call a fetch without a guaranteed release following! */
 #define x_fetch_client(id) \
@@ -84,6 +111,16 @@ struct xmms_visualization_St {
 	GMutex clientlock;
 	int32_t clientc;
 	xmms_vis_client_t **clientv;
+	gint active_clients;
+
+	/* windows handed from the decoder to the analysis thread */
+	GThread *analysis_thread;
+	GMutex windowlock;
+	GCond windowcond;
+	gboolean running;
+	gint window_head;
+	gint window_count;
+	xmms_vis_window_t windows[XMMS_VIS_WINDOW_QUEUE];
 };
 
 #endif
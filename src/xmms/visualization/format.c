@@ -2,129 +2,28 @@
 #include "common.h"
 
 #define FFT_LEN XMMSC_VISUALIZATION_WINDOW_SIZE
-/* TODO: better way, check this! */
-#define FFT_BITS 9
 
 /* Log scale settings */
 #define AMP_LOG_SCALE_THRESHOLD0	0.001f
 #define AMP_LOG_SCALE_DIVISOR		6.908f	/* divisor = -log threshold */
 #define FREQ_LOG_SCALE_BASE		2.0f
 
-static gfloat window[FFT_LEN];
-static gfloat spec[FFT_LEN/2];
-static gboolean fft_ready = FALSE;
-static gboolean fft_done;
-
-void fft_init ()
-{
-	if (!fft_ready) {
-		int i;
-		/* calculate Hann window used to reduce spectral leakage */
-		for (i = 0; i < FFT_LEN; i++) {
-			window[i] = 0.5 - 0.5 * cos (2.0 * M_PI * i / FFT_LEN);
-		}
-		fft_done = TRUE;
-	}
-	fft_done = FALSE;
-}
-
 /* interesting:	data->value.uint32 = xmms_sample_samples_to_ms (vis->format, pos); */
 
-static void
-fft (short *samples, gfloat *spec)
-{
-	gint nv2, k, l, j = 0, i;
-	gfloat t_r, t_i;
-	gfloat buf[FFT_LEN][2];
-
-	for (i = 0; i < FFT_LEN; i++){
-		buf[i][0]  = (float) samples[j++];
-		buf[i][0] += (float) samples[j++];
-		buf[i][0] /= (float) (1 << 17);
-		buf[i][0] *= window[i];
-		buf[i][1] = 0.0f;
-	}
-
-	/* reorder... */  /* this is crappy! Go rewrite it using real bitreversing */
-	nv2 = FFT_LEN / 2;
-	j = 1;
-
-	for (i = 1; i < FFT_LEN; i++) {
-		if (i < j) {
-			t_r = buf[i - 1][0];
-			t_i = buf[i - 1][1];
-			buf[i - 1][0] = buf[j - 1][0];
-			buf[i - 1][1] = buf[j - 1][1];
-			buf[j - 1][0] = t_r;
-			buf[j - 1][1] = t_i;
-		}
-
-		k = nv2;
-
-		while (k < j) {
-			j -= k;
-			k >>= 1;
-		}
-
-		j += k;
-	}
-
-	/* do fft */
-	for (l = 1; l <= FFT_BITS; l++) {
-		gint le = 1 << l;
-		gint le1 = le / 2;
-		gfloat u_r = 1.0;
-		gfloat u_i = 0.0;
-		gfloat w_r =  cosf (M_PI / (float) le1);
-		gfloat w_i = -sinf (M_PI / (float) le1);
-
-		for (j = 1; j <= le1; j++) {
-			for (i = j; i <= FFT_LEN; i += le) {
-				gint ip = i + le1;
-
-				t_r = buf[ip - 1][0] * u_r - u_i * buf[ip - 1][1];
-				t_i = buf[ip - 1][1] * u_r + u_i * buf[ip - 1][0];
-
-				buf[ip - 1][0] = buf[i - 1][0] - t_r;
-				buf[ip - 1][1] = buf[i - 1][1] - t_i;
-
-				buf[i - 1][0] =  buf[i - 1][0] + t_r;
-				buf[i - 1][1] =  buf[i - 1][1] + t_i;
-			}
-
-			t_r = u_r * w_r - w_i * u_i;
-			u_i = w_r * u_i + w_i * u_r;
-			u_r = t_r;
-		}
-	}
-
-	/* output abs-value instead */
-	for (i = 0; i < nv2; i++) {
-		spec[i] = 2 * hypot (buf[i][0], buf[i][1]) / FFT_LEN;
-	}
-
-	/* correct the scale */
-	spec[nv2 - 1] /= 2;
-}
-
 /**
- * Calcualte the FFT on the decoded data buffer.
+ * Write the spectrum the analysis thread calculated for this window.
  */
 static short
-fill_buffer_fft (int16_t* dest, int size, short *src)
+fill_buffer_fft (int16_t* dest, xmms_vis_window_t *window)
 {
+	const gfloat *spec = window->spectrum;
 	int i;
 	float tmp;
 
-	if (size != FFT_LEN * 2) {
+	if (!window->have_spectrum) {
 		return 0;
 	}
 
-	if (!fft_done) {
-		fft (src, spec);
-		fft_done = TRUE;
-	}
-
 	/* TODO: more sophisticated! */
 	for (i = 0; i < FFT_LEN / 2; ++i) {
 		if (spec[i] >= 1.0) {
@@ -145,8 +44,11 @@ fill_buffer_fft (int16_t* dest, int size, short *src)
 }
 
 short
-fill_buffer (int16_t *dest, xmmsc_vis_properties_t* prop, int channels, int size, short *src)
+fill_buffer (int16_t *dest, xmmsc_vis_properties_t* prop, xmms_vis_window_t *window)
 {
+	int channels = window->channels;
+	int size = window->size;
+	short *src = window->buf;
 	int i, j;
 	if (prop->type == VIS_PEAK) {
 		short l = 0, r = 0;
@@ -203,7 +105,7 @@ fill_buffer (int16_t *dest, xmmsc_vis_properties_t* prop, int channels, int size
 		}
 	}
 	if (prop->type == VIS_SPECTRUM) {
-		size = fill_buffer_fft (dest, size, src);
+		size = fill_buffer_fft (dest, window);
 	}
 	return size;
 }
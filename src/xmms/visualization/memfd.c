@@ -0,0 +1,178 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#define _GNU_SOURCE
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <limits.h>
+#include <errno.h>
+
+#include <xmmspriv/xmms_ipc.h>
+
+#include "common.h"
+
+/* how often to check whether the client is still there */
+#define LIVENESS_INTERVAL 64
+
+int32_t
+init_memfd (xmms_visualization_t *vis, int32_t id, xmms_error_t *err)
+{
+	xmmsc_vis_memfd_ring_t *ring;
+	xmms_vis_client_t *c;
+	struct stat st;
+	int memfd, alive, seals;
+	uint32_t size;
+
+	memfd = xmms_ipc_passed_fd_take ();
+	alive = xmms_ipc_passed_fd_take ();
+
+	if (memfd == -1 || alive == -1) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "memory and liveness descriptors expected");
+		goto fail;
+	}
+
+	/* the client must not be able to shrink the memory under our feet */
+	seals = fcntl (memfd, F_GET_SEALS);
+	if (seals == -1 || !(seals & F_SEAL_SHRINK)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "memory has to be sealed against shrinking");
+		goto fail;
+	}
+
+	if (fstat (memfd, &st) == -1 || st.st_size < XMMS_VISPACKET_MEMFD_LENGTH (1)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "memory too small");
+		goto fail;
+	}
+
+	ring = mmap (NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+	if (ring == MAP_FAILED) {
+		xmms_error_set (err, XMMS_ERROR_NO_SAUSAGE, "couldn't map shared memory");
+		goto fail;
+	}
+
+	close (memfd);
+	memfd = -1;
+
+	size = ring->size;
+	if (ring->magic != XMMS_VISPACKET_MEMFD_MAGIC || size == 0 ||
+	    size > (st.st_size - XMMS_VISPACKET_MEMFD_LENGTH (0)) / sizeof (xmmsc_vis_memfd_slot_t)) {
+		xmms_error_set (err, XMMS_ERROR_INVAL, "invalid ring header");
+		munmap (ring, st.st_size);
+		goto fail;
+	}
+
+	g_mutex_lock (&vis->clientlock);
+	c = get_client (id);
+	if (!c) {
+		g_mutex_unlock (&vis->clientlock);
+		xmms_error_set (err, XMMS_ERROR_INVAL, "invalid server-side identifier provided");
+		munmap (ring, st.st_size);
+		goto fail;
+	}
+
+	c->type = VIS_MEMFD;
+	c->transport.memfd.ring = ring;
+	c->transport.memfd.length = st.st_size;
+	c->transport.memfd.size = size;
+	c->transport.memfd.alive = alive;
+	c->transport.memfd.writes = 0;
+	g_mutex_unlock (&vis->clientlock);
+
+	xmms_log_info ("Visualization client %d initialised using memfd", id);
+	return size;
+
+fail:
+	if (memfd != -1) {
+		close (memfd);
+	}
+	if (alive != -1) {
+		close (alive);
+	}
+	return -1;
+}
+
+void
+cleanup_memfd (xmmsc_vis_memfd_t *t)
+{
+	munmap (t->ring, t->length);
+	close (t->alive);
+}
+
+/* the client keeps the other end of the socketpair open while it lives */
+static gboolean
+client_alive (xmmsc_vis_memfd_t *t)
+{
+	struct pollfd pfd = { t->alive, 0, 0 };
+
+	if (++t->writes < LIVENESS_INTERVAL) {
+		return TRUE;
+	}
+	t->writes = 0;
+
+	while (poll (&pfd, 1, 0) == -1) {
+		if (errno != EINTR) {
+			return FALSE;
+		}
+	}
+
+	return !(pfd.revents & (POLLHUP | POLLERR | POLLNVAL));
+}
+
+/**
+ * Write the window into the next slot, overwriting whatever the client
+ * didn't get to read. No syscall is made unless the client sleeps.
+ */
+gboolean
+write_memfd (xmmsc_vis_memfd_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window)
+{
+	xmmsc_vis_memfd_ring_t *ring = t->ring;
+	xmmsc_vis_memfd_slot_t *slot;
+	xmmsc_vischunk_t *dest;
+	uint32_t n;
+	short res;
+
+	if (!client_alive (t)) {
+		delete_client (id);
+		return FALSE;
+	}
+
+	/* we are the only writer */
+	n = __atomic_load_n (&ring->written, __ATOMIC_RELAXED);
+	slot = &ring->slots[n % t->size];
+	dest = &slot->chunk;
+
+	__atomic_store_n (&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence (__ATOMIC_RELEASE);
+
+	tv2net (dest->timestamp, &window->time);
+	dest->format = htons (c->format);
+	res = fill_buffer (dest->data, &c->prop, window);
+	dest->size = htons (res);
+
+	__atomic_store_n (&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+	__atomic_store_n (&ring->written, n + 1, __ATOMIC_SEQ_CST);
+
+	if (__atomic_load_n (&ring->waiting, __ATOMIC_SEQ_CST)) {
+		syscall (SYS_futex, &ring->written, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+	}
+
+	return TRUE;
+}
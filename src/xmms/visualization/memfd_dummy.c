@@ -0,0 +1,33 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "common.h"
+
+int32_t
+init_memfd (xmms_visualization_t *vis, int32_t id, xmms_error_t *err)
+{
+	xmms_error_set (err, XMMS_ERROR_NO_SAUSAGE,
+	                "memfd not supported by this platform!");
+	return -1;
+}
+
+void cleanup_memfd (xmmsc_vis_memfd_t *t) {}
+
+gboolean
+write_memfd (xmmsc_vis_memfd_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window)
+{
+	return FALSE;
+}
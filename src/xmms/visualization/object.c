@@ -36,10 +36,12 @@ static int32_t xmms_visualization_client_query_version (xmms_visualization_t *vi
 static int32_t xmms_visualization_client_register (xmms_visualization_t *vis, xmms_error_t *err);
 static int32_t xmms_visualization_client_init_shm (xmms_visualization_t *vis, int32_t id, const char *shmid, xmms_error_t *err);
 static int32_t xmms_visualization_client_init_udp (xmms_visualization_t *vis, int32_t id, xmms_error_t *err);
+static int32_t xmms_visualization_client_init_memfd (xmms_visualization_t *vis, int32_t id, xmms_error_t *err);
 static int32_t xmms_visualization_client_set_property (xmms_visualization_t *vis, int32_t id, const gchar *key, const gchar *value, xmms_error_t *err);
 static int32_t xmms_visualization_client_set_properties (xmms_visualization_t *vis, int32_t id, xmmsv_t *prop, xmms_error_t *err);
 static void xmms_visualization_client_shutdown (xmms_visualization_t *vis, int32_t id, xmms_error_t *err);
 static void xmms_visualization_destroy (xmms_object_t *object);
+static gpointer xmms_visualization_analysis_loop (gpointer udata);
 
 #include "visualization/object_ipc.c"
 
@@ -63,6 +65,8 @@ create_client (void)
 	if (!vis->clientv || (!(vis->clientv[id] = g_new (xmms_vis_client_t, 1)))) {
 		vis->clientc = 0;
 		id = -1;
+	} else {
+		g_atomic_int_inc (&vis->active_clients);
 	}
 
 	xmms_log_info ("Attached visualization client %d", id);
@@ -98,10 +102,13 @@ delete_client (int32_t id)
 		cleanup_shm (&c->transport.shm);
 	} else if (c->type == VIS_UDP) {
 		cleanup_udp (&c->transport.udp, vis->socket);
+	} else if (c->type == VIS_MEMFD) {
+		cleanup_memfd (&c->transport.memfd);
 	}
 
 	g_free (c);
 	vis->clientv[id] = NULL;
+	g_atomic_int_add (&vis->active_clients, -1);
 
 	xmms_log_info ("Removed visualization client %d", id);
 }
@@ -123,6 +130,15 @@ xmms_visualization_new (xmms_output_t *output)
 
 	xmms_socket_invalidate (&vis->socket);
 
+	spectrum_init ();
+
+	g_mutex_init (&vis->windowlock);
+	g_cond_init (&vis->windowcond);
+	vis->running = TRUE;
+	vis->analysis_thread = g_thread_new ("x2 vis analysis",
+	                                     xmms_visualization_analysis_loop,
+	                                     vis);
+
 	return vis;
 }
 
@@ -134,8 +150,23 @@ xmms_visualization_new (xmms_output_t *output)
 static void
 xmms_visualization_destroy (xmms_object_t *object)
 {
+	gint i;
+
 	XMMS_DBG ("Deactivating visualization object.");
 
+	g_mutex_lock (&vis->windowlock);
+	vis->running = FALSE;
+	g_cond_signal (&vis->windowcond);
+	g_mutex_unlock (&vis->windowlock);
+
+	g_thread_join (vis->analysis_thread);
+
+	for (i = 0; i < XMMS_VIS_WINDOW_QUEUE; i++) {
+		g_free (vis->windows[i].buf);
+	}
+	g_mutex_clear (&vis->windowlock);
+	g_cond_clear (&vis->windowcond);
+
 	xmms_object_unref (vis->output);
 
 	/* TODO: assure that the xform is already dead! */
@@ -294,6 +325,13 @@ xmms_visualization_client_init_udp (xmms_visualization_t *vis, int32_t id, xmms_
 	return init_udp (vis, id, err);
 }
 
+static int32_t
+xmms_visualization_client_init_memfd (xmms_visualization_t *vis, int32_t id, xmms_error_t *err)
+{
+	XMMS_DBG ("Trying to init memfd!");
+	return init_memfd (vis, id, err);
+}
+
 static void
 xmms_visualization_client_shutdown (xmms_visualization_t *vis, int32_t id, xmms_error_t *err)
 {
@@ -303,31 +341,115 @@ xmms_visualization_client_shutdown (xmms_visualization_t *vis, int32_t id, xmms_
 }
 
 static gboolean
-package_write (xmms_vis_client_t *c, int32_t id, struct timeval *time, int channels, int size, short *buf)
+package_write (xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window)
 {
 	if (c->type == VIS_UNIXSHM) {
-		return write_shm (&c->transport.shm, c, id, time, channels, size, buf);
+		return write_shm (&c->transport.shm, c, id, window);
 	} else if (c->type == VIS_UDP) {
-		return write_udp (&c->transport.udp, c, id, time, channels, size, buf, vis->socket);
+		return write_udp (&c->transport.udp, c, id, window, vis->socket);
+	} else if (c->type == VIS_MEMFD) {
+		return write_memfd (&c->transport.memfd, c, id, window);
 	}
 	return FALSE;
 }
 
+/**
+ * Analyse one window and hand it to every client. The spectrum is only
+ * calculated when a client asked for it, and then only once.
+ */
+static void
+send_window (xmms_vis_window_t *window)
+{
+	gboolean want_spectrum = FALSE;
+	int i;
+
+	g_mutex_lock (&vis->clientlock);
+	for (i = 0; i < vis->clientc; ++i) {
+		if (vis->clientv[i] && vis->clientv[i]->prop.type == VIS_SPECTRUM) {
+			want_spectrum = TRUE;
+			break;
+		}
+	}
+	g_mutex_unlock (&vis->clientlock);
+
+	window->have_spectrum = FALSE;
+	if (want_spectrum && window->channels > 0 &&
+	    window->size == XMMSC_VISUALIZATION_WINDOW_SIZE * window->channels) {
+		spectrum_compute (window->buf, window->channels, window->spectrum);
+		window->have_spectrum = TRUE;
+	}
+
+	g_mutex_lock (&vis->clientlock);
+	for (i = 0; i < vis->clientc; ++i) {
+		if (vis->clientv[i]) {
+			package_write (vis->clientv[i], i, window);
+		}
+	}
+	g_mutex_unlock (&vis->clientlock);
+}
+
+static gpointer
+xmms_visualization_analysis_loop (gpointer udata)
+{
+	xmms_visualization_t *vis = udata;
+	xmms_vis_window_t work, next;
+
+	memset (&work, 0, sizeof (work));
+
+	g_mutex_lock (&vis->windowlock);
+	while (vis->running) {
+		if (!vis->window_count) {
+			g_cond_wait (&vis->windowcond, &vis->windowlock);
+			continue;
+		}
+
+		/* take the oldest window, leaving our spare buffer in its slot */
+		next = vis->windows[vis->window_head];
+		vis->windows[vis->window_head] = work;
+		work = next;
+
+		vis->window_head = (vis->window_head + 1) % XMMS_VIS_WINDOW_QUEUE;
+		vis->window_count--;
+
+		g_mutex_unlock (&vis->windowlock);
+		send_window (&work);
+		g_mutex_lock (&vis->windowlock);
+	}
+	g_mutex_unlock (&vis->windowlock);
+
+	g_free (work.buf);
+
+	return NULL;
+}
+
+/**
+ * Check if there is anyone to send data to, without taking any locks.
+ */
+gboolean
+clients_attached (void)
+{
+	return vis && g_atomic_int_get (&vis->active_clients) > 0;
+}
+
+/**
+ * Queue decoded data for the visualization clients. This runs on the
+ * decoding thread, so the analysis and the writes to the clients are
+ * left to the analysis thread. If that falls behind the oldest window
+ * is dropped, the clients would skip it anyway.
+ */
 void
 send_data (int channels, int size, short *buf)
 {
-	int i;
+	xmms_vis_window_t *window;
 	struct timeval time;
 	guint32 latency;
 
-	if (!vis) {
+	if (!clients_attached ()) {
 		return;
 	}
 
 	latency = xmms_output_latency (vis->output);
 
-	fft_init ();
-
 	gettimeofday (&time, NULL);
 	time.tv_sec += (latency / 1000);
 	time.tv_usec += (latency % 1000) * 1000;
@@ -336,13 +458,27 @@ send_data (int channels, int size, short *buf)
 		time.tv_usec -= 1000000;
 	}
 
-	g_mutex_lock (&vis->clientlock);
-	for (i = 0; i < vis->clientc; ++i) {
-		if (vis->clientv[i]) {
-			package_write (vis->clientv[i], i, &time, channels, size, buf);
-		}
+	g_mutex_lock (&vis->windowlock);
+
+	if (vis->window_count == XMMS_VIS_WINDOW_QUEUE) {
+		vis->window_head = (vis->window_head + 1) % XMMS_VIS_WINDOW_QUEUE;
+		vis->window_count--;
 	}
-	g_mutex_unlock (&vis->clientlock);
+
+	window = &vis->windows[(vis->window_head + vis->window_count) % XMMS_VIS_WINDOW_QUEUE];
+	if (window->allocated < size) {
+		window->buf = g_renew (short, window->buf, size);
+		window->allocated = size;
+	}
+	memcpy (window->buf, buf, size * sizeof (short));
+	window->time = time;
+	window->channels = channels;
+	window->size = size;
+
+	vis->window_count++;
+	g_cond_signal (&vis->windowcond);
+
+	g_mutex_unlock (&vis->windowlock);
 }
 
 /** @} */
@@ -0,0 +1,235 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include <math.h>
+#include "common.h"
+
+/** @file
+ * Spectrum analysis for the visualization clients.
+ *
+ * The window of FFT_LEN real samples is packed into FFT_LEN / 2
+ * complex values (even samples as real part, odd as imaginary), which
+ * are transformed by an iterative radix-2 FFT and then split into the
+ * spectrum of the real input. All twiddle factors and the bit reversal
+ * permutation are computed once, and the per stage twiddles are stored
+ * contiguously so that the butterflies can be vectorized.
+ */
+
+#define FFT_LEN XMMSC_VISUALIZATION_WINDOW_SIZE
+#define FFT_HALF (FFT_LEN / 2)
+
+static gfloat window[FFT_LEN];
+static guint16 bitrev[FFT_HALF];
+
+/* twiddles of the complex FFT, the stage with half size h starts at h - 1 */
+static gfloat stage_re[FFT_HALF - 1];
+static gfloat stage_im[FFT_HALF - 1];
+
+/* twiddles for splitting the complex result into the real spectrum */
+static gfloat split_re[FFT_HALF];
+static gfloat split_im[FFT_HALF];
+
+typedef void (*butterfly_func_t) (gfloat *re, gfloat *im, gint half);
+
+static void
+butterfly_scalar (gfloat *re, gfloat *im, gint half)
+{
+	const gfloat *w_re = stage_re + half - 1;
+	const gfloat *w_im = stage_im + half - 1;
+	gint start, k;
+
+	for (start = 0; start < FFT_HALF; start += 2 * half) {
+		gfloat *a_re = re + start, *a_im = im + start;
+		gfloat *b_re = a_re + half, *b_im = a_im + half;
+
+		for (k = 0; k < half; k++) {
+			gfloat t_r = b_re[k] * w_re[k] - b_im[k] * w_im[k];
+			gfloat t_i = b_re[k] * w_im[k] + b_im[k] * w_re[k];
+
+			b_re[k] = a_re[k] - t_r;
+			b_im[k] = a_im[k] - t_i;
+			a_re[k] += t_r;
+			a_im[k] += t_i;
+		}
+	}
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+
+#include <immintrin.h>
+
+/* stages with at least four butterflies per group, four at a time */
+__attribute__ ((target ("sse")))
+static void
+butterfly_sse (gfloat *re, gfloat *im, gint half)
+{
+	const gfloat *w_re = stage_re + half - 1;
+	const gfloat *w_im = stage_im + half - 1;
+	gint start, k;
+
+	if (half < 4) {
+		butterfly_scalar (re, im, half);
+		return;
+	}
+
+	for (start = 0; start < FFT_HALF; start += 2 * half) {
+		gfloat *a_re = re + start, *a_im = im + start;
+		gfloat *b_re = a_re + half, *b_im = a_im + half;
+
+		for (k = 0; k < half; k += 4) {
+			__m128 wr = _mm_loadu_ps (w_re + k);
+			__m128 wi = _mm_loadu_ps (w_im + k);
+			__m128 br = _mm_loadu_ps (b_re + k);
+			__m128 bi = _mm_loadu_ps (b_im + k);
+			__m128 ar = _mm_loadu_ps (a_re + k);
+			__m128 ai = _mm_loadu_ps (a_im + k);
+			__m128 tr, ti;
+
+			tr = _mm_sub_ps (_mm_mul_ps (br, wr), _mm_mul_ps (bi, wi));
+			ti = _mm_add_ps (_mm_mul_ps (br, wi), _mm_mul_ps (bi, wr));
+
+			_mm_storeu_ps (b_re + k, _mm_sub_ps (ar, tr));
+			_mm_storeu_ps (b_im + k, _mm_sub_ps (ai, ti));
+			_mm_storeu_ps (a_re + k, _mm_add_ps (ar, tr));
+			_mm_storeu_ps (a_im + k, _mm_add_ps (ai, ti));
+		}
+	}
+}
+
+static butterfly_func_t
+butterfly_select (void)
+{
+	__builtin_cpu_init ();
+
+	if (__builtin_cpu_supports ("sse")) {
+		XMMS_DBG ("Using SSE spectrum analysis");
+		return butterfly_sse;
+	}
+
+	return butterfly_scalar;
+}
+
+#else
+
+static butterfly_func_t
+butterfly_select (void)
+{
+	return butterfly_scalar;
+}
+
+#endif
+
+static butterfly_func_t butterfly = butterfly_scalar;
+
+/**
+ * Compute the window, twiddle and permutation tables. Safe to call
+ * more than once, only the first call does any work.
+ */
+void
+spectrum_init (void)
+{
+	static gsize initialized = 0;
+	gint i, j, bits, half;
+
+	if (!g_once_init_enter (&initialized)) {
+		return;
+	}
+
+	/* Hann window used to reduce spectral leakage */
+	for (i = 0; i < FFT_LEN; i++) {
+		window[i] = 0.5 - 0.5 * cos (2.0 * M_PI * i / FFT_LEN);
+	}
+
+	for (bits = 0; (1 << bits) < FFT_HALF; bits++);
+
+	for (i = 0; i < FFT_HALF; i++) {
+		gint r = 0;
+		for (j = 0; j < bits; j++) {
+			r |= ((i >> j) & 1) << (bits - 1 - j);
+		}
+		bitrev[i] = r;
+	}
+
+	for (half = 1; half < FFT_HALF; half <<= 1) {
+		for (i = 0; i < half; i++) {
+			stage_re[half - 1 + i] = cos (M_PI * i / half);
+			stage_im[half - 1 + i] = -sin (M_PI * i / half);
+		}
+	}
+
+	for (i = 0; i < FFT_HALF; i++) {
+		split_re[i] = cos (2.0 * M_PI * i / FFT_LEN);
+		split_im[i] = -sin (2.0 * M_PI * i / FFT_LEN);
+	}
+
+	butterfly = butterfly_select ();
+
+	g_once_init_leave (&initialized, 1);
+}
+
+/**
+ * Compute the magnitude spectrum of one window.
+ *
+ * @param src interleaved samples, FFT_LEN frames of channels each
+ * @param channels the number of channels, which are mixed down
+ * @param spec where FFT_LEN / 2 magnitudes are stored
+ */
+void
+spectrum_compute (const short *src, gint channels, gfloat *spec)
+{
+	gfloat re[FFT_HALF], im[FFT_HALF];
+	gfloat scale;
+	gint i, c, half;
+
+	/* the sum of a stereo pair over 2^17, as the old analysis did */
+	scale = 1.0f / (gfloat) (channels << 16);
+
+	/* pack and permute in one go */
+	for (i = 0; i < FFT_HALF; i++) {
+		const short *even = src + 2 * i * channels;
+		const short *odd = even + channels;
+		gint sum_even = 0, sum_odd = 0;
+
+		for (c = 0; c < channels; c++) {
+			sum_even += even[c];
+			sum_odd += odd[c];
+		}
+
+		re[bitrev[i]] = sum_even * scale * window[2 * i];
+		im[bitrev[i]] = sum_odd * scale * window[2 * i + 1];
+	}
+
+	for (half = 1; half < FFT_HALF; half <<= 1) {
+		butterfly (re, im, half);
+	}
+
+	/* X[k] = E[k] + W^k O[k], where E and O are the spectra of the
+	 * even and odd samples, recovered from Z[k] and conj(Z[N/2 - k]) */
+	for (i = 0; i < FFT_HALF; i++) {
+		gint m = (FFT_HALF - i) & (FFT_HALF - 1);
+		gfloat e_r = 0.5f * (re[i] + re[m]);
+		gfloat e_i = 0.5f * (im[i] - im[m]);
+		gfloat o_r = 0.5f * (im[i] + im[m]);
+		gfloat o_i = -0.5f * (re[i] - re[m]);
+		gfloat x_r = e_r + split_re[i] * o_r - split_im[i] * o_i;
+		gfloat x_i = e_i + split_re[i] * o_i + split_im[i] * o_r;
+
+		spec[i] = 2.0f * sqrtf (x_r * x_r + x_i * x_i) / FFT_LEN;
+	}
+
+	/* correct the scale */
+	spec[FFT_HALF - 1] /= 2;
+}
@@ -179,7 +179,7 @@ cleanup_udp (xmmsc_vis_udp_t *t, xmms_socket_t socket)
 }
 
 gboolean
-write_udp (xmmsc_vis_udp_t *t, xmms_vis_client_t *c, int32_t id, struct timeval *time, int channels, int size, short *buf, int socket)
+write_udp (xmmsc_vis_udp_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window, int socket)
 {
 	xmmsc_vis_udp_data_t packet_d;
 	xmmsc_vischunk_t *__unaligned_dest;
@@ -202,13 +202,13 @@ write_udp (xmmsc_vis_udp_t *t, xmms_vis_client_t *c, int32_t id, struct timeval
 	__unaligned_dest = packet_d.__unaligned_data;
 
 	XMMSC_VIS_UNALIGNED_WRITE (&__unaligned_dest->timestamp[0],
-	                           (int32_t)htonl (time->tv_sec), int32_t);
+	                           (int32_t)htonl (window->time.tv_sec), int32_t);
 	XMMSC_VIS_UNALIGNED_WRITE (&__unaligned_dest->timestamp[1],
-	                           (int32_t)htonl (time->tv_usec), int32_t);
+	                           (int32_t)htonl (window->time.tv_usec), int32_t);
 
 
 	XMMSC_VIS_UNALIGNED_WRITE (&__unaligned_dest->format, (uint16_t)htons (c->format), uint16_t);
-	res = fill_buffer (__unaligned_dest->data, &c->prop, channels, size, buf);
+	res = fill_buffer (__unaligned_dest->data, &c->prop, window);
 	XMMSC_VIS_UNALIGNED_WRITE (&__unaligned_dest->size, (uint16_t)htons (res), uint16_t);
 
 	offset = ((char*)&__unaligned_dest->data - (char*)__unaligned_dest);
@@ -135,7 +135,7 @@ increment_client (xmmsc_vis_unixshm_t *t)
 }
 
 gboolean
-write_shm (xmmsc_vis_unixshm_t *t, xmms_vis_client_t *c, int32_t id, struct timeval *time, int channels, int size, short *buf)
+write_shm (xmmsc_vis_unixshm_t *t, xmms_vis_client_t *c, int32_t id, xmms_vis_window_t *window)
 {
 	xmmsc_vischunk_t *dest;
 	short res;
@@ -143,9 +143,9 @@ write_shm (xmmsc_vis_unixshm_t *t, xmms_vis_client_t *c, int32_t id, struct time
 	if (!write_start_shm (id, t, &dest))
 		return FALSE;
 
-	tv2net (dest->timestamp, time);
+	tv2net (dest->timestamp, &window->time);
 	dest->format = htons (c->format);
-	res = fill_buffer (dest->data, &c->prop, channels, size, buf);
+	res = fill_buffer (dest->data, &c->prop, window);
 	dest->size = htons (res);
 	write_finish_shm (id, t, dest);
 
@@ -22,14 +22,38 @@
 #include <xmmspriv/xmms_xform.h>
 #include <xmmspriv/xmms_output.h>
 #include <xmmspriv/xmms_visualization.h>
+#include <xmmspriv/xmms_streamtype.h>
+#include <xmmspriv/xmms_converter.h>
 #include <xmms/xmms_log.h>
 
 #include <glib.h>
 #include <stdio.h>
+#include <string.h>
 #include <limits.h>
 
 #include "common.h"
 
+/* the format the clients expect, everything else is converted */
+#define VIS_FORMAT XMMS_SAMPLE_FORMAT_S16
+#define VIS_SAMPLERATE 44100
+
+typedef struct xmms_vis_data_St {
+	gint channels;
+	gint frame_size;
+
+	/* only used when the stream isn't in the client format already */
+	xmms_stream_type_t *analysis_type;
+	xmms_sample_converter_t *conv;
+	gint16 *pending;
+	gint pending_frames;
+} xmms_vis_data_t;
+
+static const xmms_sample_format_t formats[] = {
+	XMMS_SAMPLE_FORMAT_S16,
+	XMMS_SAMPLE_FORMAT_S32,
+	XMMS_SAMPLE_FORMAT_FLOAT
+};
+
 static gboolean xmms_vis_init (xmms_xform_t *xform);
 static void xmms_vis_destroy (xmms_xform_t *xform);
 static gint xmms_vis_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
@@ -41,6 +65,7 @@ static gboolean
 xmms_vis_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 {
 	xmms_xform_methods_t methods;
+	gint i;
 
 	XMMS_XFORM_METHODS_INIT (methods);
 
@@ -51,14 +76,15 @@ xmms_vis_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 
 	xmms_xform_plugin_methods_set (xform_plugin, &methods);
 
-	xmms_xform_plugin_indata_add (xform_plugin,
-	                              XMMS_STREAM_TYPE_MIMETYPE,
-	                              "audio/pcm",
-	                              XMMS_STREAM_TYPE_FMT_FORMAT,
-	                              XMMS_SAMPLE_FORMAT_S16,
-	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE,
-	                              44100,
-	                              XMMS_STREAM_TYPE_END);
+	/* any rate and channel count, the data passes through untouched */
+	for (i = 0; i < G_N_ELEMENTS (formats); i++) {
+		xmms_xform_plugin_indata_add (xform_plugin,
+		                              XMMS_STREAM_TYPE_MIMETYPE,
+		                              "audio/pcm",
+		                              XMMS_STREAM_TYPE_FMT_FORMAT,
+		                              formats[i],
+		                              XMMS_STREAM_TYPE_END);
+	}
 
 	return TRUE;
 }
@@ -67,8 +93,36 @@ xmms_vis_plugin_setup (xmms_xform_plugin_t *xform_plugin)
 static gboolean
 xmms_vis_init (xmms_xform_t *xform)
 {
+	xmms_vis_data_t *data;
+	gint format, samplerate;
+
 	g_return_val_if_fail (xform, FALSE);
 
+	data = g_new0 (xmms_vis_data_t, 1);
+
+	format = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_FORMAT);
+	samplerate = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_SAMPLERATE);
+	data->channels = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	data->frame_size = xmms_sample_size_get (format) * data->channels;
+
+	/* only the copy sent to the clients is converted */
+	if (format != VIS_FORMAT || samplerate != VIS_SAMPLERATE) {
+		data->analysis_type = _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+		                                             XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+		                                             XMMS_STREAM_TYPE_FMT_FORMAT, VIS_FORMAT,
+		                                             XMMS_STREAM_TYPE_FMT_CHANNELS, data->channels,
+		                                             XMMS_STREAM_TYPE_FMT_SAMPLERATE, VIS_SAMPLERATE,
+		                                             XMMS_STREAM_TYPE_END);
+		data->conv = xmms_sample_converter_init (xmms_xform_intype_get (xform),
+		                                         data->analysis_type);
+		if (!data->conv) {
+			xmms_log_error ("Could not convert stream for visualization");
+		}
+		data->pending = g_new (gint16, XMMSC_VISUALIZATION_WINDOW_SIZE * data->channels);
+	}
+
+	xmms_xform_private_data_set (xform, data);
+
 	xmms_xform_outdata_type_copy (xform);
 
 	XMMS_DBG ("Visualization hook initialized successfully!");
@@ -79,27 +133,86 @@ xmms_vis_init (xmms_xform_t *xform)
 static void
 xmms_vis_destroy (xmms_xform_t *xform)
 {
+	xmms_vis_data_t *data;
+
 	g_return_if_fail (xform);
+
+	data = xmms_xform_private_data_get (xform);
+
+	if (data->conv) {
+		xmms_object_unref (data->conv);
+	}
+	if (data->analysis_type) {
+		xmms_object_unref (data->analysis_type);
+	}
+
+	g_free (data->pending);
+	g_free (data);
+}
+
+/**
+ * Convert the data read to the client format, and send it on in full
+ * windows once enough of it has been collected.
+ */
+static void
+xmms_vis_analyse (xmms_vis_data_t *data, xmms_sample_t *buf, gint len)
+{
+	xmms_sample_t *out;
+	guint outlen;
+	gint frames, chunk;
+	gint16 *src;
+
+	if (!data->conv) {
+		return;
+	}
+
+	xmms_sample_convert (data->conv, buf, len, &out, &outlen);
+
+	src = out;
+	frames = outlen / (sizeof (gint16) * data->channels);
+
+	while (frames > 0) {
+		chunk = MIN (frames, XMMSC_VISUALIZATION_WINDOW_SIZE - data->pending_frames);
+
+		memcpy (data->pending + data->pending_frames * data->channels, src,
+		        chunk * data->channels * sizeof (gint16));
+
+		data->pending_frames += chunk;
+		src += chunk * data->channels;
+		frames -= chunk;
+
+		if (data->pending_frames == XMMSC_VISUALIZATION_WINDOW_SIZE) {
+			send_data (data->channels,
+			           XMMSC_VISUALIZATION_WINDOW_SIZE * data->channels,
+			           data->pending);
+			data->pending_frames = 0;
+		}
+	}
 }
 
 static gint
 xmms_vis_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
               xmms_error_t *error)
 {
-	gint read, chan;
+	xmms_vis_data_t *data;
+	gint read;
 
 	g_return_val_if_fail (xform, -1);
 
-	chan = xmms_xform_indata_get_int (xform, XMMS_STREAM_TYPE_FMT_CHANNELS);
+	data = xmms_xform_private_data_get (xform);
 
 	/* perhaps rework this later */
-	if (len > XMMSC_VISUALIZATION_WINDOW_SIZE * chan * sizeof (short)) {
-		len = XMMSC_VISUALIZATION_WINDOW_SIZE * chan * sizeof (short);
+	if (len > XMMSC_VISUALIZATION_WINDOW_SIZE * data->frame_size) {
+		len = XMMSC_VISUALIZATION_WINDOW_SIZE * data->frame_size;
 	}
 
 	read = xmms_xform_read (xform, buf, len, error);
-	if (read > 0) {
-		send_data (chan, read / sizeof (short), buf);
+	if (read > 0 && clients_attached ()) {
+		if (data->analysis_type) {
+			xmms_vis_analyse (data, buf, read);
+		} else {
+			send_data (data->channels, read / sizeof (short), buf);
+		}
 	}
 
 	return read;
@@ -108,6 +221,15 @@ xmms_vis_read (xmms_xform_t *xform, xmms_sample_t *buf, gint len,
 static gint64
 xmms_vis_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence, xmms_error_t *err)
 {
+	xmms_vis_data_t *data;
+
+	data = xmms_xform_private_data_get (xform);
+
+	if (data->conv) {
+		xmms_sample_convert_reset (data->conv);
+	}
+	data->pending_frames = 0;
+
 	return xmms_xform_seek (xform, offset, whence, err);
 }
 
@@ -393,6 +393,30 @@ xmms_xform_entry_get (xmms_xform_t *xform)
 	return xform->entry;
 }
 
+gchar *
+xmms_xform_entry_property_get_str (xmms_xform_t *xform, const gchar *key)
+{
+	xmms_medialib_session_t *session;
+	gchar *ret;
+
+	g_return_val_if_fail (xform, NULL);
+	g_return_val_if_fail (key, NULL);
+
+	if (!xform->medialib || !xform->entry) {
+		return NULL;
+	}
+
+	ret = NULL;
+
+	do {
+		g_free (ret);
+		session = xmms_medialib_session_begin_ro (xform->medialib);
+		ret = xmms_medialib_entry_property_get_str (session, xform->entry, key);
+	} while (!xmms_medialib_session_commit (session));
+
+	return ret;
+}
+
 gpointer
 xmms_xform_private_data_get (xmms_xform_t *xform)
 {
@@ -637,9 +661,9 @@ xmms_xform_metadata_collect_r (xmms_xform_t *xform, metadata_festate_t *info,
 		g_string_append (namestr, xmms_xform_shortname (xform));
 	}
 
-	if (xform->metadata_changed) {
-		xmms_xform_metadata_collect_one (xform, info);
-	}
+	/* everything is collected, so that a session that failed to
+	 * commit can be redone with the same chain */
+	xmms_xform_metadata_collect_one (xform, info);
 
 	xform->metadata_collected = TRUE;
 }
@@ -1324,10 +1348,15 @@ chain_setup (xmms_medialib_t *medialib, xmms_medialib_entry_t entry,
 	return last;
 }
 
-static void
-chain_finalize (xmms_medialib_session_t *session,
-                xmms_xform_t *xform, xmms_medialib_entry_t entry,
-                const gchar *url, gboolean rehashing)
+/**
+ * Write the metadata of a chain set up by #xmms_xform_chain_probe to
+ * the medialib, and mark its entry as resolved. This may be done
+ * again in a new session if the session fails to commit.
+ */
+void
+xmms_xform_chain_finalize (xmms_medialib_session_t *session,
+                           xmms_xform_t *xform, xmms_medialib_entry_t entry,
+                           const gchar *url, gboolean rehashing)
 {
 	GString *namestr;
 	gchar *durl;
@@ -1402,6 +1431,27 @@ xmms_xform_chain_setup_url_session (xmms_medialib_t *medialib,
                                     GList *goal_formats, gboolean rehash)
 {
 	xmms_xform_t *last;
+
+	last = xmms_xform_chain_probe (medialib, entry, url, goal_formats, rehash);
+	if (!last) {
+		return NULL;
+	}
+
+	xmms_xform_chain_finalize (session, last, entry, url, rehash);
+	return last;
+}
+
+/**
+ * Set up a chain for an entry without writing anything to the
+ * medialib, which means no session is held while the media is opened
+ * and probed. #xmms_xform_chain_finalize stores what was found.
+ */
+xmms_xform_t *
+xmms_xform_chain_probe (xmms_medialib_t *medialib,
+                        xmms_medialib_entry_t entry, const gchar *url,
+                        GList *goal_formats, gboolean rehash)
+{
+	xmms_xform_t *last;
 	xmms_plugin_t *plugin;
 	xmms_xform_plugin_t *xform_plugin;
 	gboolean add_segment = FALSE;
@@ -1441,7 +1491,6 @@ xmms_xform_chain_setup_url_session (xmms_medialib_t *medialib,
 		}
 	}
 
-	chain_finalize (session, last, entry, url, rehash);
 	return last;
 }
 
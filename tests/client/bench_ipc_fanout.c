@@ -0,0 +1,316 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/* Load test for the IPC server: opens a number of connections that all
+ * subscribe to the config value broadcast, then repeatedly changes a
+ * config value from a separate control connection and measures how long
+ * it takes until every connection has seen the broadcast.
+ *
+ * Run against a live daemon, once with core.ipc_workers set to 0 (one
+ * thread per client) and once with a handful of workers:
+ *
+ *   bench_ipc_fanout [connections] [rounds] [ipc path] [slow url]
+ *
+ * Given a slow url, one more connection keeps browsing it during the
+ * rounds. Pick something that takes a while to browse, like a large
+ * directory or a remote location, to see how much a blocking command
+ * delays the listeners that share an IPC worker with that connection.
+ */
+
+#include <glib.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmmsclient/xmmsclient.h>
+
+#define STAMP_KEY "bench_ipc_fanout.stamp"
+#define ROUND_TIMEOUT_US (10 * G_USEC_PER_SEC)
+
+typedef struct listener_St {
+	xmmsc_connection_t *conn;
+	gint round;
+	gint64 received;
+} listener_t;
+
+typedef struct slow_client_St {
+	xmmsc_connection_t *conn;
+	const gchar *url;
+	gint calls;
+} slow_client_t;
+
+static int
+on_config_changed (xmmsv_t *val, void *udata)
+{
+	listener_t *listener = udata;
+	const gchar *stamp;
+
+	if (xmmsv_dict_entry_get_string (val, STAMP_KEY, &stamp)) {
+		listener->round = atoi (stamp);
+		listener->received = g_get_monotonic_time ();
+	}
+
+	return TRUE;
+}
+
+static void slow_browse (slow_client_t *slow);
+
+static int
+on_browsed (xmmsv_t *val, void *udata)
+{
+	slow_client_t *slow = udata;
+
+	slow->calls++;
+	slow_browse (slow);
+
+	return FALSE;
+}
+
+/**
+ * Keep a single browse in flight, the next one is sent as soon as the
+ * reply to the previous one arrives.
+ */
+static void
+slow_browse (slow_client_t *slow)
+{
+	xmmsc_result_t *res;
+
+	res = xmmsc_xform_media_browse (slow->conn, slow->url);
+	xmmsc_result_notifier_set (res, on_browsed, slow);
+	xmmsc_result_unref (res);
+}
+
+static xmmsc_connection_t *
+connect_or_die (const gchar *name, const gchar *path)
+{
+	xmmsc_connection_t *conn;
+
+	conn = xmmsc_init (name);
+	if (!conn || !xmmsc_connect (conn, path)) {
+		fprintf (stderr, "Could not connect to xmms2d: %s\n",
+		         conn ? xmmsc_get_last_error (conn) : "out of memory");
+		exit (EXIT_FAILURE);
+	}
+
+	return conn;
+}
+
+static void
+set_stamp (xmmsc_connection_t *control, gint round)
+{
+	xmmsc_result_t *res;
+	gchar value[16];
+
+	g_snprintf (value, sizeof (value), "%d", round);
+	res = xmmsc_config_set_value (control, STAMP_KEY, value);
+	xmmsc_result_unref (res);
+
+	while (xmmsc_io_want_out (control)) {
+		xmmsc_io_out_handle (control);
+	}
+}
+
+/**
+ * Pump all listener connections, and the slow connection if there is
+ * one, until each listener has seen the given round. Returns the
+ * number of listeners that did.
+ */
+static gint
+wait_round (listener_t *listeners, slow_client_t *slow, struct pollfd *fds,
+            gint num, gint round)
+{
+	gint64 deadline;
+	gint i, done = 0;
+
+	deadline = g_get_monotonic_time () + ROUND_TIMEOUT_US;
+
+	while (done < num) {
+		gint64 now = g_get_monotonic_time ();
+
+		if (now >= deadline) {
+			break;
+		}
+
+		for (i = 0; i < num; i++) {
+			fds[i].events = POLLIN;
+			if (xmmsc_io_want_out (listeners[i].conn)) {
+				fds[i].events |= POLLOUT;
+			}
+		}
+
+		if (slow->conn) {
+			fds[num].events = POLLIN;
+			if (xmmsc_io_want_out (slow->conn)) {
+				fds[num].events |= POLLOUT;
+			}
+		}
+
+		if (poll (fds, slow->conn ? num + 1 : num,
+		          (deadline - now) / 1000 + 1) < 0) {
+			break;
+		}
+
+		if (slow->conn) {
+			if (fds[num].revents & POLLOUT) {
+				xmmsc_io_out_handle (slow->conn);
+			}
+			if (fds[num].revents & (POLLIN | POLLHUP | POLLERR)) {
+				if (!xmmsc_io_in_handle (slow->conn)) {
+					fprintf (stderr, "Slow client lost its connection\n");
+					exit (EXIT_FAILURE);
+				}
+			}
+		}
+
+		done = 0;
+		for (i = 0; i < num; i++) {
+			if (fds[i].revents & POLLOUT) {
+				xmmsc_io_out_handle (listeners[i].conn);
+			}
+			if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+				if (!xmmsc_io_in_handle (listeners[i].conn)) {
+					fprintf (stderr, "Listener %d lost its connection\n", i);
+					exit (EXIT_FAILURE);
+				}
+			}
+			if (listeners[i].round == round) {
+				done++;
+			}
+		}
+	}
+
+	return done;
+}
+
+static int
+compare_gint64 (const void *a, const void *b)
+{
+	gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+	return (x > y) - (x < y);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsc_connection_t *control;
+	xmmsc_result_t *res;
+	listener_t *listeners;
+	slow_client_t slow = { NULL, NULL, 0 };
+	struct pollfd *fds;
+	gint64 *latency, *all_latency, start;
+	gint num = 200, rounds = 50, round, i, n = 0;
+	const gchar *path = NULL;
+
+	if (argc > 1)
+		num = MAX (1, atoi (argv[1]));
+	if (argc > 2)
+		rounds = MAX (1, atoi (argv[2]));
+	if (argc > 3)
+		path = argv[3];
+	if (argc > 4)
+		slow.url = argv[4];
+
+	control = connect_or_die ("bench_ipc_fanout", path);
+
+	res = xmmsc_config_register_value (control, STAMP_KEY, "0");
+	xmmsc_result_wait (res);
+	xmmsc_result_unref (res);
+
+	listeners = g_new0 (listener_t, num);
+	/* one more for the slow client */
+	fds = g_new0 (struct pollfd, num + 1);
+	latency = g_new (gint64, num);
+	all_latency = g_new (gint64, (gsize) num * rounds);
+
+	for (i = 0; i < num; i++) {
+		listeners[i].conn = connect_or_die ("bench_ipc_fanout_listener", path);
+		listeners[i].round = -1;
+		fds[i].fd = xmmsc_io_fd_get (listeners[i].conn);
+
+		res = xmmsc_broadcast_config_value_changed (listeners[i].conn);
+		xmmsc_result_notifier_set (res, on_config_changed, &listeners[i]);
+		xmmsc_result_unref (res);
+	}
+
+	/* Warm up: make sure every subscription has reached the server */
+	set_stamp (control, 0);
+	if (wait_round (listeners, &slow, fds, num, 0) != num) {
+		fprintf (stderr, "Not all listeners subscribed in time\n");
+		return EXIT_FAILURE;
+	}
+
+	/* connected last, so it shares a worker with some listeners */
+	if (slow.url) {
+		slow.conn = connect_or_die ("bench_ipc_fanout_slow", path);
+		fds[num].fd = xmmsc_io_fd_get (slow.conn);
+		slow_browse (&slow);
+	}
+
+	printf ("%d connections, %d rounds\n", num, rounds);
+	if (slow.url) {
+		printf ("slow client browsing %s\n", slow.url);
+	}
+	printf ("%6s %10s %10s %10s %10s\n", "round", "first", "median", "p99", "last");
+
+	for (round = 1; round <= rounds; round++) {
+		gint done;
+
+		start = g_get_monotonic_time ();
+		set_stamp (control, round);
+
+		done = wait_round (listeners, &slow, fds, num, round);
+		if (done != num) {
+			fprintf (stderr, "Round %d: only %d of %d listeners got the broadcast\n",
+			         round, done, num);
+			return EXIT_FAILURE;
+		}
+
+		for (i = 0; i < num; i++) {
+			latency[i] = listeners[i].received - start;
+			all_latency[n++] = latency[i];
+		}
+
+		qsort (latency, num, sizeof (gint64), compare_gint64);
+		printf ("%6d %8" G_GINT64_FORMAT "us %8" G_GINT64_FORMAT "us %8"
+		        G_GINT64_FORMAT "us %8" G_GINT64_FORMAT "us\n",
+		        round, latency[0], latency[num / 2],
+		        latency[(num * 99) / 100], latency[num - 1]);
+	}
+
+	qsort (all_latency, n, sizeof (gint64), compare_gint64);
+	printf ("total: median %" G_GINT64_FORMAT "us, p99 %" G_GINT64_FORMAT
+	        "us, max %" G_GINT64_FORMAT "us\n",
+	        all_latency[n / 2], all_latency[((gint64) n * 99) / 100],
+	        all_latency[n - 1]);
+
+	if (slow.conn) {
+		printf ("slow client: %d browses completed\n", slow.calls);
+		xmmsc_unref (slow.conn);
+	}
+
+	for (i = 0; i < num; i++) {
+		xmmsc_unref (listeners[i].conn);
+	}
+	xmmsc_unref (control);
+
+	g_free (all_latency);
+	g_free (latency);
+	g_free (fds);
+	g_free (listeners);
+
+	return EXIT_SUCCESS;
+}
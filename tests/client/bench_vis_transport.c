@@ -0,0 +1,269 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/* Load test for the visualization transport: starts a number of vis
+ * clients, each on its own connection and thread, that render at 60
+ * frames per second and drain every chunk that arrived since the last
+ * frame. Reports delivered chunks per second, the latency of
+ * xmmsc_visualization_chunk_get and the frames that got no data.
+ *
+ * Run against a live daemon that is playing something. Connecting over
+ * a unix socket uses the memfd ring where available, a tcp:// path
+ * forces the UDP transport for comparison:
+ *
+ *   bench_vis_transport [clients] [seconds] [pcm|spectrum|peak] [ipc path]
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmmsclient/xmmsclient.h>
+#include <xmmsc/xmmsc_visualization.h>
+
+#define FRAME_US (G_USEC_PER_SEC / 60)
+#define MAX_CALLS_PER_FRAME 16
+
+typedef struct renderer_St {
+	GThread *thread;
+	const gchar *path;
+	const gchar *type;
+	gint seconds;
+
+	gint64 chunks;
+	gint64 frames;
+	gint64 skipped;
+	gint64 *latency;
+	gint latencyc;
+	gint latency_allocated;
+	gboolean failed;
+} renderer_t;
+
+static xmmsc_connection_t *
+connect_or_die (const gchar *name, const gchar *path)
+{
+	xmmsc_connection_t *conn;
+
+	conn = xmmsc_init (name);
+	if (!conn || !xmmsc_connect (conn, path)) {
+		fprintf (stderr, "Could not connect to xmms2d: %s\n",
+		         conn ? xmmsc_get_last_error (conn) : "out of memory");
+		exit (EXIT_FAILURE);
+	}
+
+	return conn;
+}
+
+static gboolean
+result_ok (xmmsc_result_t *res)
+{
+	const gchar *errmsg;
+
+	xmmsc_result_wait (res);
+	if (xmmsv_get_error (xmmsc_result_get_value (res), &errmsg)) {
+		fprintf (stderr, "%s\n", errmsg);
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static gint
+start_vis (xmmsc_connection_t *conn, const gchar *type)
+{
+	xmmsc_result_t *res;
+	xmmsv_t *props;
+	gint vis;
+
+	res = xmmsc_visualization_init (conn);
+	if (!result_ok (res)) {
+		return -1;
+	}
+	vis = xmmsc_visualization_init_handle (res);
+	xmmsc_result_unref (res);
+
+	props = xmmsv_build_dict (XMMSV_DICT_ENTRY_STR ("type", type),
+	                          XMMSV_DICT_ENTRY_STR ("stereo", "1"),
+	                          XMMSV_DICT_END);
+	res = xmmsc_visualization_properties_set (conn, vis, props);
+	xmmsv_unref (props);
+	if (!result_ok (res)) {
+		return -1;
+	}
+	xmmsc_result_unref (res);
+
+	while (!xmmsc_visualization_started (conn, vis)) {
+		res = xmmsc_visualization_start (conn, vis);
+		if (xmmsc_visualization_errored (conn, vis)) {
+			fprintf (stderr, "Couldn't start visualization transfer: %s\n",
+			         xmmsc_get_last_error (conn));
+			return -1;
+		}
+		if (res) {
+			xmmsc_result_wait (res);
+			xmmsc_visualization_start_handle (conn, res);
+			xmmsc_result_unref (res);
+		}
+	}
+
+	return vis;
+}
+
+static void
+record_latency (renderer_t *r, gint64 us)
+{
+	if (r->latencyc == r->latency_allocated) {
+		r->latency_allocated = MAX (1024, r->latency_allocated * 2);
+		r->latency = g_renew (gint64, r->latency, r->latency_allocated);
+	}
+	r->latency[r->latencyc++] = us;
+}
+
+static gpointer
+render_loop (gpointer udata)
+{
+	renderer_t *r = udata;
+	xmmsc_connection_t *conn;
+	short data[2 * XMMSC_VISUALIZATION_WINDOW_SIZE];
+	gint64 frame, end;
+	gint vis;
+
+	conn = connect_or_die ("bench_vis_transport", r->path);
+
+	vis = start_vis (conn, r->type);
+	if (vis < 0) {
+		r->failed = TRUE;
+		xmmsc_unref (conn);
+		return NULL;
+	}
+
+	frame = g_get_monotonic_time ();
+	end = frame + (gint64) r->seconds * G_USEC_PER_SEC;
+
+	while (frame < end) {
+		gint i, got = 0, ret;
+
+		/* drain whatever arrived since the last frame, like a renderer
+		   that only draws the newest data would */
+		for (i = 0; i < MAX_CALLS_PER_FRAME; i++) {
+			gint64 before = g_get_monotonic_time ();
+
+			ret = xmmsc_visualization_chunk_get (conn, vis, data, 0, 0);
+			record_latency (r, g_get_monotonic_time () - before);
+
+			if (ret < 0) {
+				fprintf (stderr, "Lost the visualization transfer\n");
+				r->failed = TRUE;
+				goto out;
+			}
+			if (ret == 0) {
+				break;
+			}
+			got++;
+		}
+
+		r->chunks += got;
+		r->frames++;
+		if (!got) {
+			r->skipped++;
+		}
+
+		frame += FRAME_US;
+		while (g_get_monotonic_time () < frame) {
+			g_usleep (frame - g_get_monotonic_time ());
+		}
+	}
+
+out:
+	xmmsc_visualization_shutdown (conn, vis);
+	xmmsc_unref (conn);
+
+	return NULL;
+}
+
+static int
+compare_gint64 (const void *a, const void *b)
+{
+	gint64 x = *(const gint64 *) a, y = *(const gint64 *) b;
+	return (x > y) - (x < y);
+}
+
+int
+main (int argc, char **argv)
+{
+	renderer_t *renderers;
+	gint64 *all_latency, chunks = 0, frames = 0, skipped = 0;
+	gint num = 8, seconds = 10, i, n = 0, total = 0;
+	const gchar *type = "pcm";
+	const gchar *path = NULL;
+
+	if (argc > 1)
+		num = MAX (1, atoi (argv[1]));
+	if (argc > 2)
+		seconds = MAX (1, atoi (argv[2]));
+	if (argc > 3)
+		type = argv[3];
+	if (argc > 4)
+		path = argv[4];
+
+	renderers = g_new0 (renderer_t, num);
+
+	for (i = 0; i < num; i++) {
+		renderers[i].path = path;
+		renderers[i].type = type;
+		renderers[i].seconds = seconds;
+		renderers[i].thread = g_thread_new ("renderer", render_loop, &renderers[i]);
+	}
+
+	for (i = 0; i < num; i++) {
+		g_thread_join (renderers[i].thread);
+		if (renderers[i].failed) {
+			return EXIT_FAILURE;
+		}
+		chunks += renderers[i].chunks;
+		frames += renderers[i].frames;
+		skipped += renderers[i].skipped;
+		total += renderers[i].latencyc;
+	}
+
+	all_latency = g_new (gint64, MAX (1, total));
+	for (i = 0; i < num; i++) {
+		memcpy (all_latency + n, renderers[i].latency,
+		        renderers[i].latencyc * sizeof (gint64));
+		n += renderers[i].latencyc;
+		g_free (renderers[i].latency);
+	}
+
+	qsort (all_latency, n, sizeof (gint64), compare_gint64);
+
+	printf ("%d clients, %d seconds, type %s\n", num, seconds, type);
+	printf ("chunks: %.1f/s per client, %.1f/s total\n",
+	        (gdouble) chunks / num / seconds, (gdouble) chunks / seconds);
+	printf ("skipped frames: %" G_GINT64_FORMAT " of %" G_GINT64_FORMAT " (%.1f%%)\n",
+	        skipped, frames, frames ? 100.0 * skipped / frames : 0.0);
+	if (n) {
+		printf ("chunk_get: median %" G_GINT64_FORMAT "us, p99 %" G_GINT64_FORMAT
+		        "us, max %" G_GINT64_FORMAT "us\n",
+		        all_latency[n / 2], all_latency[((gint64) n * 99) / 100],
+		        all_latency[n - 1]);
+	}
+
+	g_free (all_latency);
+	g_free (renderers);
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,302 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "http_server.h"
+
+struct xmms_http_server_St {
+	GThread *thread;
+
+	gint listen_fd;
+	/* closing the write end stops the server */
+	gint wakeup[2];
+	guint16 port;
+
+	const gchar *data;
+	gsize length;
+	gboolean ranges;
+	/* status to answer range requests with instead, or 0 */
+	gint range_status;
+
+	gint requests;
+	gint connections;
+};
+
+static gboolean
+send_all (gint fd, const gchar *buf, gsize len)
+{
+	while (len > 0) {
+		gssize ret = send (fd, buf, len, MSG_NOSIGNAL);
+		if (ret < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return FALSE;
+		}
+		buf += ret;
+		len -= ret;
+	}
+	return TRUE;
+}
+
+/* Parse "Range: bytes=first-[last]", returns FALSE if there is none */
+static gboolean
+parse_range (const gchar *request, gint64 *first, gint64 *last)
+{
+	const gchar *p = request;
+	gchar *end;
+
+	while ((p = strchr (p, '\n')) != NULL) {
+		p++;
+		if (g_ascii_strncasecmp (p, "range: bytes=", 13) == 0) {
+			*first = g_ascii_strtoll (p + 13, &end, 10);
+			*last = -1;
+			if (*end == '-' && g_ascii_isdigit (end[1])) {
+				*last = g_ascii_strtoll (end + 1, NULL, 10);
+			}
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static gboolean
+serve_request (xmms_http_server_t *server, gint fd, const gchar *request)
+{
+	gint64 first = 0, last = server->length - 1;
+	gchar *header;
+	gboolean ret;
+	gint status;
+
+	g_atomic_int_inc (&server->requests);
+
+	if (server->ranges && parse_range (request, &first, &last)) {
+		status = g_atomic_int_get (&server->range_status);
+		if (status != 0) {
+			header = g_strdup_printf ("HTTP/1.1 %d Failed\r\n"
+			                          "Content-Length: 0\r\n\r\n",
+			                          status);
+			ret = send_all (fd, header, strlen (header));
+			g_free (header);
+			return ret;
+		}
+		if (last < 0 || last >= server->length) {
+			last = server->length - 1;
+		}
+		if (first >= server->length || first > last) {
+			header = g_strdup_printf ("HTTP/1.1 416 Range Not Satisfiable\r\n"
+			                          "Content-Range: bytes */%" G_GSIZE_FORMAT "\r\n"
+			                          "Content-Length: 0\r\n\r\n",
+			                          server->length);
+			ret = send_all (fd, header, strlen (header));
+			g_free (header);
+			return ret;
+		}
+		header = g_strdup_printf ("HTTP/1.1 206 Partial Content\r\n"
+		                          "Accept-Ranges: bytes\r\n"
+		                          "Content-Range: bytes %" G_GINT64_FORMAT "-%"
+		                          G_GINT64_FORMAT "/%" G_GSIZE_FORMAT "\r\n"
+		                          "Content-Length: %" G_GINT64_FORMAT "\r\n\r\n",
+		                          first, last, server->length, last - first + 1);
+	} else {
+		/* like many simple servers, say nothing about ranges
+		 * if they are not supported */
+		header = g_strdup_printf ("HTTP/1.1 200 OK\r\n"
+		                          "%s"
+		                          "Content-Length: %" G_GSIZE_FORMAT "\r\n\r\n",
+		                          server->ranges ? "Accept-Ranges: bytes\r\n" : "",
+		                          server->length);
+	}
+
+	ret = send_all (fd, header, strlen (header)) &&
+	      send_all (fd, server->data + first, last - first + 1);
+
+	g_free (header);
+
+	return ret;
+}
+
+/* Serve requests on a connection until the client goes away */
+static void
+serve_connection (xmms_http_server_t *server, gint fd)
+{
+	struct pollfd fds[2];
+	gchar request[8192];
+	gsize fill = 0;
+
+	g_atomic_int_inc (&server->connections);
+
+	fds[0].fd = fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = server->wakeup[0];
+	fds[1].events = POLLIN;
+
+	while (TRUE) {
+		gchar *end;
+		gssize ret;
+
+		if (poll (fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		if (fds[1].revents) {
+			break;
+		}
+
+		ret = recv (fd, request + fill, sizeof (request) - fill - 1, 0);
+		if (ret <= 0) {
+			break;
+		}
+		fill += ret;
+		request[fill] = '\0';
+
+		while ((end = strstr (request, "\r\n\r\n")) != NULL) {
+			gsize used = end + 4 - request;
+
+			end[2] = '\0';
+			if (!serve_request (server, fd, request)) {
+				close (fd);
+				return;
+			}
+
+			memmove (request, request + used, fill - used + 1);
+			fill -= used;
+		}
+
+		if (fill == sizeof (request) - 1) {
+			break;
+		}
+	}
+
+	close (fd);
+}
+
+static gpointer
+http_server_thread (gpointer udata)
+{
+	xmms_http_server_t *server = udata;
+	struct pollfd fds[2];
+
+	fds[0].fd = server->listen_fd;
+	fds[0].events = POLLIN;
+	fds[1].fd = server->wakeup[0];
+	fds[1].events = POLLIN;
+
+	while (TRUE) {
+		gint fd;
+
+		if (poll (fds, 2, -1) < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			break;
+		}
+
+		if (fds[1].revents) {
+			break;
+		}
+
+		fd = accept (server->listen_fd, NULL, NULL);
+		if (fd >= 0) {
+			serve_connection (server, fd);
+		}
+	}
+
+	return NULL;
+}
+
+xmms_http_server_t *
+xmms_http_server_new (gconstpointer data, gsize length, gboolean ranges)
+{
+	xmms_http_server_t *server;
+	struct sockaddr_in addr;
+	socklen_t addrlen = sizeof (addr);
+
+	server = g_new0 (xmms_http_server_t, 1);
+	server->data = data;
+	server->length = length;
+	server->ranges = ranges;
+
+	memset (&addr, 0, sizeof (addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+	addr.sin_port = 0;
+
+	server->listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+	if (server->listen_fd < 0 ||
+	    bind (server->listen_fd, (struct sockaddr *) &addr, sizeof (addr)) < 0 ||
+	    listen (server->listen_fd, 4) < 0 ||
+	    getsockname (server->listen_fd, (struct sockaddr *) &addr, &addrlen) < 0) {
+		g_error ("Could not set up test HTTP server: %s", strerror (errno));
+	}
+
+	if (pipe (server->wakeup) < 0) {
+		g_error ("Could not set up test HTTP server: %s", strerror (errno));
+	}
+
+	server->port = ntohs (addr.sin_port);
+	server->thread = g_thread_new ("http server", http_server_thread, server);
+
+	return server;
+}
+
+void
+xmms_http_server_free (xmms_http_server_t *server)
+{
+	close (server->wakeup[1]);
+	g_thread_join (server->thread);
+
+	close (server->wakeup[0]);
+	close (server->listen_fd);
+
+	g_free (server);
+}
+
+gchar *
+xmms_http_server_url (xmms_http_server_t *server, const gchar *path)
+{
+	return g_strdup_printf ("http://127.0.0.1:%u/%s", server->port, path);
+}
+
+void
+xmms_http_server_fail_ranges (xmms_http_server_t *server, gint status)
+{
+	g_atomic_int_set (&server->range_status, status);
+}
+
+gint
+xmms_http_server_requests (xmms_http_server_t *server)
+{
+	return g_atomic_int_get (&server->requests);
+}
+
+gint
+xmms_http_server_connections (xmms_http_server_t *server)
+{
+	return g_atomic_int_get (&server->connections);
+}
@@ -0,0 +1,40 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#ifndef __HTTP_SERVER_H__
+#define __HTTP_SERVER_H__
+
+#include <glib.h>
+
+/* A single threaded HTTP/1.1 server on the loopback interface that
+ * serves one blob of data on any path, with keep-alive and optional
+ * support for byte ranges.
+ */
+typedef struct xmms_http_server_St xmms_http_server_t;
+
+xmms_http_server_t *xmms_http_server_new (gconstpointer data, gsize length, gboolean ranges);
+void xmms_http_server_free (xmms_http_server_t *server);
+
+gchar *xmms_http_server_url (xmms_http_server_t *server, const gchar *path);
+
+/* Answer range requests with an HTTP error status from now on, 0 to
+ * serve them again */
+void xmms_http_server_fail_ranges (xmms_http_server_t *server, gint status);
+
+gint xmms_http_server_requests (xmms_http_server_t *server);
+gint xmms_http_server_connections (xmms_http_server_t *server);
+
+#endif
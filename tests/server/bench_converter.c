@@ -0,0 +1,105 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/* Measures how much faster than realtime the sample converter
+ * resamples 16 bit stereo at each quality level, feeding it 1024 byte
+ * chunks like the converter xform does.
+ */
+
+#include <glib.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <xmmspriv/xmms_converter.h>
+#include <xmmspriv/xmms_streamtype.h>
+#include <xmms/xmms_object.h>
+#include <xmms/xmms_sample.h>
+
+#define CHUNK_FRAMES 256
+
+static const gchar *quality_names[] = {
+	"linear", "low", "medium", "high"
+};
+
+static xmms_stream_type_t *
+s16_stereo (gint samplerate)
+{
+	return _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+	                              XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                              XMMS_STREAM_TYPE_FMT_FORMAT, XMMS_SAMPLE_FORMAT_S16,
+	                              XMMS_STREAM_TYPE_FMT_CHANNELS, 2,
+	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE, samplerate,
+	                              XMMS_STREAM_TYPE_END);
+}
+
+static void
+run (xmms_resampler_quality_t quality, gint from, gint to, gint seconds)
+{
+	xmms_sample_converter_t *conv;
+	xmms_stream_type_t *in_type, *out_type;
+	gint16 chunk[CHUNK_FRAMES * 2];
+	gint64 start, elapsed;
+	guint i, outlen;
+	gpointer out;
+	guint64 frames, total;
+
+	in_type = s16_stereo (from);
+	out_type = s16_stereo (to);
+	conv = xmms_sample_converter_init_full (in_type, out_type, quality);
+
+	for (i = 0; i < CHUNK_FRAMES; i++) {
+		chunk[2 * i] = chunk[2 * i + 1] = 16384 * sin (2.0 * M_PI * 1000 * i / from);
+	}
+
+	total = (guint64) from * seconds;
+
+	start = g_get_monotonic_time ();
+	for (frames = 0; frames < total; frames += CHUNK_FRAMES) {
+		xmms_sample_convert (conv, chunk, sizeof (chunk),
+		                     (xmms_sample_t **) &out, &outlen);
+	}
+	elapsed = MAX (1, g_get_monotonic_time () - start);
+
+	printf ("%-6s %6d -> %6d: %8.1fx realtime\n",
+	        quality_names[quality], from, to,
+	        seconds / (elapsed / (gdouble) G_USEC_PER_SEC));
+
+	xmms_object_unref (conv);
+	xmms_object_unref (in_type);
+	xmms_object_unref (out_type);
+}
+
+int
+main (int argc, char **argv)
+{
+	gint rates[][2] = { { 44100, 48000 }, { 192000, 48000 }, { 96000, 44100 } };
+	xmms_resampler_quality_t q;
+	gint seconds = 60;
+	guint i;
+
+	if (argc > 1) {
+		seconds = atoi (argv[1]);
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (rates); i++) {
+		for (q = XMMS_RESAMPLER_QUALITY_LINEAR; q <= XMMS_RESAMPLER_QUALITY_HIGH; q++) {
+			run (q, rates[i][0], rates[i][1], seconds);
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,219 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/* Compares the locked and the lock-free ringbuffer under the access
+ * pattern of the output filler: the producer writes 4096 byte chunks,
+ * the consumer reads period sized chunks like an output plugin does.
+ *
+ * Throughput is measured with both sides running flat out, wakeup
+ * latency by letting the consumer block on an empty buffer and timing
+ * how long it takes to see a timestamped chunk.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_ringbuf.h>
+
+#define CHUNK_SIZE 4096
+#define BUFFER_SIZE 32768
+
+typedef struct bench_St {
+	xmms_ringbuf_t *ringbuf;
+	GMutex *mutex;
+	GMutex mutex_storage;
+	guint64 total;
+	guint period;
+	/* microseconds to sleep between chunks, 0 for throughput runs */
+	gulong interval;
+} bench_t;
+
+static void
+bench_write (bench_t *bench, const guint8 *buf, guint len)
+{
+	if (bench->mutex) {
+		g_mutex_lock (bench->mutex);
+	}
+
+	xmms_ringbuf_wait_free (bench->ringbuf, len, bench->mutex);
+	xmms_ringbuf_write_wait (bench->ringbuf, buf, len, bench->mutex);
+
+	if (bench->mutex) {
+		g_mutex_unlock (bench->mutex);
+	}
+}
+
+static guint
+bench_read (bench_t *bench, guint8 *buf, guint len)
+{
+	guint ret;
+
+	if (bench->mutex) {
+		g_mutex_lock (bench->mutex);
+	}
+
+	xmms_ringbuf_wait_used (bench->ringbuf, len, bench->mutex);
+	ret = xmms_ringbuf_read (bench->ringbuf, buf, len);
+
+	if (bench->mutex) {
+		g_mutex_unlock (bench->mutex);
+	}
+
+	return ret;
+}
+
+static gpointer
+producer (gpointer data)
+{
+	bench_t *bench = (bench_t *) data;
+	guint8 buf[CHUNK_SIZE];
+	guint64 written = 0;
+	gint64 now;
+
+	memset (buf, 0, sizeof (buf));
+
+	while (written < bench->total) {
+		if (bench->interval) {
+			g_usleep (bench->interval);
+			now = g_get_monotonic_time ();
+			memcpy (buf, &now, sizeof (now));
+		}
+		bench_write (bench, buf, sizeof (buf));
+		written += sizeof (buf);
+	}
+
+	if (bench->mutex) {
+		g_mutex_lock (bench->mutex);
+	}
+	xmms_ringbuf_set_eos (bench->ringbuf, TRUE);
+	if (bench->mutex) {
+		g_mutex_unlock (bench->mutex);
+	}
+
+	return NULL;
+}
+
+static void
+bench_init (bench_t *bench, gboolean spsc, guint64 total, guint period,
+            gulong interval)
+{
+	memset (bench, 0, sizeof (bench_t));
+
+	if (spsc) {
+		bench->ringbuf = xmms_ringbuf_new_spsc (BUFFER_SIZE);
+	} else {
+		bench->ringbuf = xmms_ringbuf_new (BUFFER_SIZE);
+		g_mutex_init (&bench->mutex_storage);
+		bench->mutex = &bench->mutex_storage;
+	}
+
+	bench->total = total;
+	bench->period = period;
+	bench->interval = interval;
+}
+
+static void
+bench_clear (bench_t *bench)
+{
+	xmms_ringbuf_destroy (bench->ringbuf);
+	if (bench->mutex) {
+		g_mutex_clear (bench->mutex);
+	}
+}
+
+static void
+run_throughput (gboolean spsc, guint64 total, guint period)
+{
+	bench_t bench;
+	GThread *thread;
+	guint8 *buf;
+	guint64 read = 0;
+	gint64 start, elapsed;
+	guint ret;
+
+	bench_init (&bench, spsc, total, period, 0);
+	buf = g_malloc (period);
+
+	start = g_get_monotonic_time ();
+	thread = g_thread_new ("producer", producer, &bench);
+
+	while ((ret = bench_read (&bench, buf, period)) > 0 ||
+	       !xmms_ringbuf_iseos (bench.ringbuf)) {
+		read += ret;
+	}
+
+	g_thread_join (thread);
+	elapsed = MAX (1, g_get_monotonic_time () - start);
+
+	printf ("%-8s throughput  period %5u: %8.1f MiB/s\n",
+	        spsc ? "spsc" : "locked", period,
+	        (read / (1024.0 * 1024.0)) / (elapsed / (gdouble) G_USEC_PER_SEC));
+
+	g_free (buf);
+	bench_clear (&bench);
+}
+
+static void
+run_latency (gboolean spsc, guint chunks)
+{
+	bench_t bench;
+	GThread *thread;
+	guint8 buf[CHUNK_SIZE];
+	gint64 stamp, latency, sum = 0, max = 0;
+	guint n = 0;
+
+	bench_init (&bench, spsc, (guint64) chunks * CHUNK_SIZE, CHUNK_SIZE, 1000);
+	thread = g_thread_new ("producer", producer, &bench);
+
+	while (bench_read (&bench, buf, CHUNK_SIZE) == CHUNK_SIZE) {
+		memcpy (&stamp, buf, sizeof (stamp));
+		latency = g_get_monotonic_time () - stamp;
+		sum += latency;
+		max = MAX (max, latency);
+		n++;
+	}
+
+	g_thread_join (thread);
+
+	printf ("%-8s wakeup latency:      avg %5.1f us, max %5" G_GINT64_FORMAT " us\n",
+	        spsc ? "spsc" : "locked", n ? sum / (gdouble) n : 0.0, max);
+
+	bench_clear (&bench);
+}
+
+int
+main (int argc, char **argv)
+{
+	guint periods[] = { 256, 1024, 4096 };
+	guint64 total = 1024 * 1024 * 1024;
+	guint i;
+
+	if (argc > 1) {
+		total = g_ascii_strtoull (argv[1], NULL, 10) * 1024 * 1024;
+	}
+
+	for (i = 0; i < G_N_ELEMENTS (periods); i++) {
+		run_throughput (FALSE, total, periods[i]);
+		run_throughput (TRUE, total, periods[i]);
+	}
+
+	run_latency (FALSE, 2000);
+	run_latency (TRUE, 2000);
+
+	return EXIT_SUCCESS;
+}
@@ -31,6 +31,9 @@
 
 #include <memory_status.h>
 
+/* Entries generated per medialib session */
+#define GENERATE_BATCH_SIZE 1000
+
 typedef void (*xmms_path_predicate)(const gchar *filename, xmmsv_t *list);
 
 typedef gboolean (*xmms_test_predicate)(xmms_medialib_t *medialib, const gchar *name,
@@ -49,6 +52,7 @@ typedef struct xmms_test_args_St {
 	} format;
 	const gchar *database_path;
 	const gchar *testcase_path;
+	gint generate;
 	gboolean debug;
 } xmms_test_args_t;
 
@@ -239,6 +243,65 @@ populate_medialib (xmms_medialib_t *medialib, xmmsv_t *content)
 }
 
 
+/**
+ * Fills the medialib with synthetic entries, ten tracks to an album
+ * and ten albums to an artist.
+ *
+ * All urls are added in one batch, as looking up the next free id
+ * walks every entry in the medialib.
+ */
+static void
+generate_medialib (xmms_medialib_t *medialib, gint count)
+{
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t entry;
+	xmmsv_t *entries;
+	GPtrArray *urls;
+	gchar *value;
+	gint i, j, size;
+
+	urls = g_ptr_array_new_with_free_func (g_free);
+	for (i = 0; i < count; i++) {
+		g_ptr_array_add (urls, g_strdup_printf ("file:///generated/%d.mp3", i));
+	}
+
+	entries = xmmsv_new_coll (XMMS_COLLECTION_TYPE_IDLIST);
+	xmms_medialib_add_encoded_batch (medialib, (const gchar **) urls->pdata,
+	                                 urls->len, entries);
+	g_ptr_array_free (urls, TRUE);
+
+	size = xmmsv_coll_idlist_get_size (entries);
+
+	/* Commit in batches to keep the transactions small */
+	for (i = 0; i < size; i += GENERATE_BATCH_SIZE) {
+		session = xmms_medialib_session_begin (medialib);
+
+		for (j = i; j < MIN (size, i + GENERATE_BATCH_SIZE); j++) {
+			xmmsv_coll_idlist_get_index (entries, j, &entry);
+
+			value = g_strdup_printf ("Artist %d", j / 100);
+			xmms_medialib_entry_property_set_str (session, entry, "artist", value);
+			g_free (value);
+
+			value = g_strdup_printf ("Album %d", j / 10);
+			xmms_medialib_entry_property_set_str (session, entry, "album", value);
+			g_free (value);
+
+			value = g_strdup_printf ("Title %d", j);
+			xmms_medialib_entry_property_set_str (session, entry, "title", value);
+			g_free (value);
+
+			xmms_medialib_entry_property_set_int (session, entry, "tracknr", j % 10 + 1);
+			xmms_medialib_entry_property_set_int (session, entry, "duration", 120000 + j % 240000);
+		}
+
+		xmms_medialib_session_commit (session);
+	}
+
+	xmmsv_unref (entries);
+}
+
+
 /**
  * Unit test predicate
  */
@@ -404,6 +467,37 @@ run_tests (xmms_medialib_t *medialib, xmmsv_t *testcases, xmms_test_predicate pr
 }
 
 
+static void
+run_performance_suite (const gchar *path, const gchar *datasetname, gint generate,
+                       xmmsv_t *testcases, gint format)
+{
+	xmms_medialib_t *medialib;
+
+	if (format == FORMAT_PRETTY)
+		g_print ("Running suite with: %s\n", datasetname);
+
+	xmms_ipc_init ();
+	xmms_config_init ("memory://");
+	xmms_config_property_register ("medialib.path", path, NULL, NULL);
+
+	medialib = xmms_medialib_init ();
+	if (medialib == NULL) {
+		g_print ("Could not open database: %s (%d)\n", path, s4_errno ());
+		exit (EXIT_FAILURE);
+	}
+
+	if (generate > 0) {
+		generate_medialib (medialib, generate);
+	}
+
+	run_tests (medialib, testcases, run_performance_test, format, datasetname);
+
+	xmms_object_unref (medialib);
+	xmms_config_shutdown ();
+	xmms_ipc_shutdown ();
+}
+
+
 static gboolean
 run_performance_tests (xmmsv_t *databases, xmmsv_t *testcases, gint format)
 {
@@ -412,29 +506,22 @@ run_performance_tests (xmmsv_t *databases, xmmsv_t *testcases, gint format)
 
 	xmmsv_get_list_iter (databases, &it);
 	while (xmmsv_list_iter_entry_string (it, &filename)) {
-		xmms_medialib_t *medialib;
-
-		if (format == FORMAT_PRETTY)
-			g_print ("Running suite with: %s\n", filename);
-
-		xmms_ipc_init ();
-		xmms_config_init ("memory://");
-		xmms_config_property_register ("medialib.path", filename, NULL, NULL);
+		run_performance_suite (filename, filename, 0, testcases, format);
+		xmmsv_list_iter_next (it);
+	}
 
-		medialib = xmms_medialib_init ();
-		if (medialib == NULL) {
-			g_print ("Could not open database: %s (%d)\n", filename, s4_errno ());
-			exit (EXIT_FAILURE);
-		}
+	return TRUE;
+}
 
-		run_tests (medialib, testcases, run_performance_test, format, filename);
 
-		xmms_object_unref (medialib);
-		xmms_config_shutdown ();
-		xmms_ipc_shutdown ();
+static gboolean
+run_generated_performance_tests (gint count, xmmsv_t *testcases, gint format)
+{
+	gchar *datasetname;
 
-		xmmsv_list_iter_next (it);
-	}
+	datasetname = g_strdup_printf ("generated-%d", count);
+	run_performance_suite ("memory://", datasetname, count, testcases, format);
+	g_free (datasetname);
 
 	return TRUE;
 }
@@ -472,6 +559,11 @@ parse_command_line (gint argc, gchar **argv, xmms_test_args_t *args)
 			G_OPTION_ARG_FILENAME, &args->testcase_path,
 			"Scan <path> for 1..n test cases.", "<path>"
 		},
+		{
+			"generate", 'g', 0,
+			G_OPTION_ARG_INT, &args->generate,
+			"Generate a media library of <count> entries instead of scanning for them.", "<count>"
+		},
 		{
 			"debug", 'd', 0,
 			G_OPTION_ARG_NONE, &args->debug,
@@ -513,6 +605,8 @@ parse_command_line (gint argc, gchar **argv, xmms_test_args_t *args)
  * - load a number of tests from json files
  * - by default, run tests as unit tests
  * - optionally run tests as performance tests, but then require a db directory
+ *   or the number of entries to generate, for example:
+ *   medialib-runner -v performance -g 500000 -t tests/server/medialib-performance
  */
 gint
 main (gint argc, gchar **argv)
@@ -540,9 +634,13 @@ main (gint argc, gchar **argv)
 		else
 			g_print (" - Running Performance Test -\n");
 
-		databases = scan_path (args.database_path, filter_databases);
-		run_performance_tests (databases, testcases, args.format);
-		xmmsv_unref (databases);
+		if (args.generate > 0) {
+			run_generated_performance_tests (args.generate, testcases, args.format);
+		} else {
+			databases = scan_path (args.database_path, filter_databases);
+			run_performance_tests (databases, testcases, args.format);
+			xmmsv_unref (databases);
+		}
 	} else {
 		if (args.format == FORMAT_CSV)
 			g_print ("\"test\",\"success\"\n");
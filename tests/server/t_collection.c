@@ -758,3 +758,131 @@ CASE (test_collection_idlist_from_playlist)
 	CU_ASSERT_EQUAL (1, xmmsv_coll_idlist_get_size (idlist));
 	xmmsv_unref (idlist);
 }
+
+static void
+set_artist (xmms_medialib_entry_t entry, const gchar *artist)
+{
+	xmms_medialib_session_t *session;
+
+	session = xmms_medialib_session_begin (medialib);
+	xmms_medialib_entry_property_set_str (session, entry,
+	                                      XMMS_MEDIALIB_ENTRY_PROPERTY_ARTIST,
+	                                      artist);
+	xmms_medialib_session_commit (session);
+}
+
+CASE (test_random_media)
+{
+	xmms_medialib_session_t *session;
+	xmms_medialib_entry_t first, second, third, entry;
+	gboolean seen_first = FALSE, seen_second = FALSE;
+	xmmsv_t *source, *universe;
+	GHashTable *avoid;
+	gint i;
+
+	universe = xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE);
+	source = xmmsv_new_coll (XMMS_COLLECTION_TYPE_EQUALS);
+	xmmsv_coll_attribute_set_string (source, "field", "artist");
+	xmmsv_coll_attribute_set_string (source, "value", "Red Fang");
+	xmmsv_coll_add_operand (source, universe);
+	xmmsv_unref (universe);
+
+	CU_ASSERT_EQUAL (0, xmms_collection_get_random_media (dag, source, NULL));
+
+	/* media added after the first pick are picked up */
+	first = xmms_mock_entry (medialib, 1, "Red Fang", "Red Fang", "Prehistoric Dog");
+	second = xmms_mock_entry (medialib, 2, "Red Fang", "Red Fang", "Reverse Thunder");
+	third = xmms_mock_entry (medialib, 1, "Kyuss", "Welcome to Sky Valley", "Gardenia");
+
+	for (i = 0; i < 64; i++) {
+		entry = xmms_collection_get_random_media (dag, source, NULL);
+		CU_ASSERT (entry == first || entry == second);
+		seen_first |= entry == first;
+		seen_second |= entry == second;
+	}
+	CU_ASSERT_TRUE (seen_first);
+	CU_ASSERT_TRUE (seen_second);
+
+	avoid = g_hash_table_new (NULL, NULL);
+	g_hash_table_add (avoid, GINT_TO_POINTER (first));
+
+	for (i = 0; i < 16; i++) {
+		CU_ASSERT_EQUAL (second, xmms_collection_get_random_media (dag, source, avoid));
+	}
+
+	/* changed media move in and out of the collection */
+	set_artist (third, "Red Fang");
+	set_artist (second, "Kyuss");
+
+	for (i = 0; i < 16; i++) {
+		CU_ASSERT_EQUAL (third, xmms_collection_get_random_media (dag, source, avoid));
+	}
+
+	/* nothing else left to pick */
+	set_artist (third, "Kyuss");
+	CU_ASSERT_EQUAL (first, xmms_collection_get_random_media (dag, source, avoid));
+
+	session = xmms_medialib_session_begin (medialib);
+	xmms_medialib_entry_remove (session, first);
+	xmms_medialib_session_commit (session);
+
+	CU_ASSERT_EQUAL (0, xmms_collection_get_random_media (dag, source, avoid));
+
+	g_hash_table_destroy (avoid);
+	xmmsv_unref (source);
+}
+
+CASE (test_random_media_mostly_avoided)
+{
+	xmms_medialib_entry_t entries[64], entry;
+	xmmsv_t *source, *universe;
+	GHashTable *avoid;
+	gchar title[32];
+	gint i, count;
+
+	universe = xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE);
+	source = xmmsv_new_coll (XMMS_COLLECTION_TYPE_EQUALS);
+	xmmsv_coll_attribute_set_string (source, "field", "artist");
+	xmmsv_coll_attribute_set_string (source, "value", "Red Fang");
+	xmmsv_coll_add_operand (source, universe);
+	xmmsv_unref (universe);
+
+	avoid = g_hash_table_new (NULL, NULL);
+
+	for (i = 0; i < G_N_ELEMENTS (entries); i++) {
+		g_snprintf (title, sizeof (title), "Track %d", i);
+		entries[i] = xmms_mock_entry (medialib, i + 1, "Red Fang", "Red Fang", title);
+		g_hash_table_add (avoid, GINT_TO_POINTER (entries[i]));
+	}
+
+	/* the only media left is found however unlikely a random pick is */
+	g_hash_table_remove (avoid, GINT_TO_POINTER (entries[42]));
+
+	for (i = 0; i < 32; i++) {
+		CU_ASSERT_EQUAL (entries[42], xmms_collection_get_random_media (dag, source, avoid));
+	}
+
+	/* what is left is picked evenly, whatever is avoided before it */
+	g_hash_table_add (avoid, GINT_TO_POINTER (entries[42]));
+	g_hash_table_remove (avoid, GINT_TO_POINTER (entries[1]));
+	g_hash_table_remove (avoid, GINT_TO_POINTER (entries[2]));
+
+	for (i = 0, count = 0; i < 2000; i++) {
+		entry = xmms_collection_get_random_media (dag, source, avoid);
+		CU_ASSERT_TRUE (entry == entries[1] || entry == entries[2]);
+		if (entry == entries[2]) {
+			count++;
+		}
+	}
+	CU_ASSERT_TRUE (count > 700 && count < 1300);
+
+	/* everything avoided, still a member of the collection */
+	g_hash_table_add (avoid, GINT_TO_POINTER (entries[1]));
+	g_hash_table_add (avoid, GINT_TO_POINTER (entries[2]));
+
+	entry = xmms_collection_get_random_media (dag, source, avoid);
+	CU_ASSERT_TRUE (g_hash_table_contains (avoid, GINT_TO_POINTER (entry)));
+
+	g_hash_table_destroy (avoid);
+	xmmsv_unref (source);
+}
@@ -0,0 +1,270 @@
+#include <locale.h>
+#include <string.h>
+
+#include <glib/gstdio.h>
+
+#include "xcu.h"
+
+#include <xmmspriv/xmms_log.h>
+#include <xmmspriv/xmms_ipc.h>
+#include <xmmspriv/xmms_config.h>
+#include <xmmspriv/xmms_medialib.h>
+#include <xmmspriv/xmms_collection.h>
+#include <xmmspriv/xmms_collsync.h>
+#include <xmmspriv/xmms_playlist.h>
+
+#include "server-utils/ipc_call.h"
+
+static xmms_medialib_t *medialib;
+static xmms_coll_dag_t *dag;
+static xmms_playlist_t *playlist;
+static xmms_coll_sync_t *collsync;
+
+static gchar *directory;
+static gchar *database;
+static gchar *journal;
+
+static void
+server_start (void)
+{
+	dag = xmms_collection_init (medialib);
+	playlist = xmms_playlist_init (medialib, dag);
+	collsync = xmms_coll_sync_init ("test", dag, playlist);
+}
+
+/* Shutting down the synchronizer flushes pending changes. */
+static void
+server_stop (void)
+{
+	xmms_object_unref (collsync); collsync = NULL;
+	xmms_object_unref (playlist); playlist = NULL;
+	xmms_object_unref (dag); dag = NULL;
+}
+
+static void
+save_collection (const gchar *name)
+{
+	xmmsv_t *result;
+
+	result = XMMS_IPC_CALL (dag, XMMS_IPC_COMMAND_COLLECTION_SAVE,
+	                        xmmsv_new_string (name),
+	                        xmmsv_new_string (XMMS_COLLECTION_NS_COLLECTIONS),
+	                        xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE));
+	CU_ASSERT (xmmsv_is_type (result, XMMSV_TYPE_NONE));
+	xmmsv_unref (result);
+}
+
+static void
+remove_collection (const gchar *name)
+{
+	xmmsv_t *result;
+
+	result = XMMS_IPC_CALL (dag, XMMS_IPC_COMMAND_COLLECTION_REMOVE,
+	                        xmmsv_new_string (name),
+	                        xmmsv_new_string (XMMS_COLLECTION_NS_COLLECTIONS));
+	CU_ASSERT (xmmsv_is_type (result, XMMSV_TYPE_NONE));
+	xmmsv_unref (result);
+}
+
+static gboolean
+has_collection (const gchar *name)
+{
+	return xmms_collection_get_pointer (dag, name, XMMS_COLLECTION_NSID_COLLECTIONS) != NULL;
+}
+
+static gchar *
+read_file (const gchar *path, gsize *length)
+{
+	gchar *contents = NULL;
+
+	g_file_get_contents (path, &contents, length, NULL);
+
+	return contents;
+}
+
+SETUP (collsync) {
+	gchar *path;
+
+	setlocale (LC_COLLATE, "");
+
+	xmms_ipc_init ();
+	xmms_log_init (0);
+
+	xmms_config_init ("memory://");
+
+	directory = g_dir_make_tmp ("xmms2-collsync-XXXXXX", NULL);
+	database = g_build_filename (directory, "test.db", NULL);
+	journal = g_strconcat (database, ".journal", NULL);
+
+	path = g_build_filename (directory, "${uuid}.db", NULL);
+	xmms_config_property_register ("collection.directory", path, NULL, NULL);
+	g_free (path);
+
+	xmms_config_property_register ("medialib.path", "memory://", NULL, NULL);
+	xmms_config_property_register ("playlist.repeat_one", "0", NULL, NULL);
+	xmms_config_property_register ("playlist.repeat_all", "0", NULL, NULL);
+
+	medialib = xmms_medialib_init ();
+
+	return 0;
+}
+
+CLEANUP () {
+	xmms_object_unref (medialib); medialib = NULL;
+
+	g_unlink (journal);
+	g_unlink (database);
+	g_rmdir (directory);
+
+	g_free (journal);
+	g_free (database);
+	g_free (directory);
+
+	xmms_config_shutdown ();
+	xmms_ipc_shutdown ();
+
+	return 0;
+}
+
+CASE (test_journal_roundtrip)
+{
+	gchar *before, *after;
+	gsize before_length, after_length;
+
+	server_start ();
+	save_collection ("First");
+	server_stop ();
+
+	/* nothing to build on yet, so a full database is written */
+	before = read_file (database, &before_length);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (before);
+	CU_ASSERT (before_length > 8 && memcmp (before, "XMMS2CDB", 8) == 0);
+	CU_ASSERT_FALSE (g_file_test (journal, G_FILE_TEST_EXISTS));
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("First"));
+	save_collection ("Second");
+	server_stop ();
+
+	/* the change only went to the journal */
+	after = read_file (database, &after_length);
+	CU_ASSERT_EQUAL (before_length, after_length);
+	CU_ASSERT (memcmp (before, after, before_length) == 0);
+	CU_ASSERT_TRUE (g_file_test (journal, G_FILE_TEST_IS_REGULAR));
+	g_free (before);
+	g_free (after);
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("First"));
+	CU_ASSERT_TRUE (has_collection ("Second"));
+
+	/* removals may touch other collections, the database is rewritten */
+	remove_collection ("First");
+	server_stop ();
+
+	CU_ASSERT_FALSE (g_file_test (journal, G_FILE_TEST_EXISTS));
+
+	server_start ();
+	CU_ASSERT_FALSE (has_collection ("First"));
+	CU_ASSERT_TRUE (has_collection ("Second"));
+	server_stop ();
+}
+
+CASE (test_legacy_database)
+{
+	xmmsv_t *snapshot, *serialized;
+	const guchar *buffer;
+	gchar *contents;
+	guint length;
+	gsize size;
+
+	/* databases written before the header was introduced */
+	snapshot = xmmsv_build_dict (
+		XMMSV_DICT_ENTRY ("collections",
+		                  xmmsv_build_dict (XMMSV_DICT_ENTRY ("Legacy", xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE)),
+		                                    XMMSV_DICT_END)),
+		XMMSV_DICT_ENTRY ("playlists", xmmsv_new_dict ()),
+		XMMSV_DICT_END);
+	serialized = xmmsv_serialize (snapshot);
+	xmmsv_get_bin (serialized, &buffer, &length);
+	CU_ASSERT_TRUE (g_file_set_contents (database, (const gchar *) buffer, length, NULL));
+	xmmsv_unref (serialized);
+	xmmsv_unref (snapshot);
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("Legacy"));
+	server_stop ();
+
+	/* converted on the first sync */
+	contents = read_file (database, &size);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (contents);
+	CU_ASSERT (size > 8 && memcmp (contents, "XMMS2CDB", 8) == 0);
+	g_free (contents);
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("Legacy"));
+	server_stop ();
+}
+
+CASE (test_damaged_journal)
+{
+	static const guchar garbage[] = { 0x00, 0x00, 0x10, 0x00, 0xde, 0xad };
+	FILE *fp;
+
+	server_start ();
+	save_collection ("First");
+	server_stop ();
+
+	server_start ();
+	save_collection ("Second");
+	server_stop ();
+
+	/* a torn write at the end of the journal */
+	fp = g_fopen (journal, "ab");
+	CU_ASSERT_PTR_NOT_NULL_FATAL (fp);
+	fwrite (garbage, 1, sizeof (garbage), fp);
+	fclose (fp);
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("First"));
+	CU_ASSERT_TRUE (has_collection ("Second"));
+	server_stop ();
+
+	/* the damaged journal was folded into a new database */
+	CU_ASSERT_FALSE (g_file_test (journal, G_FILE_TEST_EXISTS));
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("First"));
+	CU_ASSERT_TRUE (has_collection ("Second"));
+	server_stop ();
+}
+
+CASE (test_stale_journal)
+{
+	gchar *stale;
+	gsize length;
+
+	server_start ();
+	save_collection ("First");
+	server_stop ();
+
+	server_start ();
+	save_collection ("Second");
+	server_stop ();
+
+	stale = read_file (journal, &length);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (stale);
+
+	server_start ();
+	remove_collection ("Second");
+	server_stop ();
+
+	/* a journal of an older database must not be replayed */
+	CU_ASSERT_TRUE (g_file_set_contents (journal, stale, length, NULL));
+	g_free (stale);
+
+	server_start ();
+	CU_ASSERT_TRUE (has_collection ("First"));
+	CU_ASSERT_FALSE (has_collection ("Second"));
+	server_stop ();
+}
@@ -0,0 +1,324 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+#include <math.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_converter.h>
+#include <xmmspriv/xmms_streamtype.h>
+#include <xmms/xmms_object.h>
+#include <xmms/xmms_sample.h>
+
+SETUP (converter) {
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+typedef struct {
+	/** Amplitude of the test tone in the output */
+	gdouble amplitude;
+	/** Everything but the test tone, relative to it, in dB */
+	gdouble thdn;
+	/** Output power relative to the input power, in dB */
+	gdouble gain;
+	guint frames;
+} measurement_t;
+
+static xmms_stream_type_t *
+float_mono (gint samplerate)
+{
+	return _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+	                              XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                              XMMS_STREAM_TYPE_FMT_FORMAT, XMMS_SAMPLE_FORMAT_FLOAT,
+	                              XMMS_STREAM_TYPE_FMT_CHANNELS, 1,
+	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE, samplerate,
+	                              XMMS_STREAM_TYPE_END);
+}
+
+static gint
+gcd (gint a, gint b)
+{
+	return b ? gcd (b, a % b) : a;
+}
+
+/* Resample one second of a 0.5 amplitude sine through the converter,
+ * feeding it in chunks like the converter xform does, then fit a sine
+ * at the same frequency to the output and look at what is left. */
+static measurement_t
+measure (xmms_resampler_quality_t quality, gint from, gint to, gint freq)
+{
+	xmms_sample_converter_t *conv;
+	xmms_stream_type_t *in_type, *out_type;
+	measurement_t m = { 0, };
+	GArray *output;
+	gfloat chunk[256];
+	gdouble w, s, c, a, b, dc, fit, res, sig, power;
+	guint i, j, n, start, len, period, outlen;
+	gfloat *out;
+
+	in_type = float_mono (from);
+	out_type = float_mono (to);
+
+	conv = xmms_sample_converter_init_full (in_type, out_type, quality);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (conv);
+
+	output = g_array_new (FALSE, FALSE, sizeof (gfloat));
+
+	for (i = 0; i < from; i += n) {
+		n = MIN (G_N_ELEMENTS (chunk), from - i);
+		for (j = 0; j < n; j++) {
+			chunk[j] = 0.5 * sin (2.0 * M_PI * freq * (i + j) / from);
+		}
+		xmms_sample_convert (conv, chunk, n * sizeof (gfloat),
+		                     (xmms_sample_t **) &out, &outlen);
+		g_array_append_vals (output, out, outlen / sizeof (gfloat));
+	}
+
+	m.frames = output->len;
+	out = (gfloat *) output->data;
+
+	/* skip the filter warmup, and analyse whole periods only */
+	start = 512;
+	period = to / gcd (freq, to);
+	len = output->len - 2 * start;
+	len -= len % period;
+
+	w = 2.0 * M_PI * freq / to;
+	s = c = dc = power = 0.0;
+	for (i = start; i < start + len; i++) {
+		s += out[i] * sin (w * i);
+		c += out[i] * cos (w * i);
+		dc += out[i];
+		power += out[i] * out[i];
+	}
+	a = 2.0 * s / len;
+	b = 2.0 * c / len;
+	dc /= len;
+
+	res = sig = 0.0;
+	for (i = start; i < start + len; i++) {
+		fit = a * sin (w * i) + b * cos (w * i) + dc;
+		res += (out[i] - fit) * (out[i] - fit);
+		sig += fit * fit;
+	}
+
+	m.amplitude = sqrt (a * a + b * b);
+	m.thdn = 10.0 * log10 (MAX (res, 1e-30) / MAX (sig, 1e-30));
+	m.gain = 10.0 * log10 (MAX (power / len, 1e-30) / (0.5 * 0.5 / 2.0));
+
+	g_array_free (output, TRUE);
+	xmms_object_unref (conv);
+	xmms_object_unref (in_type);
+	xmms_object_unref (out_type);
+
+	return m;
+}
+
+CASE (test_frame_count)
+{
+	measurement_t m;
+
+	m = measure (XMMS_RESAMPLER_QUALITY_LINEAR, 44100, 48000, 1000);
+	CU_ASSERT_TRUE (ABS ((gint) m.frames - 48000) < 64);
+
+	m = measure (XMMS_RESAMPLER_QUALITY_HIGH, 44100, 48000, 1000);
+	CU_ASSERT_TRUE (ABS ((gint) m.frames - 48000) < 64);
+
+	m = measure (XMMS_RESAMPLER_QUALITY_HIGH, 192000, 48000, 1000);
+	CU_ASSERT_TRUE (ABS ((gint) m.frames - 48000) < 64);
+}
+
+CASE (test_passband_gain)
+{
+	xmms_resampler_quality_t q;
+	measurement_t m;
+
+	for (q = XMMS_RESAMPLER_QUALITY_LOW; q <= XMMS_RESAMPLER_QUALITY_HIGH; q++) {
+		m = measure (q, 44100, 48000, 1000);
+		CU_ASSERT_DOUBLE_EQUAL (0.5, m.amplitude, 0.005);
+
+		m = measure (q, 192000, 48000, 1000);
+		CU_ASSERT_DOUBLE_EQUAL (0.5, m.amplitude, 0.005);
+	}
+}
+
+CASE (test_thdn)
+{
+	measurement_t linear, low, medium, high;
+
+	linear = measure (XMMS_RESAMPLER_QUALITY_LINEAR, 44100, 48000, 5000);
+	low = measure (XMMS_RESAMPLER_QUALITY_LOW, 44100, 48000, 5000);
+	medium = measure (XMMS_RESAMPLER_QUALITY_MEDIUM, 44100, 48000, 5000);
+	high = measure (XMMS_RESAMPLER_QUALITY_HIGH, 44100, 48000, 5000);
+
+	CU_ASSERT_TRUE (low.thdn < linear.thdn);
+	CU_ASSERT_TRUE (medium.thdn < low.thdn);
+	CU_ASSERT_TRUE (high.thdn < medium.thdn);
+
+	CU_ASSERT_TRUE (low.thdn < -55.0);
+	CU_ASSERT_TRUE (medium.thdn < -75.0);
+	CU_ASSERT_TRUE (high.thdn < -100.0);
+}
+
+CASE (test_aliasing)
+{
+	measurement_t linear, low, medium, high;
+
+	/* 30kHz does not fit in 44.1kHz and must be filtered out,
+	 * not folded back to 14.1kHz */
+	linear = measure (XMMS_RESAMPLER_QUALITY_LINEAR, 96000, 44100, 30000);
+	low = measure (XMMS_RESAMPLER_QUALITY_LOW, 96000, 44100, 30000);
+	medium = measure (XMMS_RESAMPLER_QUALITY_MEDIUM, 96000, 44100, 30000);
+	high = measure (XMMS_RESAMPLER_QUALITY_HIGH, 96000, 44100, 30000);
+
+	CU_ASSERT_TRUE (linear.gain > -20.0);
+	CU_ASSERT_TRUE (low.gain < -50.0);
+	CU_ASSERT_TRUE (medium.gain < -70.0);
+	CU_ASSERT_TRUE (high.gain < -100.0);
+}
+
+/* The READ and WRITE macros of the generated converters */
+static guint32
+reference_read (xmms_sample_format_t format, gconstpointer buf, guint i)
+{
+	switch (format) {
+		case XMMS_SAMPLE_FORMAT_S16:
+			return ((guint32) (((const gint16 *) buf)[i] + 32768)) << 16;
+		case XMMS_SAMPLE_FORMAT_S32:
+			return (guint32) (((const gint32 *) buf)[i] + 2147483648UL);
+		default:
+			return (((const gfloat *) buf)[i] + 1.0) * 2147483648UL;
+	}
+}
+
+static void
+reference_write (xmms_sample_format_t format, gpointer buf, guint i, guint32 a)
+{
+	switch (format) {
+		case XMMS_SAMPLE_FORMAT_S16:
+			((gint16 *) buf)[i] = (a >> 16) - 32768;
+			break;
+		case XMMS_SAMPLE_FORMAT_S32:
+			((gint32 *) buf)[i] = a - 2147483648UL;
+			break;
+		default:
+			((gfloat *) buf)[i] = a / 2147483648.0 - 1.0;
+			break;
+	}
+}
+
+static void
+reference_convert (xmms_sample_format_t informat, guint inchannels,
+                   gconstpointer in, xmms_sample_format_t outformat,
+                   guint outchannels, gpointer out, guint frames)
+{
+	guint32 a, b;
+	guint i, c;
+
+	for (i = 0; i < frames; i++) {
+		if (inchannels == outchannels) {
+			for (c = 0; c < inchannels; c++) {
+				a = reference_read (informat, in, i * inchannels + c);
+				reference_write (outformat, out, i * outchannels + c, a);
+			}
+		} else if (inchannels == 1) {
+			a = reference_read (informat, in, i);
+			reference_write (outformat, out, 2 * i, a);
+			reference_write (outformat, out, 2 * i + 1, a);
+		} else {
+			a = reference_read (informat, in, 2 * i);
+			b = reference_read (informat, in, 2 * i + 1);
+			reference_write (outformat, out, i, ((guint64) a + b) / 2);
+		}
+	}
+}
+
+static xmms_stream_type_t *
+pcm (xmms_sample_format_t format, gint channels)
+{
+	return _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+	                              XMMS_STREAM_TYPE_MIMETYPE, "audio/pcm",
+	                              XMMS_STREAM_TYPE_FMT_FORMAT, format,
+	                              XMMS_STREAM_TYPE_FMT_CHANNELS, channels,
+	                              XMMS_STREAM_TYPE_FMT_SAMPLERATE, 44100,
+	                              XMMS_STREAM_TYPE_END);
+}
+
+CASE (test_bit_exact)
+{
+	xmms_sample_format_t formats[] = {
+		XMMS_SAMPLE_FORMAT_S16, XMMS_SAMPLE_FORMAT_S32, XMMS_SAMPLE_FORMAT_FLOAT
+	};
+	gfloat edges[] = { -1.0, -0.5, -1e-10, 0.0, 1e-10, 0.5, 0.99999994 };
+	guint8 in[4 * 2 * 67], expected[4 * 2 * 67];
+	xmms_stream_type_t *from, *to;
+	xmms_sample_converter_t *conv;
+	guint fi, fo, ci, co, frames, i, outlen;
+	GRand *rand;
+	gpointer out;
+
+	rand = g_rand_new_with_seed (0x5eed);
+
+	for (fi = 0; fi < G_N_ELEMENTS (formats); fi++)
+	for (fo = 0; fo < G_N_ELEMENTS (formats); fo++)
+	for (ci = 1; ci <= 2; ci++)
+	for (co = 1; co <= 2; co++) {
+		from = pcm (formats[fi], ci);
+		to = pcm (formats[fo], co);
+		conv = xmms_sample_converter_init (from, to);
+		CU_ASSERT_PTR_NOT_NULL_FATAL (conv);
+
+		/* odd lengths to cover the tail of the vector loops */
+		for (frames = 1; frames <= 67; frames += 11) {
+			for (i = 0; i < frames * ci; i++) {
+				switch (formats[fi]) {
+					case XMMS_SAMPLE_FORMAT_S16:
+						((gint16 *) in)[i] = g_rand_int (rand);
+						break;
+					case XMMS_SAMPLE_FORMAT_S32:
+						((gint32 *) in)[i] = g_rand_int (rand);
+						break;
+					default:
+						((gfloat *) in)[i] = i < G_N_ELEMENTS (edges)
+						                     ? edges[i]
+						                     : g_rand_double_range (rand, -1.0, 1.0);
+						break;
+				}
+			}
+
+			reference_convert (formats[fi], ci, in, formats[fo], co,
+			                   expected, frames);
+			xmms_sample_convert (conv, in,
+			                     frames * ci * xmms_sample_size_get (formats[fi]),
+			                     (xmms_sample_t **) &out, &outlen);
+
+			CU_ASSERT_EQUAL (frames * co * xmms_sample_size_get (formats[fo]), outlen);
+			CU_ASSERT_EQUAL (0, memcmp (expected, out, outlen));
+		}
+
+		xmms_object_unref (conv);
+		xmms_object_unref (from);
+		xmms_object_unref (to);
+	}
+
+	g_rand_free (rand);
+}
@@ -0,0 +1,303 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_plugin.h>
+#include <xmmspriv/xmms_xform.h>
+#include <xmmspriv/xmms_xform_object.h>
+#include <xmmspriv/xmms_config.h>
+#include <xmmspriv/xmms_log.h>
+#include <xmmspriv/xmms_ipc.h>
+#include <xmmspriv/xmms_medialib.h>
+
+#include "server-utils/http_server.h"
+
+/* Not a multiple of any read or buffer size */
+#define BLOB_SIZE (3 * 1024 * 1024 + 17)
+
+static xmms_medialib_t *medialib;
+static xmms_xform_object_t *xform_object;
+static guchar *blob;
+
+SETUP (curl_http)
+{
+	gint i;
+
+	xmms_ipc_init ();
+	xmms_log_init (0);
+
+	xmms_config_init ("memory://");
+	xmms_config_property_register ("medialib.path", "memory://", NULL, NULL);
+
+	xform_object = xmms_xform_object_init ();
+	medialib = xmms_medialib_init ();
+
+	xmms_plugin_init (CURL_PLUGIN_PATH);
+
+	blob = g_malloc (BLOB_SIZE);
+	for (i = 0; i < BLOB_SIZE; i++) {
+		blob[i] = (i * 2654435761u) >> 13;
+	}
+
+	return 1;
+}
+
+CLEANUP ()
+{
+	g_free (blob); blob = NULL;
+	xmms_plugin_shutdown ();
+	xmms_object_unref (medialib); medialib = NULL;
+	xmms_object_unref (xform_object); xform_object = NULL;
+	xmms_config_shutdown ();
+	xmms_ipc_shutdown ();
+
+	return 0;
+}
+
+/* Set up a chain that ends with the curl transport */
+static xmms_xform_t *
+curl_open (xmms_http_server_t *server)
+{
+	xmms_medialib_session_t *session;
+	xmms_stream_type_t *format;
+	xmms_xform_t *xform;
+	GList *goal_format;
+	gchar *url;
+
+	format = _xmms_stream_type_new (XMMS_STREAM_TYPE_BEGIN,
+	                                XMMS_STREAM_TYPE_MIMETYPE,
+	                                "application/octet-stream",
+	                                XMMS_STREAM_TYPE_END);
+	goal_format = g_list_prepend (NULL, format);
+
+	url = xmms_http_server_url (server, "blob.bin");
+
+	session = xmms_medialib_session_begin (medialib);
+	xform = xmms_xform_chain_setup_url_session (medialib, session, 1, url,
+	                                            goal_format, TRUE);
+	xmms_medialib_session_abort (session);
+
+	g_free (url);
+	g_list_free (goal_format);
+	xmms_object_unref (format);
+
+	return xform;
+}
+
+/* Read len bytes at the current position and compare them to the blob */
+static gboolean
+curl_check (xmms_xform_t *xform, gint64 pos, gint len)
+{
+	xmms_error_t err;
+	gpointer buf;
+	gint ret;
+
+	xmms_error_reset (&err);
+
+	len = MIN (len, BLOB_SIZE - pos);
+	buf = g_malloc (len);
+
+	ret = xmms_xform_this_read (xform, buf, len, &err);
+	ret = ret == len && memcmp (buf, blob + pos, len) == 0;
+
+	g_free (buf);
+
+	return ret;
+}
+
+static gint64
+curl_seek (xmms_xform_t *xform, gint64 offset, xmms_xform_seek_mode_t whence)
+{
+	xmms_error_t err;
+
+	xmms_error_reset (&err);
+
+	return xmms_xform_this_seek (xform, offset, whence, &err);
+}
+
+CASE (test_curl_read)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+	xmms_error_t err;
+	gint64 pos;
+	gchar c;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, TRUE);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	for (pos = 0; pos < BLOB_SIZE; pos += 4093) {
+		CU_ASSERT_TRUE_FATAL (curl_check (xform, pos, 4093));
+	}
+
+	xmms_error_reset (&err);
+	CU_ASSERT_EQUAL (0, xmms_xform_this_read (xform, &c, 1, &err));
+	CU_ASSERT_EQUAL (1, xmms_http_server_requests (server));
+
+	xmms_object_unref (xform);
+	xmms_http_server_free (server);
+}
+
+CASE (test_curl_seek_buffered)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, TRUE);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	/* a short skip ahead is served from the read buffer */
+	CU_ASSERT_TRUE (curl_check (xform, 0, 1000));
+	CU_ASSERT_EQUAL (1100, curl_seek (xform, 100, XMMS_XFORM_SEEK_CUR));
+	CU_ASSERT_TRUE (curl_check (xform, 1100, 1000));
+	CU_ASSERT_EQUAL (1, xmms_http_server_requests (server));
+
+	xmms_object_unref (xform);
+	xmms_http_server_free (server);
+}
+
+CASE (test_curl_seek_tail)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, TRUE);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	/* what an ID3v1 probe does */
+	CU_ASSERT_EQUAL (BLOB_SIZE - 128, curl_seek (xform, -128, XMMS_XFORM_SEEK_END));
+	CU_ASSERT_TRUE (curl_check (xform, BLOB_SIZE - 128, 128));
+
+	CU_ASSERT_EQUAL (0, curl_seek (xform, 0, XMMS_XFORM_SEEK_SET));
+	CU_ASSERT_TRUE (curl_check (xform, 0, 65536));
+
+	/* the completed tail request leaves its connection for the next one */
+	CU_ASSERT_EQUAL (3, xmms_http_server_requests (server));
+	CU_ASSERT_EQUAL (2, xmms_http_server_connections (server));
+
+	xmms_object_unref (xform);
+	xmms_http_server_free (server);
+}
+
+CASE (test_curl_seek_random)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+	GRand *rand;
+	gint i;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, TRUE);
+	rand = g_rand_new_with_seed (1234);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	for (i = 0; i < 64; i++) {
+		gint64 pos = g_rand_int_range (rand, 0, BLOB_SIZE);
+
+		CU_ASSERT_EQUAL_FATAL (pos, curl_seek (xform, pos, XMMS_XFORM_SEEK_SET));
+		CU_ASSERT_TRUE_FATAL (curl_check (xform, pos, 1 + i * 997));
+	}
+
+	xmms_object_unref (xform);
+	g_rand_free (rand);
+	xmms_http_server_free (server);
+}
+
+CASE (test_curl_seek_without_ranges)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, FALSE);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	/* the server sends it all, the part before the offset is skipped */
+	CU_ASSERT_EQUAL (BLOB_SIZE / 2, curl_seek (xform, BLOB_SIZE / 2, XMMS_XFORM_SEEK_SET));
+	CU_ASSERT_TRUE (curl_check (xform, BLOB_SIZE / 2, 65536));
+
+	CU_ASSERT_EQUAL (0, curl_seek (xform, 0, XMMS_XFORM_SEEK_SET));
+	CU_ASSERT_TRUE (curl_check (xform, 0, 65536));
+
+	xmms_object_unref (xform);
+	xmms_http_server_free (server);
+}
+
+CASE (test_curl_seek_out_of_range)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, TRUE);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+
+	CU_ASSERT_EQUAL (-1, curl_seek (xform, BLOB_SIZE + 1, XMMS_XFORM_SEEK_SET));
+	CU_ASSERT_EQUAL (-1, curl_seek (xform, -1, XMMS_XFORM_SEEK_SET));
+
+	/* a failed seek leaves the stream where it was */
+	CU_ASSERT_TRUE (curl_check (xform, 0, 4096));
+
+	xmms_object_unref (xform);
+	xmms_http_server_free (server);
+}
+
+CASE (test_curl_seek_failed_range)
+{
+	xmms_http_server_t *server;
+	xmms_xform_t *xform;
+	xmms_error_t err;
+	gchar c;
+
+	server = xmms_http_server_new (blob, BLOB_SIZE, TRUE);
+
+	xform = curl_open (server);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (xform);
+	CU_ASSERT_TRUE (curl_check (xform, 0, 4096));
+
+	/* a refused range fails the seek, rather than ending the stream */
+	xmms_http_server_fail_ranges (server, 416);
+	CU_ASSERT_EQUAL (-1, curl_seek (xform, BLOB_SIZE / 2, XMMS_XFORM_SEEK_SET));
+
+	/* the stream can be sought again once the server recovers */
+	xmms_http_server_fail_ranges (server, 0);
+	CU_ASSERT_EQUAL (BLOB_SIZE / 4, curl_seek (xform, BLOB_SIZE / 4, XMMS_XFORM_SEEK_SET));
+	CU_ASSERT_TRUE (curl_check (xform, BLOB_SIZE / 4, 4096));
+
+	/* reading after a failed seek is an error, not the end */
+	xmms_http_server_fail_ranges (server, 500);
+	CU_ASSERT_EQUAL (-1, curl_seek (xform, BLOB_SIZE / 3, XMMS_XFORM_SEEK_SET));
+
+	xmms_error_reset (&err);
+	CU_ASSERT_EQUAL (-1, xmms_xform_this_read (xform, &c, 1, &err));
+	CU_ASSERT_TRUE (xmms_error_iserror (&err));
+
+	xmms_object_unref (xform);
+	xmms_http_server_free (server);
+}
@@ -30,6 +30,13 @@
 		CU_ASSERT_EQUAL (expected, val); \
 	} while (0);
 
+#define CU_ASSERT_LIST_STRING_EQUAL(list, pos, expected) do { \
+		const gchar *val = NULL; \
+		CU_ASSERT_EQUAL (XMMSV_TYPE_LIST, xmmsv_get_type (list)) \
+		xmmsv_list_get_string (list, pos, &val); \
+		CU_ASSERT_STRING_EQUAL (expected, val); \
+	} while (0);
+
 static xmms_medialib_t *medialib;
 
 SETUP (mlib) {
@@ -454,6 +461,30 @@ CASE (test_cluster_dict_and_list_fetch_spec)
 	xmmsv_unref (universe);
 }
 
+CASE (test_metadata_list_unrestricted)
+{
+	xmmsv_t *universe, *spec, *result;
+	xmmsv_type_t type;
+	xmms_error_t err;
+
+	xmms_mock_entry (medialib, 1, "Red Fang", "Red Fang", "Prehistoric Dog");
+	xmms_mock_entry (medialib, 2, "Red Fang", "Red Fang", "Reverse Thunder");
+
+	universe = xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE);
+
+	/* lists of integers are sent to clients without a type restriction */
+	spec = xmmsv_from_xson ("{ 'type': 'metadata', 'get': ['id'], 'aggregate': 'list' }");
+	result = medialib_query (universe, spec, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_EQUAL (2, xmmsv_list_get_size (result));
+	CU_ASSERT_TRUE (xmmsv_list_get_type (result, &type));
+	CU_ASSERT_EQUAL (XMMSV_TYPE_NONE, type);
+	xmmsv_unref (spec);
+	xmmsv_unref (result);
+
+	xmmsv_unref (universe);
+}
+
 CASE (test_organize_fetch_spec)
 {
 	xmmsv_t *universe, *spec, *result;
@@ -852,3 +883,202 @@ CASE (test_session_locking)
 
 	CU_ASSERT_NOT_EQUAL (status, new_status);
 }
+
+static gint
+query_stats_get_int (const gchar *key)
+{
+	xmmsv_t *stats;
+	gint value = -1;
+
+	stats = XMMS_IPC_CALL (medialib, XMMS_IPC_COMMAND_MEDIALIB_GET_QUERY_STATS, NULL);
+	CU_ASSERT (xmmsv_is_type (stats, XMMSV_TYPE_DICT));
+	xmmsv_dict_entry_get_int (stats, key, &value);
+	xmmsv_unref (stats);
+
+	return value;
+}
+
+CASE (test_query_plan_cache)
+{
+	xmmsv_t *universe, *match, *ordered, *filtered, *spec, *result;
+	xmms_error_t err;
+	gint hits, misses;
+
+	xmms_mock_entry (medialib, 2, "Red Fang", "Red Fang", "Reverse Thunder");
+	xmms_mock_entry (medialib, 1, "Red Fang", "Red Fang", "Prehistoric Dog");
+	xmms_mock_entry (medialib, 1, "Vibrasphere", "Lungs of the Earth", "Decade");
+
+	xmms_error_reset (&err);
+
+	universe = xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE);
+	spec = xmmsv_from_xson ("{ 'type': 'metadata', 'get': ['value'], 'fields': ['title'] }");
+
+	/* match (order (universe)) */
+	ordered = xmmsv_new_coll (XMMS_COLLECTION_TYPE_ORDER);
+	xmmsv_coll_attribute_set_string (ordered, "field", "tracknr");
+	xmmsv_coll_add_operand (ordered, universe);
+
+	match = xmmsv_new_coll (XMMS_COLLECTION_TYPE_MATCH);
+	xmmsv_coll_attribute_set_string (match, "field", "artist");
+	xmmsv_coll_attribute_set_string (match, "value", "Red Fang");
+	xmmsv_coll_add_operand (match, ordered);
+	xmmsv_unref (ordered);
+
+	misses = query_stats_get_int ("misses");
+	hits = query_stats_get_int ("hits");
+
+	result = medialib_query (match, spec, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_EQUAL (2, xmmsv_list_get_size (result));
+	xmmsv_unref (result);
+
+	CU_ASSERT_EQUAL (misses + 1, query_stats_get_int ("misses"));
+	CU_ASSERT_EQUAL (hits, query_stats_get_int ("hits"));
+
+	/* order (match (universe)) normalizes to the same plan */
+	filtered = xmmsv_new_coll (XMMS_COLLECTION_TYPE_MATCH);
+	xmmsv_coll_attribute_set_string (filtered, "field", "artist");
+	xmmsv_coll_attribute_set_string (filtered, "value", "Red Fang");
+	xmmsv_coll_add_operand (filtered, universe);
+
+	ordered = xmmsv_new_coll (XMMS_COLLECTION_TYPE_ORDER);
+	xmmsv_coll_attribute_set_string (ordered, "field", "tracknr");
+	xmmsv_coll_add_operand (ordered, filtered);
+	xmmsv_unref (filtered);
+
+	result = medialib_query (ordered, spec, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_LIST_STRING_EQUAL (result, 0, "Prehistoric Dog");
+	CU_ASSERT_LIST_STRING_EQUAL (result, 1, "Reverse Thunder");
+	xmmsv_unref (result);
+
+	CU_ASSERT_EQUAL (misses + 1, query_stats_get_int ("misses"));
+	CU_ASSERT_EQUAL (hits + 1, query_stats_get_int ("hits"));
+	CU_ASSERT_EQUAL (1, query_stats_get_int ("size"));
+
+	/* new entries must be visible through the cached plan */
+	xmms_mock_entry (medialib, 3, "Red Fang", "Murder the Mountains", "Wires");
+
+	result = medialib_query (match, spec, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_EQUAL (3, xmmsv_list_get_size (result));
+	CU_ASSERT_LIST_STRING_EQUAL (result, 2, "Wires");
+	xmmsv_unref (result);
+
+	xmmsv_unref (ordered);
+	xmmsv_unref (match);
+	xmmsv_unref (universe);
+	xmmsv_unref (spec);
+}
+
+CASE (test_query_plan_random_limit)
+{
+	xmmsv_t *universe, *ordered, *limit, *spec, *first, *second;
+	xmms_error_t err;
+	gchar title[32];
+	gint i, uncached;
+
+	for (i = 0; i < 64; i++) {
+		g_snprintf (title, sizeof (title), "Track %d", i);
+		xmms_mock_entry (medialib, i + 1, "Red Fang", "Red Fang", title);
+	}
+
+	xmms_error_reset (&err);
+
+	spec = xmmsv_from_xson ("{ 'type': 'metadata', 'get': ['id'] }");
+
+	/* limit (order random (universe)), eight random tracks */
+	universe = xmmsv_new_coll (XMMS_COLLECTION_TYPE_UNIVERSE);
+
+	ordered = xmmsv_new_coll (XMMS_COLLECTION_TYPE_ORDER);
+	xmmsv_coll_attribute_set_string (ordered, "type", "random");
+	xmmsv_coll_add_operand (ordered, universe);
+	xmmsv_unref (universe);
+
+	limit = xmmsv_new_coll (XMMS_COLLECTION_TYPE_LIMIT);
+	xmmsv_coll_attribute_set_int (limit, "length", 8);
+	xmmsv_coll_add_operand (limit, ordered);
+	xmmsv_unref (ordered);
+
+	uncached = query_stats_get_int ("uncached");
+
+	first = medialib_query (limit, spec, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_EQUAL (8, xmmsv_list_get_size (first));
+
+	/* the same query picks again rather than reusing a plan */
+	second = medialib_query (limit, spec, &err);
+	CU_ASSERT_FALSE (xmms_error_iserror (&err));
+	CU_ASSERT_EQUAL (8, xmmsv_list_get_size (second));
+	CU_ASSERT_FALSE (xmmsv_compare (first, second));
+
+	CU_ASSERT_EQUAL (uncached + 2, query_stats_get_int ("uncached"));
+	CU_ASSERT_EQUAL (0, query_stats_get_int ("size"));
+
+	xmmsv_unref (first);
+	xmmsv_unref (second);
+	xmmsv_unref (limit);
+	xmmsv_unref (spec);
+}
+
+CASE (test_add_encoded_batch)
+{
+	const gchar *urls[] = {
+		"file:///one.mp3",
+		"file:///two.mp3",
+		"file:///one.mp3",
+		"file:///three.mp3"
+	};
+	xmms_medialib_session_t *session;
+	xmmsv_t *entries, *list;
+
+	entries = xmmsv_new_coll (XMMS_COLLECTION_TYPE_IDLIST);
+
+	/* duplicates are only added once, but listed every time */
+	CU_ASSERT_EQUAL (3, xmms_medialib_add_encoded_batch (medialib, urls, 4, entries));
+
+	list = xmmsv_coll_idlist_get (entries);
+	CU_ASSERT_EQUAL (4, xmmsv_list_get_size (list));
+	CU_ASSERT_LIST_INT_EQUAL (list, 0, 1);
+	CU_ASSERT_LIST_INT_EQUAL (list, 1, 2);
+	CU_ASSERT_LIST_INT_EQUAL (list, 2, 1);
+	CU_ASSERT_LIST_INT_EQUAL (list, 3, 3);
+
+	xmmsv_unref (entries);
+
+	CU_ASSERT_EQUAL (0, xmms_medialib_add_encoded_batch (medialib, urls, 4, NULL));
+
+	session = xmms_medialib_session_begin (medialib);
+	CU_ASSERT_TRUE (xmms_medialib_check_id (session, 3));
+	CU_ASSERT_FALSE (xmms_medialib_check_id (session, 4));
+	xmms_medialib_session_abort (session);
+}
+
+CASE (test_client_import_async)
+{
+	xmmsv_t *result;
+	gint job;
+
+	result = XMMS_IPC_CALL (medialib, XMMS_IPC_COMMAND_MEDIALIB_IMPORT_CANCEL, xmmsv_new_int (1337));
+	CU_ASSERT (xmmsv_is_type (result, XMMSV_TYPE_ERROR));
+	xmmsv_unref (result);
+
+	result = XMMS_IPC_CALL (medialib, XMMS_IPC_COMMAND_MEDIALIB_IMPORT_PATH_ASYNC,
+	                        xmmsv_new_string ("file:///nonexistent"));
+	CU_ASSERT (xmmsv_is_type (result, XMMSV_TYPE_INT32));
+	CU_ASSERT (xmmsv_get_int (result, &job));
+	CU_ASSERT (job > 0);
+	xmmsv_unref (result);
+
+	/* waits for the job, and refuses new ones */
+	xmms_medialib_cancel_imports (medialib);
+
+	result = XMMS_IPC_CALL (medialib, XMMS_IPC_COMMAND_MEDIALIB_IMPORT_CANCEL, xmmsv_new_int (job));
+	CU_ASSERT (xmmsv_is_type (result, XMMSV_TYPE_ERROR));
+	xmmsv_unref (result);
+
+	result = XMMS_IPC_CALL (medialib, XMMS_IPC_COMMAND_MEDIALIB_IMPORT_PATH_ASYNC,
+	                        xmmsv_new_string ("file:///nonexistent"));
+	CU_ASSERT (xmmsv_is_type (result, XMMSV_TYPE_ERROR));
+	xmmsv_unref (result);
+}
@@ -0,0 +1,308 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_playlist_changelog.h>
+#include <xmmsc/xmmsc_idnumbers.h>
+#include <xmmsc/xmmsv.h>
+
+static xmms_playlist_changelog_t *changelog;
+static xmmsv_t *playlist;
+
+SETUP (playlist_changelog) {
+	changelog = xmms_playlist_changelog_new (1024);
+	playlist = xmmsv_new_coll (XMMS_COLLECTION_TYPE_IDLIST);
+	return 0;
+}
+
+CLEANUP () {
+	xmmsv_unref (playlist);
+	xmms_playlist_changelog_free (changelog);
+	return 0;
+}
+
+static gint64
+append (gint id)
+{
+	gint pos = xmmsv_coll_idlist_get_size (playlist);
+
+	xmmsv_coll_idlist_append (playlist, id);
+	return xmms_playlist_changelog_insert (changelog, "pl", playlist, pos, 1);
+}
+
+static gint64
+remove_at (gint pos)
+{
+	xmmsv_coll_idlist_remove (playlist, pos);
+	return xmms_playlist_changelog_remove (changelog, "pl", playlist, pos, 1);
+}
+
+static gint64
+replace (const gint32 *ids, gint len)
+{
+	gint32 *old_ids;
+	gint64 generation;
+	gint old_len, i;
+
+	old_len = xmmsv_coll_idlist_get_size (playlist);
+	old_ids = g_new (gint32, old_len);
+	for (i = 0; i < old_len; i++) {
+		xmmsv_coll_idlist_get_index_int32 (playlist, i, &old_ids[i]);
+	}
+
+	xmmsv_coll_idlist_clear (playlist);
+	for (i = 0; i < len; i++) {
+		xmmsv_coll_idlist_append (playlist, ids[i]);
+	}
+
+	generation = xmms_playlist_changelog_replace (changelog, "pl", playlist,
+	                                              old_ids, old_len);
+	g_free (old_ids);
+
+	return generation;
+}
+
+static GArray *
+snapshot (void)
+{
+	GArray *ids;
+	gint32 id;
+	gint i;
+
+	ids = g_array_new (FALSE, FALSE, sizeof (gint32));
+	for (i = 0; i < xmmsv_coll_idlist_get_size (playlist); i++) {
+		xmmsv_coll_idlist_get_index_int32 (playlist, i, &id);
+		g_array_append_val (ids, id);
+	}
+
+	return ids;
+}
+
+/* Apply the changes the way a client would */
+static void
+replay (GArray *ids, xmmsv_t *changes)
+{
+	xmmsv_t *change, *list;
+	gint32 type, pos, count, newpos, id, src, len;
+	gint i, j;
+
+	for (i = 0; xmmsv_list_get (changes, i, &change); i++) {
+		CU_ASSERT_TRUE (xmmsv_dict_entry_get_int32 (change, "type", &type));
+		CU_ASSERT_TRUE (xmmsv_dict_entry_get_int32 (change, "position", &pos));
+
+		switch (type) {
+			case XMMS_PLAYLIST_CHANGED_INSERT:
+				CU_ASSERT_TRUE (xmmsv_dict_get (change, "ids", &list));
+				for (j = 0; xmmsv_list_get_int32 (list, j, &id); j++) {
+					g_array_insert_val (ids, pos + j, id);
+				}
+				break;
+			case XMMS_PLAYLIST_CHANGED_REMOVE:
+				CU_ASSERT_TRUE (xmmsv_dict_entry_get_int32 (change, "count", &count));
+				g_array_remove_range (ids, pos, count);
+				break;
+			case XMMS_PLAYLIST_CHANGED_MOVE:
+				CU_ASSERT_TRUE (xmmsv_dict_entry_get_int32 (change, "newposition", &newpos));
+				id = g_array_index (ids, gint32, pos);
+				g_array_remove_index (ids, pos);
+				g_array_insert_val (ids, newpos, id);
+				break;
+			case XMMS_PLAYLIST_CHANGED_SORT: {
+				GArray *old = g_array_new (FALSE, FALSE, sizeof (gint32));
+
+				g_array_append_vals (old, ids->data, ids->len);
+				CU_ASSERT_TRUE (xmmsv_dict_entry_get_int32 (change, "count", &count));
+				CU_ASSERT_TRUE (xmmsv_dict_get (change, "runs", &list));
+				for (j = 0; xmmsv_list_get_int32 (list, j, &src); j += 2) {
+					CU_ASSERT_TRUE (xmmsv_list_get_int32 (list, j + 1, &len));
+					memcpy (&g_array_index (ids, gint32, pos), &g_array_index (old, gint32, src),
+					        len * sizeof (gint32));
+					pos += len;
+					count -= len;
+				}
+				CU_ASSERT_EQUAL (0, count);
+				g_array_free (old, TRUE);
+				break;
+			}
+			default:
+				CU_FAIL ("unexpected change type");
+				break;
+		}
+	}
+}
+
+static void
+assert_replays (GArray *before, gint64 generation, gint expected_changes)
+{
+	xmmsv_t *delta, *changes;
+	GArray *after;
+	gint64 current;
+
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, generation);
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int64 (delta, "generation", &current));
+	CU_ASSERT_TRUE (xmmsv_dict_get (delta, "changes", &changes));
+	CU_ASSERT_EQUAL (expected_changes, xmmsv_list_get_size (changes));
+
+	replay (before, changes);
+
+	after = snapshot ();
+	CU_ASSERT_EQUAL (after->len, before->len);
+	CU_ASSERT_EQUAL (0, memcmp (after->data, before->data, after->len * sizeof (gint32)));
+	g_array_free (after, TRUE);
+
+	xmmsv_unref (delta);
+}
+
+CASE (test_unit_inserts_and_removes_are_merged)
+{
+	GArray *before;
+	gint64 start, mid, gen;
+	gint i;
+
+	start = append (1);
+	for (i = 2; i <= 10; i++) {
+		gen = append (i);
+		CU_ASSERT_EQUAL (start + i - 1, gen);
+	}
+
+	/* one merged insert, served from the middle */
+	before = g_array_new (FALSE, FALSE, sizeof (gint32));
+	for (i = 1; i <= 5; i++) {
+		g_array_append_val (before, i);
+	}
+	assert_replays (before, start + 4, 1);
+	g_array_free (before, TRUE);
+
+	/* one merged removal at the head, like the queue updater does */
+	before = snapshot ();
+	mid = gen;
+	for (i = 0; i < 4; i++) {
+		gen = remove_at (0);
+	}
+	CU_ASSERT_EQUAL (mid + 4, gen);
+	assert_replays (before, mid, 1);
+	g_array_free (before, TRUE);
+
+	before = snapshot ();
+	assert_replays (before, gen, 0);
+	g_array_free (before, TRUE);
+}
+
+CASE (test_replace_as_permutation)
+{
+	gint32 ids[64], shuffled[64];
+	xmmsv_t *delta, *changes, *change;
+	GArray *before;
+	gint64 gen;
+	gint32 type;
+	gint i;
+
+	for (i = 0; i < 64; i++) {
+		ids[i] = i + 1;
+	}
+	replace (ids, 64);
+
+	/* move a block of 16 entries towards the end */
+	for (i = 0; i < 64; i++) {
+		shuffled[i] = ids[i];
+	}
+	memmove (shuffled + 8, ids + 24, 32 * sizeof (gint32));
+	memcpy (shuffled + 40, ids + 8, 16 * sizeof (gint32));
+
+	before = snapshot ();
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, 0);
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int64 (delta, "generation", &gen));
+	xmmsv_unref (delta);
+
+	replace (shuffled, 64);
+
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, gen);
+	CU_ASSERT_TRUE (xmmsv_dict_get (delta, "changes", &changes));
+	CU_ASSERT_TRUE (xmmsv_list_get (changes, 0, &change));
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int32 (change, "type", &type));
+	CU_ASSERT_EQUAL (XMMS_PLAYLIST_CHANGED_SORT, type);
+	xmmsv_unref (delta);
+
+	assert_replays (before, gen, 1);
+	g_array_free (before, TRUE);
+
+	/* unrelated contents end up as a removal and an insertion */
+	before = snapshot ();
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, 0);
+	CU_ASSERT_TRUE (xmmsv_dict_entry_get_int64 (delta, "generation", &gen));
+	xmmsv_unref (delta);
+
+	for (i = 0; i < 64; i++) {
+		shuffled[i] = 1000 + i;
+	}
+	replace (shuffled, 32);
+
+	assert_replays (before, gen, 2);
+	g_array_free (before, TRUE);
+}
+
+CASE (test_falls_back_to_entries)
+{
+	xmmsv_t *delta, *entries;
+	gint64 start, gen;
+	gint i;
+
+	xmms_playlist_changelog_set_max_weight (changelog, 16);
+
+	start = append (1);
+	for (i = 0; i < 32; i++) {
+		append (2);
+		gen = remove_at (0);
+	}
+
+	/* too old, and from the future */
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, start);
+	CU_ASSERT_FALSE (xmmsv_dict_has_key (delta, "changes"));
+	CU_ASSERT_TRUE (xmmsv_dict_get (delta, "entries", &entries));
+	CU_ASSERT_EQUAL (1, xmmsv_list_get_size (entries));
+	xmmsv_unref (delta);
+
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, gen + 1);
+	CU_ASSERT_TRUE (xmmsv_dict_has_key (delta, "entries"));
+	xmmsv_unref (delta);
+
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, gen - 2);
+	CU_ASSERT_TRUE (xmmsv_dict_has_key (delta, "changes"));
+	xmmsv_unref (delta);
+}
+
+CASE (test_outside_modification_restarts_history)
+{
+	xmmsv_t *delta;
+	gint64 gen, restarted;
+
+	gen = append (1);
+	append (2);
+
+	/* behind the change log's back */
+	xmmsv_coll_idlist_append (playlist, 3);
+
+	restarted = append (4);
+	CU_ASSERT_TRUE (restarted > gen + 2);
+
+	delta = xmms_playlist_changelog_since (changelog, "pl", playlist, gen);
+	CU_ASSERT_TRUE (xmmsv_dict_has_key (delta, "entries"));
+	xmmsv_unref (delta);
+}
@@ -0,0 +1,310 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+#include <string.h>
+
+#include <xmmspriv/xmms_ringbuf.h>
+
+SETUP (ringbuf) {
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+static gboolean
+count_hotspot (void *arg)
+{
+	gint *count = (gint *) arg;
+	(*count)++;
+	return TRUE;
+}
+
+static void
+check_wrap_around (xmms_ringbuf_t *ringbuf)
+{
+	guint8 in[12], out[12];
+	guint i;
+
+	for (i = 0; i < sizeof (in); i++) {
+		in[i] = i;
+	}
+
+	CU_ASSERT_EQUAL (16, xmms_ringbuf_size (ringbuf));
+
+	/* move the indices close to the end of the buffer */
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_write (ringbuf, in, 12));
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_read (ringbuf, out, 12));
+	CU_ASSERT_EQUAL (0, xmms_ringbuf_bytes_used (ringbuf));
+
+	/* ...and write across it */
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_write (ringbuf, in, 12));
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_bytes_used (ringbuf));
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_bytes_free (ringbuf));
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_write (ringbuf, in, 12));
+	CU_ASSERT_EQUAL (0, xmms_ringbuf_bytes_free (ringbuf));
+
+	memset (out, 0, sizeof (out));
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_read (ringbuf, out, 12));
+	CU_ASSERT_EQUAL (0, memcmp (in, out, 12));
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_read (ringbuf, out, 12));
+	CU_ASSERT_EQUAL (0, memcmp (in, out, 4));
+}
+
+static void
+check_hotspot (xmms_ringbuf_t *ringbuf)
+{
+	guint8 buf[8] = { 0, };
+	gint count = 0;
+
+	xmms_ringbuf_write (ringbuf, buf, 4);
+	xmms_ringbuf_hotspot_set (ringbuf, count_hotspot, NULL, &count);
+	xmms_ringbuf_write (ringbuf, buf, 4);
+
+	/* reads stop at the hotspot... */
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_read (ringbuf, buf, 8));
+	CU_ASSERT_EQUAL (0, count);
+
+	/* ...and fire it once it is reached */
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_read (ringbuf, buf, 8));
+	CU_ASSERT_EQUAL (1, count);
+
+	/* clearing drops pending hotspots */
+	xmms_ringbuf_write (ringbuf, buf, 4);
+	xmms_ringbuf_hotspot_set (ringbuf, count_hotspot, NULL, &count);
+	xmms_ringbuf_clear (ringbuf);
+	CU_ASSERT_EQUAL (0, xmms_ringbuf_bytes_used (ringbuf));
+	xmms_ringbuf_write (ringbuf, buf, 4);
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_read (ringbuf, buf, 8));
+	CU_ASSERT_EQUAL (1, count);
+}
+
+static void
+check_eos (xmms_ringbuf_t *ringbuf, GMutex *mtx)
+{
+	guint8 buf[8] = { 0, };
+
+	xmms_ringbuf_write (ringbuf, buf, 4);
+	xmms_ringbuf_set_eos (ringbuf, TRUE);
+	CU_ASSERT_FALSE (xmms_ringbuf_iseos (ringbuf));
+
+	/* must not block once eos is set */
+	if (mtx) {
+		g_mutex_lock (mtx);
+	}
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_read_wait (ringbuf, buf, 8, mtx));
+	if (mtx) {
+		g_mutex_unlock (mtx);
+	}
+
+	CU_ASSERT_TRUE (xmms_ringbuf_iseos (ringbuf));
+}
+
+CASE (test_wrap_around)
+{
+	xmms_ringbuf_t *ringbuf;
+
+	ringbuf = xmms_ringbuf_new (16);
+	check_wrap_around (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+
+	ringbuf = xmms_ringbuf_new_spsc (16);
+	check_wrap_around (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+}
+
+CASE (test_hotspot)
+{
+	xmms_ringbuf_t *ringbuf;
+
+	ringbuf = xmms_ringbuf_new (16);
+	check_hotspot (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+
+	ringbuf = xmms_ringbuf_new_spsc (16);
+	check_hotspot (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+}
+
+CASE (test_eos)
+{
+	xmms_ringbuf_t *ringbuf;
+	GMutex mtx;
+
+	g_mutex_init (&mtx);
+
+	ringbuf = xmms_ringbuf_new (16);
+	check_eos (ringbuf, &mtx);
+	xmms_ringbuf_destroy (ringbuf);
+
+	ringbuf = xmms_ringbuf_new_spsc (16);
+	check_eos (ringbuf, NULL);
+	xmms_ringbuf_destroy (ringbuf);
+
+	g_mutex_clear (&mtx);
+}
+
+static gpointer
+spsc_producer (gpointer data)
+{
+	xmms_ringbuf_t *ringbuf = (xmms_ringbuf_t *) data;
+	guint32 buf[61];
+	guint32 i, n = 0;
+
+	while (n < 100000) {
+		for (i = 0; i < G_N_ELEMENTS (buf); i++) {
+			buf[i] = n++;
+		}
+		xmms_ringbuf_write_wait (ringbuf, buf, sizeof (buf), NULL);
+	}
+	xmms_ringbuf_set_eos (ringbuf, TRUE);
+
+	return NULL;
+}
+
+CASE (test_spsc_threaded)
+{
+	xmms_ringbuf_t *ringbuf;
+	GThread *producer;
+	guint32 buf[37], expected = 0;
+	guint i, r;
+	gboolean ok = TRUE;
+
+	ringbuf = xmms_ringbuf_new_spsc (1000);
+	producer = g_thread_new ("producer", spsc_producer, ringbuf);
+
+	while (!xmms_ringbuf_iseos (ringbuf)) {
+		r = xmms_ringbuf_read_wait (ringbuf, buf, sizeof (buf), NULL);
+		for (i = 0; i < r / sizeof (guint32); i++) {
+			ok &= buf[i] == expected++;
+		}
+	}
+
+	g_thread_join (producer);
+
+	CU_ASSERT_TRUE (ok);
+	CU_ASSERT_TRUE (expected >= 100000);
+
+	xmms_ringbuf_destroy (ringbuf);
+}
+
+static void
+check_regions (xmms_ringbuf_t *ringbuf)
+{
+	guint8 in[12], out[12];
+	gconstpointer rd;
+	gpointer wr;
+	guint i, n;
+
+	for (i = 0; i < sizeof (in); i++) {
+		in[i] = i;
+	}
+
+	/* move the indices close to the end of the buffer */
+	xmms_ringbuf_write (ringbuf, in, 12);
+	xmms_ringbuf_read (ringbuf, out, 12);
+
+	/* regions never span the end of the buffer */
+	n = xmms_ringbuf_reserve (ringbuf, &wr, 12);
+	CU_ASSERT_TRUE (n > 0 && n < 12);
+	memcpy (wr, in, n);
+	CU_ASSERT_EQUAL (0, xmms_ringbuf_bytes_used (ringbuf));
+	xmms_ringbuf_commit (ringbuf, n);
+	CU_ASSERT_EQUAL (n, xmms_ringbuf_bytes_used (ringbuf));
+
+	CU_ASSERT_EQUAL (12 - n, xmms_ringbuf_reserve (ringbuf, &wr, 12 - n));
+	memcpy (wr, in + n, 12 - n);
+	xmms_ringbuf_commit (ringbuf, 12 - n);
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_bytes_used (ringbuf));
+
+	/* peeking leaves the data in place until consumed */
+	CU_ASSERT_EQUAL (n, xmms_ringbuf_peek_region (ringbuf, &rd, 12));
+	CU_ASSERT_EQUAL (0, memcmp (rd, in, n));
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_bytes_used (ringbuf));
+	CU_ASSERT_TRUE (xmms_ringbuf_consume (ringbuf, n));
+	CU_ASSERT_EQUAL (12 - n, xmms_ringbuf_bytes_used (ringbuf));
+
+	CU_ASSERT_EQUAL (12 - n, xmms_ringbuf_peek_region (ringbuf, &rd, 12));
+	CU_ASSERT_EQUAL (0, memcmp (rd, in + n, 12 - n));
+	CU_ASSERT_TRUE (xmms_ringbuf_consume (ringbuf, 12 - n));
+	CU_ASSERT_EQUAL (0, xmms_ringbuf_bytes_used (ringbuf));
+}
+
+CASE (test_regions)
+{
+	xmms_ringbuf_t *ringbuf;
+
+	ringbuf = xmms_ringbuf_new (16);
+	check_regions (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+
+	ringbuf = xmms_ringbuf_new_spsc (16);
+	check_regions (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+}
+
+static void
+check_peek_clear (xmms_ringbuf_t *ringbuf)
+{
+	guint8 in[12], fill[16];
+	gconstpointer rd;
+	gpointer wr;
+	guint i, n;
+
+	for (i = 0; i < sizeof (in); i++) {
+		in[i] = i + 1;
+	}
+	memset (fill, 0xff, sizeof (fill));
+
+	xmms_ringbuf_write (ringbuf, in, 12);
+
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_peek_region (ringbuf, &rd, 12));
+
+	/* a clear while the region is in use, like a seek or a stop */
+	xmms_ringbuf_clear (ringbuf);
+	CU_ASSERT_EQUAL (0, xmms_ringbuf_bytes_used (ringbuf));
+
+	/* the writer gets the rest of the buffer, but not the region */
+	CU_ASSERT_EQUAL (4, xmms_ringbuf_bytes_free (ringbuf));
+	n = xmms_ringbuf_reserve (ringbuf, &wr, 16);
+	CU_ASSERT_TRUE (n <= 4);
+	memset (wr, 0xff, n);
+	xmms_ringbuf_commit (ringbuf, n);
+	xmms_ringbuf_write (ringbuf, fill, sizeof (fill));
+
+	CU_ASSERT_EQUAL (0, memcmp (rd, in, 12));
+
+	/* consuming reports the stale region and frees it */
+	CU_ASSERT_FALSE (xmms_ringbuf_consume (ringbuf, 12));
+	CU_ASSERT_EQUAL (12, xmms_ringbuf_bytes_free (ringbuf));
+}
+
+CASE (test_peek_clear)
+{
+	xmms_ringbuf_t *ringbuf;
+
+	ringbuf = xmms_ringbuf_new (16);
+	check_peek_clear (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+
+	ringbuf = xmms_ringbuf_new_spsc (16);
+	check_peek_clear (ringbuf);
+	xmms_ringbuf_destroy (ringbuf);
+}
@@ -0,0 +1,121 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+#include "xcu.h"
+
+#include <glib.h>
+#include <math.h>
+
+#include "xmms/visualization/common.h"
+
+#define FFT_LEN XMMSC_VISUALIZATION_WINDOW_SIZE
+
+SETUP (spectrum) {
+	spectrum_init ();
+	return 0;
+}
+
+CLEANUP () {
+	return 0;
+}
+
+/* straight DFT of the downmixed, Hann windowed input */
+static void
+reference_spectrum (const short *src, gint channels, gdouble *spec)
+{
+	gdouble x[FFT_LEN];
+	gint i, k, c;
+
+	for (i = 0; i < FFT_LEN; i++) {
+		gdouble sum = 0.0;
+		for (c = 0; c < channels; c++) {
+			sum += src[i * channels + c];
+		}
+		x[i] = sum / (channels << 16) * (0.5 - 0.5 * cos (2.0 * M_PI * i / FFT_LEN));
+	}
+
+	for (k = 0; k < FFT_LEN / 2; k++) {
+		gdouble re = 0.0, im = 0.0;
+		for (i = 0; i < FFT_LEN; i++) {
+			re += x[i] * cos (2.0 * M_PI * k * i / FFT_LEN);
+			im -= x[i] * sin (2.0 * M_PI * k * i / FFT_LEN);
+		}
+		spec[k] = 2.0 * hypot (re, im) / FFT_LEN;
+	}
+
+	spec[FFT_LEN / 2 - 1] /= 2;
+}
+
+static void
+assert_matches_reference (const short *src, gint channels)
+{
+	gdouble expected[FFT_LEN / 2];
+	gfloat actual[FFT_LEN / 2];
+	gint k;
+
+	reference_spectrum (src, channels, expected);
+	spectrum_compute (src, channels, actual);
+
+	for (k = 0; k < FFT_LEN / 2; k++) {
+		CU_ASSERT_DOUBLE_EQUAL (expected[k], actual[k], 1e-5);
+	}
+}
+
+CASE (test_spectrum_matches_dft)
+{
+	short stereo[FFT_LEN * 2], mono[FFT_LEN];
+	GRand *rand;
+	gint i;
+
+	rand = g_rand_new_with_seed (42);
+
+	for (i = 0; i < FFT_LEN; i++) {
+		gdouble t = 2.0 * M_PI * i / FFT_LEN;
+		stereo[2 * i] = 12000 * sin (t * 17) + g_rand_int_range (rand, -2000, 2000);
+		stereo[2 * i + 1] = 8000 * cos (t * 101.5) + g_rand_int_range (rand, -2000, 2000);
+		mono[i] = g_rand_int_range (rand, -32768, 32767);
+	}
+
+	assert_matches_reference (stereo, 2);
+	assert_matches_reference (mono, 1);
+
+	g_rand_free (rand);
+}
+
+CASE (test_spectrum_peak)
+{
+	gfloat spec[FFT_LEN / 2];
+	short samples[FFT_LEN * 2];
+	gint i, peak = 0;
+
+	/* full scale tone exactly on bin 40, same on both channels */
+	for (i = 0; i < FFT_LEN; i++) {
+		samples[2 * i] = samples[2 * i + 1] = 32767 * sin (2.0 * M_PI * 40 * i / FFT_LEN);
+	}
+
+	spectrum_compute (samples, 2, spec);
+
+	for (i = 1; i < FFT_LEN / 2; i++) {
+		if (spec[i] > spec[peak]) {
+			peak = i;
+		}
+	}
+
+	CU_ASSERT_EQUAL (40, peak);
+	/* the old analysis scaled a full scale stereo tone to a quarter */
+	CU_ASSERT_DOUBLE_EQUAL (0.25, spec[40], 0.01);
+	CU_ASSERT (spec[45] < 1e-4);
+}
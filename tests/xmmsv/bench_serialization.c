@@ -0,0 +1,164 @@
+/*  XMMS2 - X Music Multiplexer System
+ *  Copyright (C) 2003-2017 XMMS2 Team
+ *
+ *  PLUGINS ARE NOT CONSIDERED TO BE DERIVED WORK !!!
+ *
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 2.1 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ */
+
+/* Measures serializing and deserializing values shaped like large IPC
+ * replies: a medialib query result (a list of dicts), a flat list of
+ * ids, and a big binary such as cover art.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <xmmsc/xmmsv.h>
+
+static double
+now (void)
+{
+	struct timespec ts;
+
+	clock_gettime (CLOCK_MONOTONIC, &ts);
+
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static xmmsv_t *
+make_query_result (int count)
+{
+	xmmsv_t *list, *dict;
+	char buf[64];
+	int i;
+
+	list = xmmsv_new_list ();
+
+	for (i = 0; i < count; i++) {
+		dict = xmmsv_new_dict ();
+
+		xmmsv_dict_set_int (dict, "id", i + 1);
+		snprintf (buf, sizeof (buf), "Artist %d", i % 100);
+		xmmsv_dict_set_string (dict, "artist", buf);
+		snprintf (buf, sizeof (buf), "Album %d", i % 1000);
+		xmmsv_dict_set_string (dict, "album", buf);
+		snprintf (buf, sizeof (buf), "Track number %d", i);
+		xmmsv_dict_set_string (dict, "title", buf);
+		xmmsv_dict_set_int (dict, "duration", 180000 + i);
+		xmmsv_dict_set_int (dict, "tracknr", i % 20);
+
+		xmmsv_list_append (list, dict);
+		xmmsv_unref (dict);
+	}
+
+	return list;
+}
+
+static xmmsv_t *
+make_id_list (int count)
+{
+	xmmsv_t *list, *val;
+	int i;
+
+	list = xmmsv_new_list ();
+	xmmsv_list_restrict_type (list, XMMSV_TYPE_INT64);
+
+	for (i = 0; i < count; i++) {
+		val = xmmsv_new_int (i + 1);
+		xmmsv_list_append (list, val);
+		xmmsv_unref (val);
+	}
+
+	return list;
+}
+
+static xmmsv_t *
+make_binary (int size)
+{
+	unsigned char *data;
+	xmmsv_t *bin;
+	int i;
+
+	data = malloc (size);
+	for (i = 0; i < size; i++) {
+		data[i] = i * 31;
+	}
+
+	bin = xmmsv_new_bin (data, size);
+	free (data);
+
+	return bin;
+}
+
+static void
+run (const char *name, xmmsv_t *value, int rounds)
+{
+	double start, serialize, deserialize;
+	const unsigned char *data;
+	unsigned int len = 0;
+	xmmsv_t *bin, *copy;
+	int i;
+
+	start = now ();
+	for (i = 0; i < rounds; i++) {
+		bin = xmmsv_serialize (value);
+		xmmsv_get_bin (bin, &data, &len);
+		xmmsv_unref (bin);
+	}
+	serialize = (now () - start) / rounds;
+
+	bin = xmmsv_serialize (value);
+	start = now ();
+	for (i = 0; i < rounds; i++) {
+		copy = xmmsv_deserialize (bin);
+		xmmsv_unref (copy);
+	}
+	deserialize = (now () - start) / rounds;
+	xmmsv_unref (bin);
+
+	printf ("%-14s %9u bytes: serialize %8.2f ms (%7.1f MiB/s), "
+	        "deserialize %8.2f ms (%7.1f MiB/s)\n",
+	        name, len,
+	        serialize * 1000, len / (1024.0 * 1024.0) / serialize,
+	        deserialize * 1000, len / (1024.0 * 1024.0) / deserialize);
+}
+
+int
+main (int argc, char **argv)
+{
+	xmmsv_t *value;
+	int rounds = 5;
+
+	if (argc > 1) {
+		rounds = atoi (argv[1]);
+		if (rounds < 1) {
+			fprintf (stderr, "usage: %s [rounds]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	value = make_query_result (50000);
+	run ("query result", value, rounds);
+	xmmsv_unref (value);
+
+	value = make_id_list (500000);
+	run ("id list", value, rounds);
+	xmmsv_unref (value);
+
+	value = make_binary (8 * 1024 * 1024);
+	run ("binary", value, rounds);
+	xmmsv_unref (value);
+
+	return 0;
+}
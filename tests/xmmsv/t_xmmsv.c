@@ -540,6 +540,86 @@ CASE (test_xmmsv_type_list_restrict_2) {
 
 }
 
+CASE (test_xmmsv_type_list_packed) {
+	xmmsv_list_iter_t *it;
+	xmmsv_t *value, *copy, *tmp, *entry;
+	int64_t i;
+
+	value = xmmsv_new_list ();
+
+	/* values appended before the restriction are kept */
+	CU_ASSERT_TRUE (xmmsv_list_append_int (value, 5));
+	CU_ASSERT_TRUE (xmmsv_list_restrict_type (value, XMMSV_TYPE_INT64));
+
+	for (i = 6; i < 10; i++) {
+		CU_ASSERT_TRUE (xmmsv_list_append_int (value, i));
+	}
+
+	tmp = xmmsv_new_int (4);
+	CU_ASSERT_TRUE (xmmsv_list_insert (value, 0, tmp));
+	xmmsv_unref (tmp);
+
+	tmp = xmmsv_new_string ("x");
+	CU_ASSERT_FALSE (xmmsv_list_append (value, tmp));
+	CU_ASSERT_FALSE (xmmsv_list_set (value, 0, tmp));
+	xmmsv_unref (tmp);
+
+	/* { 4, 5, 6, 7, 8, 9 } */
+	CU_ASSERT_EQUAL (xmmsv_list_get_size (value), 6);
+	CU_ASSERT_TRUE (xmmsv_list_get_int64 (value, -1, &i));
+	CU_ASSERT_EQUAL (i, 9);
+
+	/* borrowed references stay valid while the list is unchanged */
+	CU_ASSERT_TRUE (xmmsv_list_get (value, 2, &entry));
+	CU_ASSERT_TRUE (xmmsv_list_get (value, 2, &tmp));
+	CU_ASSERT_PTR_EQUAL (entry, tmp);
+	CU_ASSERT_TRUE (xmmsv_get_int64 (entry, &i));
+	CU_ASSERT_EQUAL (i, 6);
+
+	CU_ASSERT_EQUAL (xmmsv_list_index_of (value, entry), 2);
+
+	CU_ASSERT_TRUE (xmmsv_list_insert_int (value, 2, 1));
+	CU_ASSERT_TRUE (xmmsv_list_set_int (value, -1, 10));
+	CU_ASSERT_TRUE (xmmsv_list_move (value, 0, 3));
+	CU_ASSERT_TRUE (xmmsv_list_remove (value, 1));
+
+	/* { 5, 6, 4, 7, 8, 10 } */
+	CU_ASSERT_TRUE (xmmsv_get_list_iter (value, &it));
+	CU_ASSERT_TRUE (xmmsv_list_iter_seek (it, 1));
+	CU_ASSERT_TRUE (xmmsv_list_iter_entry (it, &tmp));
+	CU_ASSERT_PTR_EQUAL (tmp, entry);
+
+	CU_ASSERT_TRUE (xmmsv_list_iter_insert_int (it, 2));
+	CU_ASSERT_TRUE (xmmsv_list_iter_entry_int64 (it, &i));
+	CU_ASSERT_EQUAL (i, 2);
+	xmmsv_list_iter_explicit_destroy (it);
+
+	/* { 5, 2, 6, 4, 7, 8, 10 } */
+	xmmsv_list_sort (value, list_compare_int);
+
+	copy = xmmsv_copy (value);
+	xmmsv_unref (value);
+
+	CU_ASSERT_TRUE (xmmsv_list_has_type (copy, XMMSV_TYPE_INT64));
+	CU_ASSERT_EQUAL (xmmsv_list_get_size (copy), 7);
+
+	CU_ASSERT_TRUE (xmmsv_list_get_int64 (copy, 0, &i));
+	CU_ASSERT_EQUAL (i, 2);
+	CU_ASSERT_TRUE (xmmsv_list_get_int64 (copy, 1, &i));
+	CU_ASSERT_EQUAL (i, 4);
+	CU_ASSERT_TRUE (xmmsv_list_get_int64 (copy, 3, &i));
+	CU_ASSERT_EQUAL (i, 6);
+	CU_ASSERT_TRUE (xmmsv_list_get_int64 (copy, 6, &i));
+	CU_ASSERT_EQUAL (i, 10);
+
+	CU_ASSERT_TRUE (xmmsv_list_clear (copy));
+	CU_ASSERT_TRUE (xmmsv_list_append_int (copy, 3));
+	CU_ASSERT_TRUE (xmmsv_list_get_int64 (copy, 0, &i));
+	CU_ASSERT_EQUAL (i, 3);
+
+	xmmsv_unref (copy);
+}
+
 static void _dict_foreach (const char *key, xmmsv_t *value, void *udata)
 {
 	CU_ASSERT_EQUAL (xmmsv_get_type (value), XMMSV_TYPE_INT32);
@@ -996,6 +1076,68 @@ CASE (test_xmmsv_type_bitbuffer_ro)
 	xmmsv_unref (value);
 }
 
+CASE (test_xmmsv_type_bitbuffer_unaligned)
+{
+	xmmsv_t *value;
+	const unsigned char *buf;
+	unsigned char b[300];
+	int64_t r;
+	int i;
+
+	for (i = 0; i < 300; i++) {
+		b[i] = i;
+	}
+
+	value = xmmsv_new_bitbuffer ();
+
+	/* mix byte aligned and unaligned writes past the first growth */
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_bits (value, 3, 5));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_bits (value, 32, 0xdeadbeef));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, b, 300));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_align (value));
+	CU_ASSERT_EQUAL (0, xmmsv_bitbuffer_pos (value) % 8);
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_bits (value, 64, -2));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_data (value, b, 300));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_put_bits (value, 16, 0x1234));
+
+	CU_ASSERT_EQUAL (xmmsv_bitbuffer_pos (value), xmmsv_bitbuffer_len (value));
+
+	/* the 3 bit prefix shifts the following bytes */
+	buf = xmmsv_bitbuffer_buffer (value);
+	CU_ASSERT_EQUAL (0xbb, buf[0]);
+	CU_ASSERT_EQUAL (0xd5, buf[1]);
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_rewind (value));
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 3, &r));
+	CU_ASSERT_EQUAL (5, r);
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 32, &r));
+	CU_ASSERT_EQUAL (0xdeadbeef, r);
+
+	memset (b, 0, sizeof (b));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_data (value, b, 300));
+	CU_ASSERT_EQUAL (0, b[0]);
+	CU_ASSERT_EQUAL (255, b[255]);
+	CU_ASSERT_EQUAL (43, b[299]);
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_align (value));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 64, &r));
+	CU_ASSERT_EQUAL (-2, r);
+
+	memset (b, 0, sizeof (b));
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_data (value, b, 300));
+	CU_ASSERT_EQUAL (1, b[1]);
+	CU_ASSERT_EQUAL (43, b[299]);
+
+	CU_ASSERT_TRUE (xmmsv_bitbuffer_get_bits (value, 16, &r));
+	CU_ASSERT_EQUAL (0x1234, r);
+
+	CU_ASSERT_FALSE (xmmsv_bitbuffer_get_bits (value, 1, &r));
+	CU_ASSERT_FALSE (xmmsv_bitbuffer_get_data (value, b, 1));
+
+	xmmsv_unref (value);
+}
+
 CASE (test_xmmsv_list_flatten) {
 	xmmsv_t *list, *flat, *tmp;
 	int l1[] = {0, 1, 2, 3};
@@ -550,6 +550,47 @@ CASE (test_xmmsv_serialize_restricted_list)
 	xmmsv_unref (value);
 }
 
+CASE (test_xmmsv_serialize_packed_list)
+{
+	xmmsv_t *bin, *value, *truncated;
+	const unsigned char *data;
+	unsigned int length;
+	int64_t i, j;
+
+	/* spans several conversion chunks */
+	value = xmmsv_new_list ();
+	xmmsv_list_restrict_type (value, XMMSV_TYPE_INT64);
+	for (i = 0; i < 1500; i++) {
+		xmmsv_list_append_int (value, (i - 750) * INT64_C (0x100000001));
+	}
+
+	bin = xmmsv_serialize (value);
+	xmmsv_unref (value);
+
+	CU_ASSERT_TRUE (xmmsv_get_bin (bin, &data, &length));
+	CU_ASSERT_EQUAL (length, 12 + 1500 * 8);
+
+	/* the last entry: 749 * 0x100000001 */
+	CU_ASSERT_EQUAL (data[length - 5], 0xed);
+	CU_ASSERT_EQUAL (data[length - 1], 0xed);
+
+	value = xmmsv_deserialize (bin);
+	CU_ASSERT_PTR_NOT_NULL_FATAL (value);
+	CU_ASSERT_EQUAL (xmmsv_list_get_size (value), 1500);
+
+	for (i = 0; i < 1500; i++) {
+		CU_ASSERT_TRUE (xmmsv_list_get_int64 (value, i, &j));
+		CU_ASSERT_EQUAL (j, (i - 750) * INT64_C (0x100000001));
+	}
+	xmmsv_unref (value);
+
+	/* a list cut short must not parse */
+	truncated = xmmsv_new_bin (data, length - 4);
+	CU_ASSERT_PTR_NULL (xmmsv_deserialize (truncated));
+	xmmsv_unref (truncated);
+
+	xmmsv_unref (bin);
+}
 
 CASE (test_xmmsv_serialize_dict)
 {